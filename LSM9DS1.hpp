@@ -0,0 +1,307 @@
+/******************************************************************************
+
+	LSM9DS1.hpp
+	Header-only C++ driver for the LSM9DS1, specialized at compile time.
+
+Lsm9ds1<Bus, Config> drives the same device as SparkFunLSM9DS1.c, over the
+same register map (LSM9DS1_Registers.h), but everything the C driver decides
+at run time is a template parameter here:
+	- Bus is the transport. Its read()/write() are called directly, so there
+	  is no commInterface switch and no xgReadBytes/I2CreadBytes layering.
+	- Config holds addresses, scales, data rates and axis remaps as
+	  constexpr values. The control register images, the sensitivities and
+	  the sign/axis permutation fold into constants, and a sample read
+	  inlines to one bus call followed by three multiplies.
+
+A Bus provides:
+	bool read(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count);
+	bool write(uint8_t address, uint8_t subAddress, uint8_t value);
+	static constexpr uint8_t magBurst; // OR'ed into multi-byte mag sub-addresses
+I2CIfBus (i2c_if, target) and SimBus (LSM9DS1_Sim, host) are provided;
+SimBus only in host builds that define LSM9DS1_SIM, so target firmware
+does not pull in the simulator.
+
+Example:
+	struct Config : lsm9ds1::DefaultConfig {
+		static constexpr auto accelScale = lsm9ds1::AccelScale::g8;
+		using AccelAxes = lsm9ds1::Remap<-2, +1, +3>; // board rotated 90 deg
+	};
+	lsm9ds1::I2CIfBus bus{handle};
+	lsm9ds1::Lsm9ds1<lsm9ds1::I2CIfBus, Config> imu{bus};
+	imu.begin();
+	lsm9ds1::Vector3 a;
+	imu.readAccel(a);
+******************************************************************************/
+
+#ifndef __LSM9DS1_HPP__
+#define __LSM9DS1_HPP__
+
+#include <stdint.h>
+
+#include "LSM9DS1_Registers.h"
+#include "LSM9DS1_RegMap.h"
+#ifdef LSM9DS1_SIM
+#include "LSM9DS1_Sim.h"
+#endif
+
+#if defined(__has_include)
+#if __has_include("drivers/i2c_if.h")
+#include "drivers/i2c_if.h"
+#define LSM9DS1_HPP_I2C_IF
+#endif
+#endif
+
+namespace lsm9ds1 {
+
+// Full-scale selections, valued as the FS_G/FS_XL/FS_M field codes.
+enum class GyroScale : uint8_t { dps245 = 0, dps500 = 1, dps2000 = 3 };
+enum class AccelScale : uint8_t { g2 = 0, g16 = 1, g4 = 2, g8 = 3 };
+enum class MagScale : uint8_t { gauss4 = 0, gauss8 = 1, gauss12 = 2, gauss16 = 3 };
+
+// Axis remap: each output axis takes the sensor axis +-1 (X), +-2 (Y) or
+// +-3 (Z); a negative value flips the sign.
+template <int X, int Y, int Z>
+struct Remap
+{
+	static_assert(X != 0 && Y != 0 && Z != 0 && X >= -3 && X <= 3 &&
+	              Y >= -3 && Y <= 3 && Z >= -3 && Z <= 3, "axes are +-1..3");
+	static constexpr int axis[3] = {X, Y, Z};
+};
+
+// Same defaults as LSM9DS1_init() with SA0 = SA1 = 1.
+struct DefaultConfig
+{
+	static constexpr uint8_t xgAddress = 0x6B;
+	static constexpr uint8_t mAddress = 0x1E;
+
+	static constexpr GyroScale gyroScale = GyroScale::dps245;
+	static constexpr uint8_t gyroODR = 6;       // 952 Hz, see setGyroODR()
+	static constexpr uint8_t gyroBandwidth = 0;
+
+	static constexpr AccelScale accelScale = AccelScale::g2;
+	static constexpr uint8_t accelODR = 6;      // used when the gyro is off
+	static constexpr int8_t accelBandwidth = -1;// -1: set by the ODR
+
+	static constexpr MagScale magScale = MagScale::gauss4;
+	static constexpr uint8_t magODR = 7;        // 80 Hz, see setMagODR()
+	static constexpr uint8_t magPerformance = 3;// ultra-high, X/Y and Z
+
+	using GyroAxes = Remap<1, 2, 3>;
+	using AccelAxes = Remap<1, 2, 3>;
+	using MagAxes = Remap<1, 2, 3>;
+};
+
+struct Vector3
+{
+	float x, y, z;
+};
+
+struct Raw3
+{
+	int16_t x, y, z;
+};
+
+namespace detail {
+
+constexpr uint8_t field(int mask, int shift, int value)
+{
+	return (uint8_t)((value << shift) & mask);
+}
+
+// Sensitivities of SparkFunLSM9DS1.c, per LSB.
+constexpr float gyroRes(GyroScale s)
+{
+	return s == GyroScale::dps2000 ? 0.07f : s == GyroScale::dps500 ? 0.0175f : 0.00875f;
+}
+
+constexpr float accelRes(AccelScale s)
+{
+	return s == AccelScale::g16 ? 0.000732f : s == AccelScale::g8 ? 0.000244f :
+	       s == AccelScale::g4 ? 0.000122f : 0.000061f;
+}
+
+constexpr float magRes(MagScale s)
+{
+	return s == MagScale::gauss16 ? 0.00058f : s == MagScale::gauss12 ? 0.00043f :
+	       s == MagScale::gauss8 ? 0.00029f : 0.00014f;
+}
+
+// One output axis of a little-endian X,Y,Z register block, remapped and
+// scaled. Axis and sign are template constants: this is a load and a
+// multiply.
+template <int Axis>
+inline float axis(const uint8_t *raw, float res)
+{
+	constexpr int index = (Axis < 0 ? -Axis : Axis) - 1;
+	constexpr float sign = Axis < 0 ? -1.0f : 1.0f;
+	return (int16_t)(raw[2 * index] | (raw[2 * index + 1] << 8)) * (sign * res);
+}
+
+template <class Axes>
+inline void convert(const uint8_t *raw, float res, Vector3 &out)
+{
+	out.x = axis<Axes::axis[0]>(raw, res);
+	out.y = axis<Axes::axis[1]>(raw, res);
+	out.z = axis<Axes::axis[2]>(raw, res);
+}
+
+} // namespace detail
+
+template <class Bus, class Config = DefaultConfig>
+class Lsm9ds1
+{
+public:
+	// Register images written by begin(), see initGyro()/initAccel()/initMag().
+	static constexpr uint8_t ctrlReg1G =
+		detail::field(LSM9DS1_ODR_G_MASK, LSM9DS1_ODR_G_SHIFT, Config::gyroODR) |
+		detail::field(LSM9DS1_FS_G_MASK, LSM9DS1_FS_G_SHIFT, (int)Config::gyroScale) |
+		detail::field(LSM9DS1_BW_G_MASK, LSM9DS1_BW_G_SHIFT, Config::gyroBandwidth);
+	static constexpr uint8_t ctrlReg4 =
+		(int)LSM9DS1_ZEN_G_MASK | LSM9DS1_YEN_G_MASK | LSM9DS1_XEN_G_MASK | LSM9DS1_LIR_XL1_MASK;
+	static constexpr uint8_t ctrlReg5XL =
+		(int)LSM9DS1_ZEN_XL_MASK | LSM9DS1_YEN_XL_MASK | LSM9DS1_XEN_XL_MASK;
+	static constexpr uint8_t ctrlReg6XL =
+		detail::field(LSM9DS1_ODR_XL_MASK, LSM9DS1_ODR_XL_SHIFT, Config::accelODR) |
+		detail::field(LSM9DS1_FS_XL_MASK, LSM9DS1_FS_XL_SHIFT, (int)Config::accelScale) |
+		(Config::accelBandwidth >= 0 ?
+		 ((int)LSM9DS1_BW_SCAL_ODR_MASK |
+		  detail::field(LSM9DS1_BW_XL_MASK, LSM9DS1_BW_XL_SHIFT, Config::accelBandwidth)) : 0);
+	static constexpr uint8_t ctrlReg1M =
+		detail::field(LSM9DS1_OM_MASK, LSM9DS1_OM_SHIFT, Config::magPerformance) |
+		detail::field(LSM9DS1_DO_MASK, LSM9DS1_DO_SHIFT, Config::magODR);
+	static constexpr uint8_t ctrlReg2M =
+		detail::field(LSM9DS1_FS_M_MASK, LSM9DS1_FS_M_SHIFT, (int)Config::magScale);
+	static constexpr uint8_t ctrlReg4M =
+		detail::field(LSM9DS1_OMZ_MASK, LSM9DS1_OMZ_SHIFT, Config::magPerformance);
+
+	static constexpr float gyroRes = detail::gyroRes(Config::gyroScale);
+	static constexpr float accelRes = detail::accelRes(Config::accelScale);
+	static constexpr float magRes = detail::magRes(Config::magScale);
+
+	explicit Lsm9ds1(Bus &bus) : bus_(bus) {}
+
+	// begin() -- Check both WHO_AM_I registers and write the configuration.
+	bool begin()
+	{
+		uint8_t xgId = 0, mId = 0;
+
+		if (!bus_.read(Config::xgAddress, WHO_AM_I_XG, &xgId, 1) ||
+		    !bus_.read(Config::mAddress, WHO_AM_I_M, &mId, 1) ||
+		    (xgId != WHO_AM_I_AG_RSP) || (mId != WHO_AM_I_M_RSP))
+			return false;
+
+		return bus_.write(Config::xgAddress, CTRL_REG1_G, ctrlReg1G) &&
+		       bus_.write(Config::xgAddress, CTRL_REG2_G, 0) &&
+		       bus_.write(Config::xgAddress, CTRL_REG3_G, 0) &&
+		       bus_.write(Config::xgAddress, CTRL_REG4, ctrlReg4) &&
+		       bus_.write(Config::xgAddress, CTRL_REG5_XL, ctrlReg5XL) &&
+		       bus_.write(Config::xgAddress, CTRL_REG6_XL, ctrlReg6XL) &&
+		       bus_.write(Config::xgAddress, CTRL_REG7_XL, 0) &&
+		       bus_.write(Config::mAddress, CTRL_REG1_M, ctrlReg1M) &&
+		       bus_.write(Config::mAddress, CTRL_REG2_M, ctrlReg2M) &&
+		       bus_.write(Config::mAddress, CTRL_REG3_M, 0) &&
+		       bus_.write(Config::mAddress, CTRL_REG4_M, ctrlReg4M) &&
+		       bus_.write(Config::mAddress, CTRL_REG5_M, 0);
+	}
+
+	// readGyro()/readAccel()/readMag() -- One burst, converted to dps, g
+	// and gauss in the remapped frame.
+	bool readGyro(Vector3 &out)
+	{
+		uint8_t raw[6];
+		if (!bus_.read(Config::xgAddress, OUT_X_L_G, raw, 6)) return false;
+		detail::convert<typename Config::GyroAxes>(raw, gyroRes, out);
+		return true;
+	}
+
+	bool readAccel(Vector3 &out)
+	{
+		uint8_t raw[6];
+		if (!bus_.read(Config::xgAddress, OUT_X_L_XL, raw, 6)) return false;
+		detail::convert<typename Config::AccelAxes>(raw, accelRes, out);
+		return true;
+	}
+
+	bool readMag(Vector3 &out)
+	{
+		uint8_t raw[6];
+		if (!bus_.read(Config::mAddress, OUT_X_L_M | Bus::magBurst, raw, 6)) return false;
+		detail::convert<typename Config::MagAxes>(raw, magRes, out);
+		return true;
+	}
+
+	// readGyroRaw()/readAccelRaw()/readMagRaw() -- Register values, sensor frame.
+	bool readGyroRaw(Raw3 &out) { return readRaw(Config::xgAddress, OUT_X_L_G, out); }
+	bool readAccelRaw(Raw3 &out) { return readRaw(Config::xgAddress, OUT_X_L_XL, out); }
+	bool readMagRaw(Raw3 &out) { return readRaw(Config::mAddress, OUT_X_L_M | Bus::magBurst, out); }
+
+	// readTemp() -- Degrees C, same conversion as LSM9DS1_readTemp().
+	bool readTemp(int16_t &out)
+	{
+		uint8_t raw[2];
+		if (!bus_.read(Config::xgAddress, OUT_TEMP_L, raw, 2)) return false;
+		out = 25 + ((int16_t)(raw[0] | (raw[1] << 8)) >> 8);
+		return true;
+	}
+
+	Bus &bus() { return bus_; }
+
+private:
+	bool readRaw(uint8_t address, uint8_t subAddress, Raw3 &out)
+	{
+		uint8_t raw[6];
+		if (!bus_.read(address, subAddress, raw, 6)) return false;
+		out.x = (int16_t)(raw[0] | (raw[1] << 8));
+		out.y = (int16_t)(raw[2] | (raw[3] << 8));
+		out.z = (int16_t)(raw[4] | (raw[5] << 8));
+		return true;
+	}
+
+	Bus &bus_;
+};
+
+#ifdef LSM9DS1_HPP_I2C_IF
+// Transport over an i2c_if bus handle.
+struct I2CIfBus
+{
+	static constexpr uint8_t magBurst = 0x80;
+
+	I2C_IF_Handle handle;
+
+	bool read(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count)
+	{
+		return I2C_IF_ReadFrom(handle, address, &subAddress, 1, dest, count) == 0;
+	}
+
+	bool write(uint8_t address, uint8_t subAddress, uint8_t value)
+	{
+		uint8_t data[2] = {subAddress, value};
+		return I2C_IF_Write(handle, address, data, 2, 1) == 0;
+	}
+};
+#endif
+
+#ifdef LSM9DS1_SIM
+// Transport over the host register model.
+struct SimBus
+{
+	static constexpr uint8_t magBurst = 0x80;
+
+	lsm9ds1_sim *sim;
+
+	bool read(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count)
+	{
+		return LSM9DS1_simRead(sim, address, subAddress, dest, count) == 0;
+	}
+
+	bool write(uint8_t address, uint8_t subAddress, uint8_t value)
+	{
+		uint8_t data[2] = {subAddress, value};
+		return LSM9DS1_simWrite(sim, address, data, 2) == 0;
+	}
+};
+#endif
+
+} // namespace lsm9ds1
+
+#endif
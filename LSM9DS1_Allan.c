@@ -0,0 +1,302 @@
+/******************************************************************************
+
+	LSM9DS1_Allan.c
+	Streaming Allan deviation and noise model of the LSM9DS1 gyro or accel.
+
+Level k keeps a ring of 2 q + 1 values of S, q = min(2^k, OVERLAP), taken
+every h = 2^k / q samples; after each write the newest entry is S[t + 2m],
+the middle one S[t + m] and the oldest S[t]. h is a power of two, so the
+test on the sample counter stays right when it wraps.
+
+The squares are summed in double: at a few levels per sample that is
+cheap even in software, and a float sum would stop growing after some
+10^7 terms. The fit runs once, in double, on columns scaled to unit norm
+(tau^-2 to tau^2 spans over twenty decades otherwise).
+******************************************************************************/
+
+#include "LSM9DS1_Allan.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MODEL_TERMS		5
+#define PI_D			3.14159265358979
+#define LN2_D			0.69314718055995
+
+// Octave-to-octave deviation ratio above which a leading point is taken
+// as filtered, 2^-0.45 (white noise gives 2^-0.5).
+#define WHITE_OCTAVE_RATIO	0.732f
+
+// Ring entries per cluster length at level k.
+static uint32_t levelSpan(uint8_t k)
+{
+	uint32_t m = 1UL << k;
+
+	return (m < LSM9DS1_ALLAN_OVERLAP) ? m : LSM9DS1_ALLAN_OVERLAP;
+}
+
+bool LSM9DS1_allanInit(lsm9ds1_allan *allan, uint8_t source, float scale,
+                       float periodS)
+{
+	uint8_t k;
+
+	if ((source > LSM9DS1_ALLAN_ACCEL) || !(periodS > 0.0f))
+		return false;
+
+	memset(allan, 0, sizeof(*allan));
+	allan->source = source;
+	allan->scale = scale;
+	allan->periodS = periodS;
+	// Every level starts with S = 0 before the first sample
+	for (k = 0; k < LSM9DS1_ALLAN_LEVELS; k++)
+	{
+		allan->level[k].pos = 1;
+		allan->level[k].fill = 1;
+	}
+	return true;
+}
+
+void LSM9DS1_allanAdd(lsm9ds1_allan *allan, const int16_t *raw)
+{
+	lsm9ds1_allan_level *level;
+	uint32_t q, length, mid, old, step;
+	int64_t d;
+	uint8_t k, ii;
+
+	for (ii = 0; ii < 3; ii++)
+		allan->integral[ii] += raw[ii];
+	allan->samples++;
+
+	for (k = 0; k < LSM9DS1_ALLAN_LEVELS; k++)
+	{
+		q = levelSpan(k);
+		step = (1UL << k) / q;
+		// Higher levels sample S less often: stop at the first one not due
+		if (allan->samples & (step - 1))
+			break;
+
+		level = &allan->level[k];
+		length = 2 * q + 1;
+		for (ii = 0; ii < 3; ii++)
+			level->ring[ii][level->pos] = allan->integral[ii];
+		if (level->fill < length)
+			level->fill++;
+		if (level->fill == length)
+		{
+			mid = (level->pos + length - q) % length;
+			old = (level->pos + 1) % length;
+			for (ii = 0; ii < 3; ii++)
+			{
+				d = level->ring[ii][level->pos] - 2 * level->ring[ii][mid] +
+				    level->ring[ii][old];
+				level->sum[ii] += (double)d * (double)d;
+			}
+			level->terms++;
+		}
+		level->pos = (uint8_t)((level->pos + 1) % length);
+	}
+}
+
+void LSM9DS1_allanFeed(lsm9ds1_allan *allan, const uint8_t *samples,
+                       uint8_t count, uint8_t sampleBytes)
+{
+	const uint8_t *sample;
+	int16_t raw[3];
+	uint8_t ii, jj, offset;
+
+	if (sampleBytes == 12)
+		offset = (allan->source == LSM9DS1_ALLAN_GYRO) ? 0 : 6;
+	else if ((sampleBytes == 6) && (allan->source == LSM9DS1_ALLAN_ACCEL))
+		offset = 0;
+	else
+		return;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		sample = samples + ii * sampleBytes + offset;
+		for (jj = 0; jj < 3; jj++)
+			raw[jj] = (int16_t)((sample[2 * jj + 1] << 8) | sample[2 * jj]);
+		LSM9DS1_allanAdd(allan, raw);
+	}
+}
+
+uint8_t LSM9DS1_allanResult(const lsm9ds1_allan *allan,
+                            lsm9ds1_allan_point *points, uint8_t maxPoints)
+{
+	const lsm9ds1_allan_level *level;
+	uint8_t k, ii, found = 0;
+	double m;
+
+	for (k = 0; (k < LSM9DS1_ALLAN_LEVELS) && (found < maxPoints); k++)
+	{
+		level = &allan->level[k];
+		if (level->terms == 0)
+			break;
+		m = (double)(1UL << k);
+		points[found].tau = (float)(m * allan->periodS);
+		for (ii = 0; ii < 3; ii++)
+			points[found].adev[ii] = (float)(sqrt(level->sum[ii] / (2.0 * m * m * level->terms)) *
+			                                 allan->scale);
+		points[found].terms = level->terms;
+		found++;
+	}
+	return found;
+}
+
+// Solve the normal equations of the active columns in place (Gaussian
+// elimination, partial pivoting). Output: false if singular.
+static bool solve(double a[MODEL_TERMS][MODEL_TERMS], double *b, const bool *active,
+                  double *x)
+{
+	uint8_t idx[MODEL_TERMS], n = 0, ii, jj, kk, pivot;
+	double t;
+
+	for (ii = 0; ii < MODEL_TERMS; ii++)
+		if (active[ii])
+			idx[n++] = ii;
+
+	for (kk = 0; kk < n; kk++)
+	{
+		pivot = kk;
+		for (ii = kk + 1; ii < n; ii++)
+			if (fabs(a[idx[ii]][idx[kk]]) > fabs(a[idx[pivot]][idx[kk]]))
+				pivot = ii;
+		if (fabs(a[idx[pivot]][idx[kk]]) < 1e-12)
+			return false;
+		if (pivot != kk)
+		{
+			for (jj = 0; jj < MODEL_TERMS; jj++)
+			{
+				t = a[idx[kk]][jj]; a[idx[kk]][jj] = a[idx[pivot]][jj]; a[idx[pivot]][jj] = t;
+			}
+			t = b[idx[kk]]; b[idx[kk]] = b[idx[pivot]]; b[idx[pivot]] = t;
+		}
+		for (ii = kk + 1; ii < n; ii++)
+		{
+			t = a[idx[ii]][idx[kk]] / a[idx[kk]][idx[kk]];
+			for (jj = kk; jj < n; jj++)
+				a[idx[ii]][idx[jj]] -= t * a[idx[kk]][idx[jj]];
+			b[idx[ii]] -= t * b[idx[kk]];
+		}
+	}
+	for (ii = 0; ii < MODEL_TERMS; ii++)
+		x[ii] = 0.0;
+	for (kk = n; kk-- > 0; )
+	{
+		t = b[idx[kk]];
+		for (jj = kk + 1; jj < n; jj++)
+			t -= a[idx[kk]][idx[jj]] * x[idx[jj]];
+		x[idx[kk]] = t / a[idx[kk]][idx[kk]];
+	}
+	return true;
+}
+
+// Square root of the independent clusters behind a point; points[0] is
+// the one-sample level, as allanResult() returns them.
+static double fitWeight(const lsm9ds1_allan_point *points, uint8_t index)
+{
+	double m = points[index].tau / points[0].tau;
+
+	return sqrt(points[index].terms / ((m < LSM9DS1_ALLAN_OVERLAP) ? m : LSM9DS1_ALLAN_OVERLAP));
+}
+
+bool LSM9DS1_allanFit(const lsm9ds1_allan_point *points, uint8_t count,
+                      uint8_t axis, lsm9ds1_allan_model *model)
+{
+	double row[MODEL_TERMS], norm[MODEL_TERMS], x[MODEL_TERMS];
+	double ata[MODEL_TERMS][MODEL_TERMS], atb[MODEL_TERMS];
+	double tau, avar, w;
+	bool active[MODEL_TERMS];
+	uint8_t ii, jj, kk, first = 0, used = 0, activeCount = MODEL_TERMS, worst;
+
+	memset(model, 0, sizeof(*model));
+	if ((axis > 2) || (count == 0))
+		return false;
+
+	// The output filter holds the short clusters below the white-noise
+	// line, which the model cannot follow: skip the leading points until
+	// the deviation falls at the -1/2 slope (quantization falls faster)
+	while ((first + 1 < count) &&
+	       (points[first + 1].adev[axis] > WHITE_OCTAVE_RATIO * points[first].adev[axis]))
+		first++;
+	if (count - first < 3)
+		first = 0;
+
+	// Relative residuals weighted by the square root of the independent
+	// clusters, terms / min(m, OVERLAP): rows are basis / AVAR
+	memset(norm, 0, sizeof(norm));
+	for (ii = first; ii < count; ii++)
+	{
+		avar = (double)points[ii].adev[axis] * points[ii].adev[axis];
+		if ((points[ii].terms == 0) || !(avar > 0.0))
+			continue;
+		used++;
+		if ((model->minAdev == 0.0f) || (points[ii].adev[axis] < model->minAdev))
+		{
+			model->minAdev = points[ii].adev[axis];
+			model->minTau = points[ii].tau;
+		}
+		tau = points[ii].tau;
+		w = fitWeight(points, ii) / avar;
+		for (jj = 0; jj < MODEL_TERMS; jj++)
+		{
+			row[jj] = w * pow(tau, (double)jj - 2.0);
+			norm[jj] += row[jj] * row[jj];
+		}
+	}
+	if (used < 2)
+		return false;
+	for (jj = 0; jj < MODEL_TERMS; jj++)
+	{
+		norm[jj] = sqrt(norm[jj]);
+		active[jj] = true;
+	}
+	// No more terms than points
+	for (jj = MODEL_TERMS; (activeCount > used) && (jj-- > 0); activeCount--)
+		active[jj] = false;
+
+	// Active set: drop the most negative coefficient until all are >= 0
+	while (activeCount > 0)
+	{
+		memset(ata, 0, sizeof(ata));
+		memset(atb, 0, sizeof(atb));
+		for (ii = first; ii < count; ii++)
+		{
+			avar = (double)points[ii].adev[axis] * points[ii].adev[axis];
+			if ((points[ii].terms == 0) || !(avar > 0.0))
+				continue;
+			tau = points[ii].tau;
+			w = fitWeight(points, ii) / avar;
+			for (jj = 0; jj < MODEL_TERMS; jj++)
+				row[jj] = w * pow(tau, (double)jj - 2.0) / norm[jj];
+			for (jj = 0; jj < MODEL_TERMS; jj++)
+			{
+				for (kk = 0; kk < MODEL_TERMS; kk++)
+					ata[jj][kk] += row[jj] * row[kk];
+				atb[jj] += row[jj] * w * avar;
+			}
+		}
+		if (!solve(ata, atb, active, x))
+			return false;
+
+		worst = MODEL_TERMS;
+		for (jj = 0; jj < MODEL_TERMS; jj++)
+			if (active[jj] && (x[jj] < 0.0) && ((worst == MODEL_TERMS) || (x[jj] < x[worst])))
+				worst = jj;
+		if (worst == MODEL_TERMS)
+			break;
+		active[worst] = false;
+		activeCount--;
+	}
+
+	for (jj = 0; jj < MODEL_TERMS; jj++)
+		x[jj] = active[jj] ? x[jj] / norm[jj] : 0.0;
+	model->quantization = (float)sqrt(x[0] / 3.0);
+	model->randomWalk = (float)sqrt(x[1]);
+	model->biasInstability = (float)sqrt(x[2] * PI_D / (2.0 * LN2_D));
+	model->rateRandomWalk = (float)sqrt(3.0 * x[3]);
+	model->rateRamp = (float)sqrt(2.0 * x[4]);
+	return true;
+}
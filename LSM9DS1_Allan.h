@@ -0,0 +1,125 @@
+/******************************************************************************
+
+	LSM9DS1_Allan.h
+	Streaming Allan deviation and noise model of the LSM9DS1 gyro or accel.
+
+Choosing the bandwidth, ODR and filters of a unit needs its noise terms:
+angle (velocity) random walk, bias instability and rate random walk, read
+off the Allan deviation over cluster times from one sample to hours. The
+engine computes the overlapping Allan variance at octave-spaced cluster
+sizes m = 1, 2, 4, ... while the samples stream in, so a log never has to
+be stored. With S the running sum of the raw samples, each term is
+
+	(S[t + 2m] - 2 S[t + m] + S[t])^2 / (2 m^2)
+
+so a cluster size only needs S at t, t + m and t + 2m. Level k (m = 2^k)
+samples S every h = m / LSM9DS1_ALLAN_OVERLAP samples (every sample while
+m is smaller) into a ring of 2 * OVERLAP + 1 entries: clusters overlap by
+all but h samples, which keeps nearly all the variance reduction of the
+fully overlapping estimator at a fixed memory per level. Memory is
+O(log T) and the cost per sample is constant: the levels with h = 1 run
+every sample and the others half as often per octave. S is kept in 64-bit
+integers, so long runs lose no precision.
+
+LSM9DS1_allanFit() fits the usual five-term model
+
+	AVAR(tau) = 3 Q^2 / tau^2 + N^2 / tau + (2 ln 2 / pi) B^2
+	          + K^2 tau / 3 + R^2 tau^2 / 2
+
+by non-negative weighted least squares over the levels. The sensor must
+be at rest, at constant temperature, for the whole run; the longest
+usable cluster time is about a tenth of the run.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Allan_H__
+#define __LSM9DS1_Allan_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // Octave levels, the largest cluster being 2^(LEVELS - 1) samples.
+    #ifndef LSM9DS1_ALLAN_LEVELS
+    #define LSM9DS1_ALLAN_LEVELS        22
+    #endif
+
+    // Cluster starts per cluster length, a power of two.
+    #ifndef LSM9DS1_ALLAN_OVERLAP
+    #define LSM9DS1_ALLAN_OVERLAP       4
+    #endif
+
+    #define LSM9DS1_ALLAN_RING          (2 * LSM9DS1_ALLAN_OVERLAP + 1)
+
+    // Sources of allanInit().
+    #define LSM9DS1_ALLAN_GYRO          0
+    #define LSM9DS1_ALLAN_ACCEL         1
+
+    typedef struct
+    {
+        int64_t ring[3][LSM9DS1_ALLAN_RING];   // S every h samples
+        uint8_t pos;                // next ring entry
+        uint8_t fill;               // entries written, up to the ring length
+        double sum[3];              // sum of squared second differences
+        uint32_t terms;
+    } lsm9ds1_allan_level;
+
+    typedef struct
+    {
+        float tau;              // cluster time, s
+        float adev[3];          // per axis, dps or g
+        uint32_t terms;         // differences averaged
+    } lsm9ds1_allan_point;
+
+    typedef struct
+    {
+        float quantization;     // Q, units * s
+        float randomWalk;       // N (ARW or VRW), units / sqrt(Hz)
+        float biasInstability;  // B, units
+        float rateRandomWalk;   // K, units * sqrt(Hz)
+        float rateRamp;         // R, units / s
+        float minTau;           // cluster time of the smallest deviation, s
+        float minAdev;          // smallest deviation, units
+    } lsm9ds1_allan_model;
+
+    typedef struct
+    {
+        // Configuration
+        uint8_t source;               // LSM9DS1_ALLAN_GYRO or _ACCEL
+        float scale;                  // units per raw count
+        float periodS;                // sample period
+
+        // State
+        int64_t integral[3];          // S, raw counts
+        uint32_t samples;
+        lsm9ds1_allan_level level[LSM9DS1_ALLAN_LEVELS];
+    } lsm9ds1_allan;
+
+    // allanInit() -- Select the sensor and clear the levels.
+    // Input:
+    //	- source = LSM9DS1_ALLAN_GYRO (needs 12-byte samples) or _ACCEL.
+    //	- scale = LSM9DS1_calcGyro(1) or LSM9DS1_calcAccel(1).
+    //	- periodS = Sample period, s (e.g. wm.periodUs / 1e6).
+    // Output: false if source or periodS is invalid.
+    bool LSM9DS1_allanInit(lsm9ds1_allan *allan, uint8_t source, float scale,
+                           float periodS);
+
+    // allanAdd() -- Add one raw X,Y,Z sample of the selected sensor.
+    void LSM9DS1_allanAdd(lsm9ds1_allan *allan, const int16_t *raw);
+
+    // allanFeed() -- Add a block of raw FIFO samples, as stored by
+    // LSM9DS1_wmDrain() (gyro X,Y,Z then accel X,Y,Z, or accel only).
+    void LSM9DS1_allanFeed(lsm9ds1_allan *allan, const uint8_t *samples,
+                           uint8_t count, uint8_t sampleBytes);
+
+    // allanResult() -- Allan deviation of the levels with data so far.
+    // Output: Points stored, shortest cluster first, up to maxPoints.
+    uint8_t LSM9DS1_allanResult(const lsm9ds1_allan *allan,
+                                lsm9ds1_allan_point *points, uint8_t maxPoints);
+
+    // allanFit() -- Fit the noise model to one axis of allanResult().
+    // Input:
+    //	- axis = 0..2.
+    // Output: false if fewer than two points have data.
+    bool LSM9DS1_allanFit(const lsm9ds1_allan_point *points, uint8_t count,
+                          uint8_t axis, lsm9ds1_allan_model *model);
+
+#endif
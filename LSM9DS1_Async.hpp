@@ -0,0 +1,489 @@
+/******************************************************************************
+
+	LSM9DS1_Async.hpp
+	C++20 coroutine API for the LSM9DS1 over the asynchronous I2C calls.
+
+With the blocking API every sensor needs a task parked in xTaskNotifyWait.
+Here a sensor pipeline is a coroutine:
+
+	lsm9ds1::async::Task<bool> pipeline(Imu &imu)
+	{
+		if (!co_await imu.begin()) co_return false;
+		for (;;) {
+			Imu::Frame f = co_await imu.readFrame();
+			...
+		}
+	}
+
+Suspended coroutines keep only their frame (a few dozen bytes, see
+frameStats()), so any number of pipelines share one task or thread. Bus
+completions arrive as callbacks (from the I2C ISR on target) and are handed
+to a Resumer, which resumes the coroutine on the thread that runs the loop:
+	- FreeRTOSResumer: a task notification wakes the owning task.
+	- EventLoopResumer (Linux): an eventfd that can sit in any poll/epoll loop.
+
+An AsyncBus provides
+	bool readAsync(uint8_t address, uint8_t subAddress, uint8_t *dest,
+	               uint8_t count, I2C_IF_Callback done, void *arg);
+	bool writeAsync(uint8_t address, uint8_t *data, uint8_t count,
+	                I2C_IF_Callback done, void *arg);
+	static constexpr uint8_t magBurst;
+where done(arg, status) is called exactly once per accepted request.
+I2CIfAsyncBus (i2c_if) and SimAsyncBus (LSM9DS1_Sim, with LSM9DS1_SIM)
+are provided.
+******************************************************************************/
+
+#ifndef __LSM9DS1_ASYNC_HPP__
+#define __LSM9DS1_ASYNC_HPP__
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+#include "LSM9DS1.hpp"
+
+#if __has_include("FreeRTOS.h") && !defined(OS_IF_BAREMETAL) && !defined(OS_IF_POSIX)
+#include "FreeRTOS.h"
+#include "task.h"
+#define LSM9DS1_ASYNC_FREERTOS
+#endif
+
+#if defined(__linux__)
+#include <mutex>
+#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifndef LSM9DS1_HPP_I2C_IF
+typedef void (*I2C_IF_Callback)(void *pvArg, int iStatus);
+#endif
+
+namespace lsm9ds1 {
+namespace async {
+
+// Coroutine frame accounting. Frames are created and destroyed on the
+// resumer thread only, so plain counters are enough.
+struct FrameStats
+{
+	size_t live;        // frames currently allocated
+	size_t bytes;       // bytes currently allocated
+	size_t peakBytes;   // high-water mark of bytes
+};
+
+inline FrameStats &frameStats()
+{
+	static FrameStats stats;
+	return stats;
+}
+
+inline void *allocateFrame(size_t size)
+{
+#ifdef LSM9DS1_ASYNC_FREERTOS
+	void *frame = pvPortMalloc(size);
+#else
+	void *frame = ::operator new(size, std::nothrow);
+#endif
+	if (frame == nullptr) std::terminate();
+
+	FrameStats &stats = frameStats();
+	stats.live++;
+	stats.bytes += size;
+	if (stats.bytes > stats.peakBytes) stats.peakBytes = stats.bytes;
+	return frame;
+}
+
+inline void releaseFrame(void *frame, size_t size)
+{
+	FrameStats &stats = frameStats();
+	stats.live--;
+	stats.bytes -= size;
+#ifdef LSM9DS1_ASYNC_FREERTOS
+	vPortFree(frame);
+#else
+	::operator delete(frame);
+#endif
+}
+
+// Lazily started coroutine returning T. co_await it from another Task, or
+// start() the outermost one and keep the object alive while it runs.
+template <class T>
+class Task
+{
+public:
+	struct promise_type
+	{
+		T value{};
+		std::coroutine_handle<> continuation;
+
+		Task get_return_object()
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+			{
+				std::coroutine_handle<> next = h.promise().continuation;
+				return next ? next : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		void return_value(T v) { value = std::move(v); }
+		void unhandled_exception() { std::terminate(); }
+
+		static void *operator new(size_t size) { return allocateFrame(size); }
+		static void operator delete(void *frame, size_t size) { releaseFrame(frame, size); }
+	};
+
+	Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+	~Task() { if (handle_) handle_.destroy(); }
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+	{
+		handle_.promise().continuation = caller;
+		return handle_;
+	}
+	T await_resume() { return std::move(handle_.promise().value); }
+
+	void start() { handle_.resume(); }
+	bool done() const { return handle_.done(); }
+	T &result() { return handle_.promise().value; }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+	std::coroutine_handle<promise_type> handle_;
+};
+
+// Up to N bus requests issued back to back and awaited together. The
+// requests queue in the i2c_if ring in order, so the bus runs them without
+// waking the coroutine in between. co_await yields true if all succeeded.
+template <class Bus, class Resumer, int N>
+class Batch
+{
+public:
+	Batch(Bus &bus, Resumer &resumer) : bus_(bus), resumer_(resumer) {}
+
+	void read(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count)
+	{
+		Op &op = ops_[count_++];
+		op.address = address;
+		op.subAddress = subAddress;
+		op.dest = dest;
+		op.count = count;
+	}
+
+	void write(uint8_t address, uint8_t subAddress, uint8_t value)
+	{
+		Op &op = ops_[count_++];
+		op.address = address;
+		op.dest = nullptr;
+		op.data[0] = subAddress;
+		op.data[1] = value;
+	}
+
+	bool await_ready() const noexcept { return count_ == 0; }
+
+	bool await_suspend(std::coroutine_handle<> caller)
+	{
+		caller_ = caller;
+		// One extra count held while submitting, so a completion arriving
+		// before the loop ends cannot resume us early.
+		pending_.store(count_ + 1, std::memory_order_relaxed);
+		for (int i = 0; i < count_; i++)
+		{
+			Op &op = ops_[i];
+			bool queued = op.dest ?
+				bus_.readAsync(op.address, op.subAddress, op.dest, op.count, &Batch::done, this) :
+				bus_.writeAsync(op.address, op.data, 2, &Batch::done, this);
+			if (!queued)
+			{
+				failed_.store(true, std::memory_order_relaxed);
+				pending_.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+		// Suspend unless everything has already completed.
+		return pending_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+	}
+
+	bool await_resume() const { return !failed_.load(std::memory_order_acquire); }
+
+private:
+	struct Op
+	{
+		uint8_t address;
+		uint8_t subAddress;
+		uint8_t *dest;      // nullptr for a write
+		uint8_t count;
+		uint8_t data[2];    // sub-address and value of a write
+	};
+
+	static void done(void *arg, int status)
+	{
+		Batch *self = static_cast<Batch *>(arg);
+		if (status != 0) self->failed_.store(true, std::memory_order_relaxed);
+		if (self->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			self->resumer_.post(self->caller_);
+	}
+
+	Bus &bus_;
+	Resumer &resumer_;
+	Op ops_[N];
+	int count_ = 0;
+	std::atomic<int> pending_{0};
+	std::atomic<bool> failed_{false};
+	std::coroutine_handle<> caller_;
+};
+
+// Coroutine counterpart of Lsm9ds1<Bus, Config>, same register images and
+// conversions.
+template <class Bus, class Resumer, class Config = DefaultConfig>
+class AsyncLsm9ds1
+{
+	using Sync = Lsm9ds1<Bus, Config>;
+
+public:
+	struct Frame
+	{
+		Vector3 gyro;   // dps
+		Vector3 accel;  // g
+		Vector3 mag;    // gauss
+		bool ok;
+	};
+
+	AsyncLsm9ds1(Bus &bus, Resumer &resumer) : bus_(bus), resumer_(resumer) {}
+
+	Task<bool> begin()
+	{
+		uint8_t xgId = 0, mId = 0;
+		Batch<Bus, Resumer, 2> ids(bus_, resumer_);
+		ids.read(Config::xgAddress, WHO_AM_I_XG, &xgId, 1);
+		ids.read(Config::mAddress, WHO_AM_I_M, &mId, 1);
+		if (!co_await ids || (xgId != WHO_AM_I_AG_RSP) || (mId != WHO_AM_I_M_RSP))
+			co_return false;
+
+		Batch<Bus, Resumer, 12> config(bus_, resumer_);
+		config.write(Config::xgAddress, CTRL_REG1_G, Sync::ctrlReg1G);
+		config.write(Config::xgAddress, CTRL_REG2_G, 0);
+		config.write(Config::xgAddress, CTRL_REG3_G, 0);
+		config.write(Config::xgAddress, CTRL_REG4, Sync::ctrlReg4);
+		config.write(Config::xgAddress, CTRL_REG5_XL, Sync::ctrlReg5XL);
+		config.write(Config::xgAddress, CTRL_REG6_XL, Sync::ctrlReg6XL);
+		config.write(Config::xgAddress, CTRL_REG7_XL, 0);
+		config.write(Config::mAddress, CTRL_REG1_M, Sync::ctrlReg1M);
+		config.write(Config::mAddress, CTRL_REG2_M, Sync::ctrlReg2M);
+		config.write(Config::mAddress, CTRL_REG3_M, 0);
+		config.write(Config::mAddress, CTRL_REG4_M, Sync::ctrlReg4M);
+		config.write(Config::mAddress, CTRL_REG5_M, 0);
+		co_return co_await config;
+	}
+
+	// readFrame() -- Gyro, accel and mag bursts queued together.
+	Task<Frame> readFrame()
+	{
+		uint8_t raw[18];
+		Frame frame;
+		Batch<Bus, Resumer, 3> reads(bus_, resumer_);
+		reads.read(Config::xgAddress, OUT_X_L_G, raw, 6);
+		reads.read(Config::xgAddress, OUT_X_L_XL, raw + 6, 6);
+		reads.read(Config::mAddress, OUT_X_L_M | Bus::magBurst, raw + 12, 6);
+		frame.ok = co_await reads;
+		detail::convert<typename Config::GyroAxes>(raw, Sync::gyroRes, frame.gyro);
+		detail::convert<typename Config::AccelAxes>(raw + 6, Sync::accelRes, frame.accel);
+		detail::convert<typename Config::MagAxes>(raw + 12, Sync::magRes, frame.mag);
+		co_return frame;
+	}
+
+private:
+	Bus &bus_;
+	Resumer &resumer_;
+};
+
+#ifdef LSM9DS1_ASYNC_FREERTOS
+// Resumes coroutines in the task it is bound to. post() is called from the
+// I2C ISR and wakes that task, so the resumer must be bound before the
+// first coroutine starts: give the constructor the task handle, or call
+// bind() from the task. Capacity bounds the completions waiting to be
+// resumed, one per suspended coroutine at most.
+template <size_t Capacity = 16>
+class FreeRTOSResumer
+{
+public:
+	explicit FreeRTOSResumer(TaskHandle_t task = nullptr) : task_(task) {}
+
+	void post(std::coroutine_handle<> handle)
+	{
+		BaseType_t woken = pdFALSE;
+		UBaseType_t state;
+
+		configASSERT(task_ != nullptr);
+		state = taskENTER_CRITICAL_FROM_ISR();
+		configASSERT(head_ - tail_ < Capacity);
+		ready_[head_++ % Capacity] = handle;
+		taskEXIT_CRITICAL_FROM_ISR(state);
+		vTaskNotifyGiveFromISR(task_, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+
+	// poll() -- Resume every coroutine whose request completed.
+	void poll()
+	{
+		for (;;)
+		{
+			std::coroutine_handle<> handle;
+			taskENTER_CRITICAL();
+			if (tail_ == head_)
+			{
+				taskEXIT_CRITICAL();
+				return;
+			}
+			handle = ready_[tail_++ % Capacity];
+			taskEXIT_CRITICAL();
+			handle.resume();
+		}
+	}
+
+	// run() -- Body of the bound task. Start the coroutines once the
+	// resumer is bound, before or after run() begins.
+	void run()
+	{
+		configASSERT(task_ == xTaskGetCurrentTaskHandle());
+		for (;;)
+		{
+			poll();
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		}
+	}
+
+	// bind() -- Bind to the calling task, before starting any coroutine.
+	void bind() { task_ = xTaskGetCurrentTaskHandle(); }
+
+private:
+	std::coroutine_handle<> ready_[Capacity];
+	volatile size_t head_ = 0;
+	size_t tail_ = 0;
+	TaskHandle_t task_ = nullptr;
+};
+#endif
+
+#if defined(__linux__)
+// Resumes coroutines in the thread that services fd(). post() may be called
+// from any thread.
+class EventLoopResumer
+{
+public:
+	EventLoopResumer() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+	~EventLoopResumer() { if (fd_ >= 0) close(fd_); }
+
+	void post(std::coroutine_handle<> handle)
+	{
+		uint64_t one = 1;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ready_.push_back(handle);
+		}
+		(void)!write(fd_, &one, sizeof(one));
+	}
+
+	// fd() -- Readable when coroutines are ready; add it to the loop.
+	int fd() const { return fd_; }
+
+	// poll() -- Resume every ready coroutine. Call when fd() is readable.
+	void poll()
+	{
+		uint64_t count;
+		std::vector<std::coroutine_handle<>> ready;
+
+		(void)!read(fd_, &count, sizeof(count));
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ready.swap(ready_);
+		}
+		for (std::coroutine_handle<> handle : ready)
+			handle.resume();
+	}
+
+	// run() -- Minimal loop: wait on fd() until done() returns true.
+	template <class Done>
+	void run(Done done)
+	{
+		struct pollfd pfd = {fd_, POLLIN, 0};
+		while (!done())
+		{
+			poll();
+			if (!done()) ::poll(&pfd, 1, -1);
+		}
+	}
+
+private:
+	int fd_;
+	std::mutex mutex_;
+	std::vector<std::coroutine_handle<>> ready_;
+};
+#endif
+
+#ifdef LSM9DS1_HPP_I2C_IF
+// Transport over the asynchronous i2c_if calls.
+struct I2CIfAsyncBus
+{
+	static constexpr uint8_t magBurst = 0x80;
+
+	I2C_IF_Handle handle;
+
+	bool readAsync(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count,
+	               I2C_IF_Callback done, void *arg)
+	{
+		// The sub-address travels in the receive buffer (see I2C_IF_ReadFrom)
+		return I2C_IF_ReadFromAsync(handle, address, &subAddress, 1, dest, count,
+		                            done, arg) == 0;
+	}
+
+	bool writeAsync(uint8_t address, uint8_t *data, uint8_t count,
+	                I2C_IF_Callback done, void *arg)
+	{
+		return I2C_IF_WriteAsync(handle, address, data, count, done, arg) == 0;
+	}
+};
+#endif
+
+#ifdef LSM9DS1_SIM
+// Transport over the host register model. Requests complete immediately,
+// so co_await never actually suspends.
+struct SimAsyncBus
+{
+	static constexpr uint8_t magBurst = 0x80;
+
+	lsm9ds1_sim *sim;
+
+	bool readAsync(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count,
+	               I2C_IF_Callback done, void *arg)
+	{
+		done(arg, LSM9DS1_simRead(sim, address, subAddress, dest, count));
+		return true;
+	}
+
+	bool writeAsync(uint8_t address, uint8_t *data, uint8_t count,
+	                I2C_IF_Callback done, void *arg)
+	{
+		done(arg, LSM9DS1_simWrite(sim, address, data, count));
+		return true;
+	}
+};
+#endif
+
+} // namespace async
+} // namespace lsm9ds1
+
+#endif
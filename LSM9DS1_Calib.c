@@ -0,0 +1,889 @@
+/******************************************************************************
+
+	LSM9DS1_Calib.c
+	Full calibration of one LSM9DS1 unit from a recorded tumble.
+
+The still detector slides a 0.2 s window over the accel in raw counts,
+adding the sample entering and removing the one leaving, and trims the
+window's half-length off both ends of every still run so that the pose
+means never include the start or the end of a rotation.
+
+The fits share one Levenberg-Marquardt loop. The residual function fills
+a vector; the Jacobian is built column by column from one more call per
+parameter and kept in the work area, the normal equations (at most 12x12)
+are damped by lambda times their diagonal and solved by elimination with
+partial pivoting.
+
+The gyro residual integrates every rotation again at each call, decoding
+the samples from the log, with the exact rotation of each sample step.
+A gravity vector seen from the body turns the other way: df/dt = -w x f.
+******************************************************************************/
+
+#include "LSM9DS1_Calib.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PI_D			3.14159265358979
+#define DEG_TO_RAD_D	(PI_D / 180.0)
+
+#define STILL_HALF_S	0.1			// half the still detector window
+#define MIN_MAG_POINTS	50
+#define MAX_PARAMS		LSM9DS1_CAL_MAX_PARAMS
+#define LM_ITERATIONS	60
+#define LM_TOLERANCE	1e-12		// relative cost change that ends a fit
+
+// Plausibility limits of the fitted unit
+#define MAX_SCALE_ERROR	0.2
+#define MAX_ACCEL_RMS	0.02		// g
+#define MAX_GYRO_RMS	5.0			// deg
+#define MAX_MAG_RMS		0.1
+
+#define CRC32_POLY		0xEDB88320UL
+
+typedef void (*residual_fn)(void *context, const double *p, double *r);
+
+typedef struct
+{
+	const lsm9ds1_cal_log *log;
+	lsm9ds1_cal_work *work;
+	lsm9ds1_cal *cal;
+	bool accelTemp;				// accel fit includes the temperature coefficients
+} fit_context;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LOG: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static uint16_t get16(const uint8_t *in)
+{
+	return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *in)
+{
+	return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+	       ((uint32_t)in[3] << 24);
+}
+
+static float getFloat(const uint8_t *in)
+{
+	uint32_t bits = get32(in);
+	float value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void put16(uint8_t *out, uint16_t value)
+{
+	out[0] = (uint8_t)value;
+	out[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *out, uint32_t value)
+{
+	out[0] = (uint8_t)value;
+	out[1] = (uint8_t)(value >> 8);
+	out[2] = (uint8_t)(value >> 16);
+	out[3] = (uint8_t)(value >> 24);
+}
+
+static void putFloat(uint8_t *out, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	put32(out, bits);
+}
+
+bool LSM9DS1_calLogOpen(lsm9ds1_cal_log *log, const uint8_t *data, uint32_t len)
+{
+	if ((data == NULL) || (len < LSM9DS1_CAL_LOG_HEADER) ||
+	    (memcmp(data, "L9CL", 4) != 0) || (data[4] != LSM9DS1_CAL_LOG_VERSION) ||
+	    (((len - LSM9DS1_CAL_LOG_HEADER) % LSM9DS1_CAL_LOG_SAMPLE) != 0))
+		return false;
+
+	log->data = data;
+	log->samples = (len - LSM9DS1_CAL_LOG_HEADER) / LSM9DS1_CAL_LOG_SAMPLE;
+	log->periodNs = get32(data + 8);
+	log->gyroRes = getFloat(data + 12);
+	log->accelRes = getFloat(data + 16);
+	log->magRes = getFloat(data + 20);
+	return (log->periodNs > 0) && (log->gyroRes > 0.0f) && (log->accelRes > 0.0f) &&
+	       (log->magRes > 0.0f);
+}
+
+void LSM9DS1_calLogSample(const lsm9ds1_cal_log *log, uint32_t index,
+                          lsm9ds1_cal_sample *sample)
+{
+	const uint8_t *in = log->data + LSM9DS1_CAL_LOG_HEADER + index * LSM9DS1_CAL_LOG_SAMPLE;
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		sample->gyro[ii] = (int16_t)get16(in + 2 * ii);
+		sample->accel[ii] = (int16_t)get16(in + 6 + 2 * ii);
+		sample->mag[ii] = (int16_t)get16(in + 12 + 2 * ii);
+	}
+	sample->temperature = (int16_t)get16(in + 18);
+	sample->flags = get16(in + 20);
+}
+
+void LSM9DS1_calLogHeader(uint8_t *out, uint32_t periodNs, float gyroRes,
+                          float accelRes, float magRes)
+{
+	memcpy(out, "L9CL", 4);
+	out[4] = LSM9DS1_CAL_LOG_VERSION;
+	out[5] = 0;
+	put16(out + 6, 0);
+	put32(out + 8, periodNs);
+	putFloat(out + 12, gyroRes);
+	putFloat(out + 16, accelRes);
+	putFloat(out + 20, magRes);
+}
+
+void LSM9DS1_calLogPack(uint8_t *out, const lsm9ds1_cal_sample *sample)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		put16(out + 2 * ii, (uint16_t)sample->gyro[ii]);
+		put16(out + 6 + 2 * ii, (uint16_t)sample->accel[ii]);
+		put16(out + 12 + 2 * ii, (uint16_t)sample->mag[ii]);
+	}
+	put16(out + 18, (uint16_t)sample->temperature);
+	put16(out + 20, sample->flags);
+}
+
+static double temperatureC(int16_t raw)
+{
+	return LSM9DS1_CAL_TEMP_REF_C + raw / LSM9DS1_CAL_TEMP_LSB_PER_C;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ FITTING: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static double sumSquares(const double *r, uint32_t n)
+{
+	double sum = 0.0;
+	uint32_t ii;
+
+	for (ii = 0; ii < n; ii++)
+		sum += r[ii] * r[ii];
+	return sum;
+}
+
+// Solve a x = b in place (b becomes x). Output: false if singular.
+static bool solve(double a[MAX_PARAMS][MAX_PARAMS], double *b, uint8_t n)
+{
+	double factor, swap;
+	uint8_t row, col, pivot, kk;
+
+	for (col = 0; col < n; col++)
+	{
+		pivot = col;
+		for (row = col + 1; row < n; row++)
+			if (fabs(a[row][col]) > fabs(a[pivot][col]))
+				pivot = row;
+		if (!(fabs(a[pivot][col]) > 1e-300))
+			return false;
+		if (pivot != col)
+		{
+			for (kk = 0; kk < n; kk++)
+			{
+				swap = a[col][kk]; a[col][kk] = a[pivot][kk]; a[pivot][kk] = swap;
+			}
+			swap = b[col]; b[col] = b[pivot]; b[pivot] = swap;
+		}
+		for (row = col + 1; row < n; row++)
+		{
+			factor = a[row][col] / a[col][col];
+			for (kk = col; kk < n; kk++)
+				a[row][kk] -= factor * a[col][kk];
+			b[row] -= factor * b[col];
+		}
+	}
+	for (row = n; row-- > 0; )
+	{
+		for (kk = row + 1; kk < n; kk++)
+			b[row] -= a[row][kk] * b[kk];
+		b[row] /= a[row][row];
+	}
+	return true;
+}
+
+// Minimise the squared residuals of fn over p. Output: final cost, or a
+// negative value if it is not finite.
+static double levenberg(lsm9ds1_cal_work *work, residual_fn fn, void *context,
+                        double *p, uint8_t np, uint32_t n)
+{
+	double *r = work->residual[0], *trial = work->residual[1];
+	double normal[MAX_PARAMS][MAX_PARAMS], damped[MAX_PARAMS][MAX_PARAMS];
+	double gradient[MAX_PARAMS], delta[MAX_PARAMS], next[MAX_PARAMS];
+	double lambda = 1e-3, cost, trialCost, step;
+	uint8_t iteration, jj, kk, tries;
+	uint32_t ii;
+	bool accepted;
+
+	fn(context, p, r);
+	cost = sumSquares(r, n);
+	for (iteration = 0; (iteration < LM_ITERATIONS) && isfinite(cost); iteration++)
+	{
+		for (jj = 0; jj < np; jj++)
+		{
+			memcpy(next, p, np * sizeof(double));
+			step = 1e-7 * (fabs(p[jj]) > 1.0 ? fabs(p[jj]) : 1.0);
+			next[jj] += step;
+			fn(context, next, work->jacobian[jj]);
+			for (ii = 0; ii < n; ii++)
+				work->jacobian[jj][ii] = (work->jacobian[jj][ii] - r[ii]) / step;
+		}
+		for (jj = 0; jj < np; jj++)
+		{
+			gradient[jj] = 0.0;
+			for (ii = 0; ii < n; ii++)
+				gradient[jj] += work->jacobian[jj][ii] * r[ii];
+			for (kk = 0; kk <= jj; kk++)
+			{
+				normal[jj][kk] = 0.0;
+				for (ii = 0; ii < n; ii++)
+					normal[jj][kk] += work->jacobian[jj][ii] * work->jacobian[kk][ii];
+				normal[kk][jj] = normal[jj][kk];
+			}
+		}
+
+		accepted = false;
+		for (tries = 0; (tries < 12) && !accepted; tries++)
+		{
+			memcpy(damped, normal, sizeof(normal));
+			for (jj = 0; jj < np; jj++)
+			{
+				damped[jj][jj] += lambda * (normal[jj][jj] > 1e-12 ? normal[jj][jj] : 1e-12);
+				delta[jj] = -gradient[jj];
+			}
+			if (solve(damped, delta, np))
+			{
+				for (jj = 0; jj < np; jj++)
+					next[jj] = p[jj] + delta[jj];
+				fn(context, next, trial);
+				trialCost = sumSquares(trial, n);
+				if (trialCost < cost)
+				{
+					accepted = true;
+					memcpy(p, next, np * sizeof(double));
+					memcpy(r, trial, n * sizeof(double));
+					lambda = (lambda > 1e-12) ? lambda / 10.0 : lambda;
+					if (cost - trialCost <= LM_TOLERANCE * cost)
+						iteration = LM_ITERATIONS;
+					cost = trialCost;
+					break;
+				}
+			}
+			lambda *= 10.0;
+		}
+		if (!accepted)
+			break;
+	}
+	return isfinite(cost) ? cost : -1.0;
+}
+
+// Least-squares line through (x, y); slope 0 if x does not vary.
+static void fitLine(const double *x, const double *y, uint16_t n, double x0,
+                    double *slope, double *atX0)
+{
+	double mx = 0.0, my = 0.0, sxx = 0.0, sxy = 0.0;
+	uint16_t ii;
+
+	for (ii = 0; ii < n; ii++)
+	{
+		mx += x[ii];
+		my += y[ii];
+	}
+	mx /= n;
+	my /= n;
+	for (ii = 0; ii < n; ii++)
+	{
+		sxx += (x[ii] - mx) * (x[ii] - mx);
+		sxy += (x[ii] - mx) * (y[ii] - my);
+	}
+	*slope = (sxx > 0.0) ? sxy / sxx : 0.0;
+	*atX0 = my + *slope * (x0 - mx);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ POSES: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static void addPose(const lsm9ds1_cal_log *log, lsm9ds1_cal_work *work,
+                    uint32_t first, uint32_t last)
+{
+	lsm9ds1_cal_pose *pose = &work->pose[work->poses++];
+	lsm9ds1_cal_sample sample;
+	uint32_t index;
+	uint8_t ii;
+
+	memset(pose, 0, sizeof(*pose));
+	pose->first = first;
+	pose->last = last;
+	for (index = first; index <= last; index++)
+	{
+		LSM9DS1_calLogSample(log, index, &sample);
+		for (ii = 0; ii < 3; ii++)
+		{
+			pose->gyro[ii] += sample.gyro[ii];
+			pose->accel[ii] += sample.accel[ii];
+		}
+		pose->temperatureC += temperatureC(sample.temperature);
+	}
+	for (ii = 0; ii < 3; ii++)
+	{
+		pose->gyro[ii] *= log->gyroRes / (last - first + 1);
+		pose->accel[ii] *= log->accelRes / (last - first + 1);
+	}
+	pose->temperatureC /= (last - first + 1);
+}
+
+static lsm9ds1_cal_status findPoses(const lsm9ds1_cal_log *log, lsm9ds1_cal_work *work)
+{
+	double periodS = log->periodNs * 1e-9;
+	uint32_t half = (uint32_t)(STILL_HALF_S / periodS + 0.5);
+	uint32_t rest = (uint32_t)(LSM9DS1_CAL_REST_S / periodS + 0.5);
+	uint32_t minPose = (uint32_t)(LSM9DS1_CAL_MIN_POSE_S / periodS + 0.5);
+	uint32_t window, index, runStart = 0;
+	double sum[3] = {0.0, 0.0, 0.0}, squares[3] = {0.0, 0.0, 0.0};
+	double restVariance = 0.0, variance, threshold, value;
+	lsm9ds1_cal_sample sample;
+	bool still, inRun = false;
+	uint8_t ii;
+
+	if (half < 1)
+		half = 1;
+	window = 2 * half + 1;
+	work->poses = 0;
+	if ((log->samples < rest + window) || (rest < window))
+		return CAL_NO_REST;
+
+	// Noise of the still start, in counts^2, summed over the axes
+	for (index = 0; index < rest; index++)
+	{
+		LSM9DS1_calLogSample(log, index, &sample);
+		for (ii = 0; ii < 3; ii++)
+		{
+			sum[ii] += sample.accel[ii];
+			squares[ii] += (double)sample.accel[ii] * sample.accel[ii];
+		}
+	}
+	for (ii = 0; ii < 3; ii++)
+		restVariance += squares[ii] / rest - (sum[ii] / rest) * (sum[ii] / rest);
+	// A quantised still unit can read a single code
+	threshold = LSM9DS1_CAL_STILL_FACTOR * (restVariance > 0.25 ? restVariance : 0.25);
+
+	memset(sum, 0, sizeof(sum));
+	memset(squares, 0, sizeof(squares));
+	for (index = 0; index < window - 1; index++)
+	{
+		LSM9DS1_calLogSample(log, index, &sample);
+		for (ii = 0; ii < 3; ii++)
+		{
+			sum[ii] += sample.accel[ii];
+			squares[ii] += (double)sample.accel[ii] * sample.accel[ii];
+		}
+	}
+	// index is the newest sample of the window centred on index - half
+	for (; index <= log->samples; index++)
+	{
+		still = false;
+		if (index < log->samples)
+		{
+			LSM9DS1_calLogSample(log, index, &sample);
+			variance = 0.0;
+			for (ii = 0; ii < 3; ii++)
+			{
+				sum[ii] += sample.accel[ii];
+				squares[ii] += (double)sample.accel[ii] * sample.accel[ii];
+				value = sum[ii] / window;
+				variance += squares[ii] / window - value * value;
+			}
+			still = variance < threshold;
+			LSM9DS1_calLogSample(log, index + 1 - window, &sample);
+			for (ii = 0; ii < 3; ii++)
+			{
+				sum[ii] -= sample.accel[ii];
+				squares[ii] -= (double)sample.accel[ii] * sample.accel[ii];
+			}
+		}
+
+		if (still && !inRun)
+		{
+			inRun = true;
+			runStart = index - half;
+		}
+		else if (!still && inRun)
+		{
+			inRun = false;
+			// Centres runStart .. index - half - 1, trimmed by half each side
+			if ((index - half - runStart >= minPose + 2 * half) &&
+			    (work->poses < LSM9DS1_CAL_MAX_POSES))
+				addPose(log, work, runStart + half, index - 2 * half - 1);
+		}
+	}
+
+	if ((work->poses == 0) || (work->pose[0].first > 2 * half) ||
+	    (work->pose[0].last + 2 * half + 1 < rest))
+		return CAL_NO_REST;
+	return (work->poses < LSM9DS1_CAL_MIN_POSES) ? CAL_FEW_POSES : CAL_OK;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ACCEL: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// p: bias X,Y,Z, scale errors X,Y,Z, misalignments (Y to X, Z to X, Z to Y),
+// then with accelTemp the bias temperature coefficients X,Y,Z
+static void accelCorrect(const double *p, const double *tempCoeff, double t,
+                         const double *a, double *f)
+{
+	double y[3];
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+		y[ii] = (a[ii] - p[ii] - tempCoeff[ii] * (t - LSM9DS1_CAL_TEMP_REF_C)) / (1.0 + p[3 + ii]);
+	f[0] = y[0];
+	f[1] = y[1] - p[6] * f[0];
+	f[2] = y[2] - p[7] * f[0] - p[8] * f[1];
+}
+
+static void accelResidual(void *context, const double *p, double *r)
+{
+	static const double noTemp[3] = {0.0, 0.0, 0.0};
+	fit_context *fit = context;
+	const lsm9ds1_cal_work *work = fit->work;
+	const double *tempCoeff = fit->accelTemp ? &p[9] : noTemp;
+	double f[3];
+	uint16_t kk;
+
+	for (kk = 0; kk < work->poses; kk++)
+	{
+		accelCorrect(p, tempCoeff, work->pose[kk].temperatureC, work->pose[kk].accel, f);
+		r[kk] = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]) - 1.0;
+	}
+}
+
+// The temperature coefficients are fitted with the other terms: fitted
+// apart, they trade off against the bias wherever the unit warms as it turns.
+static double fitAccel(fit_context *fit, bool tempSpan)
+{
+	lsm9ds1_cal_work *work = fit->work;
+	lsm9ds1_cal_sensor *accel = &fit->cal->accel;
+	double p[MAX_PARAMS], noTemp[3] = {0.0, 0.0, 0.0}, unit[3], f[3], cost;
+	uint8_t ii, jj;
+
+	memset(p, 0, sizeof(p));
+	fit->accelTemp = tempSpan;
+	cost = levenberg(work, accelResidual, fit, p, tempSpan ? 12 : 9, work->poses);
+	fit->accelTemp = false;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		accel->bias[ii] = (float)p[ii];
+		accel->tempCoeff[ii] = (float)p[9 + ii];
+	}
+	// Columns of T^-1 K^-1: correct the unit vectors with no offset
+	p[0] = p[1] = p[2] = 0.0;
+	for (jj = 0; jj < 3; jj++)
+	{
+		memset(unit, 0, sizeof(unit));
+		unit[jj] = 1.0;
+		accelCorrect(p, noTemp, LSM9DS1_CAL_TEMP_REF_C, unit, f);
+		for (ii = 0; ii < 3; ii++)
+			accel->matrix[ii][jj] = (float)f[ii];
+	}
+	for (ii = 0; ii < 3; ii++)
+		if (fabs(p[3 + ii]) > MAX_SCALE_ERROR)
+			return -1.0;
+	return cost;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ GYRO: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Turn v by -|w| dt about w (w in rad/s)
+static void rotateBack(double *v, const double *w, double dt)
+{
+	double angle = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]) * dt;
+	double k[3], cross[3], dot, c, s;
+	uint8_t ii;
+
+	if (angle < 1e-15)
+		return;
+	for (ii = 0; ii < 3; ii++)
+		k[ii] = -w[ii] * dt / angle;
+	c = cos(angle);
+	s = sin(angle);
+	dot = k[0] * v[0] + k[1] * v[1] + k[2] * v[2];
+	cross[0] = k[1] * v[2] - k[2] * v[1];
+	cross[1] = k[2] * v[0] - k[0] * v[2];
+	cross[2] = k[0] * v[1] - k[1] * v[0];
+	for (ii = 0; ii < 3; ii++)
+		v[ii] = v[ii] * c + cross[ii] * s + k[ii] * dot * (1.0 - c);
+}
+
+// p: correction matrix, row by row
+static void gyroResidual(void *context, const double *p, double *r)
+{
+	fit_context *fit = context;
+	const lsm9ds1_cal_log *log = fit->log;
+	const lsm9ds1_cal_work *work = fit->work;
+	const lsm9ds1_cal_sensor *gyro = &fit->cal->gyro;
+	double dt = log->periodNs * 1e-9, v[3], m[3], w[3], t;
+	lsm9ds1_cal_sample sample;
+	uint32_t index;
+	uint16_t kk;
+	uint8_t ii;
+
+	for (kk = 0; kk + 1 < work->poses; kk++)
+	{
+		memcpy(v, work->up[kk], sizeof(v));
+		for (index = work->pose[kk].last + 1; index < work->pose[kk + 1].first; index++)
+		{
+			LSM9DS1_calLogSample(log, index, &sample);
+			t = temperatureC(sample.temperature) - LSM9DS1_CAL_TEMP_REF_C;
+			for (ii = 0; ii < 3; ii++)
+				m[ii] = sample.gyro[ii] * (double)log->gyroRes - gyro->bias[ii] - gyro->tempCoeff[ii] * t;
+			for (ii = 0; ii < 3; ii++)
+				w[ii] = (p[3 * ii] * m[0] + p[3 * ii + 1] * m[1] + p[3 * ii + 2] * m[2]) * DEG_TO_RAD_D;
+			rotateBack(v, w, dt);
+		}
+		for (ii = 0; ii < 3; ii++)
+			r[3 * kk + ii] = v[ii] - work->up[kk + 1][ii];
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ MAG: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// p: offset X,Y,Z, symmetric matrix XX, YY, ZZ, XY, XZ, YZ
+static void magResidual(void *context, const double *p, double *r)
+{
+	const lsm9ds1_cal_work *work = ((fit_context *)context)->work;
+	double d[3], h[3];
+	uint16_t kk;
+
+	for (kk = 0; kk < work->magPoints; kk++)
+	{
+		d[0] = work->mag[kk][0] - p[0];
+		d[1] = work->mag[kk][1] - p[1];
+		d[2] = work->mag[kk][2] - p[2];
+		h[0] = p[3] * d[0] + p[6] * d[1] + p[7] * d[2];
+		h[1] = p[6] * d[0] + p[4] * d[1] + p[8] * d[2];
+		h[2] = p[7] * d[0] + p[8] * d[1] + p[5] * d[2];
+		r[kk] = sqrt(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]) - 1.0;
+	}
+}
+
+static lsm9ds1_cal_status fitMag(fit_context *fit)
+{
+	const lsm9ds1_cal_log *log = fit->log;
+	lsm9ds1_cal_work *work = fit->work;
+	lsm9ds1_cal_sensor *mag = &fit->cal->mag;
+	double p[9], low[3] = {0.0, 0.0, 0.0}, high[3] = {0.0, 0.0, 0.0};
+	double radius = 0.0, det, scale, cost;
+	lsm9ds1_cal_sample sample;
+	uint32_t index, conversions = 0, stride, seen = 0;
+	uint8_t ii;
+
+	for (index = 0; index < log->samples; index++)
+	{
+		LSM9DS1_calLogSample(log, index, &sample);
+		conversions += (sample.flags & LSM9DS1_CAL_MAG_NEW) ? 1 : 0;
+	}
+	stride = (conversions + LSM9DS1_CAL_MAX_MAG - 1) / LSM9DS1_CAL_MAX_MAG;
+	work->magPoints = 0;
+	for (index = 0; (index < log->samples) && (stride > 0); index++)
+	{
+		LSM9DS1_calLogSample(log, index, &sample);
+		if (!(sample.flags & LSM9DS1_CAL_MAG_NEW) || ((seen++ % stride) != 0) ||
+		    (work->magPoints == LSM9DS1_CAL_MAX_MAG))
+			continue;
+		for (ii = 0; ii < 3; ii++)
+		{
+			work->mag[work->magPoints][ii] = sample.mag[ii] * log->magRes;
+			if ((work->magPoints == 0) || (work->mag[work->magPoints][ii] < low[ii]))
+				low[ii] = work->mag[work->magPoints][ii];
+			if ((work->magPoints == 0) || (work->mag[work->magPoints][ii] > high[ii]))
+				high[ii] = work->mag[work->magPoints][ii];
+		}
+		work->magPoints++;
+	}
+	if (work->magPoints < MIN_MAG_POINTS)
+		return CAL_NO_MAG;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		p[ii] = (low[ii] + high[ii]) / 2.0;
+		radius += (high[ii] - low[ii]) / 6.0;
+	}
+	if (!(radius > 0.0))
+		return CAL_NO_FIT;
+	p[3] = p[4] = p[5] = 1.0 / radius;
+	p[6] = p[7] = p[8] = 0.0;
+	cost = levenberg(work, magResidual, fit, p, 9, work->magPoints);
+
+	det = p[3] * (p[4] * p[5] - p[8] * p[8]) - p[6] * (p[6] * p[5] - p[8] * p[7]) +
+	      p[7] * (p[6] * p[8] - p[4] * p[7]);
+	if ((cost < 0.0) || !(det > 0.0))
+		return CAL_NO_FIT;
+	scale = cbrt(det);
+	for (ii = 0; ii < 3; ii++)
+	{
+		mag->bias[ii] = (float)p[ii];
+		mag->tempCoeff[ii] = 0.0f;
+		mag->matrix[ii][ii] = (float)(p[3 + ii] / scale);
+	}
+	mag->matrix[0][1] = mag->matrix[1][0] = (float)(p[6] / scale);
+	mag->matrix[0][2] = mag->matrix[2][0] = (float)(p[7] / scale);
+	mag->matrix[1][2] = mag->matrix[2][1] = (float)(p[8] / scale);
+	fit->cal->fieldGauss = (float)(1.0 / scale);
+	fit->cal->magRms = (float)sqrt(cost / work->magPoints);
+	return (fit->cal->magRms < MAX_MAG_RMS) ? CAL_OK : CAL_NO_FIT;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SOLVE: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+void LSM9DS1_calIdentity(lsm9ds1_cal *cal)
+{
+	lsm9ds1_cal_sensor *sensors[3] = { &cal->gyro, &cal->accel, &cal->mag };
+	uint8_t ss, ii;
+
+	memset(cal, 0, sizeof(*cal));
+	for (ss = 0; ss < 3; ss++)
+		for (ii = 0; ii < 3; ii++)
+			sensors[ss]->matrix[ii][ii] = 1.0f;
+	cal->tempMinC = cal->tempMaxC = LSM9DS1_CAL_TEMP_REF_C;
+}
+
+lsm9ds1_cal_status LSM9DS1_calSolve(const lsm9ds1_cal_log *log,
+                                    lsm9ds1_cal_work *work,
+                                    lsm9ds1_cal *cal)
+{
+	fit_context fit = { log, work, cal, false };
+	lsm9ds1_cal_status status, magStatus;
+	double x[LSM9DS1_CAL_MAX_POSES], y[LSM9DS1_CAL_MAX_POSES];
+	double p[9], f[3], norm, slope, atRef, cost, spanC;
+	uint16_t kk;
+	uint8_t ii, jj;
+
+	LSM9DS1_calIdentity(cal);
+	if ((status = findPoses(log, work)) != CAL_OK)
+		return status;
+
+	cal->poses = work->poses;
+	cal->tempMinC = cal->tempMaxC = (float)work->pose[0].temperatureC;
+	for (kk = 0; kk < work->poses; kk++)
+	{
+		x[kk] = work->pose[kk].temperatureC;
+		if (x[kk] < cal->tempMinC) cal->tempMinC = (float)x[kk];
+		if (x[kk] > cal->tempMaxC) cal->tempMaxC = (float)x[kk];
+	}
+	spanC = cal->tempMaxC - cal->tempMinC;
+
+	// Gyro bias: a line through the pose means, or their mean
+	for (ii = 0; ii < 3; ii++)
+	{
+		for (kk = 0; kk < work->poses; kk++)
+			y[kk] = work->pose[kk].gyro[ii];
+		fitLine(x, y, work->poses, LSM9DS1_CAL_TEMP_REF_C, &slope, &atRef);
+		if (spanC < LSM9DS1_CAL_MIN_SPAN_C)
+		{
+			atRef = 0.0;
+			for (kk = 0; kk < work->poses; kk++)
+				atRef += y[kk] / work->poses;
+			slope = 0.0;
+		}
+		cal->gyro.bias[ii] = (float)atRef;
+		cal->gyro.tempCoeff[ii] = (float)slope;
+	}
+
+	cost = fitAccel(&fit, spanC >= LSM9DS1_CAL_MIN_SPAN_C);
+	if (cost < 0.0)
+		goto fail;
+	cal->accelRms = (float)sqrt(cost / work->poses);
+	if (cal->accelRms > MAX_ACCEL_RMS)
+		goto fail;
+
+	// Gravity direction of each pose in the corrected accel frame
+	for (kk = 0; kk < work->poses; kk++)
+	{
+		for (ii = 0; ii < 3; ii++)
+		{
+			f[ii] = 0.0;
+			for (jj = 0; jj < 3; jj++)
+				f[ii] += cal->accel.matrix[ii][jj] *
+				         (work->pose[kk].accel[jj] - cal->accel.bias[jj] -
+				          cal->accel.tempCoeff[jj] * (work->pose[kk].temperatureC - LSM9DS1_CAL_TEMP_REF_C));
+		}
+		norm = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+		for (ii = 0; ii < 3; ii++)
+			work->up[kk][ii] = f[ii] / norm;
+	}
+
+	memset(p, 0, sizeof(p));
+	p[0] = p[4] = p[8] = 1.0;
+	cost = levenberg(work, gyroResidual, &fit, p, 9, 3 * (work->poses - 1));
+	if (cost < 0.0)
+		goto fail;
+	cal->gyroRms = (float)(sqrt(cost / (work->poses - 1)) / DEG_TO_RAD_D);
+	for (ii = 0; ii < 3; ii++)
+	{
+		for (jj = 0; jj < 3; jj++)
+			cal->gyro.matrix[ii][jj] = (float)p[3 * ii + jj];
+		if (fabs(p[4 * ii] - 1.0) > MAX_SCALE_ERROR)
+			goto fail;
+	}
+	if (cal->gyroRms > MAX_GYRO_RMS)
+		goto fail;
+
+	magStatus = fitMag(&fit);
+	if (magStatus == CAL_NO_FIT)
+		goto fail;
+	return magStatus;
+
+fail:
+	LSM9DS1_calIdentity(cal);
+	return CAL_NO_FIT;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ USE: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+void LSM9DS1_calApply(const lsm9ds1_cal_sensor *sensor, const int16_t *raw,
+                      float res, float temperatureC, float *out)
+{
+	float d[3];
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+		d[ii] = raw[ii] * res - sensor->bias[ii] -
+		        sensor->tempCoeff[ii] * (temperatureC - LSM9DS1_CAL_TEMP_REF_C);
+	for (ii = 0; ii < 3; ii++)
+		out[ii] = sensor->matrix[ii][0] * d[0] + sensor->matrix[ii][1] * d[1] +
+		          sensor->matrix[ii][2] * d[2];
+}
+
+static int16_t saturate16(float value)
+{
+	if (value > 32767.0f) return 32767;
+	if (value < -32768.0f) return -32768;
+	return (int16_t)lrintf(value);
+}
+
+void LSM9DS1_calToHeading(const lsm9ds1_cal *cal, float magRes,
+                          lsm9ds1_heading_cal *heading)
+{
+	lsm9ds1_heading_cal axes;
+	float sum;
+	uint8_t ii, jj, kk;
+
+	LSM9DS1_headingCalInit(&axes);
+	for (ii = 0; ii < 3; ii++)
+	{
+		heading->offset[ii] = saturate16(cal->mag.bias[ii] / magRes);
+		for (jj = 0; jj < 3; jj++)
+		{
+			sum = 0.0f;
+			for (kk = 0; kk < 3; kk++)
+				sum += axes.matrix[ii][kk] * cal->mag.matrix[kk][jj];
+			heading->matrix[ii][jj] = saturate16(sum);
+		}
+	}
+}
+
+static uint32_t crc32(const uint8_t *data, uint32_t len)
+{
+	uint32_t crc = 0xFFFFFFFFUL;
+	uint8_t bit;
+
+	while (len--)
+	{
+		crc ^= *data++;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32_POLY : 0);
+	}
+	return ~crc;
+}
+
+// Blob: "L9CB", version, reserved, poses (16 bits), serial (16 bytes),
+// gyro, accel and mag as bias, tempCoeff and matrix row by row (15 floats
+// each), fieldGauss, tempMinC, tempMaxC, accelRms, gyroRms, magRms, CRC-32
+// of everything before it.
+static uint8_t *packSensor(uint8_t *out, const lsm9ds1_cal_sensor *sensor)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++, out += 4)
+		putFloat(out, sensor->bias[ii]);
+	for (ii = 0; ii < 3; ii++, out += 4)
+		putFloat(out, sensor->tempCoeff[ii]);
+	for (ii = 0; ii < 9; ii++, out += 4)
+		putFloat(out, sensor->matrix[ii / 3][ii % 3]);
+	return out;
+}
+
+static const uint8_t *unpackSensor(const uint8_t *in, lsm9ds1_cal_sensor *sensor)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++, in += 4)
+		sensor->bias[ii] = getFloat(in);
+	for (ii = 0; ii < 3; ii++, in += 4)
+		sensor->tempCoeff[ii] = getFloat(in);
+	for (ii = 0; ii < 9; ii++, in += 4)
+		sensor->matrix[ii / 3][ii % 3] = getFloat(in);
+	return in;
+}
+
+void LSM9DS1_calPack(uint8_t *blob, const lsm9ds1_cal *cal, const char *serial)
+{
+	const float tail[6] = { cal->fieldGauss, cal->tempMinC, cal->tempMaxC,
+	                        cal->accelRms, cal->gyroRms, cal->magRms };
+	uint8_t *out;
+	uint8_t ii;
+
+	memset(blob, 0, LSM9DS1_CAL_BLOB_LEN);
+	memcpy(blob, "L9CB", 4);
+	blob[4] = LSM9DS1_CAL_BLOB_VERSION;
+	put16(blob + 6, cal->poses);
+	for (ii = 0; (serial != NULL) && (ii < 15) && (serial[ii] != '\0'); ii++)
+		blob[8 + ii] = (uint8_t)serial[ii];
+	out = packSensor(blob + 24, &cal->gyro);
+	out = packSensor(out, &cal->accel);
+	out = packSensor(out, &cal->mag);
+	for (ii = 0; ii < 6; ii++, out += 4)
+		putFloat(out, tail[ii]);
+	put32(out, crc32(blob, LSM9DS1_CAL_BLOB_LEN - 4));
+}
+
+bool LSM9DS1_calUnpack(const uint8_t *blob, lsm9ds1_cal *cal, char *serial)
+{
+	float tail[6];
+	const uint8_t *in;
+	uint8_t ii;
+
+	if ((memcmp(blob, "L9CB", 4) != 0) || (blob[4] != LSM9DS1_CAL_BLOB_VERSION) ||
+	    (crc32(blob, LSM9DS1_CAL_BLOB_LEN - 4) != get32(blob + LSM9DS1_CAL_BLOB_LEN - 4)))
+		return false;
+
+	memset(cal, 0, sizeof(*cal));
+	cal->poses = get16(blob + 6);
+	if (serial != NULL)
+	{
+		memcpy(serial, blob + 8, 15);
+		serial[15] = '\0';
+	}
+	in = unpackSensor(blob + 24, &cal->gyro);
+	in = unpackSensor(in, &cal->accel);
+	in = unpackSensor(in, &cal->mag);
+	for (ii = 0; ii < 6; ii++, in += 4)
+		tail[ii] = getFloat(in);
+	cal->fieldGauss = tail[0];
+	cal->tempMinC = tail[1];
+	cal->tempMaxC = tail[2];
+	cal->accelRms = tail[3];
+	cal->gyroRms = tail[4];
+	cal->magRms = tail[5];
+	return true;
+}
@@ -0,0 +1,218 @@
+/******************************************************************************
+
+	LSM9DS1_Calib.h
+	Full calibration of one LSM9DS1 unit from a recorded tumble.
+
+calibrate() only measures the gyro and accel offsets at rest and
+calibrateMag() the hard-iron offsets from the extremes of the field. This
+solver takes a log of the unit being turned by hand or by a rig through
+a few dozen still poses, with rotations of any kind in between, and fits
+every term of the sensor model without a reference table (the
+multi-position method of Tedaldi, Pretto and Menegatti, ICRA 2014):
+
+	accel:  a = K_a T_a f + b_a + k_a (T - 25 C)	(f: specific force)
+	gyro:   w = M_g r + b_g + k_g (T - 25 C)		(r: angular rate)
+	mag:    m = S^-1 h + o						(h: field)
+
+with K_a diagonal scale factors, T_a unit lower-triangular misalignments
+(the accel X axis defines the unit frame, Y lies in its XY plane), M_g a
+full 3x3 gyro scale, misalignment and cross-axis matrix in that frame, S a
+symmetric soft-iron matrix of unit determinant, o the hard-iron offset
+and k the bias temperature coefficients.
+
+	1. Still poses are found where the accel variance over 0.2 s stays
+	   within LSM9DS1_CAL_STILL_FACTOR times that of the first
+	   LSM9DS1_CAL_REST_S of the log, which must be still.
+	2. The gyro bias and its temperature coefficient come from a line fit
+	   of the pose means against the pose temperatures.
+	3. The accel terms, bias temperature coefficients included, are
+	   fitted together so that every pose reads 1 g.
+	4. The gyro matrix is fitted so that integrating the corrected rates
+	   through each rotation carries the gravity direction of one pose
+	   onto that of the next.
+	5. The soft and hard iron come from an ellipsoid fit of the mag
+	   conversions of the whole log; its size gives the local field.
+
+All fits are Levenberg-Marquardt with forward-difference Jacobians, in
+double. Accel and gyro want at least LSM9DS1_CAL_MIN_POSES poses spread
+over the sphere and rotations about all three axes; a temperature span
+below LSM9DS1_CAL_MIN_SPAN_C leaves the coefficients at zero. Nothing is
+allocated: the caller provides the log in memory and a work area, so
+several units can be solved at once on separate threads.
+
+Log format, little-endian: a LSM9DS1_CAL_LOG_HEADER byte header ("L9CL",
+version, reserved, reserved 16 bits, accel/gyro sample period in ns as
+32 bits, then gyro, accel and mag resolution as 32-bit floats in dps, g
+and gauss per count), then LSM9DS1_CAL_LOG_SAMPLE byte samples of gyro,
+accel and mag X,Y,Z, temperature (16 bits each) and 16 bits of flags,
+one per accel/gyro sample. The mag fields hold the last conversion and
+LSM9DS1_CAL_MAG_NEW marks the samples where a new one completed.
+
+The result packs into a LSM9DS1_CAL_BLOB_LEN byte blob with a CRC-32,
+for the unit's flash or EEPROM.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Calib_H__
+#define __LSM9DS1_Calib_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_Heading.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    #define LSM9DS1_CAL_LOG_VERSION     1
+    #define LSM9DS1_CAL_LOG_HEADER      24
+    #define LSM9DS1_CAL_LOG_SAMPLE      22
+    #define LSM9DS1_CAL_MAG_NEW         0x0001
+
+    #define LSM9DS1_CAL_BLOB_VERSION    1
+    #define LSM9DS1_CAL_BLOB_LEN        232
+
+    // Solver limits; the work area grows with them.
+    #ifndef LSM9DS1_CAL_MAX_POSES
+    #define LSM9DS1_CAL_MAX_POSES       64
+    #endif
+    #ifndef LSM9DS1_CAL_MAX_MAG
+    #define LSM9DS1_CAL_MAX_MAG         2048
+    #endif
+    #define LSM9DS1_CAL_MAX_RESIDUALS   ((LSM9DS1_CAL_MAX_MAG > 3 * LSM9DS1_CAL_MAX_POSES) ? \
+                                         LSM9DS1_CAL_MAX_MAG : 3 * LSM9DS1_CAL_MAX_POSES)
+    #define LSM9DS1_CAL_MAX_PARAMS      12      // accel with temperature
+    #define LSM9DS1_CAL_MIN_POSES       12
+    #define LSM9DS1_CAL_MIN_POSE_S      1.0f    // shortest still pose
+    #define LSM9DS1_CAL_REST_S          2.0f    // still start of the log
+    #define LSM9DS1_CAL_STILL_FACTOR    8.0f
+    #define LSM9DS1_CAL_MIN_SPAN_C      2.0f
+
+    // Temperature output: 16 counts per degree, 0 at 25 C.
+    #define LSM9DS1_CAL_TEMP_REF_C      25.0f
+    #define LSM9DS1_CAL_TEMP_LSB_PER_C  16.0f
+
+    typedef enum lsm9ds1_cal_status {
+        CAL_OK,               // all terms fitted
+        CAL_NO_MAG,           // too few mag conversions; gyro and accel are valid
+        CAL_BAD_LOG,          // truncated log or bad header
+        CAL_NO_REST,          // the log does not start still
+        CAL_FEW_POSES,        // fewer than LSM9DS1_CAL_MIN_POSES still poses
+        CAL_NO_FIT            // a fit did not converge to a plausible unit
+    } lsm9ds1_cal_status;
+
+    typedef struct
+    {
+        int16_t gyro[3];
+        int16_t accel[3];
+        int16_t mag[3];
+        int16_t temperature;
+        uint16_t flags;
+    } lsm9ds1_cal_sample;
+
+    typedef struct
+    {
+        const uint8_t *data;      // the whole log, header included
+        uint32_t samples;
+        uint32_t periodNs;
+        float gyroRes;            // dps per count
+        float accelRes;           // g per count
+        float magRes;             // gauss per count
+    } lsm9ds1_cal_log;
+
+    // Correction of one sensor, in its units (dps, g, gauss):
+    // corrected = matrix * (measured - bias - tempCoeff * (T - 25 C))
+    typedef struct
+    {
+        float bias[3];
+        float tempCoeff[3];       // per degree C, zero for the mag
+        float matrix[3][3];
+    } lsm9ds1_cal_sensor;
+
+    typedef struct
+    {
+        lsm9ds1_cal_sensor gyro;
+        lsm9ds1_cal_sensor accel;
+        lsm9ds1_cal_sensor mag;   // in the mag axes, see calToHeading()
+        float fieldGauss;         // local field strength during the log
+        float tempMinC, tempMaxC; // range the coefficients were fitted over
+        uint16_t poses;           // still poses used
+        float accelRms;           // |corrected accel| - 1 g over the poses, g
+        float gyroRms;            // gravity direction error after each rotation, deg
+        float magRms;             // |corrected field| / field - 1
+    } lsm9ds1_cal;
+
+    typedef struct
+    {
+        uint32_t first, last;     // sample range
+        double gyro[3];           // means, dps, g, degrees C
+        double accel[3];
+        double temperatureC;
+    } lsm9ds1_cal_pose;
+
+    // Work area of calSolve(), about 260 kB at the default limits.
+    typedef struct
+    {
+        lsm9ds1_cal_pose pose[LSM9DS1_CAL_MAX_POSES];
+        uint16_t poses;
+        float mag[LSM9DS1_CAL_MAX_MAG][3];
+        uint16_t magPoints;
+        double up[LSM9DS1_CAL_MAX_POSES][3];      // corrected gravity directions
+        double residual[2][LSM9DS1_CAL_MAX_RESIDUALS];
+        double jacobian[LSM9DS1_CAL_MAX_PARAMS][LSM9DS1_CAL_MAX_RESIDUALS];
+    } lsm9ds1_cal_work;
+
+    // calLogOpen() -- Check a log held in memory.
+    // Output: false if the header is wrong or the length is not whole samples.
+    bool LSM9DS1_calLogOpen(lsm9ds1_cal_log *log, const uint8_t *data,
+                            uint32_t len);
+
+    // calLogSample() -- Decode sample index (0..samples - 1) of an open log.
+    void LSM9DS1_calLogSample(const lsm9ds1_cal_log *log, uint32_t index,
+                              lsm9ds1_cal_sample *sample);
+
+    // calLogHeader() / calLogPack() -- Encode a log, for recorders.
+    void LSM9DS1_calLogHeader(uint8_t *out, uint32_t periodNs, float gyroRes,
+                              float accelRes, float magRes);
+    void LSM9DS1_calLogPack(uint8_t *out, const lsm9ds1_cal_sample *sample);
+
+    // calSolve() -- Fit every term to one unit's log.
+    // Input:
+    //	- log = Log opened with calLogOpen().
+    //	- work = Scratch, one per concurrent call.
+    // Output: CAL_OK or CAL_NO_MAG with cal filled in, else the failure;
+    // cal is left as the identity on failure.
+    lsm9ds1_cal_status LSM9DS1_calSolve(const lsm9ds1_cal_log *log,
+                                        lsm9ds1_cal_work *work,
+                                        lsm9ds1_cal *cal);
+
+    // calIdentity() -- No correction.
+    void LSM9DS1_calIdentity(lsm9ds1_cal *cal);
+
+    // calApply() -- Correct one raw X,Y,Z reading.
+    // Input:
+    //	- res = Units per count (the log's resolution or calcGyro(1) etc.).
+    //	- temperatureC = Die temperature.
+    void LSM9DS1_calApply(const lsm9ds1_cal_sensor *sensor, const int16_t *raw,
+                          float res, float temperatureC, float *out);
+
+    // calToHeading() -- Hard-iron offsets and soft-iron matrix mapped onto
+    // the accel axes, for LSM9DS1_headingCompute().
+    // Input:
+    //	- magRes = Gauss per count of the readings the heading will use.
+    void LSM9DS1_calToHeading(const lsm9ds1_cal *cal, float magRes,
+                              lsm9ds1_heading_cal *heading);
+
+    // calPack() / calUnpack() -- Blob of LSM9DS1_CAL_BLOB_LEN bytes with the
+    // unit serial (up to 15 characters, 16 bytes with its terminator for
+    // calUnpack(), which may be NULL) and a CRC-32.
+    // Output of calUnpack(): false if the blob is damaged or of another version.
+    void LSM9DS1_calPack(uint8_t *blob, const lsm9ds1_cal *cal, const char *serial);
+    bool LSM9DS1_calUnpack(const uint8_t *blob, lsm9ds1_cal *cal, char *serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+/******************************************************************************
+
+	LSM9DS1_Disturb.c
+	Magnetic disturbance detection for LSM9DS1 heading updates.
+
+The accelerometer measures the reaction to gravity, pointing up, so the dip
+angle is asin(-m.a / (|m| |a|)): positive when the field points below the
+horizontal, as in the northern hemisphere. Errors are normalised by their
+tolerance and the larger one drives the state machine and the weight.
+******************************************************************************/
+
+#include "LSM9DS1_Disturb.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define RAD_TO_DEG		57.29578f
+
+void LSM9DS1_disturbInit(lsm9ds1_disturb *dist, float refField,
+                         float refDip, uint16_t learnSamples)
+{
+	memset(dist, 0, sizeof(*dist));
+	dist->fieldTol = 0.10f;
+	dist->dipTol = 5.0f;
+	dist->accelTol = 0.1f;
+	dist->enterSamples = 2;
+	dist->exitSamples = 20;
+
+	if (refField > 0.0f)
+	{
+		dist->refField = refField;
+		dist->refDip = refDip;
+		dist->haveDip = true;
+	}
+	else
+		dist->learnLeft = learnSamples ? learnSamples : 1;
+	dist->weight = dist->learnLeft ? 0.0f : 1.0f;
+}
+
+uint8_t LSM9DS1_disturbUpdate(lsm9ds1_disturb *dist, const float *mag,
+                              const float *accel)
+{
+	float dot = 0.0f, gravity = 0.0f, field = 0.0f, sine, error, dipError;
+	bool dipValid = false;
+	uint8_t flags = 0, ii;
+
+	dist->stats.samples++;
+	for (ii = 0; ii < 3; ii++)
+	{
+		field += mag[ii] * mag[ii];
+		if (accel != NULL)
+		{
+			gravity += accel[ii] * accel[ii];
+			dot += mag[ii] * accel[ii];
+		}
+	}
+	field = sqrtf(field);
+	gravity = sqrtf(gravity);
+	dist->field = field;
+
+	if ((accel != NULL) && (field > 0.0f) && (fabsf(gravity - 1.0f) <= dist->accelTol))
+	{
+		sine = -dot / (field * gravity);
+		if (sine > 1.0f) sine = 1.0f;
+		if (sine < -1.0f) sine = -1.0f;
+		dist->dip = asinf(sine) * RAD_TO_DEG;
+		dipValid = true;
+	}
+	else
+		dist->stats.dipSkipped++;
+
+	// Learn the reference as running means
+	if (dist->learnLeft)
+	{
+		dist->learned++;
+		dist->refField += (field - dist->refField) / dist->learned;
+		if (dipValid)
+		{
+			dist->dipLearned++;
+			dist->refDip += (dist->dip - dist->refDip) / dist->dipLearned;
+		}
+		if (--dist->learnLeft == 0)
+		{
+			dist->haveDip = (dist->dipLearned > 0);
+			dist->weight = 1.0f;
+		}
+		return LSM9DS1_DISTURB_LEARNING;
+	}
+
+	error = fabsf(field - dist->refField) / dist->refField;
+	if (error > dist->stats.fieldErrMax)
+		dist->stats.fieldErrMax = error;
+	error /= dist->fieldTol;
+	if (error > 1.0f)
+		flags |= LSM9DS1_DISTURB_FIELD;
+
+	if (dipValid && dist->haveDip)
+	{
+		dipError = fabsf(dist->dip - dist->refDip);
+		if (dipError > dist->stats.dipErrMax)
+			dist->stats.dipErrMax = dipError;
+		dipError /= dist->dipTol;
+		if (dipError > 1.0f)
+			flags |= LSM9DS1_DISTURB_DIP;
+		if (dipError > error)
+			error = dipError;
+	}
+
+	// Enter on enterSamples bad samples, leave on exitSamples good ones
+	if (!dist->gated)
+	{
+		dist->run = (error > 1.0f) ? dist->run + 1 : 0;
+		if (dist->run >= (dist->enterSamples ? dist->enterSamples : 1))
+		{
+			dist->gated = true;
+			dist->run = 0;
+			dist->stats.events++;
+		}
+	}
+	else
+	{
+		dist->run = (error <= 0.5f) ? dist->run + 1 : 0;
+		if (dist->run >= dist->exitSamples)
+		{
+			dist->gated = false;
+			dist->run = 0;
+		}
+	}
+
+	if (dist->gated)
+	{
+		dist->weight = 0.0f;
+		dist->stats.gatedSamples++;
+		return flags | LSM9DS1_DISTURB_GATED;
+	}
+	dist->weight = (error < 1.0f) ? 1.0f - error : 0.0f;
+	return flags;
+}
+
+void LSM9DS1_disturbGetStats(lsm9ds1_disturb *dist,
+                             lsm9ds1_disturb_stats *stats, bool reset)
+{
+	*stats = dist->stats;
+	if (reset)
+		memset(&dist->stats, 0, sizeof(dist->stats));
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+
+	LSM9DS1_Disturb.h
+	Magnetic disturbance detection for LSM9DS1 heading updates.
+
+Motors, steel structures and current-carrying wires add their own field to
+the Earth's, and a heading filter that trusts every magnetometer sample is
+pulled towards them. Away from such sources the calibrated field has a
+fixed magnitude and a fixed dip angle (the angle below the horizontal,
+measured against gravity from the accelerometer), so a sample that changes
+either is disturbed, whatever its heading. The detector compares each
+sample with a reference (given, or learned from the first samples), enters
+the disturbed state after enterSamples consecutive samples outside the
+tolerance, and only leaves it after exitSamples consecutive samples inside
+half of it. Fusion code scales its magnetometer correction by weight:
+0 while disturbed, otherwise falling from 1 to 0 as the sample approaches
+the tolerance.
+
+The dip test needs the accelerometer to see gravity alone; samples taken
+while the accelerometer magnitude is off 1 g by more than accelTol skip it.
+Both vectors must be in the same frame and the magnetometer hard and soft
+iron calibrated. Each update costs two square roots, an arcsine and no
+history.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Disturb_H__
+#define __LSM9DS1_Disturb_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // disturbUpdate() result bits.
+    #define LSM9DS1_DISTURB_FIELD       0x01    // magnitude outside tolerance
+    #define LSM9DS1_DISTURB_DIP         0x02    // dip angle outside tolerance
+    #define LSM9DS1_DISTURB_GATED       0x04    // disturbed state: do not use
+    #define LSM9DS1_DISTURB_LEARNING    0x08    // reference not known yet
+
+    typedef struct
+    {
+        uint32_t samples;         // disturbUpdate() calls
+        uint32_t gatedSamples;    // samples returned with DISTURB_GATED
+        uint32_t events;          // entries into the disturbed state
+        uint32_t dipSkipped;      // samples without a usable gravity vector
+        float fieldErrMax;        // largest |field - refField| / refField
+        float dipErrMax;          // largest |dip - refDip|, degrees
+    } lsm9ds1_disturb_stats;
+
+    typedef struct
+    {
+        // Configuration, defaults set by disturbInit()
+        float refField;           // reference magnitude, gauss
+        float refDip;             // reference dip angle, degrees
+        float fieldTol;           // allowed magnitude error, fraction (0.10)
+        float dipTol;             // allowed dip error, degrees (5)
+        float accelTol;           // |accel| - 1 g allowed for the dip test (0.1)
+        uint16_t enterSamples;    // samples outside tolerance to gate (2)
+        uint16_t exitSamples;     // samples inside half tolerance to ungate (20)
+
+        // State
+        uint16_t learnLeft;       // samples still to average into the reference
+        uint16_t learned;         // samples averaged so far
+        uint16_t dipLearned;      // of which with a usable gravity vector
+        bool haveDip;             // refDip is known, the dip test runs
+        uint16_t run;             // consecutive samples towards a state change
+        bool gated;
+        float field;              // last sample magnitude, gauss
+        float dip;                // last valid dip, degrees
+        float weight;             // gating signal for fusion, 0..1
+        lsm9ds1_disturb_stats stats;
+    } lsm9ds1_disturb;
+
+    // disturbInit() -- Set the reference and the default configuration.
+    // Input:
+    //	- refField, refDip = Undisturbed field magnitude (gauss) and dip angle
+    //	  (degrees, positive below the horizontal) at the site.
+    //	  refField <= 0 learns both from the first learnSamples samples
+    //	  instead (taken away from disturbances, device still).
+    void LSM9DS1_disturbInit(lsm9ds1_disturb *dist, float refField,
+                             float refDip, uint16_t learnSamples);
+
+    // disturbUpdate() -- Check one magnetometer sample.
+    // Input:
+    //	- mag = Calibrated field, gauss (calcMag()), in the accel frame.
+    //	- accel = Acceleration, g (calcAccel()) taken with the mag sample, or
+    //	  NULL to test the magnitude only.
+    // Output: LSM9DS1_DISTURB_* bits; dist->weight holds the gating signal.
+    uint8_t LSM9DS1_disturbUpdate(lsm9ds1_disturb *dist, const float *mag,
+                                  const float *accel);
+
+    // disturbGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_disturbGetStats(lsm9ds1_disturb *dist,
+                                 lsm9ds1_disturb_stats *stats, bool reset);
+
+#endif
@@ -0,0 +1,259 @@
+/******************************************************************************
+
+	LSM9DS1_Features.c
+	Streaming statistical features of the LSM9DS1 FIFO stream.
+
+The moment recurrences work on raw counts, so gravity on an accel axis
+only shifts the mean and costs no precision in the moments. Scaling to g
+or dps is applied once per window in featCompute().
+******************************************************************************/
+
+#include "LSM9DS1_Features.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+bool LSM9DS1_featInit(lsm9ds1_feat *feat, uint8_t channels, uint32_t window,
+                      float gyroScale, float accelScale)
+{
+	channels &= (1 << LSM9DS1_FEAT_CHANNELS) - 1;
+	if ((channels == 0) || (window == 0))
+		return false;
+
+	memset(feat, 0, sizeof(*feat));
+	feat->channels = channels;
+	feat->window = window;
+	feat->gyroScale = gyroScale;
+	feat->accelScale = accelScale;
+	return true;
+}
+
+void LSM9DS1_featAccumulate(lsm9ds1_feat_acc *acc, int16_t value)
+{
+	float n1 = (float)acc->n, n, delta, deltaN, deltaN2, term;
+	int8_t sign;
+
+	if (acc->n == 0)
+	{
+		acc->min = acc->max = value;
+		acc->sign = 0;
+	}
+	else
+	{
+		if (value < acc->min) acc->min = value;
+		if (value > acc->max) acc->max = value;
+	}
+
+	// Side of the running mean, ties keep the previous side
+	sign = (value > acc->mean) ? 1 : ((value < acc->mean) ? -1 : acc->sign);
+	if ((acc->n > 0) && (acc->sign != 0) && (sign != acc->sign))
+		acc->crossings++;
+	acc->sign = sign;
+
+	acc->n++;
+	n = (float)acc->n;
+	delta = value - acc->mean;
+	deltaN = delta / n;
+	deltaN2 = deltaN * deltaN;
+	term = delta * deltaN * n1;
+	acc->mean += deltaN;
+	acc->m4 += term * deltaN2 * (n * n - 3.0f * n + 3.0f) + 6.0f * deltaN2 * acc->m2 -
+	           4.0f * deltaN * acc->m3;
+	acc->m3 += term * deltaN * (n - 2.0f) - 3.0f * deltaN * acc->m2;
+	acc->m2 += term;
+}
+
+void LSM9DS1_featMerge(lsm9ds1_feat_acc *dst, const lsm9ds1_feat_acc *src)
+{
+	float na = (float)dst->n, nb = (float)src->n, n = na + nb;
+	float delta, delta2, m2, m3, m4;
+
+	if (src->n == 0)
+		return;
+	if (dst->n == 0)
+	{
+		*dst = *src;
+		return;
+	}
+
+	delta = src->mean - dst->mean;
+	delta2 = delta * delta;
+	m2 = dst->m2 + src->m2 + delta2 * na * nb / n;
+	m3 = dst->m3 + src->m3 + delta2 * delta * na * nb * (na - nb) / (n * n) +
+	     3.0f * delta * (na * src->m2 - nb * dst->m2) / n;
+	m4 = dst->m4 + src->m4 +
+	     delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+	     6.0f * delta2 * (na * na * src->m2 + nb * nb * dst->m2) / (n * n) +
+	     4.0f * delta * (na * src->m3 - nb * dst->m3) / n;
+
+	dst->mean += delta * nb / n;
+	dst->m2 = m2;
+	dst->m3 = m3;
+	dst->m4 = m4;
+	dst->n += src->n;
+	if (src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+	dst->crossings += src->crossings;
+	dst->sign = src->sign;
+}
+
+void LSM9DS1_featCompute(const lsm9ds1_feat_acc *acc, float scale,
+                         uint32_t periodUs, lsm9ds1_feat_axis *axis)
+{
+	float n = (float)acc->n, variance, high, low;
+
+	memset(axis, 0, sizeof(*axis));
+	if (acc->n == 0)
+		return;
+
+	variance = acc->m2 / n;
+	high = acc->max - acc->mean;
+	low = acc->mean - acc->min;
+	axis->mean = acc->mean * scale;
+	axis->rms = sqrtf(variance) * scale;
+	axis->peak = ((high > low) ? high : low) * scale;
+	if (axis->rms > 0.0f)
+	{
+		axis->crest = axis->peak / axis->rms;
+		axis->skewness = sqrtf(n) * acc->m3 / (acc->m2 * sqrtf(acc->m2));
+		axis->kurtosis = n * acc->m4 / (acc->m2 * acc->m2);
+	}
+	if (periodUs)
+		axis->zcr = acc->crossings * 1000000.0f / (n * periodUs);
+}
+
+// Close the window: compute the vector, queue it and restart.
+static void finishWindow(lsm9ds1_feat *feat)
+{
+	lsm9ds1_features *out;
+	uint8_t ch;
+
+	if (feat->queueCount == LSM9DS1_FEAT_QUEUE)
+	{
+		feat->queueHead = (feat->queueHead + 1) % LSM9DS1_FEAT_QUEUE;
+		feat->queueCount--;
+		feat->stats.dropped++;
+	}
+	out = &feat->queue[(feat->queueHead + feat->queueCount) % LSM9DS1_FEAT_QUEUE];
+	feat->queueCount++;
+	feat->stats.windows++;
+
+	memset(out, 0, sizeof(*out));
+	out->startUs = feat->startUs;
+	out->channels = feat->channels;
+	for (ch = 0; ch < LSM9DS1_FEAT_CHANNELS; ch++)
+	{
+		if (!(feat->channels & (1 << ch)))
+			continue;
+		out->samples = feat->acc[ch].n;
+		LSM9DS1_featCompute(&feat->acc[ch], (ch < 3) ? feat->gyroScale : feat->accelScale,
+		                    feat->periodUs, &out->axis[ch]);
+	}
+	memset(feat->acc, 0, sizeof(feat->acc));
+}
+
+uint8_t LSM9DS1_featFeed(lsm9ds1_feat *feat, const uint8_t *samples,
+                         uint8_t count, uint8_t sampleBytes,
+                         uint32_t firstUs, uint32_t periodUs)
+{
+	const uint8_t *sample;
+	uint8_t ii, ch, first, finished = 0;
+	uint32_t filled = 0;
+
+	if ((sampleBytes != 12) && (sampleBytes != 6))
+		return 0;
+	// Accel-only samples have no gyro words
+	first = (sampleBytes == 12) ? 0 : 3;
+	feat->periodUs = periodUs;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		sample = samples + ii * sampleBytes;
+		for (ch = first; ch < LSM9DS1_FEAT_CHANNELS; ch++)
+		{
+			if (!(feat->channels & (1 << ch)))
+				continue;
+			if (feat->acc[ch].n == 0)
+				feat->startUs = firstUs + ii * periodUs;
+			LSM9DS1_featAccumulate(&feat->acc[ch],
+			                       (int16_t)((sample[2 * (ch - first) + 1] << 8) |
+			                                 sample[2 * (ch - first)]));
+			filled = feat->acc[ch].n;
+		}
+		feat->stats.samples++;
+		if (filled >= feat->window)
+		{
+			finishWindow(feat);
+			finished++;
+			filled = 0;
+		}
+	}
+	return finished;
+}
+
+bool LSM9DS1_featGet(lsm9ds1_feat *feat, lsm9ds1_features *features)
+{
+	if (feat->queueCount == 0)
+		return false;
+	*features = feat->queue[feat->queueHead];
+	feat->queueHead = (feat->queueHead + 1) % LSM9DS1_FEAT_QUEUE;
+	feat->queueCount--;
+	return true;
+}
+
+static uint8_t * put16(uint8_t *out, int32_t value)
+{
+	if (value > 32767) value = 32767;
+	if (value < -32768) value = -32768;
+	out[0] = (uint8_t)(value & 0xFF);
+	out[1] = (uint8_t)((uint16_t)value >> 8);
+	return out + 2;
+}
+
+uint8_t LSM9DS1_featPack(const lsm9ds1_feat *feat,
+                         const lsm9ds1_features *features, uint8_t *out)
+{
+	const lsm9ds1_feat_axis *axis;
+	uint8_t *p = out;
+	float scale;
+	uint16_t samples;
+	uint8_t ch;
+
+	p[0] = (uint8_t)(features->startUs & 0xFF);
+	p[1] = (uint8_t)((features->startUs >> 8) & 0xFF);
+	p[2] = (uint8_t)((features->startUs >> 16) & 0xFF);
+	p[3] = (uint8_t)(features->startUs >> 24);
+	// The count is unsigned, unlike the fields put16() stores
+	samples = (features->samples > 65535) ? 65535 : (uint16_t)features->samples;
+	p[4] = (uint8_t)(samples & 0xFF);
+	p[5] = (uint8_t)(samples >> 8);
+	p += 6;
+	*p++ = features->channels;
+	*p++ = 0;
+
+	for (ch = 0; ch < LSM9DS1_FEAT_CHANNELS; ch++)
+	{
+		if (!(features->channels & (1 << ch)))
+			continue;
+		axis = &features->axis[ch];
+		scale = (ch < 3) ? feat->gyroScale : feat->accelScale;
+		p = put16(p, lrintf(axis->mean / scale));
+		p = put16(p, lrintf(axis->rms / scale));
+		p = put16(p, lrintf(axis->peak / scale));
+		p = put16(p, lrintf(axis->crest * 256.0f));
+		p = put16(p, lrintf(axis->skewness * 256.0f));
+		p = put16(p, lrintf(axis->kurtosis * 256.0f));
+		p = put16(p, lrintf(axis->zcr * 10.0f));
+	}
+	return (uint8_t)(p - out);
+}
+
+void LSM9DS1_featGetStats(lsm9ds1_feat *feat, lsm9ds1_feat_stats *stats,
+                          bool reset)
+{
+	*stats = feat->stats;
+	if (reset)
+		memset(&feat->stats, 0, sizeof(feat->stats));
+}
@@ -0,0 +1,150 @@
+/******************************************************************************
+
+	LSM9DS1_Features.h
+	Streaming statistical features of the LSM9DS1 FIFO stream.
+
+Edge analytics rarely need the raw samples: mean, RMS, peak, crest factor,
+skewness, kurtosis and zero-crossing rate per axis over a window describe
+most machine states, in a few dozen bytes instead of kilobytes. The stage
+is fed the raw FIFO blocks wmDrain() returns and keeps one accumulator per
+channel with the count, mean and second to fourth central moments, updated
+per sample with Welford's single-pass recurrences (Terriberry's extension
+to the higher moments) so there is no sum-of-powers cancellation, plus the
+extremes and the sign changes around the running mean. Windows may end in
+the middle of a block; the finished feature vector is queued and the next
+window starts with the following sample.
+
+Accumulators of separate spans merge exactly (Chan et al. / Pebay), so
+short windows can be combined into longer summaries, or accumulators from
+several sensors into one, without the samples: see LSM9DS1_featMerge().
+LSM9DS1_featPack() encodes a vector in 8 + 14 bytes per channel for the
+uplink (a 1 s window of 952 gyro+accel samples is 11424 raw bytes, 92
+packed).
+******************************************************************************/
+
+#ifndef __LSM9DS1_Features_H__
+#define __LSM9DS1_Features_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // Channels, in FIFO order, as bits of featInit()'s channels.
+    #define LSM9DS1_FEAT_GX             0x01
+    #define LSM9DS1_FEAT_GY             0x02
+    #define LSM9DS1_FEAT_GZ             0x04
+    #define LSM9DS1_FEAT_AX             0x08
+    #define LSM9DS1_FEAT_AY             0x10
+    #define LSM9DS1_FEAT_AZ             0x20
+    #define LSM9DS1_FEAT_CHANNELS       6
+
+    // Finished vectors kept until featGet() collects them.
+    #define LSM9DS1_FEAT_QUEUE          4
+
+    // Largest featPack() output.
+    #define LSM9DS1_FEAT_PACKED_MAX     (8 + 14 * LSM9DS1_FEAT_CHANNELS)
+
+    typedef struct
+    {
+        uint32_t n;
+        float mean;             // raw counts
+        float m2, m3, m4;       // sums of the 2nd..4th powers of the deviation
+        int16_t min, max;
+        uint32_t crossings;     // sign changes around the running mean
+        int8_t sign;            // side of the mean of the last sample
+    } lsm9ds1_feat_acc;
+
+    typedef struct
+    {
+        float mean;             // g or dps
+        float rms;              // around the mean, g or dps
+        float peak;             // largest deviation from the mean
+        float crest;            // peak / rms
+        float skewness;
+        float kurtosis;         // 3 for a Gaussian
+        float zcr;              // mean crossings per second
+    } lsm9ds1_feat_axis;
+
+    typedef struct
+    {
+        uint32_t startUs;       // first sample of the window
+        uint32_t samples;
+        uint8_t channels;       // LSM9DS1_FEAT_* present in axis[]
+        lsm9ds1_feat_axis axis[LSM9DS1_FEAT_CHANNELS];  // by channel index
+    } lsm9ds1_features;
+
+    typedef struct
+    {
+        uint32_t samples;       // samples fed
+        uint32_t windows;       // vectors finished
+        uint32_t dropped;       // vectors overwritten before featGet()
+    } lsm9ds1_feat_stats;
+
+    typedef struct
+    {
+        // Configuration
+        uint8_t channels;             // LSM9DS1_FEAT_* set
+        uint32_t window;              // samples per vector
+        float gyroScale;              // dps per raw count
+        float accelScale;             // g per raw count
+
+        // State
+        lsm9ds1_feat_acc acc[LSM9DS1_FEAT_CHANNELS];
+        uint32_t startUs;
+        uint32_t periodUs;
+        lsm9ds1_features queue[LSM9DS1_FEAT_QUEUE];
+        uint8_t queueHead;
+        uint8_t queueCount;
+        lsm9ds1_feat_stats stats;
+    } lsm9ds1_feat;
+
+    // featInit() -- Configure the channels and the window, empty the queue.
+    // Input:
+    //	- channels = LSM9DS1_FEAT_* set. Gyro channels need 12-byte samples.
+    //	- window = Samples per feature vector (e.g. the ODR for 1 s).
+    //	- gyroScale, accelScale = LSM9DS1_calcGyro(1), LSM9DS1_calcAccel(1).
+    // Output: false if channels or window is empty.
+    bool LSM9DS1_featInit(lsm9ds1_feat *feat, uint8_t channels, uint32_t window,
+                          float gyroScale, float accelScale);
+
+    // featFeed() -- Add a block of raw FIFO samples, as stored by
+    // LSM9DS1_wmDrain() (gyro X,Y,Z then accel X,Y,Z, or accel only).
+    // Input:
+    //	- firstUs, periodUs = Time of the first sample and sample period (see
+    //	  LSM9DS1_zuptFifo()).
+    // Output: Feature vectors finished by this block.
+    uint8_t LSM9DS1_featFeed(lsm9ds1_feat *feat, const uint8_t *samples,
+                             uint8_t count, uint8_t sampleBytes,
+                             uint32_t firstUs, uint32_t periodUs);
+
+    // featGet() -- Take the oldest finished vector.
+    // Output: true if features was filled.
+    bool LSM9DS1_featGet(lsm9ds1_feat *feat, lsm9ds1_features *features);
+
+    // featAccumulate() -- Add one raw sample to an accumulator.
+    void LSM9DS1_featAccumulate(lsm9ds1_feat_acc *acc, int16_t value);
+
+    // featMerge() -- Fold src into dst as if dst had seen its samples too.
+    // Crossings at the junction are not counted.
+    void LSM9DS1_featMerge(lsm9ds1_feat_acc *dst, const lsm9ds1_feat_acc *src);
+
+    // featCompute() -- Features of an accumulator.
+    // Input:
+    //	- scale = Units per raw count.
+    //	- periodUs = Sample period, for the crossing rate.
+    void LSM9DS1_featCompute(const lsm9ds1_feat_acc *acc, float scale,
+                             uint32_t periodUs, lsm9ds1_feat_axis *axis);
+
+    // featPack() -- Encode a vector for the uplink, little-endian: start
+    // time (4 bytes), samples (uint16, at most 65535), channels (1),
+    // reserved (1), then per channel present mean, rms and peak in raw
+    // counts, crest, skewness and kurtosis in 1/256 and zcr in 0.1 Hz, all
+    // int16, clamped.
+    // Output: Bytes written, up to LSM9DS1_FEAT_PACKED_MAX.
+    uint8_t LSM9DS1_featPack(const lsm9ds1_feat *feat,
+                             const lsm9ds1_features *features, uint8_t *out);
+
+    // featGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_featGetStats(lsm9ds1_feat *feat, lsm9ds1_feat_stats *stats,
+                              bool reset);
+
+#endif
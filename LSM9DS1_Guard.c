@@ -0,0 +1,339 @@
+/******************************************************************************
+
+	LSM9DS1_Guard.c
+	Sensor reset detection and recovery for the LSM9DS1 driver.
+
+The snapshot is read back from the device rather than rebuilt from the
+settings, so it also covers registers the application wrote directly
+(interrupt thresholds, FIFO mode, hard-iron offsets). Blocks are restored
+in the order below: interrupt setup first, then the gyro, axis and accel
+control registers, then the FIFO, so the device starts converting with its
+final configuration. Times are 32-bit microsecond counters compared by
+unsigned subtraction, so they may wrap.
+******************************************************************************/
+
+#include "LSM9DS1_Guard.h"
+#include "LSM9DS1_Planner.h"
+#include "SparkFunLSM9DS1.h"
+#include "LSM9DS1_Registers.h"
+#include "LSM9DS1_RegMap.h"
+#include "LSM9DS1_Types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct
+{
+	uint8_t mag;
+	uint8_t subAddress;
+	uint8_t count;
+} config_block;
+
+// Writable registers of each slave, in restore order. Clear-on-read and
+// read-only registers split the blocks.
+static const config_block configBlocks[] = {
+	{0, ACT_THS,          10},  // activity and accel interrupt generator, INT1/2
+	{0, INT_GEN_CFG_G,     8},  // gyro interrupt generator
+	{0, CTRL_REG1_G,       4},  // gyro ODR, scale, filters, orientation
+	{0, CTRL_REG4,         7},  // axis enables, accel ODR and scale, CTRL_REG8..10
+	{0, FIFO_CTRL,         1},
+	{1, OFFSET_X_REG_L_M,  6},  // hard-iron offsets
+	{1, INT_CFG_M,         1},
+	{1, INT_THS_L_M,       2},
+	{1, CTRL_REG1_M,       5},  // mag ODR, scale, mode
+};
+#define CONFIG_BLOCKS	(sizeof(configBlocks) / sizeof(configBlocks[0]))
+
+// Signature candidates, tried first: the registers holding the output data
+// rate or operating mode, whose reset value turns the stream off.
+static const uint8_t xgPreferred[] = {CTRL_REG1_G, CTRL_REG6_XL};
+static const uint8_t mPreferred[] = {CTRL_REG3_M, CTRL_REG1_M};
+
+// Snapshot byte of a register, NULL if the register is not saved.
+static uint8_t * snapshotByte(lsm9ds1_guard *guard, uint8_t mag, uint8_t address)
+{
+	uint8_t offset[2] = {0, 0};
+	uint8_t ii;
+
+	for (ii = 0; ii < CONFIG_BLOCKS; ii++)
+	{
+		const config_block *block = &configBlocks[ii];
+
+		if (block->mag != mag)
+			continue;
+		if ((address >= block->subAddress) && (address < block->subAddress + block->count))
+			return (mag ? guard->m : guard->xg) + offset[mag] + (address - block->subAddress);
+		offset[mag] += block->count;
+	}
+	return NULL;
+}
+
+// First register of a slave whose saved value differs from its reset value.
+static bool chooseSignature(lsm9ds1_guard *guard, uint8_t mag, uint8_t *address)
+{
+	const uint8_t *preferred = mag ? mPreferred : xgPreferred;
+	uint8_t ii, reg;
+
+	for (ii = 0; ii < 2; ii++)
+	{
+		if (*snapshotByte(guard, mag, preferred[ii]) != LSM9DS1_regInfo(mag, preferred[ii])->reset)
+		{
+			*address = preferred[ii];
+			return true;
+		}
+	}
+	for (ii = 0; ii < CONFIG_BLOCKS; ii++)
+	{
+		const config_block *block = &configBlocks[ii];
+
+		if (block->mag != mag)
+			continue;
+		for (reg = block->subAddress; reg < block->subAddress + block->count; reg++)
+		{
+			if (*snapshotByte(guard, mag, reg) != LSM9DS1_regInfo(mag, reg)->reset)
+			{
+				*address = reg;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Write the snapshot of the given slaves back, one burst per block.
+static void restore(lsm9ds1_guard *guard, uint8_t devices)
+{
+	uint8_t offset[2] = {0, 0};
+	uint8_t ii;
+
+	for (ii = 0; ii < CONFIG_BLOCKS; ii++)
+	{
+		const config_block *block = &configBlocks[ii];
+		const uint8_t *data = (block->mag ? guard->m : guard->xg) + offset[block->mag];
+
+		offset[block->mag] += block->count;
+		if (!(devices & (block->mag ? LSM9DS1_GUARD_MAG : LSM9DS1_GUARD_XG)))
+			continue;
+		if (block->mag)
+			LSM9DS1_mWriteBytes(block->subAddress, data, block->count);
+		else
+			LSM9DS1_xgWriteBytes(block->subAddress, data, block->count);
+	}
+	guard->stats.restores++;
+}
+
+static void closeGap(lsm9ds1_guard *guard, uint32_t nowUs)
+{
+	lsm9ds1_gap *gap = &guard->open;
+	uint32_t lengthUs;
+
+	gap->endUs = nowUs;
+	lengthUs = gap->endUs - gap->startUs;
+	if (lengthUs > guard->stats.gapMaxUs)
+		guard->stats.gapMaxUs = lengthUs;
+	lengthUs = gap->endUs - gap->detectUs;
+	if (lengthUs > guard->stats.recoveryMaxUs)
+		guard->stats.recoveryMaxUs = lengthUs;
+
+	if (guard->gapCount == LSM9DS1_GUARD_GAPS)
+	{
+		guard->gapHead = (guard->gapHead + 1) % LSM9DS1_GUARD_GAPS;
+		guard->gapCount--;
+		guard->stats.droppedGaps++;
+	}
+	guard->gaps[(guard->gapHead + guard->gapCount) % LSM9DS1_GUARD_GAPS] = *gap;
+	guard->gapCount++;
+	guard->recovering = false;
+}
+
+// Common tail of guardRead() and guardCheck(): compare the signature bytes
+// (NULL: not checked on this read) and open, extend or close the gap.
+static bool verify(lsm9ds1_guard *guard, uint32_t nowUs, bool busOk,
+                   const uint8_t *check)
+{
+	uint8_t changed = 0, ii = 0;
+
+	if (!busOk)
+	{
+		// The slave may still be booting; wait for it to answer
+		guard->stats.busErrors++;
+		if (!guard->recovering)
+		{
+			memset(&guard->open, 0, sizeof(guard->open));
+			guard->open.startUs = guard->lastGoodUs;
+			guard->open.detectUs = nowUs;
+			guard->open.endUs = nowUs;
+			guard->recovering = true;
+			guard->stats.resets++;
+		}
+		return false;
+	}
+	if (check == NULL)
+		return !guard->recovering;
+
+	guard->stats.checks++;
+	if ((guard->armed & LSM9DS1_GUARD_XG) && (check[ii++] != guard->signature[0]))
+		changed |= LSM9DS1_GUARD_XG;
+	if ((guard->armed & LSM9DS1_GUARD_MAG) && (check[ii] != guard->signature[1]))
+		changed |= LSM9DS1_GUARD_MAG;
+
+	if (changed)
+	{
+		if (!guard->recovering)
+		{
+			memset(&guard->open, 0, sizeof(guard->open));
+			guard->open.startUs = guard->lastGoodUs;
+			guard->open.detectUs = nowUs;
+			guard->recovering = true;
+			guard->stats.resets++;
+		}
+		guard->open.devices |= changed;
+		guard->open.attempts++;
+		guard->open.endUs = nowUs;  // last restore, until the gap closes
+		restore(guard, changed);
+		return false;
+	}
+
+	// Outputs hold the reset value until the first conversion at the
+	// restored rate
+	if (guard->recovering && (guard->open.attempts > 0) &&
+	    ((uint32_t)(nowUs - guard->open.endUs) < guard->settleUs))
+		return false;
+
+	if (guard->recovering)
+		closeGap(guard, nowUs);
+	guard->lastGoodUs = nowUs;
+	return true;
+}
+
+uint8_t LSM9DS1_guardInit(lsm9ds1_guard *guard, uint16_t channels,
+                          uint16_t transactionCost, uint8_t checkEvery,
+                          uint32_t (*micros)(void))
+{
+	const IMUSettings *settings = LSM9DS1_getSettings();
+	lsm9ds1_plan_request request = {0, 0};
+	lsm9ds1_plan busPlan;
+	uint8_t offset[2] = {0, 0};
+	uint8_t address, ii;
+	uint8_t *reg;
+
+	memset(guard, 0, sizeof(*guard));
+	guard->micros = micros;
+	guard->checkEvery = checkEvery ? checkEvery : 1;
+
+	for (ii = 0; ii < CONFIG_BLOCKS; ii++)
+	{
+		const config_block *block = &configBlocks[ii];
+
+		uint8_t got;
+
+		if (block->mag)
+			got = LSM9DS1_mReadBytes(block->subAddress | 0x80, guard->m + offset[1], block->count);
+		else
+			got = LSM9DS1_xgReadBytes(block->subAddress, guard->xg + offset[0], block->count);
+		// A partial snapshot would be written back over the real setup
+		if (got != block->count)
+		{
+			memset(guard, 0, sizeof(*guard));
+			guard->micros = micros;
+			return LSM9DS1_GUARD_FAILED;
+		}
+		offset[block->mag] += block->count;
+	}
+	// Never replay a reboot or software reset request
+	reg = snapshotByte(guard, 0, CTRL_REG8);
+	*reg &= ~(LSM9DS1_BOOT_MASK | LSM9DS1_SW_RESET_MASK);
+	reg = snapshotByte(guard, 1, CTRL_REG2_M);
+	*reg &= ~(LSM9DS1_REBOOT_MASK | LSM9DS1_SOFT_RST_MASK);
+
+	LSM9DS1_planChannels(&guard->plan, channels, transactionCost);
+	guard->checked = guard->plan;
+	if (chooseSignature(guard, 0, &address) &&
+	    LSM9DS1_planCheck(&guard->checked, 0, address, 1))
+	{
+		guard->signature[0] = *snapshotByte(guard, 0, address);
+		guard->armed |= LSM9DS1_GUARD_XG;
+	}
+	if (chooseSignature(guard, 1, &address) &&
+	    LSM9DS1_planCheck(&guard->checked, 1, address, 1))
+	{
+		guard->signature[1] = *snapshotByte(guard, 1, address);
+		guard->armed |= LSM9DS1_GUARD_MAG;
+	}
+
+	// One output period of the accel/gyro, or of the mag when alone. The
+	// rates do not depend on the clock, but planBus() needs a valid one.
+	LSM9DS1_planBus(settings, settings->device.i2cSpeed ? settings->device.i2cSpeed : 100000,
+	                &request, &busPlan);
+	if (busPlan.fifoRate)
+		guard->settleUs = (uint32_t)(1000000000ULL / busPlan.fifoRate);
+	else if (busPlan.wakeupRate)
+		guard->settleUs = (uint32_t)(1000000000ULL / busPlan.wakeupRate);
+
+	guard->lastGoodUs = micros();
+	return guard->armed;
+}
+
+bool LSM9DS1_guardRead(lsm9ds1_guard *guard, int16_t *values)
+{
+	uint8_t check[LSM9DS1_MAX_SPANS];
+	bool checked = false, busOk;
+
+	guard->stats.reads++;
+	if (guard->recovering || (guard->countdown == 0))
+	{
+		checked = true;
+		guard->countdown = guard->checkEvery;
+	}
+	guard->countdown--;
+
+	if (checked)
+		busOk = (LSM9DS1_readChannelsCheck(&guard->checked, values, check) != 0) ||
+		        (guard->checked.spanCount == 0);
+	else
+		busOk = (LSM9DS1_readChannels(&guard->plan, values) != 0) ||
+		        (guard->plan.spanCount == 0);
+
+	return verify(guard, guard->micros(), busOk, checked ? check : NULL);
+}
+
+bool LSM9DS1_guardCheck(lsm9ds1_guard *guard)
+{
+	lsm9ds1_read_plan probe;
+	uint8_t check[LSM9DS1_MAX_SPANS];
+	int16_t values[CH_COUNT];
+	uint8_t ii;
+	bool busOk;
+
+	guard->stats.reads++;
+	if (guard->armed == 0)
+		return true;
+
+	// Signature spans of the checked plan alone
+	LSM9DS1_planChannels(&probe, 0, 0);
+	for (ii = guard->plan.spanCount; ii < guard->checked.spanCount; ii++)
+		LSM9DS1_planCheck(&probe, guard->checked.spans[ii].mag,
+		                  guard->checked.spans[ii].subAddress, 1);
+
+	busOk = LSM9DS1_readChannelsCheck(&probe, values, check) != 0;
+	return verify(guard, guard->micros(), busOk, check);
+}
+
+bool LSM9DS1_guardGetGap(lsm9ds1_guard *guard, lsm9ds1_gap *gap)
+{
+	if (guard->gapCount == 0)
+		return false;
+	*gap = guard->gaps[guard->gapHead];
+	guard->gapHead = (guard->gapHead + 1) % LSM9DS1_GUARD_GAPS;
+	guard->gapCount--;
+	return true;
+}
+
+void LSM9DS1_guardGetStats(lsm9ds1_guard *guard, lsm9ds1_guard_stats *stats,
+                           bool reset)
+{
+	*stats = guard->stats;
+	if (reset)
+		memset(&guard->stats, 0, sizeof(guard->stats));
+}
@@ -0,0 +1,131 @@
+/******************************************************************************
+
+	LSM9DS1_Guard.h
+	Sensor reset detection and recovery for the LSM9DS1 driver.
+
+A brown-out or a glitch on the supply resets the LSM9DS1 registers to their
+defaults: the gyro and accel power down (ODR 0), the magnetometer goes to
+power-down mode and the FIFO and interrupt setup is lost, while the driver
+keeps reading stale or zero outputs. The guard snapshots the configuration
+once it is set up, picks on each slave a register whose configured value
+differs from its reset value (the ODR and mode registers first) and reads
+that signature byte in the same request as the stream data. When it no
+longer matches, the guard writes the snapshot back, one auto-increment
+burst per register block, hard-iron offsets included, and reports the data
+gap with the time of the last read it verified and of the first verified
+read after recovery.
+
+Typical use: after begin(), initMag(), calibration and FIFO setup, call
+LSM9DS1_guardInit() with the channels to stream, then LSM9DS1_guardRead()
+in place of readChannels(). FIFO users call LSM9DS1_guardCheck() after each
+drain. Call LSM9DS1_guardInit() again after changing the configuration.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Guard_H__
+#define __LSM9DS1_Guard_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "SparkFunLSM9DS1.h"
+
+    // Slaves, as bits of lsm9ds1_gap.devices and of guardInit()'s result.
+    #define LSM9DS1_GUARD_XG            0x01
+    #define LSM9DS1_GUARD_MAG           0x02
+    // guardInit() result alone when the configuration could not be read.
+    #define LSM9DS1_GUARD_FAILED        0x80
+
+    // Completed gaps kept until guardGetGap() collects them.
+    #define LSM9DS1_GUARD_GAPS          4
+
+    // Configuration bytes saved per slave (see configBlocks in the .c file).
+    #define LSM9DS1_GUARD_XG_BYTES      30
+    #define LSM9DS1_GUARD_M_BYTES       14
+
+    typedef struct
+    {
+        uint32_t startUs;       // last read verified before the reset
+        uint32_t detectUs;      // read that found the signature changed
+        uint32_t endUs;         // first read verified after recovery
+        uint8_t devices;        // LSM9DS1_GUARD_* slaves that were reset
+        uint8_t attempts;       // snapshot restores until the signature held
+    } lsm9ds1_gap;
+
+    typedef struct
+    {
+        uint32_t reads;           // guardRead()/guardCheck() calls
+        uint32_t checks;          // reads that carried the signature
+        uint32_t resets;          // gaps opened
+        uint32_t restores;        // snapshot restores, retries included
+        uint32_t busErrors;       // reads the bus did not complete
+        uint32_t gapMaxUs;        // longest gap, startUs to endUs
+        uint32_t recoveryMaxUs;   // longest detectUs to endUs
+        uint32_t droppedGaps;     // gaps overwritten before guardGetGap()
+    } lsm9ds1_guard_stats;
+
+    typedef struct
+    {
+        // Configuration
+        uint32_t (*micros)(void);   // free-running microsecond counter
+        uint8_t checkEvery;         // reads per signature check, 1 = all
+        uint8_t armed;              // LSM9DS1_GUARD_* slaves watched
+        uint32_t settleUs;          // output period; reads this soon after a
+                                    // restore still belong to the gap
+
+        // Snapshot and signature
+        uint8_t xg[LSM9DS1_GUARD_XG_BYTES];
+        uint8_t m[LSM9DS1_GUARD_M_BYTES];
+        uint8_t signature[2];       // expected XG byte, then mag byte
+        lsm9ds1_read_plan plan;     // stream channels only
+        lsm9ds1_read_plan checked;  // stream channels plus the signature
+
+        // State
+        uint8_t countdown;
+        bool recovering;
+        lsm9ds1_gap open;
+        uint32_t lastGoodUs;
+        lsm9ds1_gap gaps[LSM9DS1_GUARD_GAPS];
+        uint8_t gapHead;
+        uint8_t gapCount;
+        lsm9ds1_guard_stats stats;
+    } lsm9ds1_guard;
+
+    // guardInit() -- Snapshot the current configuration, choose the
+    // signature registers and plan the stream read. Call after the sensor
+    // is fully configured.
+    // Input:
+    //	- guard = Guard instance (caller storage).
+    //	- channels = LSM9DS1_CH() set read by guardRead(), 0 for guardCheck()
+    //	  only.
+    //	- transactionCost = As for planChannels().
+    //	- checkEvery = Check the signature on one read out of checkEvery
+    //	  (1: every read, exact gap start; N: up to N - 1 unverified reads).
+    //	- micros = Microsecond timestamp source.
+    // Output: LSM9DS1_GUARD_* slaves watched. A slave left at its reset
+    // configuration (e.g. magnetometer powered down) is not watched, since
+    // a reset does not change it. LSM9DS1_GUARD_FAILED if a snapshot read
+    // failed: nothing is watched or streamed; call guardInit() again.
+    uint8_t LSM9DS1_guardInit(lsm9ds1_guard *guard, uint16_t channels,
+                              uint16_t transactionCost, uint8_t checkEvery,
+                              uint32_t (*micros)(void));
+
+    // guardRead() -- readChannels() with reset detection and recovery.
+    // Output: true if values hold data read with the configuration in
+    // force; false while a gap is open (reset detected, recovery under way
+    // or bus error), values are then not to be used.
+    bool LSM9DS1_guardRead(lsm9ds1_guard *guard, int16_t *values);
+
+    // guardCheck() -- Check the signature alone (one burst per watched
+    // slave, one request) and recover if needed, e.g. after a FIFO drain.
+    // Output: true if the configuration is in force.
+    bool LSM9DS1_guardCheck(lsm9ds1_guard *guard);
+
+    // guardGetGap() -- Take the oldest completed gap.
+    // Output: true if gap was filled.
+    bool LSM9DS1_guardGetGap(lsm9ds1_guard *guard, lsm9ds1_gap *gap);
+
+    // guardGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_guardGetStats(lsm9ds1_guard *guard, lsm9ds1_guard_stats *stats,
+                               bool reset);
+
+#endif
@@ -0,0 +1,217 @@
+/******************************************************************************
+
+	LSM9DS1_Heading.c
+	Tilt-compensated compass heading in fixed point for the LSM9DS1.
+
+Vectors are brought to a common scale by shifts (largest component in
+[2^14, 2^15)) and unit vectors are Q15. Products are accumulated in 64
+bits (32x32->64 multiply-accumulate is a single instruction on the
+Cortex-M4). No floating point, no libm.
+******************************************************************************/
+
+#include "LSM9DS1_Heading.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 2^29 / sqrt(x) at the middle of each [i, i + 1) * 2^26 interval,
+// i = 4..15, the seed for the reciprocal square root.
+static const uint16_t rsqrtSeed[12] = {
+	30894, 27945, 25705, 23930, 22479, 21263,
+	20225, 19326, 18536, 17837, 17211, 16646
+};
+
+// atan(t) for t in [0, 1] as an odd polynomial in t, coefficients in
+// binary angles * 256 (max error 1.2e-5 rad).
+#define ATAN_C1		 2669819
+#define ATAN_C3		 -881958
+#define ATAN_C5		  481008
+#define ATAN_C7		 -227320
+#define ATAN_C9		   55633
+
+#define ANGLE_90	16384
+
+// Reciprocal square root of x > 0: 1 / sqrt(x) = y / 2^(29 - k), y in
+// [2^14, 2^15]. Two Newton-Raphson steps from the table seed.
+static uint32_t rsqrtFix(uint32_t x, int8_t *k)
+{
+	uint32_t y, h;
+	uint8_t ii;
+
+	*k = 0;
+	while (x >= (1UL << 30))
+	{
+		x >>= 2;
+		(*k)--;
+	}
+	while (x < (1UL << 28))
+	{
+		x <<= 2;
+		(*k)++;
+	}
+
+	y = rsqrtSeed[(x >> 26) - 4];
+	for (ii = 0; ii < 2; ii++)
+	{
+		// h = x * y^2 / 2^29, 1.0 at convergence is 2^29
+		h = (uint32_t)(((uint64_t)x * y) >> 15);
+		h = (uint32_t)(((uint64_t)h * y) >> 14);
+		y = (uint32_t)(((uint64_t)y * ((3UL << 29) - h)) >> 30);
+	}
+	return y;
+}
+
+// Shift v so that its largest component is in [2^14, 2^15).
+// Output: false if v is zero.
+static bool scaleVector(int32_t *v)
+{
+	uint32_t max = 0, a;
+	int8_t shift = 0;
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		a = (v[ii] < 0) ? (uint32_t)-v[ii] : (uint32_t)v[ii];
+		if (a > max)
+			max = a;
+	}
+	if (max == 0)
+		return false;
+#ifdef __GNUC__
+	shift = (int8_t)(__builtin_clz(max) - 17);	// CLZ on the Cortex-M4
+#else
+	while (max >= (1UL << 15))
+	{
+		max >>= 1;
+		shift--;
+	}
+	while (max < (1UL << 14))
+	{
+		max <<= 1;
+		shift++;
+	}
+#endif
+	for (ii = 0; ii < 3; ii++)
+		v[ii] = (shift >= 0) ? (v[ii] * (1L << shift)) : (v[ii] >> -shift);
+	return true;
+}
+
+// c = a x b / 2^15
+static void cross(const int32_t *a, const int32_t *b, int32_t *c)
+{
+	c[0] = (int32_t)(((int64_t)a[1] * b[2] - (int64_t)a[2] * b[1]) >> 15);
+	c[1] = (int32_t)(((int64_t)a[2] * b[0] - (int64_t)a[0] * b[2]) >> 15);
+	c[2] = (int32_t)(((int64_t)a[0] * b[1] - (int64_t)a[1] * b[0]) >> 15);
+}
+
+static uint32_t sumSquares(const int32_t *v, uint8_t first)
+{
+	uint32_t sum = 0;
+	uint8_t ii;
+
+	for (ii = first; ii < 3; ii++)
+		sum += (uint32_t)(v[ii] * v[ii]);
+	return sum;
+}
+
+int16_t LSM9DS1_atan2Fix(int32_t y, int32_t x)
+{
+	uint32_t ax = (x < 0) ? (uint32_t)-x : (uint32_t)x;
+	uint32_t ay = (y < 0) ? (uint32_t)-y : (uint32_t)y;
+	uint32_t min, max, t, t2;
+	int32_t angle;
+	int64_t p;
+
+	if ((ax | ay) == 0)
+		return 0;
+	max = (ay > ax) ? ay : ax;
+	min = (ay > ax) ? ax : ay;
+	while (max >= (1UL << 16))
+	{
+		max >>= 1;
+		min >>= 1;
+	}
+
+	// First octant: t = min / max in Q16
+	t = (min << 16) / max;
+	t2 = (uint32_t)(((uint64_t)t * t) >> 16);
+	p = ATAN_C9;
+	p = ATAN_C7 + ((p * t2) >> 16);
+	p = ATAN_C5 + ((p * t2) >> 16);
+	p = ATAN_C3 + ((p * t2) >> 16);
+	p = ATAN_C1 + ((p * t2) >> 16);
+	angle = (int32_t)((((p * t) >> 16) + 128) >> 8);
+
+	if (ay > ax)
+		angle = ANGLE_90 - angle;
+	if (x < 0)
+		angle = 2 * ANGLE_90 - angle;
+	if (y < 0)
+		angle = -angle;
+	return (int16_t)(uint16_t)angle;
+}
+
+void LSM9DS1_headingCalInit(lsm9ds1_heading_cal *cal)
+{
+	uint8_t ii, jj;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		cal->offset[ii] = 0;
+		for (jj = 0; jj < 3; jj++)
+			cal->matrix[ii][jj] = 0;
+	}
+	cal->matrix[0][0] = -LSM9DS1_HEADING_ONE;
+	cal->matrix[1][1] = LSM9DS1_HEADING_ONE;
+	cal->matrix[2][2] = LSM9DS1_HEADING_ONE;
+}
+
+bool LSM9DS1_headingCompute(const int16_t *accel, const int16_t *mag,
+                            const lsm9ds1_heading_cal *cal,
+                            lsm9ds1_heading *out)
+{
+	int32_t up[3], m[3], east[3], north[3];
+	uint32_t sum, y;
+	int64_t acc;
+	int32_t horizontal;
+	int8_t k;
+	uint8_t ii, jj;
+
+	// Unit up vector, Q15
+	for (ii = 0; ii < 3; ii++)
+		up[ii] = accel[ii];
+	if (!scaleVector(up))
+		return false;
+	y = rsqrtFix(sumSquares(up, 0), &k);
+	for (ii = 0; ii < 3; ii++)
+		up[ii] = (up[ii] * (int32_t)y) >> (14 - k);
+
+	// Calibrated field in the accel frame
+	for (ii = 0; ii < 3; ii++)
+	{
+		acc = 0;
+		for (jj = 0; jj < 3; jj++)
+			acc += (int64_t)cal->matrix[ii][jj] * ((int32_t)mag[jj] - cal->offset[jj]);
+		m[ii] = (int32_t)(acc >> 14);
+	}
+	if (!scaleVector(m))
+		return false;
+
+	// Horizontal east and north, both |m| cos(dip) long
+	cross(m, up, east);
+	if (!scaleVector(east))
+		return false;
+	cross(up, east, north);
+
+	out->heading = (uint16_t)LSM9DS1_atan2Fix(east[0], north[0]);
+	out->roll = LSM9DS1_atan2Fix(up[1], up[2]);
+	sum = sumSquares(up, 1);
+	horizontal = 0;
+	if (sum)
+	{
+		y = rsqrtFix(sum, &k);
+		horizontal = (int32_t)(((uint64_t)sum * y) >> (29 - k));
+	}
+	out->pitch = LSM9DS1_atan2Fix(up[0], horizontal);
+	return true;
+}
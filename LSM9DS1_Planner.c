@@ -0,0 +1,163 @@
+/******************************************************************************
+
+	LSM9DS1_Planner.c
+	Bus bandwidth planner for the LSM9DS1 driver.
+
+All rates are kept in mHz and all times in microseconds so the arithmetic
+stays in integers; bus time uses the same cost model as the periodic read
+scheduler (I2C_SCHED_BusBits).
+******************************************************************************/
+
+#include "LSM9DS1_Planner.h"
+#include "SparkFunLSM9DS1.h"
+#include "LSM9DS1_Types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "drivers/i2c_sched.h"
+
+// Output data rates in mHz, indexed by the sampleRate settings (see
+// setGyroODR(), setAccelODR() and setMagODR()).
+static const uint32_t gyroODR_mHz[8] = {0, 14900, 59500, 119000, 238000, 476000, 952000, 0};
+static const uint32_t accelODR_mHz[8] = {0, 10000, 50000, 119000, 238000, 476000, 952000, 0};
+static const uint32_t magODR_mHz[8] = {625, 1250, 2500, 5000, 10000, 20000, 40000, 80000};
+
+// Ceiling division, a and b in the same units.
+static uint32_t divUp(uint64_t a, uint64_t b)
+{
+	return (uint32_t)((a + b - 1) / b);
+}
+
+// Bus time, in bit times, of a FIFO drain of samples levels: one FIFO_SRC
+// read to learn the level, then bursts of at most LSM9DS1_MAX_BURST_BYTES.
+static uint32_t drainBits(uint8_t samples, uint8_t sampleBytes, uint8_t *transactions)
+{
+	uint8_t perBurst = LSM9DS1_MAX_BURST_BYTES / sampleBytes;
+	uint32_t bits = I2C_SCHED_BusBits(1);
+	uint8_t count = 0;
+
+	while (samples > 0)
+	{
+		uint8_t burst = samples < perBurst ? samples : perBurst;
+		bits += I2C_SCHED_BusBits(burst * sampleBytes);
+		samples -= burst;
+		count++;
+	}
+	*transactions = count;
+	return bits;
+}
+
+lsm9ds1_plan_status LSM9DS1_planBus(const IMUSettings *settings, uint32_t busHz,
+                                    const lsm9ds1_plan_request *request,
+                                    lsm9ds1_plan *plan)
+{
+	uint32_t fifoODR = 0; // accel/gyro FIFO rate, mHz
+	uint32_t magODR = 0;  // polled magnetometer rate, mHz
+	uint64_t magBits = 0; // magnetometer bit times per 1000 s
+	uint8_t sampleBytes = 0;
+	int threshold;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->busHz = busHz;
+	if (busHz == 0)
+	{
+		// Every bus time below divides by the clock
+		plan->status = PLAN_BAD_BUS;
+		return plan->status;
+	}
+
+	// With the gyro on, the accel runs at the gyro ODR and every FIFO level
+	// holds both (12 bytes from OUT_X_L_G). Accel-only mode stores 6 bytes.
+	if (settings->gyro.enabled)
+	{
+		fifoODR = gyroODR_mHz[settings->gyro.sampleRate & 0x07];
+		sampleBytes = 12;
+	}
+	else if (settings->accel.enabled)
+	{
+		fifoODR = accelODR_mHz[settings->accel.sampleRate & 0x07];
+		sampleBytes = 6;
+	}
+	// The magnetometer has no FIFO: one 6-byte read per conversion.
+	if (settings->mag.enabled && (settings->mag.operatingMode & 0x3) == 0)
+	{
+		magODR = magODR_mHz[settings->mag.sampleRate & 0x07];
+		magBits = (uint64_t)I2C_SCHED_BusBits(6) * magODR;
+	}
+	plan->fifoRate = fifoODR;
+	plan->sampleBytes = sampleBytes;
+	plan->bytesPerSecond = (uint32_t)(((uint64_t)sampleBytes * fifoODR +
+	                                   6ULL * magODR) / 1000);
+
+	if (fifoODR == 0)
+	{
+		// Magnetometer only, nothing to drain.
+		plan->busBitsPerSecond = (uint32_t)(magBits / 1000);
+		plan->utilization = (uint16_t)divUp(magBits, busHz);
+		plan->wakeupRate = magODR;
+		plan->status = plan->utilization > 1000 ? PLAN_BUS_OVERLOAD : PLAN_OK;
+		return plan->status;
+	}
+
+	// Highest threshold first: it gives the fewest wake-ups. The first one
+	// that satisfies every constraint wins; if none does, the plan left
+	// behind is the one for threshold 1, the lowest-latency choice.
+	for (threshold = LSM9DS1_FIFO_DEPTH - 1; threshold >= 1; threshold--)
+	{
+		uint8_t transactions;
+		uint32_t bits = drainBits(threshold, sampleBytes, &transactions);
+		uint32_t drainUs = divUp((uint64_t)bits * 1000000, busHz);
+		uint32_t serviceUs = request->wakeLatencyUs + drainUs;
+		// Samples that land while we wake up and drain.
+		uint32_t arriving = divUp((uint64_t)serviceUs * fifoODR, 1000000000ULL);
+		uint64_t busBits = (uint64_t)bits * fifoODR / threshold + magBits;
+
+		plan->fifoThreshold = threshold;
+		plan->drainBurst = threshold < LSM9DS1_MAX_BURST_BYTES / sampleBytes ?
+		                   threshold : LSM9DS1_MAX_BURST_BYTES / sampleBytes;
+		plan->drainTransactions = transactions;
+		plan->drainUs = drainUs;
+		plan->busBitsPerSecond = (uint32_t)(busBits / 1000);
+		plan->utilization = (uint16_t)divUp(busBits, busHz);
+		plan->wakeupRate = fifoODR / threshold + magODR;
+		plan->latencyUs = (uint32_t)((uint64_t)(threshold - 1) * 1000000000ULL / fifoODR) +
+		                  serviceUs;
+
+		if (plan->utilization > 1000)
+			plan->status = PLAN_BUS_OVERLOAD;
+		else if (threshold + arriving > LSM9DS1_FIFO_DEPTH)
+			plan->status = PLAN_FIFO_OVERRUN;
+		else if (request->maxLatencyUs && plan->latencyUs > request->maxLatencyUs)
+			plan->status = PLAN_LATENCY;
+		else
+			plan->status = PLAN_OK;
+
+		if (plan->status == PLAN_OK)
+			break;
+	}
+
+	return plan->status;
+}
+
+lsm9ds1_plan_status LSM9DS1_proposePlan(const IMUSettings *settings,
+                                        const lsm9ds1_plan_request *request,
+                                        lsm9ds1_plan *plan)
+{
+	uint32_t busHz = settings->device.i2cSpeed ? settings->device.i2cSpeed : 100000;
+
+	if (LSM9DS1_planBus(settings, busHz, request, plan) == PLAN_OK || busHz >= 400000)
+		return plan->status;
+
+	// Standard mode is not enough, try fast mode.
+	return LSM9DS1_planBus(settings, 400000, request, plan);
+}
+
+void LSM9DS1_applyPlan(const lsm9ds1_plan *plan)
+{
+	if ((plan->status != PLAN_OK) || (plan->fifoThreshold == 0))
+		return;
+
+	LSM9DS1_enableFIFO(true);
+	LSM9DS1_setFIFO(FIFO_CONT, plan->fifoThreshold);
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+
+	LSM9DS1_Planner.h
+	Bus bandwidth planner for the LSM9DS1 driver.
+
+Given the IMUSettings that begin() will apply and the I2C clock, the planner
+works out how many bytes per second the configuration moves, which FIFO
+threshold to program, how to split each FIFO drain into bus transactions and
+how busy that keeps the bus. Configurations that would overrun the FIFO,
+overload the bus or miss the latency bound are rejected, and the feasible
+configuration with the fewest wake-ups is proposed.
+
+The model assumes the accel/gyro samples are drained from the FIFO on the
+FIFO threshold interrupt and the magnetometer (which has no FIFO) is read
+once per sample in continuous-conversion mode.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Planner_H__
+#define __LSM9DS1_Planner_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_Types.h"
+
+    // FIFO depth, in samples, and the largest burst the i2c_if transaction
+    // length (an unsigned char) can carry.
+    #define LSM9DS1_FIFO_DEPTH          32
+    #define LSM9DS1_MAX_BURST_BYTES     255
+
+    typedef enum lsm9ds1_plan_status {
+        PLAN_OK,              // configuration fits
+        PLAN_BUS_OVERLOAD,    // more traffic than the bus can carry
+        PLAN_FIFO_OVERRUN,    // FIFO fills before it can be drained
+        PLAN_LATENCY,         // no threshold meets the latency bound
+        PLAN_BAD_BUS          // busHz is 0
+    } lsm9ds1_plan_status;
+
+    typedef struct
+    {
+        uint32_t maxLatencyUs;    // oldest sample age when handed to the consumer
+        uint32_t wakeLatencyUs;   // time from FIFO interrupt to start of the drain
+    } lsm9ds1_plan_request;
+
+    typedef struct
+    {
+        lsm9ds1_plan_status status;
+        uint32_t busHz;           // I2C clock the plan was computed for
+        uint8_t fifoThreshold;    // FTH to program in FIFO_CTRL
+        uint32_t fifoRate;        // FIFO sample rate, mHz (0: FIFO unused)
+        uint8_t sampleBytes;      // bytes per FIFO level (12: gyro+accel, 6: accel)
+        uint8_t drainBurst;       // samples per drain transaction
+        uint8_t drainTransactions;// transactions per drain (FIFO_SRC read excluded)
+        uint32_t bytesPerSecond;  // sensor payload (accel, gyro and mag data)
+        uint32_t busBitsPerSecond;// bus time used, payload plus addressing
+        uint16_t utilization;     // busBitsPerSecond / busHz, per mille
+        uint32_t wakeupRate;      // FIFO drains plus mag reads per second, x1000
+        uint32_t latencyUs;       // worst-case sample age at the consumer
+        uint32_t drainUs;         // bus time of one FIFO drain
+    } lsm9ds1_plan;
+
+    // planBus() -- Evaluate a configuration at a given I2C clock.
+    // Picks the highest FIFO threshold (fewest wake-ups) that meets the
+    // latency bound without overrunning the FIFO or the bus.
+    // Input:
+    //	- settings = Configuration to evaluate (see LSM9DS1_getSettings()).
+    //	- busHz = I2C clock in Hz, not 0.
+    //	- request = Latency bound and interrupt response time.
+    //	- plan = Filled with the result; on failure it describes the
+    //	  lowest-latency threshold so the shortfall can be reported.
+    // Output: PLAN_OK or the reason the configuration is infeasible.
+    lsm9ds1_plan_status LSM9DS1_planBus(const IMUSettings *settings, uint32_t busHz,
+                                        const lsm9ds1_plan_request *request,
+                                        lsm9ds1_plan *plan);
+
+    // proposePlan() -- Plan at settings->device.i2cSpeed and, if that is
+    // infeasible, at 400 kHz fast mode. plan->busHz tells which one fits.
+    lsm9ds1_plan_status LSM9DS1_proposePlan(const IMUSettings *settings,
+                                            const lsm9ds1_plan_request *request,
+                                            lsm9ds1_plan *plan);
+
+    // applyPlan() -- Program the FIFO threshold of a feasible plan and put the
+    // FIFO in continuous mode. The I2C clock (plan->busHz) must be stored in
+    // settings.device.i2cSpeed before begin().
+    void LSM9DS1_applyPlan(const lsm9ds1_plan *plan);
+
+#endif
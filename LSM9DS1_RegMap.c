@@ -0,0 +1,86 @@
+/******************************************************************************
+
+	LSM9DS1_RegMap.c
+	Lookup tables generated from the lists in LSM9DS1_Registers.h.
+
+The register tables are indexed by address so lookups are constant time;
+unlisted (reserved) addresses are left zeroed.
+******************************************************************************/
+
+#include "LSM9DS1_RegMap.h"
+#include "LSM9DS1_Registers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define REG_INFO(name, address, reset, access, group) \
+	[address] = {#name, address, reset, access, group},
+
+static const lsm9ds1_reg_info xgRegisters[LSM9DS1_REG_SPACE] = {
+	LSM9DS1_XG_REGISTERS(REG_INFO)
+};
+
+static const lsm9ds1_reg_info mRegisters[LSM9DS1_REG_SPACE] = {
+	LSM9DS1_M_REGISTERS(REG_INFO)
+};
+
+#undef REG_INFO
+
+#define XG_FIELD_INFO(reg, field, shift, width)	{#field, 0, reg, shift, width},
+#define M_FIELD_INFO(reg, field, shift, width)	{#field, 1, reg, shift, width},
+
+static const lsm9ds1_field_info fields[LSM9DS1_FIELD_COUNT] = {
+	LSM9DS1_XG_FIELDS(XG_FIELD_INFO)
+	LSM9DS1_M_FIELDS(M_FIELD_INFO)
+};
+
+#undef XG_FIELD_INFO
+#undef M_FIELD_INFO
+
+const lsm9ds1_reg_info * LSM9DS1_regInfo(uint8_t mag, uint8_t address)
+{
+	const lsm9ds1_reg_info *info;
+
+	if (address >= LSM9DS1_REG_SPACE)
+		return NULL;
+
+	info = mag ? &mRegisters[address] : &xgRegisters[address];
+	return info->access ? info : NULL;
+}
+
+const lsm9ds1_field_info * LSM9DS1_fieldInfo(lsm9ds1_field field)
+{
+	return (field < LSM9DS1_FIELD_COUNT) ? &fields[field] : NULL;
+}
+
+bool LSM9DS1_canBurst(uint8_t mag, uint8_t address, uint8_t count)
+{
+	const lsm9ds1_reg_info *info;
+	uint8_t ii;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		info = LSM9DS1_regInfo(mag, address + ii);
+		if ((info == NULL) || (info->access & REG_CLEAR))
+			return false;
+	}
+	return true;
+}
+
+uint8_t LSM9DS1_burstLength(uint8_t mag, uint8_t address)
+{
+	const lsm9ds1_reg_info *info = LSM9DS1_regInfo(mag, address);
+	const lsm9ds1_reg_info *next;
+	uint8_t length = 1;
+
+	if (info == NULL)
+		return 0;
+	if (info->group == 0)
+		return 1;
+
+	while ((next = LSM9DS1_regInfo(mag, address + length)) != NULL &&
+	       (next->group == info->group))
+		length++;
+	return length;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+
+	LSM9DS1_RegMap.h
+	Register map generated from the lists in LSM9DS1_Registers.h.
+
+For every field X(register, field, shift, width) this header defines
+LSM9DS1_field_REG, LSM9DS1_field_SHIFT and LSM9DS1_field_MASK plus two
+typed accessors working on a register value:
+	LSM9DS1_get_field(value) -- extract the field
+	LSM9DS1_set_field(value, fieldValue) -- return value with the field replaced
+e.g. LSM9DS1_set_FS_XL(ctrl6, 2) instead of (ctrl6 & 0xE7) | (2 << 3).
+
+LSM9DS1_regInfo() and LSM9DS1_fieldInfo() give run-time access to the same
+description (reset values, access rights, burst groups) for code that walks
+the map, such as the read planner and the host simulator. This header has
+no dependency on the driver or the RTOS.
+******************************************************************************/
+
+#ifndef __LSM9DS1_RegMap_H__
+#define __LSM9DS1_RegMap_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_Registers.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Access rights, a bit set: read, write, clear-on-read.
+    #define REG_READ                0x01
+    #define REG_WRITE               0x02
+    #define REG_CLEAR               0x04
+    #define REG_RO                  (REG_READ)
+    #define REG_RW                  (REG_READ | REG_WRITE)
+    #define REG_COR                 (REG_READ | REG_CLEAR)
+
+    // Registers span 0x00..0x3F on both devices.
+    #define LSM9DS1_REG_SPACE       0x40
+
+    typedef struct
+    {
+        const char *name;       // NULL for reserved addresses
+        uint8_t address;
+        uint8_t reset;          // value after power-up or software reset
+        uint8_t access;         // REG_RO, REG_RW or REG_COR
+        uint8_t group;          // burst group, 0: read on its own
+    } lsm9ds1_reg_info;
+
+    typedef struct
+    {
+        const char *name;
+        uint8_t mag;            // 0: accel/gyro, 1: magnetometer
+        uint8_t address;
+        uint8_t shift;
+        uint8_t width;
+    } lsm9ds1_field_info;
+
+    // Field constants and accessors
+    #define LSM9DS1_FIELD_ACCESSORS(reg, field, shift, width)                   \
+        enum { LSM9DS1_##field##_REG = reg, LSM9DS1_##field##_SHIFT = shift,    \
+               LSM9DS1_##field##_MASK = ((1 << (width)) - 1) << (shift) };      \
+        static inline uint8_t LSM9DS1_get_##field(uint8_t value)                \
+        {                                                                       \
+            return (uint8_t)((value & LSM9DS1_##field##_MASK) >>                \
+                             LSM9DS1_##field##_SHIFT);                          \
+        }                                                                       \
+        static inline uint8_t LSM9DS1_set_##field(uint8_t value, uint8_t fieldValue) \
+        {                                                                       \
+            return (uint8_t)((value & ~LSM9DS1_##field##_MASK) |                \
+                             ((fieldValue << LSM9DS1_##field##_SHIFT) &         \
+                              LSM9DS1_##field##_MASK));                         \
+        }
+    LSM9DS1_XG_FIELDS(LSM9DS1_FIELD_ACCESSORS)
+    LSM9DS1_M_FIELDS(LSM9DS1_FIELD_ACCESSORS)
+    #undef LSM9DS1_FIELD_ACCESSORS
+
+    // Field identifiers for LSM9DS1_fieldInfo(): LSM9DS1_FIELD_<field>
+    #define LSM9DS1_FIELD_ID(reg, field, shift, width)  LSM9DS1_FIELD_##field,
+    typedef enum lsm9ds1_field {
+        LSM9DS1_XG_FIELDS(LSM9DS1_FIELD_ID)
+        LSM9DS1_M_FIELDS(LSM9DS1_FIELD_ID)
+        LSM9DS1_FIELD_COUNT
+    } lsm9ds1_field;
+    #undef LSM9DS1_FIELD_ID
+
+    // regInfo() -- Description of a register, NULL if the address is reserved.
+    const lsm9ds1_reg_info * LSM9DS1_regInfo(uint8_t mag, uint8_t address);
+
+    // fieldInfo() -- Description of a field.
+    const lsm9ds1_field_info * LSM9DS1_fieldInfo(lsm9ds1_field field);
+
+    // canBurst() -- True if count registers from address can be read in one
+    // auto-increment burst without touching reserved or clear-on-read
+    // registers, i.e. reading them has no side effect.
+    bool LSM9DS1_canBurst(uint8_t mag, uint8_t address, uint8_t count);
+
+    // burstLength() -- Registers from address to the end of its burst group
+    // (1 for group 0, 0 for a reserved address).
+    uint8_t LSM9DS1_burstLength(uint8_t mag, uint8_t address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
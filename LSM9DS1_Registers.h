@@ -9,6 +9,12 @@ Original Creation Date: April 21, 2015
 https://github.com/sparkfun/LSM9DS1_Breakout
 This file defines all registers internal to the gyro/accel and magnetometer
 devices in the LSM9DS1.
+
+The map is a set of X-macro lists, the single description of the device:
+every register with its reset value, access rights and burst group, and
+every bit field with its position. The register addresses below are
+generated from it; LSM9DS1_RegMap.h generates the lookup tables and the
+field accessors used by the driver and by the host simulator.
 Development environment specifics:
 	IDE: Arduino 1.6.0
 	Hardware Platform: Arduino Uno
@@ -21,86 +27,189 @@ Distributed as-is; no warranty is given.
 #ifndef __LSM9DS1_Registers_H__
 #define __LSM9DS1_Registers_H__
 
+// Register lists: X(name, address, reset value, access, burst group)
+//	- access: REG_RO, REG_RW, or REG_COR (read-only, reading clears
+//	  latched interrupt bits; never read as a side effect of a burst).
+//	- burst group: registers of the same non-zero group are contiguous and
+//	  are read in one burst with auto-increment (IF_ADD_INC on the
+//	  accel/gyro, sub-address MSB on the magnetometer). Group 0 registers
+//	  are only read on their own.
+
 /////////////////////////////////////////
 // LSM9DS1 Accel/Gyro (XL/G) Registers //
 /////////////////////////////////////////
-#define ACT_THS				0x04
-#define ACT_DUR				0x05
-#define INT_GEN_CFG_XL		0x06
-#define INT_GEN_THS_X_XL	0x07
-#define INT_GEN_THS_Y_XL	0x08
-#define INT_GEN_THS_Z_XL	0x09
-#define INT_GEN_DUR_XL		0x0A
-#define REFERENCE_G			0x0B
-#define INT1_CTRL			0x0C
-#define INT2_CTRL			0x0D
-#define WHO_AM_I_XG			0x0F
-#define CTRL_REG1_G			0x10
-#define CTRL_REG2_G			0x11
-#define CTRL_REG3_G			0x12
-#define ORIENT_CFG_G		0x13
-#define INT_GEN_SRC_G		0x14
-#define OUT_TEMP_L			0x15
-#define OUT_TEMP_H			0x16
-#define STATUS_REG_0		0x17
-#define OUT_X_L_G			0x18
-#define OUT_X_H_G			0x19
-#define OUT_Y_L_G			0x1A
-#define OUT_Y_H_G			0x1B
-#define OUT_Z_L_G			0x1C
-#define OUT_Z_H_G			0x1D
-#define CTRL_REG4			0x1E
-#define CTRL_REG5_XL		0x1F
-#define CTRL_REG6_XL		0x20
-#define CTRL_REG7_XL		0x21
-#define CTRL_REG8			0x22
-#define CTRL_REG9			0x23
-#define CTRL_REG10			0x24
-#define INT_GEN_SRC_XL		0x26
-#define STATUS_REG_1		0x27
-#define OUT_X_L_XL			0x28
-#define OUT_X_H_XL			0x29
-#define OUT_Y_L_XL			0x2A
-#define OUT_Y_H_XL			0x2B
-#define OUT_Z_L_XL			0x2C
-#define OUT_Z_H_XL			0x2D
-#define FIFO_CTRL			0x2E
-#define FIFO_SRC			0x2F
-#define INT_GEN_CFG_G		0x30
-#define INT_GEN_THS_XH_G	0x31
-#define INT_GEN_THS_XL_G	0x32
-#define INT_GEN_THS_YH_G	0x33
-#define INT_GEN_THS_YL_G	0x34
-#define INT_GEN_THS_ZH_G	0x35
-#define INT_GEN_THS_ZL_G	0x36
-#define INT_GEN_DUR_G		0x37
+#define LSM9DS1_XG_REGISTERS(X) \
+	X(ACT_THS,          0x04, 0x00, REG_RW, 1) \
+	X(ACT_DUR,          0x05, 0x00, REG_RW, 1) \
+	X(INT_GEN_CFG_XL,   0x06, 0x00, REG_RW, 1) \
+	X(INT_GEN_THS_X_XL, 0x07, 0x00, REG_RW, 1) \
+	X(INT_GEN_THS_Y_XL, 0x08, 0x00, REG_RW, 1) \
+	X(INT_GEN_THS_Z_XL, 0x09, 0x00, REG_RW, 1) \
+	X(INT_GEN_DUR_XL,   0x0A, 0x00, REG_RW, 1) \
+	X(REFERENCE_G,      0x0B, 0x00, REG_RW, 1) \
+	X(INT1_CTRL,        0x0C, 0x00, REG_RW, 1) \
+	X(INT2_CTRL,        0x0D, 0x00, REG_RW, 1) \
+	X(WHO_AM_I_XG,      0x0F, 0x68, REG_RO, 2) \
+	X(CTRL_REG1_G,      0x10, 0x00, REG_RW, 3) \
+	X(CTRL_REG2_G,      0x11, 0x00, REG_RW, 3) \
+	X(CTRL_REG3_G,      0x12, 0x00, REG_RW, 3) \
+	X(ORIENT_CFG_G,     0x13, 0x00, REG_RW, 3) \
+	X(INT_GEN_SRC_G,    0x14, 0x00, REG_COR,0) \
+	X(OUT_TEMP_L,       0x15, 0x00, REG_RO, 4) \
+	X(OUT_TEMP_H,       0x16, 0x00, REG_RO, 4) \
+	X(STATUS_REG_0,     0x17, 0x00, REG_RO, 4) \
+	X(OUT_X_L_G,        0x18, 0x00, REG_RO, 4) \
+	X(OUT_X_H_G,        0x19, 0x00, REG_RO, 4) \
+	X(OUT_Y_L_G,        0x1A, 0x00, REG_RO, 4) \
+	X(OUT_Y_H_G,        0x1B, 0x00, REG_RO, 4) \
+	X(OUT_Z_L_G,        0x1C, 0x00, REG_RO, 4) \
+	X(OUT_Z_H_G,        0x1D, 0x00, REG_RO, 4) \
+	X(CTRL_REG4,        0x1E, 0x38, REG_RW, 5) \
+	X(CTRL_REG5_XL,     0x1F, 0x38, REG_RW, 5) \
+	X(CTRL_REG6_XL,     0x20, 0x00, REG_RW, 5) \
+	X(CTRL_REG7_XL,     0x21, 0x00, REG_RW, 5) \
+	X(CTRL_REG8,        0x22, 0x04, REG_RW, 5) \
+	X(CTRL_REG9,        0x23, 0x00, REG_RW, 5) \
+	X(CTRL_REG10,       0x24, 0x00, REG_RW, 5) \
+	X(INT_GEN_SRC_XL,   0x26, 0x00, REG_COR,0) \
+	X(STATUS_REG_1,     0x27, 0x00, REG_RO, 6) \
+	X(OUT_X_L_XL,       0x28, 0x00, REG_RO, 6) \
+	X(OUT_X_H_XL,       0x29, 0x00, REG_RO, 6) \
+	X(OUT_Y_L_XL,       0x2A, 0x00, REG_RO, 6) \
+	X(OUT_Y_H_XL,       0x2B, 0x00, REG_RO, 6) \
+	X(OUT_Z_L_XL,       0x2C, 0x00, REG_RO, 6) \
+	X(OUT_Z_H_XL,       0x2D, 0x00, REG_RO, 6) \
+	X(FIFO_CTRL,        0x2E, 0x00, REG_RW, 7) \
+	X(FIFO_SRC,         0x2F, 0x00, REG_RO, 7) \
+	X(INT_GEN_CFG_G,    0x30, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_XH_G, 0x31, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_XL_G, 0x32, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_YH_G, 0x33, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_YL_G, 0x34, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_ZH_G, 0x35, 0x00, REG_RW, 8) \
+	X(INT_GEN_THS_ZL_G, 0x36, 0x00, REG_RW, 8) \
+	X(INT_GEN_DUR_G,    0x37, 0x00, REG_RW, 8)
 
 ///////////////////////////////
 // LSM9DS1 Magneto Registers //
 ///////////////////////////////
-#define OFFSET_X_REG_L_M	0x05
-#define OFFSET_X_REG_H_M	0x06
-#define OFFSET_Y_REG_L_M	0x07
-#define OFFSET_Y_REG_H_M	0x08
-#define OFFSET_Z_REG_L_M	0x09
-#define OFFSET_Z_REG_H_M	0x0A
-#define WHO_AM_I_M			0x0F
-#define CTRL_REG1_M			0x20
-#define CTRL_REG2_M			0x21
-#define CTRL_REG3_M			0x22
-#define CTRL_REG4_M			0x23
-#define CTRL_REG5_M			0x24
-#define STATUS_REG_M		0x27
-#define OUT_X_L_M			0x28
-#define OUT_X_H_M			0x29
-#define OUT_Y_L_M			0x2A
-#define OUT_Y_H_M			0x2B
-#define OUT_Z_L_M			0x2C
-#define OUT_Z_H_M			0x2D
-#define INT_CFG_M			0x30
-#define INT_SRC_M			0x31
-#define INT_THS_L_M			0x32
-#define INT_THS_H_M			0x33
+#define LSM9DS1_M_REGISTERS(X) \
+	X(OFFSET_X_REG_L_M, 0x05, 0x00, REG_RW, 1) \
+	X(OFFSET_X_REG_H_M, 0x06, 0x00, REG_RW, 1) \
+	X(OFFSET_Y_REG_L_M, 0x07, 0x00, REG_RW, 1) \
+	X(OFFSET_Y_REG_H_M, 0x08, 0x00, REG_RW, 1) \
+	X(OFFSET_Z_REG_L_M, 0x09, 0x00, REG_RW, 1) \
+	X(OFFSET_Z_REG_H_M, 0x0A, 0x00, REG_RW, 1) \
+	X(WHO_AM_I_M,       0x0F, 0x3D, REG_RO, 2) \
+	X(CTRL_REG1_M,      0x20, 0x10, REG_RW, 3) \
+	X(CTRL_REG2_M,      0x21, 0x00, REG_RW, 3) \
+	X(CTRL_REG3_M,      0x22, 0x03, REG_RW, 3) \
+	X(CTRL_REG4_M,      0x23, 0x00, REG_RW, 3) \
+	X(CTRL_REG5_M,      0x24, 0x00, REG_RW, 3) \
+	X(STATUS_REG_M,     0x27, 0x00, REG_RO, 4) \
+	X(OUT_X_L_M,        0x28, 0x00, REG_RO, 4) \
+	X(OUT_X_H_M,        0x29, 0x00, REG_RO, 4) \
+	X(OUT_Y_L_M,        0x2A, 0x00, REG_RO, 4) \
+	X(OUT_Y_H_M,        0x2B, 0x00, REG_RO, 4) \
+	X(OUT_Z_L_M,        0x2C, 0x00, REG_RO, 4) \
+	X(OUT_Z_H_M,        0x2D, 0x00, REG_RO, 4) \
+	X(INT_CFG_M,        0x30, 0x08, REG_RW, 5) \
+	X(INT_SRC_M,        0x31, 0x00, REG_COR,0) \
+	X(INT_THS_L_M,      0x32, 0x00, REG_RW, 5) \
+	X(INT_THS_H_M,      0x33, 0x00, REG_RW, 5)
+
+// Field lists: X(register, field, shift, width). Field names are unique
+// across both devices.
+
+/////////////////////////////////////////
+// LSM9DS1 Accel/Gyro (XL/G) Fields    //
+/////////////////////////////////////////
+#define LSM9DS1_XG_FIELDS(X) \
+	X(CTRL_REG1_G,  ODR_G,         5, 3) \
+	X(CTRL_REG1_G,  FS_G,          3, 2) \
+	X(CTRL_REG1_G,  BW_G,          0, 2) \
+	X(CTRL_REG2_G,  INT_SEL,       2, 2) \
+	X(CTRL_REG2_G,  OUT_SEL,       0, 2) \
+	X(CTRL_REG3_G,  LP_MODE,       7, 1) \
+	X(CTRL_REG3_G,  HP_EN,         6, 1) \
+	X(CTRL_REG3_G,  HPCF_G,        0, 4) \
+	X(ORIENT_CFG_G, SIGNX_G,       5, 1) \
+	X(ORIENT_CFG_G, SIGNY_G,       4, 1) \
+	X(ORIENT_CFG_G, SIGNZ_G,       3, 1) \
+	X(ORIENT_CFG_G, ORIENT,        0, 3) \
+	X(CTRL_REG4,    ZEN_G,         5, 1) \
+	X(CTRL_REG4,    YEN_G,         4, 1) \
+	X(CTRL_REG4,    XEN_G,         3, 1) \
+	X(CTRL_REG4,    LIR_XL1,       1, 1) \
+	X(CTRL_REG4,    D4D_XL1,       0, 1) \
+	X(CTRL_REG5_XL, DEC,           6, 2) \
+	X(CTRL_REG5_XL, ZEN_XL,        5, 1) \
+	X(CTRL_REG5_XL, YEN_XL,        4, 1) \
+	X(CTRL_REG5_XL, XEN_XL,        3, 1) \
+	X(CTRL_REG6_XL, ODR_XL,        5, 3) \
+	X(CTRL_REG6_XL, FS_XL,         3, 2) \
+	X(CTRL_REG6_XL, BW_SCAL_ODR,   2, 1) \
+	X(CTRL_REG6_XL, BW_XL,         0, 2) \
+	X(CTRL_REG7_XL, HR,            7, 1) \
+	X(CTRL_REG7_XL, DCF,           5, 2) \
+	X(CTRL_REG7_XL, FDS,           2, 1) \
+	X(CTRL_REG7_XL, HPIS1,         0, 1) \
+	X(CTRL_REG8,    BOOT,          7, 1) \
+	X(CTRL_REG8,    BDU,           6, 1) \
+	X(CTRL_REG8,    H_LACTIVE,     5, 1) \
+	X(CTRL_REG8,    PP_OD,         4, 1) \
+	X(CTRL_REG8,    SIM,           3, 1) \
+	X(CTRL_REG8,    IF_ADD_INC,    2, 1) \
+	X(CTRL_REG8,    BLE,           1, 1) \
+	X(CTRL_REG8,    SW_RESET,      0, 1) \
+	X(CTRL_REG9,    SLEEP_G,       6, 1) \
+	X(CTRL_REG9,    FIFO_TEMP_EN,  4, 1) \
+	X(CTRL_REG9,    DRDY_MASK_BIT, 3, 1) \
+	X(CTRL_REG9,    I2C_DISABLE,   2, 1) \
+	X(CTRL_REG9,    FIFO_EN,       1, 1) \
+	X(CTRL_REG9,    STOP_ON_FTH,   0, 1) \
+	X(STATUS_REG_1, IG_XL,         6, 1) \
+	X(STATUS_REG_1, IG_G,          5, 1) \
+	X(STATUS_REG_1, INACT,         4, 1) \
+	X(STATUS_REG_1, BOOT_STATUS,   3, 1) \
+	X(STATUS_REG_1, TDA,           2, 1) \
+	X(STATUS_REG_1, GDA,           1, 1) \
+	X(STATUS_REG_1, XLDA,          0, 1) \
+	X(FIFO_CTRL,    FMODE,         5, 3) \
+	X(FIFO_CTRL,    FTH,           0, 5) \
+	X(FIFO_SRC,     FTH_FLAG,      7, 1) \
+	X(FIFO_SRC,     OVRN,          6, 1) \
+	X(FIFO_SRC,     FSS,           0, 6)
+
+///////////////////////////////
+// LSM9DS1 Magneto Fields    //
+///////////////////////////////
+#define LSM9DS1_M_FIELDS(X) \
+	X(CTRL_REG1_M,  TEMP_COMP,     7, 1) \
+	X(CTRL_REG1_M,  OM,            5, 2) \
+	X(CTRL_REG1_M,  DO,            2, 3) \
+	X(CTRL_REG1_M,  FAST_ODR,      1, 1) \
+	X(CTRL_REG1_M,  ST,            0, 1) \
+	X(CTRL_REG2_M,  FS_M,          5, 2) \
+	X(CTRL_REG2_M,  REBOOT,        3, 1) \
+	X(CTRL_REG2_M,  SOFT_RST,      2, 1) \
+	X(CTRL_REG3_M,  I2C_DISABLE_M, 7, 1) \
+	X(CTRL_REG3_M,  LP,            5, 1) \
+	X(CTRL_REG3_M,  SIM_M,         2, 1) \
+	X(CTRL_REG3_M,  MD,            0, 2) \
+	X(CTRL_REG4_M,  OMZ,           2, 2) \
+	X(CTRL_REG4_M,  BLE_M,         1, 1) \
+	X(CTRL_REG5_M,  FAST_READ,     7, 1) \
+	X(CTRL_REG5_M,  BDU_M,         6, 1) \
+	X(STATUS_REG_M, ZYXOR,         7, 1) \
+	X(STATUS_REG_M, ZYXDA,         3, 1) \
+	X(INT_SRC_M,    INT_M,         0, 1)
+
+// Register addresses
+#define LSM9DS1_REGISTER_ADDRESS(name, address, reset, access, group)	name = address,
+enum lsm9ds1_xg_register { LSM9DS1_XG_REGISTERS(LSM9DS1_REGISTER_ADDRESS) };
+enum lsm9ds1_m_register { LSM9DS1_M_REGISTERS(LSM9DS1_REGISTER_ADDRESS) };
+#undef LSM9DS1_REGISTER_ADDRESS
 
 ////////////////////////////////
 // LSM9DS1 WHO_AM_I Responses //
@@ -108,4 +217,4 @@ Distributed as-is; no warranty is given.
 #define WHO_AM_I_AG_RSP		0x68
 #define WHO_AM_I_M_RSP		0x3D
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,253 @@
+/******************************************************************************
+
+	LSM9DS1_Shm.c
+	Shared-memory IMU stream for several Linux processes.
+
+The publisher is the only writer of the ring. For frame n it marks slot
+n % slotCount odd (2n + 1), stores the frame and marks it complete (2n + 2),
+then advances header->published. A reader copies the slot between two reads
+of the sequence word and keeps the copy only if both match the value it
+expects, which costs two loads and a 32-byte copy per frame.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "LSM9DS1_Shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+static uint32_t roundUpPow2(uint32_t value)
+{
+	uint32_t pow2 = 1;
+
+	while (pow2 < value)
+		pow2 <<= 1;
+	return pow2;
+}
+
+static size_t mapSize(uint32_t slotCount)
+{
+	return sizeof(lsm9ds1_shm_header) + (size_t)slotCount * sizeof(lsm9ds1_shm_slot);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+int LSM9DS1_shmCreate(lsm9ds1_shm_publisher *pub, const char *name,
+                      uint32_t slotCount, float gyroRes, float accelRes,
+                      float magRes, uint32_t sampleRateMHz)
+{
+	lsm9ds1_shm_header *header;
+	void *map;
+	int fd;
+
+	memset(pub, 0, sizeof(*pub));
+	slotCount = roundUpPow2(slotCount < 2 ? 2 : slotCount);
+	snprintf(pub->name, sizeof(pub->name), "%s", name);
+	pub->mapSize = mapSize(slotCount);
+
+	// Readers still mapping an old ring keep it; new readers get this one
+	shm_unlink(name);
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, (off_t)pub->mapSize) < 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+	map = mmap(NULL, pub->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return -1;
+	}
+
+	// ftruncate() zero-fills, so every slot starts with seq 0 (empty)
+	header = (lsm9ds1_shm_header *)map;
+	header->version = LSM9DS1_SHM_VERSION;
+	header->slotCount = slotCount;
+	header->slotSize = sizeof(lsm9ds1_shm_slot);
+	header->gyroRes = gyroRes;
+	header->accelRes = accelRes;
+	header->magRes = magRes;
+	header->sampleRateMHz = sampleRateMHz;
+	header->publisherPid = (uint32_t)getpid();
+	__atomic_store_n(&header->magic, LSM9DS1_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	pub->header = header;
+	pub->slots = (lsm9ds1_shm_slot *)(header + 1);
+	return 0;
+}
+
+void LSM9DS1_shmPublish(lsm9ds1_shm_publisher *pub,
+                        lsm9ds1_shm_frame *frames, uint32_t count)
+{
+	lsm9ds1_shm_header *header = pub->header;
+	uint64_t n = header->published;
+	lsm9ds1_shm_slot *slot;
+	uint32_t ii;
+
+	if (count == 0)
+		return;
+
+	for (ii = 0; ii < count; ii++, n++)
+	{
+		slot = &pub->slots[n & (header->slotCount - 1)];
+		__atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		frames[ii].sequence = (uint32_t)n;
+		slot->frame = frames[ii];
+		__atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+	}
+
+	__atomic_store_n(&header->published, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&header->futex, (uint32_t)n, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &header->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void LSM9DS1_shmDestroy(lsm9ds1_shm_publisher *pub)
+{
+	if (pub->header != NULL)
+	{
+		munmap(pub->header, pub->mapSize);
+		shm_unlink(pub->name);
+		pub->header = NULL;
+	}
+}
+
+int LSM9DS1_shmOpen(lsm9ds1_shm_reader *reader, const char *name)
+{
+	const lsm9ds1_shm_header *header;
+	struct stat info;
+	void *map;
+	int fd;
+
+	memset(reader, 0, sizeof(*reader));
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return -1;
+	if ((fstat(fd, &info) < 0) || ((size_t)info.st_size < sizeof(lsm9ds1_shm_header)))
+	{
+		close(fd);
+		errno = EPROTO;
+		return -1;
+	}
+	map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	header = (const lsm9ds1_shm_header *)map;
+	if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != LSM9DS1_SHM_MAGIC) ||
+	    (header->version != LSM9DS1_SHM_VERSION) ||
+	    (header->slotSize != sizeof(lsm9ds1_shm_slot)) ||
+	    (header->slotCount == 0) || (header->slotCount & (header->slotCount - 1)) ||
+	    (mapSize(header->slotCount) > (size_t)info.st_size))
+	{
+		munmap(map, (size_t)info.st_size);
+		errno = EPROTO;
+		return -1;
+	}
+
+	reader->header = header;
+	reader->slots = (const lsm9ds1_shm_slot *)(header + 1);
+	reader->mapSize = (size_t)info.st_size;
+	reader->next = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+int LSM9DS1_shmRead(lsm9ds1_shm_reader *reader, lsm9ds1_shm_frame *frame)
+{
+	const lsm9ds1_shm_header *header = reader->header;
+	const lsm9ds1_shm_slot *slot;
+	uint64_t want, seq, published, oldest;
+
+	for (;;)
+	{
+		slot = &reader->slots[reader->next & (header->slotCount - 1)];
+		want = 2 * reader->next + 2;
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if (seq < want)
+			return 0;   // not published yet (or being written, want - 1)
+
+		if (seq == want)
+		{
+			*frame = slot->frame;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+			if (seq == want)
+			{
+				reader->next++;
+				return 1;
+			}
+		}
+
+		// Lapped by the publisher: the slot holds, or is receiving, frame
+		// (seq - 1) / 2, at least a ring ahead. Everything up to a ring
+		// before it is gone, and published may not count it yet (it advances
+		// once per batch), so resync past both and count the loss.
+		oldest = (seq - 1) / 2 - header->slotCount + 1;
+		published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+		if ((published >= header->slotCount) && (published - header->slotCount + 1 > oldest))
+			oldest = published - header->slotCount + 1;
+		reader->lost += oldest - reader->next;
+		reader->next = oldest;
+	}
+}
+
+bool LSM9DS1_shmWait(lsm9ds1_shm_reader *reader, uint64_t timeoutNs)
+{
+	const lsm9ds1_shm_header *header = reader->header;
+	uint64_t deadline = monotonicNs() + timeoutNs;
+	uint64_t published, now;
+	struct timespec remaining;
+
+	for (;;)
+	{
+		published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+		if (published > reader->next)
+			return true;
+
+		if (timeoutNs)
+		{
+			now = monotonicNs();
+			if (now >= deadline)
+				return false;
+			remaining.tv_sec = (time_t)((deadline - now) / 1000000000ULL);
+			remaining.tv_nsec = (long)((deadline - now) % 1000000000ULL);
+		}
+		// Sleeps only while futex still holds the count we just read
+		syscall(SYS_futex, &header->futex, FUTEX_WAIT, (uint32_t)published,
+		        timeoutNs ? &remaining : NULL, NULL, 0);
+	}
+}
+
+void LSM9DS1_shmClose(lsm9ds1_shm_reader *reader)
+{
+	if (reader->header != NULL)
+	{
+		munmap((void *)reader->header, reader->mapSize);
+		reader->header = NULL;
+	}
+}
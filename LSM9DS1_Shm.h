@@ -0,0 +1,131 @@
+/******************************************************************************
+
+	LSM9DS1_Shm.h
+	Shared-memory IMU stream for several Linux processes.
+
+One publisher (tools/lsm9ds1_pubd.c) owns the bus, drains the FIFO and
+writes timestamped frames into a POSIX shared-memory ring. Any number of
+readers map the ring read-only and consume it without system calls: each
+slot carries a sequence word used as a seqlock, odd while the slot is being
+written and 2 * (frame number + 1) once frame number is complete, so a
+reader can tell a finished frame from a torn or overwritten one. A reader
+that falls more than a ring behind skips to the oldest frame still
+available and is told how many it lost.
+
+Readers that would rather sleep than spin call LSM9DS1_shmWait(), a futex
+wait on the published count; the publisher does one wake per batch.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Shm_H__
+#define __LSM9DS1_Shm_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+    #include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    #define LSM9DS1_SHM_MAGIC           0x394D534CUL    // "LSM9"
+    #define LSM9DS1_SHM_VERSION         1
+    #define LSM9DS1_SHM_DEFAULT_NAME    "/lsm9ds1"
+
+    // lsm9ds1_shm_frame flags
+    #define LSM9DS1_SHM_GYRO            0x01    // gyro holds a new sample
+    #define LSM9DS1_SHM_ACCEL           0x02    // accel holds a new sample
+    #define LSM9DS1_SHM_MAG             0x04    // mag was read with this frame
+    #define LSM9DS1_SHM_OVERRUN         0x08    // FIFO overran before this frame
+
+    typedef struct
+    {
+        uint64_t timestampNs;   // CLOCK_MONOTONIC time of the sample
+        uint32_t sequence;      // frame number, low 32 bits
+        uint16_t flags;         // LSM9DS1_SHM_*
+        int16_t gyro[3];        // raw, times gyroRes for dps
+        int16_t accel[3];       // raw, times accelRes for g
+        int16_t mag[3];         // raw, times magRes for gauss; last read value
+    } lsm9ds1_shm_frame;
+
+    typedef struct
+    {
+        uint64_t seq;           // seqlock, see above
+        lsm9ds1_shm_frame frame;
+    } lsm9ds1_shm_slot;
+
+    // Ring header, followed by slotCount slots. Only the publisher writes it.
+    typedef struct
+    {
+        uint32_t magic;         // written last by the publisher
+        uint32_t version;
+        uint32_t slotCount;     // power of two
+        uint32_t slotSize;      // sizeof(lsm9ds1_shm_slot)
+        float gyroRes;          // scales in force when the ring was created
+        float accelRes;
+        float magRes;
+        uint32_t sampleRateMHz; // FIFO rate, mHz
+        uint64_t published;     // frames published so far
+        uint32_t futex;         // low 32 bits of published, for shmWait()
+        uint32_t publisherPid;
+        uint8_t reserved[16];
+    } lsm9ds1_shm_header;
+
+    typedef struct
+    {
+        lsm9ds1_shm_header *header;
+        lsm9ds1_shm_slot *slots;
+        size_t mapSize;
+        char name[64];
+    } lsm9ds1_shm_publisher;
+
+    typedef struct
+    {
+        const lsm9ds1_shm_header *header;
+        const lsm9ds1_shm_slot *slots;
+        size_t mapSize;
+        uint64_t next;          // next frame number to read
+        uint64_t lost;          // frames overwritten before they were read
+    } lsm9ds1_shm_reader;
+
+    // shmCreate() -- Create (or replace) the shared-memory ring.
+    // Input:
+    //	- name = POSIX shm name, e.g. LSM9DS1_SHM_DEFAULT_NAME.
+    //	- slotCount = Ring length, rounded up to a power of two.
+    //	- gyroRes/accelRes/magRes/sampleRateMHz = Copied to the header.
+    // Output: 0 on success, -1 with errno set on failure.
+    int LSM9DS1_shmCreate(lsm9ds1_shm_publisher *pub, const char *name,
+                          uint32_t slotCount, float gyroRes, float accelRes,
+                          float magRes, uint32_t sampleRateMHz);
+
+    // shmPublish() -- Append count frames; frame sequence numbers are
+    // filled in. Readers blocked in shmWait() are woken once.
+    void LSM9DS1_shmPublish(lsm9ds1_shm_publisher *pub,
+                            lsm9ds1_shm_frame *frames, uint32_t count);
+
+    // shmDestroy() -- Unmap and unlink the ring.
+    void LSM9DS1_shmDestroy(lsm9ds1_shm_publisher *pub);
+
+    // shmOpen() -- Map an existing ring read-only. The reader starts at the
+    // next frame to be published.
+    // Output: 0 on success, -1 with errno set (EPROTO: bad header).
+    int LSM9DS1_shmOpen(lsm9ds1_shm_reader *reader, const char *name);
+
+    // shmRead() -- Copy the next frame out of the ring.
+    // Output: 1 if a frame was stored, 0 if none is available yet. A reader
+    // lapped by the publisher resumes at the oldest frame that is not being
+    // overwritten; the frames skipped are added to reader->lost.
+    int LSM9DS1_shmRead(lsm9ds1_shm_reader *reader, lsm9ds1_shm_frame *frame);
+
+    // shmWait() -- Sleep until a frame is available or timeoutNs elapses
+    // (0: forever). Output: true if a frame is available.
+    bool LSM9DS1_shmWait(lsm9ds1_shm_reader *reader, uint64_t timeoutNs);
+
+    // shmClose() -- Unmap the ring.
+    void LSM9DS1_shmClose(lsm9ds1_shm_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+/******************************************************************************
+
+	LSM9DS1_Sim.c
+	Register-level model of the LSM9DS1 for host builds.
+
+Everything the model knows about registers comes from the map in
+LSM9DS1_Registers.h; only the data-ready handshake is coded here.
+******************************************************************************/
+
+#include "LSM9DS1_Sim.h"
+#include "LSM9DS1_RegMap.h"
+#include "LSM9DS1_Registers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Magnetometer STATUS_REG_M: ZYXDA plus the per-axis XDA/YDA/ZDA bits.
+#define STATUS_M_DATA_READY		(LSM9DS1_ZYXDA_MASK | 0x07)
+
+// FIFO_CTRL FMODE: FIFO mode, which stops collecting when full
+#define FMODE_FIFO				1
+
+static bool LSM9DS1_simFifoOn(const lsm9ds1_sim *sim)
+{
+	return LSM9DS1_get_FIFO_EN(sim->xg[CTRL_REG9]) && (LSM9DS1_get_FMODE(sim->xg[FIFO_CTRL]) != 0);
+}
+
+// Refresh FIFO_SRC from the level count, keeping OVRN until a level is read
+static void LSM9DS1_simFifoStatus(lsm9ds1_sim *sim, bool overrun)
+{
+	uint8_t src = LSM9DS1_set_FSS(0, sim->fifoLevels);
+
+	src = LSM9DS1_set_OVRN(src, overrun);
+	src = LSM9DS1_set_FTH_FLAG(src, sim->fifoLevels >= LSM9DS1_get_FTH(sim->xg[FIFO_CTRL]));
+	sim->xg[FIFO_SRC] = src;
+}
+
+// Byte of the oldest level an output register reads, -1 if not a FIFO register
+static int LSM9DS1_simFifoByte(uint8_t reg)
+{
+	if ((reg >= OUT_X_L_G) && (reg <= OUT_Z_H_G))
+		return reg - OUT_X_L_G;
+	if ((reg >= OUT_X_L_XL) && (reg <= OUT_Z_H_XL))
+		return 6 + reg - OUT_X_L_XL;
+	return -1;
+}
+
+static void LSM9DS1_simResetDevice(uint8_t *regs, uint8_t mag)
+{
+	const lsm9ds1_reg_info *info;
+	int address;
+
+	memset(regs, 0, LSM9DS1_REG_SPACE);
+	for (address = 0; address < LSM9DS1_REG_SPACE; address++)
+	{
+		info = LSM9DS1_regInfo(mag, address);
+		if (info != NULL)
+			regs[address] = info->reset;
+	}
+}
+
+void LSM9DS1_simInit(lsm9ds1_sim *sim, uint8_t xgAddress, uint8_t mAddress)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->xgAddress = xgAddress;
+	sim->mAddress = mAddress;
+	LSM9DS1_simResetDevice(sim->xg, 0);
+	LSM9DS1_simResetDevice(sim->m, 1);
+}
+
+int LSM9DS1_simWrite(lsm9ds1_sim *sim, uint8_t address,
+                     const uint8_t *data, uint8_t count)
+{
+	uint8_t mag, reg, ii;
+	uint8_t *regs;
+	bool increment;
+	const lsm9ds1_reg_info *info;
+
+	if (address == sim->xgAddress) mag = 0;
+	else if (address == sim->mAddress) mag = 1;
+	else return -1;
+
+	sim->transfers++;
+	if (count == 0)
+		return 0;
+
+	regs = mag ? sim->m : sim->xg;
+	reg = data[0] & 0x7F;
+	increment = mag ? (data[0] & 0x80) : LSM9DS1_get_IF_ADD_INC(regs[CTRL_REG8]);
+
+	for (ii = 1; ii < count; ii++)
+	{
+		info = LSM9DS1_regInfo(mag, reg);
+		if ((info != NULL) && (info->access & REG_WRITE))
+			regs[reg] = data[ii];
+		sim->bytes++;
+		if (increment)
+			reg = (reg + 1) & (LSM9DS1_REG_SPACE - 1);
+	}
+
+	// Software resets restore the map and clear themselves
+	if (!mag && LSM9DS1_get_SW_RESET(regs[CTRL_REG8]))
+		LSM9DS1_simResetDevice(regs, 0);
+	if (mag && LSM9DS1_get_SOFT_RST(regs[CTRL_REG2_M]))
+		LSM9DS1_simResetDevice(regs, 1);
+
+	// Bypass mode (or FIFO_EN off) empties the FIFO; FTH may have moved
+	if (!mag)
+	{
+		if (!LSM9DS1_simFifoOn(sim))
+			sim->fifoLevels = 0;
+		LSM9DS1_simFifoStatus(sim, LSM9DS1_get_OVRN(regs[FIFO_SRC]) && (sim->fifoLevels != 0));
+	}
+
+	return 0;
+}
+
+int LSM9DS1_simRead(lsm9ds1_sim *sim, uint8_t address, uint8_t subAddress,
+                    uint8_t *dest, uint8_t count)
+{
+	uint8_t mag, reg, ii;
+	uint8_t *regs;
+	bool increment, fifo;
+	int level;
+	const lsm9ds1_reg_info *info;
+
+	if (address == sim->xgAddress) mag = 0;
+	else if (address == sim->mAddress) mag = 1;
+	else return -1;
+
+	sim->transfers++;
+	regs = mag ? sim->m : sim->xg;
+	reg = subAddress & 0x7F;
+	increment = mag ? (subAddress & 0x80) : LSM9DS1_get_IF_ADD_INC(regs[CTRL_REG8]);
+	fifo = !mag && LSM9DS1_simFifoOn(sim);
+
+	for (ii = 0; ii < count; ii++)
+	{
+		info = LSM9DS1_regInfo(mag, reg);
+		dest[ii] = (info != NULL) ? regs[reg] : 0;
+		sim->bytes++;
+
+		level = fifo ? LSM9DS1_simFifoByte(reg) : -1;
+		if ((level >= 0) && (sim->fifoLevels > 0))
+		{
+			dest[ii] = sim->fifo[sim->fifoFirst][level];
+			if (reg == OUT_Z_H_XL)
+			{
+				sim->fifoFirst = (sim->fifoFirst + 1) % LSM9DS1_SIM_FIFO_DEPTH;
+				sim->fifoLevels--;
+				LSM9DS1_simFifoStatus(sim, false);
+			}
+		}
+
+		if ((info != NULL) && (info->access & REG_CLEAR))
+			regs[reg] = 0;
+
+		// Reading the last output byte of a sensor acknowledges its data
+		if (!mag && (reg == OUT_Z_H_G))
+		{
+			regs[STATUS_REG_0] = LSM9DS1_set_GDA(regs[STATUS_REG_0], 0);
+			regs[STATUS_REG_1] = LSM9DS1_set_GDA(regs[STATUS_REG_1], 0);
+		}
+		else if (!mag && (reg == OUT_Z_H_XL))
+		{
+			regs[STATUS_REG_0] = LSM9DS1_set_XLDA(regs[STATUS_REG_0], 0);
+			regs[STATUS_REG_1] = LSM9DS1_set_XLDA(regs[STATUS_REG_1], 0);
+		}
+		else if (!mag && (reg == OUT_TEMP_H))
+		{
+			regs[STATUS_REG_0] = LSM9DS1_set_TDA(regs[STATUS_REG_0], 0);
+			regs[STATUS_REG_1] = LSM9DS1_set_TDA(regs[STATUS_REG_1], 0);
+		}
+		else if (mag && (reg == OUT_Z_H_M))
+			regs[STATUS_REG_M] &= ~STATUS_M_DATA_READY;
+
+		if (!increment)
+			continue;
+		// In FIFO mode the address skips from the gyro to the accel outputs
+		// and rolls over to the start of the next level
+		if (fifo && (reg == OUT_Z_H_G))
+			reg = OUT_X_L_XL;
+		else if (fifo && (reg == OUT_Z_H_XL))
+			reg = LSM9DS1_get_ODR_G(regs[CTRL_REG1_G]) ? OUT_X_L_G : OUT_X_L_XL;
+		else
+			reg = (reg + 1) & (LSM9DS1_REG_SPACE - 1);
+	}
+
+	return 0;
+}
+
+static void LSM9DS1_simLatch(uint8_t *regs, uint8_t first, const int16_t *values, int count)
+{
+	int ii;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		regs[first + 2 * ii] = (uint8_t)(values[ii] & 0xFF);
+		regs[first + 2 * ii + 1] = (uint8_t)((uint16_t)values[ii] >> 8);
+	}
+}
+
+void LSM9DS1_simSetSample(lsm9ds1_sim *sim, const int16_t *gyro,
+                          const int16_t *accel, const int16_t *mag,
+                          const int16_t *temperature)
+{
+	uint8_t status = sim->xg[STATUS_REG_1];
+
+	if (gyro != NULL)
+	{
+		LSM9DS1_simLatch(sim->xg, OUT_X_L_G, gyro, 3);
+		status = LSM9DS1_set_GDA(status, 1);
+	}
+	if (accel != NULL)
+	{
+		LSM9DS1_simLatch(sim->xg, OUT_X_L_XL, accel, 3);
+		status = LSM9DS1_set_XLDA(status, 1);
+	}
+	if (temperature != NULL)
+	{
+		LSM9DS1_simLatch(sim->xg, OUT_TEMP_L, temperature, 1);
+		status = LSM9DS1_set_TDA(status, 1);
+	}
+	sim->xg[STATUS_REG_0] = status;
+	sim->xg[STATUS_REG_1] = status;
+
+	// Store a FIFO level; FIFO mode keeps the first 32, the others the last
+	if (((gyro != NULL) || (accel != NULL)) && LSM9DS1_simFifoOn(sim) &&
+	    ((sim->fifoLevels < LSM9DS1_SIM_FIFO_DEPTH) ||
+	     (LSM9DS1_get_FMODE(sim->xg[FIFO_CTRL]) != FMODE_FIFO)))
+	{
+		bool overrun = false;
+		uint8_t last;
+
+		if (sim->fifoLevels == LSM9DS1_SIM_FIFO_DEPTH)
+		{
+			sim->fifoFirst = (sim->fifoFirst + 1) % LSM9DS1_SIM_FIFO_DEPTH;
+			sim->fifoLevels--;
+			overrun = true;
+		}
+		last = (sim->fifoFirst + sim->fifoLevels) % LSM9DS1_SIM_FIFO_DEPTH;
+		memcpy(&sim->fifo[last][0], &sim->xg[OUT_X_L_G], 6);
+		memcpy(&sim->fifo[last][6], &sim->xg[OUT_X_L_XL], 6);
+		sim->fifoLevels++;
+		LSM9DS1_simFifoStatus(sim, overrun || LSM9DS1_get_OVRN(sim->xg[FIFO_SRC]));
+	}
+
+	// The magnetometer converts in continuous (MD 00) and single-conversion
+	// (MD 01) mode; a single conversion drops it back to power-down
+	if ((mag != NULL) && (LSM9DS1_get_MD(sim->m[CTRL_REG3_M]) < 2))
+	{
+		LSM9DS1_simLatch(sim->m, OUT_X_L_M, mag, 3);
+		sim->m[STATUS_REG_M] |= STATUS_M_DATA_READY;
+		if (LSM9DS1_get_MD(sim->m[CTRL_REG3_M]) == 1)
+			sim->m[CTRL_REG3_M] = LSM9DS1_set_MD(sim->m[CTRL_REG3_M], 0x3);
+	}
+}
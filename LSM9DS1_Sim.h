@@ -0,0 +1,83 @@
+/******************************************************************************
+
+	LSM9DS1_Sim.h
+	Register-level model of the LSM9DS1 for host builds.
+
+The model answers I2C transfers for both slaves the way the device does:
+registers start at the reset values of the map in LSM9DS1_Registers.h,
+writes to read-only or reserved registers are ignored, clear-on-read
+registers are zeroed after a read, and the sub-address auto-increments
+(IF_ADD_INC on the accel/gyro, sub-address MSB on the magnetometer).
+Software reset (CTRL_REG8 SW_RESET, CTRL_REG2_M SOFT_RST) restores the
+reset values. Sensor data is injected with LSM9DS1_simSetSample().
+
+The accel/gyro FIFO is modelled too: with CTRL_REG9 FIFO_EN set and a
+FIFO_CTRL mode other than bypass, every sample is stored as a level of
+gyro X,Y,Z then accel X,Y,Z, FIFO_SRC reports the level count and the
+threshold and overrun flags, and the output registers read the oldest
+level. A level is removed when its OUT_Z_H_XL byte is read, and a burst
+continues from OUT_Z_H_G to OUT_X_L_XL and from OUT_Z_H_XL to the first
+output register of the next level, so a FIFO drain returns whole levels
+back to back. FIFO mode stops when full; the other modes overwrite the
+oldest level and set OVRN.
+
+It has no dependency on the RTOS or the Tiva libraries and can back the
+driver on a PC.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Sim_H__
+#define __LSM9DS1_Sim_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_RegMap.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    #define LSM9DS1_SIM_FIFO_DEPTH  32
+
+    typedef struct
+    {
+        uint8_t xgAddress;      // 7-bit slave addresses
+        uint8_t mAddress;
+        uint8_t xg[LSM9DS1_REG_SPACE];
+        uint8_t m[LSM9DS1_REG_SPACE];
+        uint32_t transfers;     // bus transactions answered
+        uint32_t bytes;         // data bytes moved, sub-addresses excluded
+        uint8_t fifo[LSM9DS1_SIM_FIFO_DEPTH][12];   // gyro then accel, raw
+        uint8_t fifoFirst;      // oldest level
+        uint8_t fifoLevels;     // levels stored
+    } lsm9ds1_sim;
+
+    // simInit() -- Power up the model at the given slave addresses.
+    void LSM9DS1_simInit(lsm9ds1_sim *sim, uint8_t xgAddress, uint8_t mAddress);
+
+    // simWrite() -- Write transaction: data[0] is the sub-address, the rest
+    // the bytes written from there on.
+    // Output: 0 on success, -1 if no slave answers at address.
+    int LSM9DS1_simWrite(lsm9ds1_sim *sim, uint8_t address,
+                         const uint8_t *data, uint8_t count);
+
+    // simRead() -- Write the sub-address then read count bytes.
+    // Output: 0 on success, -1 if no slave answers at address.
+    int LSM9DS1_simRead(lsm9ds1_sim *sim, uint8_t address, uint8_t subAddress,
+                        uint8_t *dest, uint8_t count);
+
+    // simSetSample() -- Latch a new set of output registers and raise the
+    // data-ready bits. Any of the pointers may be NULL to leave that sensor
+    // unchanged. Values are raw little-endian register contents. The mag
+    // sample is only taken while CTRL_REG3_M selects continuous or
+    // single-conversion mode, as the device would.
+    void LSM9DS1_simSetSample(lsm9ds1_sim *sim, const int16_t *gyro,
+                              const int16_t *accel, const int16_t *mag,
+                              const int16_t *temperature);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,367 @@
+/******************************************************************************
+
+	LSM9DS1_Spectrum.c
+	On-device vibration spectra from the LSM9DS1 accelerometer FIFO.
+
+A real window x[0..n-1] is packed as the complex sequence
+z[j] = x[2j] + i x[2j+1], which is the interleaved layout the FFT works on
+anyway, so packing costs nothing. After the n/2-point FFT,
+X[k] = E[k] - i W^k O[k], with E and O the halves of Z[k] +- conj(Z[n/2-k])
+and W = exp(-2 pi i / n); the power of X[k] goes straight into the Welch
+accumulator without storing X.
+
+The fixed-point work array holds 16-bit values scaled by 2^exp. Before
+each stage the block is halved if any component reaches 2^13, which keeps
+the radix-2 butterfly (growth at most 1 + sqrt(2)) inside 16 bits.
+******************************************************************************/
+
+#include "LSM9DS1_Spectrum.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PI_F			3.14159265f
+#define BLOCK_LIMIT		(1L << 13)
+
+// Bit-reversal permutation of m interleaved complex values.
+#define BIT_REVERSE(type, z, m)                             \
+	do {                                                    \
+		uint16_t i_, j_ = 0, bit_;                          \
+		type t_;                                            \
+		for (i_ = 1; i_ < (m); i_++)                        \
+		{                                                   \
+			for (bit_ = (m) >> 1; j_ & bit_; bit_ >>= 1)    \
+				j_ ^= bit_;                                 \
+			j_ |= bit_;                                     \
+			if (i_ < j_)                                    \
+			{                                               \
+				t_ = z[2 * i_]; z[2 * i_] = z[2 * j_]; z[2 * j_] = t_;             \
+				t_ = z[2 * i_ + 1]; z[2 * i_ + 1] = z[2 * j_ + 1]; z[2 * j_ + 1] = t_; \
+			}                                               \
+		}                                                   \
+	} while (0)
+
+bool LSM9DS1_spectrumInit(lsm9ds1_spectrum *spec, uint16_t n, uint8_t axes,
+                          bool fixedPoint, uint16_t averages,
+                          float sampleRate, float accelScale)
+{
+	float angle, w, windowPower = 0.0f;
+	uint16_t k;
+
+	if ((n < 16) || (n > LSM9DS1_SPECTRUM_MAX_N) || (n & (n - 1)) ||
+	    ((axes & 0x07) == 0) || (sampleRate <= 0.0f))
+		return false;
+
+	memset(spec, 0, sizeof(*spec));
+	spec->n = n;
+	spec->axes = axes & 0x07;
+	spec->fixedPoint = fixedPoint;
+	spec->averages = averages ? averages : 1;
+	spec->sampleRate = sampleRate;
+	spec->accelScale = accelScale;
+
+	for (k = 0; k < n / 2; k++)
+	{
+		angle = 2.0f * PI_F * k / n;
+		if (fixedPoint)
+		{
+			spec->twiddle.q[2 * k] = (int16_t)lrintf(cosf(angle) * 32767.0f);
+			spec->twiddle.q[2 * k + 1] = (int16_t)lrintf(sinf(angle) * 32767.0f);
+		}
+		else
+		{
+			spec->twiddle.f[2 * k] = cosf(angle);
+			spec->twiddle.f[2 * k + 1] = sinf(angle);
+		}
+	}
+	for (k = 0; k < n; k++)
+	{
+		// Periodic Hann, the form whose half-overlapped copies sum flat
+		w = 0.5f - 0.5f * cosf(2.0f * PI_F * k / n);
+		windowPower += w * w;
+		if (fixedPoint)
+			spec->window.q[k] = (int16_t)lrintf(w * 32767.0f);
+		else
+			spec->window.f[k] = w;
+	}
+	spec->psdScale = accelScale * accelScale / (sampleRate * windowPower);
+	return true;
+}
+
+static void transformFloat(lsm9ds1_spectrum *spec, const int16_t *x)
+{
+	float *z = spec->work.f;
+	const float *tw = spec->twiddle.f;
+	uint16_t n = spec->n, m = n / 2, len, half, step, i, j, k, a, b;
+	float mean, c, s, tr, ti, er, ei, orr, oi, xr, xi;
+	int32_t sum = 0;
+
+	for (i = 0; i < n; i++)
+		sum += x[i];
+	mean = (float)sum / n;
+	for (i = 0; i < n; i++)
+		z[i] = (x[i] - mean) * spec->window.f[i];
+
+	BIT_REVERSE(float, z, m);
+	for (len = 2; len <= m; len <<= 1)
+	{
+		half = len / 2;
+		step = n / len;
+		for (i = 0; i < m; i += len)
+		{
+			for (j = 0; j < half; j++)
+			{
+				c = tw[2 * j * step];
+				s = tw[2 * j * step + 1];
+				a = i + j;
+				b = a + half;
+				tr = z[2 * b] * c + z[2 * b + 1] * s;
+				ti = z[2 * b + 1] * c - z[2 * b] * s;
+				z[2 * b] = z[2 * a] - tr;
+				z[2 * b + 1] = z[2 * a + 1] - ti;
+				z[2 * a] += tr;
+				z[2 * a + 1] += ti;
+			}
+		}
+	}
+
+	spec->accum[0] += (z[0] + z[1]) * (z[0] + z[1]);
+	spec->accum[m] += (z[0] - z[1]) * (z[0] - z[1]);
+	for (k = 1; k < m; k++)
+	{
+		er = 0.5f * (z[2 * k] + z[2 * (m - k)]);
+		ei = 0.5f * (z[2 * k + 1] - z[2 * (m - k) + 1]);
+		orr = 0.5f * (z[2 * k] - z[2 * (m - k)]);
+		oi = 0.5f * (z[2 * k + 1] + z[2 * (m - k) + 1]);
+		// X = E - i W O, W = c - i s
+		c = tw[2 * k];
+		s = tw[2 * k + 1];
+		xr = er + c * oi - s * orr;
+		xi = ei - c * orr - s * oi;
+		spec->accum[k] += xr * xr + xi * xi;
+	}
+}
+
+// Halve the block if a component could overflow in the next stage.
+static int8_t renormalise(int16_t *z, uint16_t count)
+{
+	uint16_t i;
+	bool large = false;
+
+	for (i = 0; i < count; i++)
+		if ((z[i] >= BLOCK_LIMIT) || (z[i] <= -BLOCK_LIMIT))
+		{
+			large = true;
+			break;
+		}
+	if (!large)
+		return 0;
+	for (i = 0; i < count; i++)
+		z[i] >>= 1;
+	return 1;
+}
+
+static void transformFixed(lsm9ds1_spectrum *spec, const int16_t *x)
+{
+	int16_t *z = spec->work.q;
+	const int16_t *tw = spec->twiddle.q;
+	uint16_t n = spec->n, m = n / 2, len, half, step, i, j, k, a, b;
+	int32_t sum = 0, mean, v, max = 0, c, s, tr, ti, er, ei, orr, oi, xr, xi;
+	int8_t shift = 0, exponent;
+	float gain;
+
+	for (i = 0; i < n; i++)
+		sum += x[i];
+	mean = sum / n;
+
+	// Window into the work array, scaled so the largest value is just
+	// under 2^13
+	for (i = 0; i < n; i++)
+	{
+		v = ((x[i] - mean) * (int32_t)spec->window.q[i]) >> 15;
+		if (v > max) max = v;
+		if (-v > max) max = -v;
+	}
+	if (max == 0)
+		return;
+	while (max >= BLOCK_LIMIT)
+	{
+		max >>= 1;
+		shift--;
+	}
+	while (max < BLOCK_LIMIT / 2)
+	{
+		max <<= 1;
+		shift++;
+	}
+	for (i = 0; i < n; i++)
+	{
+		v = ((x[i] - mean) * (int32_t)spec->window.q[i]) >> 15;
+		z[i] = (int16_t)((shift >= 0) ? (v * (1L << shift)) : (v >> -shift));
+	}
+	exponent = -shift;
+
+	BIT_REVERSE(int16_t, z, m);
+	for (len = 2; len <= m; len <<= 1)
+	{
+		half = len / 2;
+		step = n / len;
+		exponent += renormalise(z, n);
+		for (i = 0; i < m; i += len)
+		{
+			for (j = 0; j < half; j++)
+			{
+				c = tw[2 * j * step];
+				s = tw[2 * j * step + 1];
+				a = i + j;
+				b = a + half;
+				tr = (z[2 * b] * c + z[2 * b + 1] * s) >> 15;
+				ti = (z[2 * b + 1] * c - z[2 * b] * s) >> 15;
+				z[2 * b] = (int16_t)(z[2 * a] - tr);
+				z[2 * b + 1] = (int16_t)(z[2 * a + 1] - ti);
+				z[2 * a] = (int16_t)(z[2 * a] + tr);
+				z[2 * a + 1] = (int16_t)(z[2 * a + 1] + ti);
+			}
+		}
+	}
+
+	// Powers are squares: fold the block exponent back in twice
+	gain = ldexpf(1.0f, 2 * exponent);
+	xr = z[0] + z[1];
+	xi = z[0] - z[1];
+	spec->accum[0] += gain * ((float)xr * xr);
+	spec->accum[m] += gain * ((float)xi * xi);
+	for (k = 1; k < m; k++)
+	{
+		er = (z[2 * k] + z[2 * (m - k)]) >> 1;
+		ei = (z[2 * k + 1] - z[2 * (m - k) + 1]) >> 1;
+		orr = (z[2 * k] - z[2 * (m - k)]) >> 1;
+		oi = (z[2 * k + 1] + z[2 * (m - k) + 1]) >> 1;
+		c = tw[2 * k];
+		s = tw[2 * k + 1];
+		xr = er + ((c * oi - s * orr) >> 15);
+		xi = ei - ((c * orr + s * oi) >> 15);
+		spec->accum[k] += gain * ((float)xr * xr + (float)xi * xi);
+	}
+}
+
+bool LSM9DS1_spectrumFeed(lsm9ds1_spectrum *spec, const uint8_t *samples,
+                          uint8_t count, uint8_t sampleBytes)
+{
+	const uint8_t *accel;
+	uint16_t n = spec->n, m = n / 2, k;
+	uint8_t ii, axis;
+	bool ready = false;
+
+	if ((sampleBytes != 12) && (sampleBytes != 6))
+		return false;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		accel = samples + ii * sampleBytes + sampleBytes - 6;
+		for (axis = 0; axis < 3; axis++)
+			if (spec->axes & (1 << axis))
+				spec->samples[axis][spec->fill] =
+					(int16_t)((accel[2 * axis + 1] << 8) | accel[2 * axis]);
+		spec->stats.samples++;
+		if (++spec->fill < n)
+			continue;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			if (!(spec->axes & (1 << axis)))
+				continue;
+			if (spec->fixedPoint)
+				transformFixed(spec, spec->samples[axis]);
+			else
+				transformFloat(spec, spec->samples[axis]);
+			// Half overlap: the second half starts the next window
+			memcpy(spec->samples[axis], spec->samples[axis] + m, m * sizeof(int16_t));
+		}
+		spec->fill = m;
+		spec->stats.segments++;
+		if (++spec->segments < spec->averages)
+			continue;
+
+		// One-sided density: every bin but DC and Nyquist counts twice
+		for (k = 0; k <= m; k++)
+		{
+			spec->psd[k] = spec->accum[k] * spec->psdScale / spec->segments;
+			if ((k > 0) && (k < m))
+				spec->psd[k] *= 2.0f;
+			spec->accum[k] = 0.0f;
+		}
+		spec->segments = 0;
+		spec->stats.results++;
+		ready = true;
+	}
+	return ready;
+}
+
+float LSM9DS1_spectrumBandPower(const lsm9ds1_spectrum *spec,
+                                float lowHz, float highHz)
+{
+	float binHz = spec->sampleRate / spec->n, power = 0.0f;
+	int32_t k, first, last;
+
+	first = (int32_t)ceilf(lowHz / binHz);
+	last = (int32_t)floorf(highHz / binHz);
+	if (first < 0)
+		first = 0;
+	if (last > spec->n / 2)
+		last = spec->n / 2;
+	for (k = first; k <= last; k++)
+		power += spec->psd[k];
+	return power * binHz;
+}
+
+uint8_t LSM9DS1_spectrumPeaks(const lsm9ds1_spectrum *spec,
+                              lsm9ds1_spectrum_peak *peaks, uint8_t maxPeaks)
+{
+	const float *psd = spec->psd;
+	float binHz = spec->sampleRate / spec->n, power, delta, left, centre, right;
+	uint16_t k, m = spec->n / 2;
+	uint8_t found = 0, slot;
+
+	for (k = 2; k < m - 1; k++)
+	{
+		if ((psd[k] <= psd[k - 1]) || (psd[k] < psd[k + 1]))
+			continue;
+
+		// Hann spreads a tone over three bins; keep the list sorted by
+		// that lobe power, strongest first
+		power = (psd[k - 1] + psd[k] + psd[k + 1]) * binHz;
+		for (slot = found; (slot > 0) && (peaks[slot - 1].power < power); slot--)
+			if (slot < maxPeaks)
+				peaks[slot] = peaks[slot - 1];
+		if (slot >= maxPeaks)
+			continue;
+		if (found < maxPeaks)
+			found++;
+
+		// Parabola through the log powers: exact for a Gaussian lobe and
+		// close for Hann
+		delta = 0.0f;
+		if ((psd[k - 1] > 0.0f) && (psd[k + 1] > 0.0f))
+		{
+			left = logf(psd[k - 1]);
+			centre = logf(psd[k]);
+			right = logf(psd[k + 1]);
+			if (left - 2.0f * centre + right < 0.0f)
+				delta = 0.5f * (left - right) / (left - 2.0f * centre + right);
+		}
+		peaks[slot].frequency = (k + delta) * binHz;
+		peaks[slot].power = power;
+	}
+	return found;
+}
+
+void LSM9DS1_spectrumGetStats(lsm9ds1_spectrum *spec,
+                              lsm9ds1_spectrum_stats *stats, bool reset)
+{
+	*stats = spec->stats;
+	if (reset)
+		memset(&spec->stats, 0, sizeof(spec->stats));
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+
+	LSM9DS1_Spectrum.h
+	On-device vibration spectra from the LSM9DS1 accelerometer FIFO.
+
+Machine condition monitoring needs the acceleration spectrum, not the raw
+952 Hz stream. The engine collects the accel part of each FIFO drain into
+N-sample windows overlapping by half, removes the mean, applies a Hann
+window and runs an N-point real FFT (an N/2-point complex radix-2 FFT and
+a split step), then averages the power of a fixed number of windows
+(Welch's method) into a one-sided power spectral density in g^2/Hz. From
+it, band powers and the largest peaks, with interpolated frequencies, are
+cheap to extract.
+
+Two FFT variants share the code around them: single-precision float, and
+16-bit fixed point with block floating point (the block is renormalised
+before each stage that could overflow, and the shifts are folded back when
+the power is accumulated), for cores without an FPU or with a busy one.
+
+RAM is bounded at compile time by LSM9DS1_SPECTRUM_MAX_N: the engine keeps
+one sample buffer per axis, the work array, the window and twiddle tables
+and two PSD arrays, all inside lsm9ds1_spectrum (5.6 KB for 256;
+tools/lsm9ds1_spectrumbench.c prints the exact size with the cycles per
+window of each variant).
+******************************************************************************/
+
+#ifndef __LSM9DS1_Spectrum_H__
+#define __LSM9DS1_Spectrum_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // Largest FFT length, a power of two; sizes lsm9ds1_spectrum.
+    #ifndef LSM9DS1_SPECTRUM_MAX_N
+    #define LSM9DS1_SPECTRUM_MAX_N      256
+    #endif
+
+    #define LSM9DS1_SPECTRUM_BINS       (LSM9DS1_SPECTRUM_MAX_N / 2 + 1)
+
+    // Axes, as bits of spectrumInit()'s axes; their spectra are summed.
+    #define LSM9DS1_SPECTRUM_X          0x01
+    #define LSM9DS1_SPECTRUM_Y          0x02
+    #define LSM9DS1_SPECTRUM_Z          0x04
+
+    typedef struct
+    {
+        float frequency;        // Hz, interpolated between bins
+        float power;            // g^2 in the three bins around the peak
+    } lsm9ds1_spectrum_peak;
+
+    typedef struct
+    {
+        uint32_t segments;      // windows transformed
+        uint32_t results;       // PSDs completed
+        uint32_t samples;       // accel samples fed
+    } lsm9ds1_spectrum_stats;
+
+    typedef struct
+    {
+        // Configuration
+        uint16_t n;                 // FFT length
+        uint8_t axes;               // LSM9DS1_SPECTRUM_* set
+        bool fixedPoint;            // fixed-point FFT instead of float
+        uint16_t averages;          // windows per PSD
+        float sampleRate;           // Hz
+        float accelScale;           // g per raw count
+
+        // Tables for n, in the variant's format
+        union
+        {
+            float f[LSM9DS1_SPECTRUM_MAX_N];    // cos, sin of 2 pi k / n
+            int16_t q[LSM9DS1_SPECTRUM_MAX_N];  // the same, Q15
+        } twiddle;
+        union
+        {
+            float f[LSM9DS1_SPECTRUM_MAX_N];
+            int16_t q[LSM9DS1_SPECTRUM_MAX_N];
+        } window;                   // Hann
+        float psdScale;             // power to g^2/Hz, window loss included
+
+        // Sample buffers and FFT work array
+        int16_t samples[3][LSM9DS1_SPECTRUM_MAX_N];
+        uint16_t fill;
+        union
+        {
+            float f[LSM9DS1_SPECTRUM_MAX_N];
+            int16_t q[LSM9DS1_SPECTRUM_MAX_N];
+        } work;
+
+        // Welch average and result
+        float accum[LSM9DS1_SPECTRUM_BINS];
+        uint16_t segments;
+        float psd[LSM9DS1_SPECTRUM_BINS];   // g^2/Hz, bin k at k * rate / n
+        lsm9ds1_spectrum_stats stats;
+    } lsm9ds1_spectrum;
+
+    // spectrumInit() -- Build the tables and empty the buffers.
+    // Input:
+    //	- n = FFT length, a power of two from 16 to LSM9DS1_SPECTRUM_MAX_N.
+    //	- axes = LSM9DS1_SPECTRUM_* axes to analyse.
+    //	- fixedPoint = Use the fixed-point FFT.
+    //	- averages = Windows averaged into each PSD (hop n / 2).
+    //	- sampleRate = Accelerometer output rate, Hz (e.g. 1e6 / wm.periodUs).
+    //	- accelScale = g per raw count, LSM9DS1_calcAccel(1).
+    // Output: false if n or axes is invalid.
+    bool LSM9DS1_spectrumInit(lsm9ds1_spectrum *spec, uint16_t n, uint8_t axes,
+                              bool fixedPoint, uint16_t averages,
+                              float sampleRate, float accelScale);
+
+    // spectrumFeed() -- Add a block of raw FIFO samples, as stored by
+    // LSM9DS1_wmDrain() (12 bytes with the gyro, 6 accel only); windows
+    // are transformed as they fill.
+    // Output: true if a new PSD was completed in spec->psd.
+    bool LSM9DS1_spectrumFeed(lsm9ds1_spectrum *spec, const uint8_t *samples,
+                              uint8_t count, uint8_t sampleBytes);
+
+    // spectrumBandPower() -- Power between two frequencies of the last PSD.
+    // Output: g^2 (the square of the band's RMS acceleration).
+    float LSM9DS1_spectrumBandPower(const lsm9ds1_spectrum *spec,
+                                    float lowHz, float highHz);
+
+    // spectrumPeaks() -- Largest local maxima of the last PSD, strongest
+    // first.
+    // Output: Number of peaks stored, up to maxPeaks.
+    uint8_t LSM9DS1_spectrumPeaks(const lsm9ds1_spectrum *spec,
+                                  lsm9ds1_spectrum_peak *peaks,
+                                  uint8_t maxPeaks);
+
+    // spectrumGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_spectrumGetStats(lsm9ds1_spectrum *spec,
+                                  lsm9ds1_spectrum_stats *stats, bool reset);
+
+#endif
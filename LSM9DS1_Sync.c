@@ -0,0 +1,133 @@
+/******************************************************************************
+
+	LSM9DS1_Sync.c
+	External trigger tagging for LSM9DS1 samples.
+
+The trigger buffer is a single-producer, single-consumer ring: the
+interrupt only advances head and the tagger only advances tail, both
+32-bit stores, so neither side masks interrupts. Times are 32-bit
+microsecond counters compared by signed difference, so they may wrap.
+******************************************************************************/
+
+#include "LSM9DS1_Sync.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+void LSM9DS1_syncInit(lsm9ds1_sync *sync)
+{
+	memset((void *)sync, 0, sizeof(*sync));
+}
+
+void LSM9DS1_syncTrigger(lsm9ds1_sync *sync, uint32_t us)
+{
+	uint32_t head = sync->head;
+
+	if (head - sync->tail >= LSM9DS1_SYNC_EVENTS)
+	{
+		sync->overflows++;
+		return;
+	}
+	sync->events[head & (LSM9DS1_SYNC_EVENTS - 1)] = us;
+	sync->head = head + 1;	// publish after the timestamp
+	sync->triggers++;
+}
+
+uint32_t LSM9DS1_syncTag(lsm9ds1_sync *sync, uint32_t firstUs,
+                         uint32_t periodUs, uint8_t count,
+                         lsm9ds1_sync_tag *tags, uint8_t *tagCount,
+                         uint8_t maxTags)
+{
+	uint32_t startUs = firstUs - periodUs;	// the first sample's period starts here
+	uint32_t spanUs = (uint32_t)count * periodUs;
+	uint32_t head = sync->head, tail = sync->tail;
+	uint32_t mask = 0, offsetUs, eventUs;
+	uint8_t sample, tagged = 0;
+
+	while ((tail != head) && count && periodUs)
+	{
+		eventUs = sync->events[tail & (LSM9DS1_SYNC_EVENTS - 1)];
+		if ((int32_t)(eventUs - startUs) <= 0)
+		{
+			// Before this batch: the samples it belonged to are gone
+			sync->stats.late++;
+			tail++;
+			continue;
+		}
+		offsetUs = eventUs - startUs;
+		if (offsetUs > spanUs)
+			break;	// after the last sample, keep it for the next batch
+
+		sample = (uint8_t)((offsetUs - 1) / periodUs);
+		if (sample < 32)
+			mask |= 1UL << sample;
+		if (tagged < maxTags)
+		{
+			tags[tagged].sample = sample;
+			tags[tagged].phase = (uint16_t)(((uint64_t)(offsetUs - sample * periodUs) * 65535) / periodUs);
+			tags[tagged].us = eventUs;
+			tagged++;
+		}
+		sync->stats.tagged++;
+		tail++;
+	}
+	sync->tail = tail;
+
+	if (tagCount != NULL)
+		*tagCount = tagged;
+	return mask;
+}
+
+uint32_t LSM9DS1_syncTagFifo(lsm9ds1_sync *sync, uint32_t irqUs,
+                             uint8_t threshold, uint32_t periodUs,
+                             uint8_t count, lsm9ds1_sync_tag *tags,
+                             uint8_t *tagCount, uint8_t maxTags)
+{
+	uint32_t anchor = threshold ? threshold - 1 : 0;
+
+	return LSM9DS1_syncTag(sync, irqUs - anchor * periodUs, periodUs, count,
+	                       tags, tagCount, maxTags);
+}
+
+bool LSM9DS1_syncTagRead(lsm9ds1_sync *sync, uint32_t readUs,
+                         lsm9ds1_sync_tag *tag)
+{
+	uint8_t tagged = 0;
+	uint32_t mask;
+
+	if (!sync->readStarted)
+	{
+		// No previous read to bound the sample: drop what came before
+		sync->readStarted = true;
+		sync->lastReadUs = readUs;
+		while (sync->tail != sync->head &&
+		       (int32_t)(sync->events[sync->tail & (LSM9DS1_SYNC_EVENTS - 1)] - readUs) <= 0)
+		{
+			sync->stats.late++;
+			sync->tail++;
+		}
+		return false;
+	}
+
+	mask = LSM9DS1_syncTag(sync, readUs, readUs - sync->lastReadUs, 1,
+	                       tag, &tagged, tag != NULL ? 1 : 0);
+	sync->lastReadUs = readUs;
+
+	// Further triggers in the same interval tag the same sample
+	return mask != 0;
+}
+
+void LSM9DS1_syncGetStats(lsm9ds1_sync *sync, lsm9ds1_sync_stats *stats,
+                          bool reset)
+{
+	*stats = sync->stats;
+	stats->triggers = sync->triggers;
+	stats->overflows = sync->overflows;
+	if (reset)
+	{
+		memset(&sync->stats, 0, sizeof(sync->stats));
+		sync->triggers = 0;
+		sync->overflows = 0;
+	}
+}
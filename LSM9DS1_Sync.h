@@ -0,0 +1,104 @@
+/******************************************************************************
+
+	LSM9DS1_Sync.h
+	External trigger tagging for LSM9DS1 samples.
+
+Camera exposures and encoder pulses have to be matched to the IMU sample
+they fall in, and to the position inside its period. The register map
+(LSM9DS1_Registers.h) has no field that stamps an input level into the
+output data, so the trigger is timestamped by the MCU instead: the trigger
+pin interrupt calls LSM9DS1_syncTrigger() with the same microsecond counter
+used for the FIFO interrupt, and the drain or read path hands the sample
+timeline to a tagger that marks each sample a trigger fell in and gives the
+trigger's phase within that sample period.
+No bus traffic is added and the outputs keep their full 16 bits.
+
+Sample k of a batch converted at firstUs + k * periodUs and covers the
+period that ends there; a trigger in (t[k] - periodUs, t[k]] tags sample k.
+Triggers newer than the batch wait for the next one; older ones (a gap or
+an overrun) are dropped and counted.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Sync_H__
+#define __LSM9DS1_Sync_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // Trigger timestamps buffered between the interrupt and the tagger,
+    // a power of two.
+    #define LSM9DS1_SYNC_EVENTS         16
+
+    typedef struct
+    {
+        uint8_t sample;         // index of the tagged sample in the batch
+        uint16_t phase;         // trigger position in the sample period, Q16
+                                // (0: just after t[k-1], 65535: at t[k])
+        uint32_t us;            // trigger time
+    } lsm9ds1_sync_tag;
+
+    typedef struct
+    {
+        uint32_t triggers;        // syncTrigger() calls
+        uint32_t tagged;          // triggers matched to a sample
+        uint32_t late;            // triggers older than the batch they reached
+        uint32_t overflows;       // triggers lost to a full buffer
+    } lsm9ds1_sync_stats;
+
+    typedef struct
+    {
+        // Written by the trigger interrupt only
+        volatile uint32_t events[LSM9DS1_SYNC_EVENTS];
+        volatile uint32_t head;
+        volatile uint32_t triggers;
+        volatile uint32_t overflows;
+
+        // Written by the tagger only
+        volatile uint32_t tail;
+        uint32_t lastReadUs;      // previous syncTagRead() sample time
+        bool readStarted;
+        lsm9ds1_sync_stats stats;
+    } lsm9ds1_sync;
+
+    // syncInit() -- Empty the trigger buffer and reset the counters.
+    void LSM9DS1_syncInit(lsm9ds1_sync *sync);
+
+    // syncTrigger() -- Record a trigger edge. Call from the trigger pin
+    // interrupt (one producer), with the FIFO interrupt's time source.
+    void LSM9DS1_syncTrigger(lsm9ds1_sync *sync, uint32_t us);
+
+    // syncTag() -- Tag a batch of samples on a known timeline.
+    // Input:
+    //	- firstUs = Conversion time of the first sample of the batch.
+    //	- periodUs = Sample period (e.g. lsm9ds1_watermark.periodUs).
+    //	- count = Samples in the batch.
+    //	- tags = Filled with up to maxTags tags, in time order; tagCount
+    //	  gets how many (may be NULL).
+    // Output: Bit k set if sample k was tagged (samples 0..31).
+    uint32_t LSM9DS1_syncTag(lsm9ds1_sync *sync, uint32_t firstUs,
+                             uint32_t periodUs, uint8_t count,
+                             lsm9ds1_sync_tag *tags, uint8_t *tagCount,
+                             uint8_t maxTags);
+
+    // syncTagFifo() -- syncTag() for a FIFO drain after a threshold
+    // interrupt: FTH goes up when sample threshold - 1 of the batch is
+    // stored, which anchors the timeline at irqUs. Pass the threshold that
+    // was programmed when the interrupt fired (read wm.threshold before
+    // LSM9DS1_wmDrain(), which may change it).
+    uint32_t LSM9DS1_syncTagFifo(lsm9ds1_sync *sync, uint32_t irqUs,
+                                 uint8_t threshold, uint32_t periodUs,
+                                 uint8_t count, lsm9ds1_sync_tag *tags,
+                                 uint8_t *tagCount, uint8_t maxTags);
+
+    // syncTagRead() -- Tag a single sample from readChannels() or the
+    // read*() calls, taken at readUs. Triggers since the previous read tag
+    // it; the phase is relative to the time between the two reads.
+    // Output: true if the sample was tagged; tag gets the first trigger.
+    bool LSM9DS1_syncTagRead(lsm9ds1_sync *sync, uint32_t readUs,
+                             lsm9ds1_sync_tag *tag);
+
+    // syncGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_syncGetStats(lsm9ds1_sync *sync, lsm9ds1_sync_stats *stats,
+                              bool reset);
+
+#endif
@@ -0,0 +1,369 @@
+/******************************************************************************
+
+	LSM9DS1_Synth.c
+	Trajectory and sensor-error synthesizer feeding the LSM9DS1 model.
+
+The body rate is constant within a segment, so each step rotates the
+attitude by the exact quaternion of rate * period. The truth vectors are
+rotated into the body with the matrix of the attitude, built once per
+sample. Noise samples come from xorshift64* and Box-Muller in pairs; the
+spare one is kept for the next draw.
+******************************************************************************/
+
+#include "LSM9DS1_Synth.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PI_D			3.14159265358979
+#define DEG_TO_RAD		(PI_D / 180.0)
+
+// Temperature output: 16 LSB/degC, 0 at 25 degC.
+#define TEMP_LSB_PER_C	16.0f
+#define TEMP_ZERO_C		25.0f
+
+enum { GYRO, ACCEL, MAG };
+
+// Rates in Hz, indexed by the sampleRate settings
+static const float gyroODR[7] = {0.0f, 14.9f, 59.5f, 119.0f, 238.0f, 476.0f, 952.0f};
+static const float accelODR[7] = {0.0f, 10.0f, 50.0f, 119.0f, 238.0f, 476.0f, 952.0f};
+static const float magODR[8] = {0.625f, 1.25f, 2.5f, 5.0f, 10.0f, 20.0f, 40.0f, 80.0f};
+
+// Gyro LPF2 cutoff (Hz) by ODR and BW_G, accel anti-aliasing by BW_XL
+static const float gyroCutoff[7][4] = {
+	{0, 0, 0, 0}, {5, 5, 5, 5}, {19, 19, 19, 19}, {14, 31, 31, 31},
+	{14, 29, 63, 78}, {21, 28, 57, 100}, {33, 40, 58, 100}
+};
+static const float accelCutoff[4] = {408.0f, 211.0f, 105.0f, 50.0f};
+
+static float lowpassAlpha(float cutoffHz, double period)
+{
+	if (cutoffHz <= 0.0f)
+		return 1.0f;
+	return (float)(1.0 - exp(-2.0 * PI_D * cutoffHz * period));
+}
+
+static uint64_t nextRandom(lsm9ds1_synth *synth)
+{
+	synth->rng ^= synth->rng >> 12;
+	synth->rng ^= synth->rng << 25;
+	synth->rng ^= synth->rng >> 27;
+	return synth->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static float gaussian(lsm9ds1_synth *synth)
+{
+	float u, v, r;
+
+	if (synth->hasSpare)
+	{
+		synth->hasSpare = false;
+		return synth->spare;
+	}
+	// 24-bit uniforms in (0, 1]
+	u = (float)((nextRandom(synth) >> 40) + 1) * (1.0f / 16777216.0f);
+	v = (float)(nextRandom(synth) >> 40) * (float)(2.0 * PI_D / 16777216.0);
+	r = sqrtf(-2.0f * logf(u));
+	synth->spare = r * sinf(v);
+	synth->hasSpare = true;
+	return r * cosf(v);
+}
+
+// Typical values, of the order of the datasheet; replace them with the
+// unit's own (LSM9DS1_allanFit()) for accuracy work.
+static void defaultErrors(lsm9ds1_synth *synth)
+{
+	memset(&synth->gyroErrors, 0, sizeof(synth->gyroErrors));
+	synth->gyroErrors.noiseDensity = 0.01f;
+	synth->gyroErrors.biasInstability = 0.005f;
+	synth->gyroErrors.biasTau = 100.0f;
+	memset(&synth->accelErrors, 0, sizeof(synth->accelErrors));
+	synth->accelErrors.noiseDensity = 0.0002f;
+	synth->accelErrors.biasInstability = 0.00005f;
+	synth->accelErrors.biasTau = 100.0f;
+	memset(&synth->magErrors, 0, sizeof(synth->magErrors));
+	synth->magErrors.noiseDensity = 0.0003f;
+}
+
+bool LSM9DS1_synthInit(lsm9ds1_synth *synth, const IMUSettings *settings,
+                       const lsm9ds1_synth_segment *script,
+                       uint16_t segments, uint32_t seed)
+{
+	uint8_t gyroRate = settings->gyro.sampleRate, accelRate = settings->accel.sampleRate;
+	float odr, accelBW;
+	double total = 0.0;
+	uint16_t ii;
+
+	if (script == NULL)
+		return false;
+	for (ii = 0; ii < segments; ii++)
+		total += script[ii].duration;
+	if (!(total > 0.0))
+		return false;
+
+	memset(synth, 0, sizeof(*synth));
+	synth->gyroEnabled = settings->gyro.enabled && (gyroRate >= 1) && (gyroRate <= 6);
+	synth->accelEnabled = settings->accel.enabled && (accelRate >= 1) && (accelRate <= 6);
+	synth->magEnabled = settings->mag.enabled;
+	// With the gyro on, the accel runs at the gyro ODR
+	if (synth->gyroEnabled)
+		odr = gyroODR[gyroRate];
+	else if (synth->accelEnabled)
+		odr = accelODR[accelRate];
+	else
+		return false;
+
+	synth->script = script;
+	synth->segments = segments;
+	synth->period = 1.0 / odr;
+	synth->magPeriod = 1.0 / magODR[settings->mag.sampleRate & 0x07];
+	synth->earthField[1] = 0.2f;
+	synth->earthField[2] = -0.45f;
+	synth->temperatureC = TEMP_ZERO_C;
+	defaultErrors(synth);
+
+	switch (settings->gyro.scale)
+	{
+		case 500: synth->gyroScale = 0.0175f; break;
+		case 2000: synth->gyroScale = 0.07f; break;
+		default: synth->gyroScale = 0.00875f; break;
+	}
+	switch (settings->accel.scale)
+	{
+		case 4: synth->accelScale = 0.000122f; break;
+		case 8: synth->accelScale = 0.000244f; break;
+		case 16: synth->accelScale = 0.000732f; break;
+		default: synth->accelScale = 0.000061f; break;
+	}
+	switch (settings->mag.scale)
+	{
+		case 8: synth->magScale = 0.00029f; break;
+		case 12: synth->magScale = 0.00043f; break;
+		case 16: synth->magScale = 0.00058f; break;
+		default: synth->magScale = 0.00014f; break;
+	}
+
+	if (synth->gyroEnabled)
+		synth->gyroAlpha = lowpassAlpha(gyroCutoff[gyroRate][settings->gyro.bandwidth & 0x03],
+		                                synth->period);
+	// BW_SCAL_ODR = 0 picks the anti-aliasing filter from the ODR
+	if (settings->accel.bandwidth >= 0)
+		accelBW = accelCutoff[settings->accel.bandwidth & 0x03];
+	else
+		accelBW = (odr > 900.0f) ? 408.0f : (odr > 400.0f) ? 211.0f : (odr > 200.0f) ? 105.0f : 50.0f;
+	synth->accelAlpha = lowpassAlpha(accelBW, synth->period);
+
+	synth->q[0] = 1.0;
+	synth->rng = ((uint64_t)seed << 32) ^ 0x9E3779B97F4A7C15ULL;
+	return true;
+}
+
+// Rotate a world vector into the body with the attitude matrix r (body to
+// world, so its transpose).
+static void toBody(const float r[3][3], const float *world, float *body)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+		body[ii] = r[0][ii] * world[0] + r[1][ii] * world[1] + r[2][ii] * world[2];
+}
+
+// Apply one sensor's errors to a truth vector, in units.
+static void applyErrors(lsm9ds1_synth *synth, uint8_t sensor, const float *truth,
+                        double period, float *out)
+{
+	const lsm9ds1_synth_errors *errors = (sensor == GYRO) ? &synth->gyroErrors :
+	                                     (sensor == ACCEL) ? &synth->accelErrors : &synth->magErrors;
+	float *drift = synth->drift[sensor];
+	float decay, drive, sigma;
+	uint8_t ii;
+
+	out[0] = truth[0];
+	out[1] = truth[1] + errors->misalignment[0] * truth[0];
+	out[2] = truth[2] + errors->misalignment[1] * truth[0] + errors->misalignment[2] * truth[1];
+
+	sigma = errors->noiseDensity * (float)sqrt(1.0 / period);
+	decay = 0.0f;
+	drive = 0.0f;
+	if ((errors->biasInstability > 0.0f) && (errors->biasTau > 0.0f))
+	{
+		decay = (float)exp(-period / errors->biasTau);
+		drive = errors->biasInstability * (float)sqrt(-expm1(-2.0 * period / errors->biasTau));
+	}
+	for (ii = 0; ii < 3; ii++)
+	{
+		if (drive > 0.0f)
+			drift[ii] = drift[ii] * decay + drive * gaussian(synth);
+		out[ii] = out[ii] * (1.0f + errors->scaleError[ii]) + errors->bias[ii] + drift[ii] +
+		          errors->tempCoeff[ii] * (synth->temperatureC - TEMP_ZERO_C);
+		if (sigma > 0.0f)
+			out[ii] += sigma * gaussian(synth);
+	}
+}
+
+static int16_t quantize(float value, float scale)
+{
+	float counts = value / scale;
+
+	if (counts >= 32767.0f) return 32767;
+	if (counts <= -32768.0f) return -32768;
+	return (int16_t)lrintf(counts);
+}
+
+bool LSM9DS1_synthStep(lsm9ds1_synth *synth, lsm9ds1_synth_sample *sample)
+{
+	const lsm9ds1_synth_segment *seg;
+	float r[3][3], world[3], measured[3], phase, pulse;
+	double angle, half, s, dq[4], q[4];
+	double *a = synth->q;
+	uint8_t ii;
+
+	if (synth->finished)
+		return false;
+
+	memset(sample, 0, sizeof(*sample));
+	seg = &synth->script[synth->segment];
+	sample->time = synth->time;
+
+	// Truth at this instant
+	for (ii = 0; ii < 4; ii++)
+		sample->attitude[ii] = (float)a[ii];
+	r[0][0] = (float)(1.0 - 2.0 * (a[2] * a[2] + a[3] * a[3]));
+	r[0][1] = (float)(2.0 * (a[1] * a[2] - a[0] * a[3]));
+	r[0][2] = (float)(2.0 * (a[1] * a[3] + a[0] * a[2]));
+	r[1][0] = (float)(2.0 * (a[1] * a[2] + a[0] * a[3]));
+	r[1][1] = (float)(1.0 - 2.0 * (a[1] * a[1] + a[3] * a[3]));
+	r[1][2] = (float)(2.0 * (a[2] * a[3] - a[0] * a[1]));
+	r[2][0] = (float)(2.0 * (a[1] * a[3] - a[0] * a[2]));
+	r[2][1] = (float)(2.0 * (a[2] * a[3] + a[0] * a[1]));
+	r[2][2] = (float)(1.0 - 2.0 * (a[1] * a[1] + a[2] * a[2]));
+
+	for (ii = 0; ii < 3; ii++)
+		world[ii] = seg->accel[ii] + ((ii == 2) ? 1.0f : 0.0f);
+	toBody(r, world, sample->specificForce);
+	phase = (float)(2.0 * PI_D * seg->vibrationHz * synth->segmentTime);
+	pulse = 0.0f;
+	if ((seg->impactMs > 0.0f) && (synth->segmentTime * 1000.0 < seg->impactMs))
+		pulse = sinf((float)(PI_D * synth->segmentTime * 1000.0 / seg->impactMs));
+	for (ii = 0; ii < 3; ii++)
+	{
+		sample->specificForce[ii] += seg->vibration[ii] * sinf(phase) + seg->impact[ii] * pulse;
+		sample->rate[ii] = seg->rate[ii];
+		world[ii] = synth->earthField[ii] + seg->magOffset[ii];
+	}
+	toBody(r, world, sample->field);
+
+	// Sensor outputs: errors, then the low-pass, then the ADC
+	if (synth->gyroEnabled)
+		applyErrors(synth, GYRO, sample->rate, synth->period, measured);
+	else
+		memset(measured, 0, sizeof(measured));
+	if (!synth->filterPrimed)
+		memcpy(synth->filter[GYRO], measured, sizeof(measured));
+	for (ii = 0; ii < 3; ii++)
+	{
+		synth->filter[GYRO][ii] += synth->gyroAlpha * (measured[ii] - synth->filter[GYRO][ii]);
+		sample->gyro[ii] = synth->gyroEnabled ? quantize(synth->filter[GYRO][ii], synth->gyroScale) : 0;
+	}
+	if (synth->accelEnabled)
+		applyErrors(synth, ACCEL, sample->specificForce, synth->period, measured);
+	else
+		memset(measured, 0, sizeof(measured));
+	if (!synth->filterPrimed)
+		memcpy(synth->filter[ACCEL], measured, sizeof(measured));
+	for (ii = 0; ii < 3; ii++)
+	{
+		synth->filter[ACCEL][ii] += synth->accelAlpha * (measured[ii] - synth->filter[ACCEL][ii]);
+		sample->accel[ii] = synth->accelEnabled ? quantize(synth->filter[ACCEL][ii], synth->accelScale) : 0;
+	}
+	synth->filterPrimed = true;
+
+	if (synth->magEnabled && (synth->time >= synth->nextMag))
+	{
+		applyErrors(synth, MAG, sample->field, synth->magPeriod, measured);
+		// The magnetometer X axis points the other way on the die
+		sample->mag[0] = quantize(-measured[0], synth->magScale);
+		sample->mag[1] = quantize(measured[1], synth->magScale);
+		sample->mag[2] = quantize(measured[2], synth->magScale);
+		sample->magReady = true;
+		synth->nextMag += synth->magPeriod;
+	}
+	sample->temperature = (int16_t)lrintf((synth->temperatureC - TEMP_ZERO_C) * TEMP_LSB_PER_C);
+
+	// Advance the attitude by the exact rotation of this step
+	angle = DEG_TO_RAD * synth->period *
+	        sqrt((double)seg->rate[0] * seg->rate[0] + (double)seg->rate[1] * seg->rate[1] +
+	             (double)seg->rate[2] * seg->rate[2]);
+	if (angle > 0.0)
+	{
+		half = 0.5 * angle;
+		s = sin(half) / angle * DEG_TO_RAD * synth->period;
+		dq[0] = cos(half);
+		dq[1] = s * seg->rate[0];
+		dq[2] = s * seg->rate[1];
+		dq[3] = s * seg->rate[2];
+		q[0] = a[0] * dq[0] - a[1] * dq[1] - a[2] * dq[2] - a[3] * dq[3];
+		q[1] = a[0] * dq[1] + a[1] * dq[0] + a[2] * dq[3] - a[3] * dq[2];
+		q[2] = a[0] * dq[2] - a[1] * dq[3] + a[2] * dq[0] + a[3] * dq[1];
+		q[3] = a[0] * dq[3] + a[1] * dq[2] - a[2] * dq[1] + a[3] * dq[0];
+		s = 1.0 / sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		for (ii = 0; ii < 4; ii++)
+			a[ii] = q[ii] * s;
+	}
+
+	// Advance the script
+	synth->time += synth->period;
+	synth->segmentTime += synth->period;
+	while (synth->segmentTime >= synth->script[synth->segment].duration)
+	{
+		synth->segmentTime -= synth->script[synth->segment].duration;
+		if (++synth->segment == synth->segments)
+		{
+			synth->segment = 0;
+			if (!synth->loop)
+			{
+				synth->finished = true;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+uint16_t LSM9DS1_synthFifo(lsm9ds1_synth *synth, uint8_t *out,
+                           uint16_t count, uint8_t sampleBytes)
+{
+	lsm9ds1_synth_sample sample;
+	const int16_t *words;
+	uint16_t ii;
+	uint8_t jj;
+
+	if ((sampleBytes != 12) && (sampleBytes != 6))
+		return 0;
+	for (ii = 0; ii < count; ii++)
+	{
+		if (!LSM9DS1_synthStep(synth, &sample))
+			break;
+		for (jj = 0; jj < sampleBytes / 2; jj++)
+		{
+			words = (sampleBytes == 12) && (jj < 3) ? sample.gyro : sample.accel;
+			*out++ = (uint8_t)(words[jj % 3] & 0xFF);
+			*out++ = (uint8_t)((uint16_t)words[jj % 3] >> 8);
+		}
+	}
+	return ii;
+}
+
+bool LSM9DS1_synthToSim(lsm9ds1_synth *synth, lsm9ds1_sim *sim)
+{
+	lsm9ds1_synth_sample sample;
+
+	if (!LSM9DS1_synthStep(synth, &sample))
+		return false;
+	LSM9DS1_simSetSample(sim, synth->gyroEnabled ? sample.gyro : NULL,
+	                     synth->accelEnabled ? sample.accel : NULL,
+	                     sample.magReady ? sample.mag : NULL, &sample.temperature);
+	return true;
+}
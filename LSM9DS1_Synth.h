@@ -0,0 +1,150 @@
+/******************************************************************************
+
+	LSM9DS1_Synth.h
+	Trajectory and sensor-error synthesizer feeding the LSM9DS1 model.
+
+LSM9DS1_Sim answers the bus like the device but only returns the samples
+it is given. The synthesizer produces them: a script of segments, each
+holding a body angular rate, a linear acceleration, a vibration, an impact
+and a magnetic disturbance for a duration, is integrated into the true
+attitude, angular rate, specific force and magnetic field at the output
+rate, and then run through a model of the sensors configured in an
+IMUSettings:
+
+	out = quantize(lowpass((1 + scale) * misalign * truth + bias
+	                       + tempCoeff * (T - 25 C) + bias drift
+	                       + white noise))
+
+The white noise is given as the random-walk coefficient N (what
+LSM9DS1_allanFit() reports for the unit) and drawn at N * sqrt(ODR) per
+sample; the bias drift is a first-order Gauss-Markov process; the
+low-pass is a single pole at the gyro (BW_G) or accel (BW_XL) cutoff the
+settings select; quantization uses the configured full scale and
+saturates like the ADC. Gyro and accel run at the gyro ODR when the gyro
+is enabled, as in the device, and the magnetometer at its own ODR with
+its X axis reversed, as on the die.
+
+Attitude is propagated with the exact rotation of each sample step in
+double, the noise comes from a seeded xorshift generator and Box-Muller
+pairs, and there is no allocation: hours of 952 Hz data take seconds on
+a PC and the same seed gives the same data.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Synth_H__
+#define __LSM9DS1_Synth_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_Types.h"
+    #include "LSM9DS1_Sim.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // One step of the script. World frame: X east, Y north, Z up.
+    typedef struct
+    {
+        float duration;         // s
+        float rate[3];          // body angular rate, dps
+        float accel[3];         // linear acceleration, world frame, g
+        float vibration[3];     // sine amplitude, body frame, g
+        float vibrationHz;
+        float impact[3];        // half-sine peak at the segment start, body frame, g
+        float impactMs;         // pulse width
+        float magOffset[3];     // added to the earth field, world frame, gauss
+    } lsm9ds1_synth_segment;
+
+    typedef struct
+    {
+        float noiseDensity;     // N, units / sqrt(Hz)
+        float biasInstability;  // rms of the Gauss-Markov drift, units
+        float biasTau;          // its correlation time, s
+        float bias[3];          // constant offset, units
+        float scaleError[3];    // 0.01 = +1 %
+        float misalignment[3];  // rad: Y toward X, Z toward X, Z toward Y
+        float tempCoeff[3];     // bias change per degree C above 25 C
+    } lsm9ds1_synth_errors;
+
+    typedef struct
+    {
+        double time;            // s since the start of the script
+        int16_t gyro[3];        // raw outputs
+        int16_t accel[3];
+        int16_t mag[3];         // valid if magReady
+        int16_t temperature;
+        bool magReady;          // a mag conversion completed this sample
+
+        // Truth, body frame
+        float rate[3];          // dps
+        float specificForce[3]; // g, +1 on Z when level
+        float field[3];         // gauss
+        float attitude[4];      // quaternion w, x, y, z, body to world
+    } lsm9ds1_synth_sample;
+
+    typedef struct
+    {
+        // Configuration
+        const lsm9ds1_synth_segment *script;
+        uint16_t segments;
+        bool loop;                    // restart the script at its end
+        float earthField[3];          // world frame, gauss
+        float temperatureC;
+        lsm9ds1_synth_errors gyroErrors;    // dps
+        lsm9ds1_synth_errors accelErrors;   // g
+        lsm9ds1_synth_errors magErrors;     // gauss
+        bool gyroEnabled, accelEnabled, magEnabled;
+        float gyroScale, accelScale, magScale;  // units per raw count
+        double period;                // s, accel/gyro
+        double magPeriod;             // s
+        float gyroAlpha, accelAlpha;  // low-pass coefficients
+
+        // State
+        double time;
+        uint16_t segment;
+        double segmentTime;
+        bool finished;
+        double q[4];                  // body to world
+        float drift[3][3];            // Gauss-Markov state, gyro/accel/mag
+        float filter[2][3];           // low-pass state, gyro/accel
+        bool filterPrimed;
+        double nextMag;
+        uint64_t rng;
+        float spare;
+        bool hasSpare;
+    } lsm9ds1_synth;
+
+    // synthInit() -- Read the rates, scales and bandwidths from settings,
+    // load typical error values and start the script level, X east.
+    // The error structs, earthField and loop may be changed afterwards.
+    // Input:
+    //	- settings = Configuration to model (see LSM9DS1_getSettings()).
+    //	- script, segments = Trajectory, kept by reference.
+    //	- seed = Noise generator seed.
+    // Output: false if no accel/gyro rate is set or the script is empty.
+    bool LSM9DS1_synthInit(lsm9ds1_synth *synth, const IMUSettings *settings,
+                           const lsm9ds1_synth_segment *script,
+                           uint16_t segments, uint32_t seed);
+
+    // synthStep() -- Produce the next accel/gyro sample.
+    // Output: false at the end of a script that does not loop.
+    bool LSM9DS1_synthStep(lsm9ds1_synth *synth, lsm9ds1_synth_sample *sample);
+
+    // synthFifo() -- Produce samples in the layout LSM9DS1_wmDrain()
+    // stores (12 bytes gyro+accel, or 6 accel only).
+    // Output: Samples written, fewer than count at the end of the script.
+    uint16_t LSM9DS1_synthFifo(lsm9ds1_synth *synth, uint8_t *out,
+                               uint16_t count, uint8_t sampleBytes);
+
+    // synthToSim() -- Produce the next sample and latch it into the
+    // register model (the mag only when it converted).
+    // Output: false at the end of a script that does not loop.
+    bool LSM9DS1_synthToSim(lsm9ds1_synth *synth, lsm9ds1_sim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -201,6 +201,7 @@ typedef struct
 	uint8_t commInterface; // Can be I2C, SPI 4-wire or SPI 3-wire
 	uint8_t agAddress;	 // I2C address or SPI CS pin
 	uint8_t mAddress;	  // I2C address or SPI CS pin
+	uint32_t i2cSpeed;	  // I2C SCL frequency in Hz: 100000 or 400000
 } deviceSettings;
 
 typedef struct
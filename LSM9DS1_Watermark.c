@@ -0,0 +1,194 @@
+/******************************************************************************
+
+	LSM9DS1_Watermark.c
+	Adaptive FIFO watermark controller for the LSM9DS1 driver.
+
+The threshold moves down at once when the latency target or the free FIFO
+space demands it, and creeps up one level per drain only when there is room
+for at least two more, so a single slow wake-up or the longer drain of a
+higher threshold does not make it oscillate. Times are 32-bit microsecond
+counters compared by unsigned subtraction, so they may wrap.
+******************************************************************************/
+
+#include "LSM9DS1_Watermark.h"
+#include "LSM9DS1_Planner.h"
+#include "SparkFunLSM9DS1.h"
+#include "LSM9DS1_Registers.h"
+#include "LSM9DS1_RegMap.h"
+#include "LSM9DS1_Types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Exponential average with a weight of 1/4 for the new measurement.
+static uint32_t smooth(uint32_t average, uint32_t sample)
+{
+	if (average == 0) return sample;
+	return average - (average >> 2) + (sample >> 2);
+}
+
+// Highest threshold that meets the latency target and leaves room in the
+// FIFO for the samples arriving while we wake up and drain.
+static uint8_t wantedThreshold(const lsm9ds1_watermark *wm)
+{
+	uint32_t serviceUs = wm->stats.wakeUs + wm->stats.drainUs;
+	uint32_t arriving = (serviceUs + wm->periodUs - 1) / wm->periodUs;
+	int32_t wanted = LSM9DS1_FIFO_DEPTH - 1;
+
+	if ((int32_t)(LSM9DS1_FIFO_DEPTH - arriving - LSM9DS1_WM_MARGIN) < wanted)
+		wanted = LSM9DS1_FIFO_DEPTH - arriving - LSM9DS1_WM_MARGIN;
+
+	if (wm->targetLatencyUs)
+	{
+		int32_t byLatency = 1;
+		if (wm->targetLatencyUs > serviceUs)
+			byLatency = (wm->targetLatencyUs - serviceUs) / wm->periodUs + 1;
+		if (byLatency < wanted)
+			wanted = byLatency;
+	}
+
+	return wanted < 1 ? 1 : (uint8_t)wanted;
+}
+
+bool LSM9DS1_wmInit(lsm9ds1_watermark *wm, uint32_t targetLatencyUs,
+                    uint32_t (*micros)(void))
+{
+	const IMUSettings *settings = LSM9DS1_getSettings();
+	lsm9ds1_plan_request request = {targetLatencyUs, 0};
+	lsm9ds1_plan plan;
+
+	memset(wm, 0, sizeof(*wm));
+	wm->micros = micros;
+	wm->targetLatencyUs = targetLatencyUs;
+
+	// The planner's threshold is only a starting point; its status does not
+	// matter here since the controller corrects it from measurements.
+	LSM9DS1_proposePlan(settings, &request, &plan);
+	if (plan.fifoRate == 0)
+		return false;
+
+	wm->periodUs = (uint32_t)(1000000000ULL / plan.fifoRate);
+	wm->sampleBytes = plan.sampleBytes;
+	wm->firstReg = (plan.sampleBytes == 12) ? OUT_X_L_G : OUT_X_L_XL;
+	wm->stats.drainUs = plan.drainUs;
+	wm->threshold = plan.fifoThreshold;
+	wm->stats.threshold = wm->threshold;
+
+	LSM9DS1_enableFIFO(true);
+	LSM9DS1_setFIFO(FIFO_CONT, wm->threshold);
+	return true;
+}
+
+void LSM9DS1_wmSetTarget(lsm9ds1_watermark *wm, uint32_t targetLatencyUs)
+{
+	wm->targetLatencyUs = targetLatencyUs;
+}
+
+uint8_t LSM9DS1_wmDrain(lsm9ds1_watermark *wm, uint32_t irqUs,
+                        uint8_t *dest, uint8_t maxSamples)
+{
+	uint8_t perBurst = LSM9DS1_MAX_BURST_BYTES / wm->sampleBytes;
+	uint8_t src, stored, count, read = 0;
+	uint8_t wanted, next;
+	uint32_t startUs, endUs, latencyUs;
+
+	startUs = wm->micros();
+	if (LSM9DS1_xgReadBytes(FIFO_SRC, &src, 1) != 1)
+	{
+		wm->stats.failures++;
+		return 0;
+	}
+	stored = LSM9DS1_get_FSS(src);
+	count = stored < maxSamples ? stored : maxSamples;
+
+	// With the FIFO enabled, a burst from the first output register returns
+	// whole FIFO levels back to back (see LSM9DS1_planBus()).
+	while (read < count)
+	{
+		uint8_t burst = (count - read) < perBurst ? (count - read) : perBurst;
+		if (LSM9DS1_xgReadBytes(wm->firstReg, dest + read * wm->sampleBytes,
+		                        burst * wm->sampleBytes) != burst * wm->sampleBytes)
+			break;
+		read += burst;
+	}
+	endUs = wm->micros();
+
+	// A bus error cut the drain short: hand over the whole bursts before it
+	// but keep its timing out of the averages and FTH where it is.
+	if (read < count)
+	{
+		wm->stats.failures++;
+		wm->stats.samples += read;
+		return read;
+	}
+
+	// The newest sample landed just before the drain started; the oldest is
+	// stored - 1 periods older and is handed over when the drain ends.
+	latencyUs = (stored ? (stored - 1) * wm->periodUs : 0) + (endUs - startUs);
+
+	wm->stats.wakeUs = smooth(wm->stats.wakeUs, startUs - irqUs);
+	if (count)
+		wm->stats.drainUs = smooth(wm->stats.drainUs, endUs - startUs);
+
+	if (wm->stats.wakeups == 0)
+		wm->firstUs = irqUs;
+	wm->lastUs = irqUs;
+	wm->stats.wakeups++;
+	wm->stats.samples += count;
+	wm->stats.latencyUs = latencyUs;
+	if (latencyUs > wm->stats.latencyMaxUs)
+		wm->stats.latencyMaxUs = latencyUs;
+	wm->latencySumUs += latencyUs;
+
+	// Retune FTH. An overrun means the measurements were too optimistic:
+	// halve the threshold on top of what they suggest.
+	wanted = wantedThreshold(wm);
+	if (LSM9DS1_get_OVRN(src))
+	{
+		wm->stats.overruns++;
+		if (wanted > wm->threshold / 2)
+			wanted = wm->threshold / 2 ? wm->threshold / 2 : 1;
+	}
+	if (wanted < wm->threshold)
+		next = wanted;
+	else if (wanted > wm->threshold + 1)
+		next = wm->threshold + 1;
+	else
+		next = wm->threshold;
+
+	if (next != wm->threshold)
+	{
+		wm->threshold = next;
+		wm->stats.threshold = next;
+		wm->stats.adjustments++;
+		LSM9DS1_setFIFO(FIFO_CONT, next);
+	}
+
+	return count;
+}
+
+void LSM9DS1_wmGetStats(lsm9ds1_watermark *wm, lsm9ds1_wm_stats *stats,
+                        bool reset)
+{
+	uint32_t elapsedUs = wm->lastUs - wm->firstUs;
+
+	*stats = wm->stats;
+	if (wm->stats.wakeups)
+		stats->latencyAvgUs = (uint32_t)(wm->latencySumUs / wm->stats.wakeups);
+	if (elapsedUs)
+		stats->wakeupRate = (uint32_t)((uint64_t)(wm->stats.wakeups - 1) *
+		                               1000000000ULL / elapsedUs);
+
+	if (reset)
+	{
+		// Keep the smoothed timings and the threshold, they are state.
+		wm->stats.wakeups = 0;
+		wm->stats.samples = 0;
+		wm->stats.overruns = 0;
+		wm->stats.adjustments = 0;
+		wm->stats.failures = 0;
+		wm->stats.latencyMaxUs = 0;
+		wm->latencySumUs = 0;
+	}
+}
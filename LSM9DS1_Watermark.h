@@ -0,0 +1,92 @@
+/******************************************************************************
+
+	LSM9DS1_Watermark.h
+	Adaptive FIFO watermark controller for the LSM9DS1 driver.
+
+A fixed FIFO threshold either wakes the consumer too often (low FTH) or adds
+up to 32 sample periods of latency (high FTH). The controller drains the FIFO
+on each threshold interrupt, measures how long the wake-up and the drain
+took, and moves FIFO_CTRL FTH to the highest value that still meets the
+consumer latency target and leaves enough free levels to absorb the samples
+that arrive while draining, so the overrun bit in FIFO_SRC stays clear.
+
+Typical use: the FIFO threshold interrupt (INT_FTH on INT1) records the time
+with its timestamp source and wakes a task, which calls LSM9DS1_wmDrain().
+******************************************************************************/
+
+#ifndef __LSM9DS1_Watermark_H__
+#define __LSM9DS1_Watermark_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    #include "LSM9DS1_Types.h"
+
+    // Free FIFO levels kept on top of the samples expected during a drain.
+    #define LSM9DS1_WM_MARGIN           2
+
+    typedef struct
+    {
+        uint32_t wakeups;         // drains performed
+        uint32_t samples;         // samples read out of the FIFO
+        uint32_t overruns;        // drains that found FIFO_SRC OVRN set
+        uint32_t adjustments;     // FTH rewrites
+        uint32_t failures;        // drains cut short by a bus error
+        uint32_t wakeupRate;      // drains per second, x1000
+        uint32_t latencyUs;       // last end-to-end latency of the oldest sample
+        uint32_t latencyMaxUs;    // worst latency seen
+        uint32_t latencyAvgUs;    // mean latency over the drains counted
+        uint32_t drainUs;         // smoothed bus time of a drain
+        uint32_t wakeUs;          // smoothed interrupt-to-drain delay
+        uint8_t threshold;        // current FTH
+    } lsm9ds1_wm_stats;
+
+    typedef struct
+    {
+        // Configuration
+        uint32_t (*micros)(void); // free-running microsecond counter
+        uint32_t targetLatencyUs; // 0: no bound, minimise wake-ups
+        uint32_t periodUs;        // FIFO sample period, from the ODR
+        uint8_t sampleBytes;      // 12 (gyro+accel) or 6 (accel only)
+        uint8_t firstReg;         // OUT_X_L_G or OUT_X_L_XL
+
+        // State
+        uint8_t threshold;
+        uint32_t firstUs;
+        uint32_t lastUs;
+        uint64_t latencySumUs;
+        lsm9ds1_wm_stats stats;
+    } lsm9ds1_watermark;
+
+    // wmInit() -- Start the FIFO in continuous mode with a threshold chosen by
+    // LSM9DS1_planBus() for the current settings, and reset the counters.
+    // Call after begin().
+    // Input:
+    //	- wm = Controller instance (caller storage).
+    //	- targetLatencyUs = Largest acceptable age of the oldest sample when
+    //	  wmDrain() returns it, 0 for no bound.
+    //	- micros = Microsecond timestamp source, also used by the interrupt.
+    // Output: true if the gyro or the accel is enabled and the FIFO started.
+    bool LSM9DS1_wmInit(lsm9ds1_watermark *wm, uint32_t targetLatencyUs,
+                        uint32_t (*micros)(void));
+
+    // wmSetTarget() -- Change the latency target. Takes effect at the next drain.
+    void LSM9DS1_wmSetTarget(lsm9ds1_watermark *wm, uint32_t targetLatencyUs);
+
+    // wmDrain() -- Read every sample in the FIFO and retune FTH.
+    // Input:
+    //	- wm = Controller instance.
+    //	- irqUs = micros() value taken in the FIFO threshold interrupt.
+    //	- dest = Buffer of maxSamples * sampleBytes bytes. Each sample is raw
+    //	  gyro X,Y,Z then accel X,Y,Z (accel only when the gyro is off).
+    //	- maxSamples = Capacity of dest, in samples (32 holds a full FIFO).
+    // Output: Number of samples stored in dest. A bus error ends the drain
+    // with the samples read before it (0 if FIFO_SRC failed) and leaves FTH.
+    uint8_t LSM9DS1_wmDrain(lsm9ds1_watermark *wm, uint32_t irqUs,
+                            uint8_t *dest, uint8_t maxSamples);
+
+    // wmGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_wmGetStats(lsm9ds1_watermark *wm, lsm9ds1_wm_stats *stats,
+                            bool reset);
+
+#endif
@@ -0,0 +1,174 @@
+/******************************************************************************
+
+	LSM9DS1_Zupt.c
+	Stationary (zero-velocity) detection on the LSM9DS1 sample stream.
+
+The running sums are integers, so adding and removing samples never
+accumulates rounding error. The scatter term is formed exactly as
+W * sum(|a|^2) - |sum(a)|^2 in 64 bits before the only floating-point
+steps: one square root for |mean(a)| and the weighting.
+******************************************************************************/
+
+#include "LSM9DS1_Zupt.h"
+#include "SparkFunLSM9DS1.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+bool LSM9DS1_zuptInit(lsm9ds1_zupt *zupt, uint8_t window, float threshold,
+                      float sigmaAccel, float sigmaGyro)
+{
+	float sigma;
+
+	if ((window == 0) || (window > LSM9DS1_ZUPT_MAX_WINDOW))
+		return false;
+
+	memset(zupt, 0, sizeof(*zupt));
+	zupt->window = window;
+	zupt->threshold = threshold;
+	zupt->gravity = 1.0f / LSM9DS1_calcAccel(1);
+	sigma = sigmaAccel / LSM9DS1_calcAccel(1);
+	zupt->accelWeight = 1.0f / (sigma * sigma);
+	sigma = sigmaGyro / LSM9DS1_calcGyro(1);
+	zupt->gyroWeight = 1.0f / (sigma * sigma);
+	zupt->stats.statisticMin = INFINITY;
+	return true;
+}
+
+// Bias-corrected rate, clamped: a reading near full scale minus a bias of
+// the other sign does not fit in 16 bits and must not wrap to the far end.
+static int16_t saturate16(int32_t value)
+{
+	if (value > INT16_MAX)
+		return INT16_MAX;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t)value;
+}
+
+static void closeInterval(lsm9ds1_zupt *zupt)
+{
+	if (zupt->intervalCount == LSM9DS1_ZUPT_INTERVALS)
+	{
+		zupt->intervalHead = (zupt->intervalHead + 1) % LSM9DS1_ZUPT_INTERVALS;
+		zupt->intervalCount--;
+		zupt->stats.droppedIntervals++;
+	}
+	zupt->intervals[(zupt->intervalHead + zupt->intervalCount) % LSM9DS1_ZUPT_INTERVALS] = zupt->open;
+	zupt->intervalCount++;
+	zupt->stats.intervals++;
+	zupt->stationary = false;
+}
+
+bool LSM9DS1_zuptUpdate(lsm9ds1_zupt *zupt, const int16_t *gyro,
+                        const int16_t *accel, uint32_t us)
+{
+	int16_t *slot = zupt->history[zupt->head];
+	int64_t scatter, sumSq;
+	float mean, statistic;
+	uint8_t ii, window = zupt->window;
+	bool pass;
+
+	// Drop the sample leaving the window, then add the new one
+	if (zupt->filled == window)
+	{
+		for (ii = 0; ii < 3; ii++)
+		{
+			zupt->sumW2 -= (int32_t)slot[ii] * slot[ii];
+			zupt->sumA[ii] -= slot[3 + ii];
+			zupt->sumA2 -= (int32_t)slot[3 + ii] * slot[3 + ii];
+		}
+	}
+	else
+		zupt->filled++;
+	for (ii = 0; ii < 3; ii++)
+	{
+		slot[ii] = gyro ? saturate16((int32_t)gyro[ii] - zupt->gyroBias[ii]) : 0;
+		slot[3 + ii] = accel[ii];
+		zupt->sumW2 += (int32_t)slot[ii] * slot[ii];
+		zupt->sumA[ii] += slot[3 + ii];
+		zupt->sumA2 += (int32_t)slot[3 + ii] * slot[3 + ii];
+	}
+	zupt->times[zupt->head] = us;
+	zupt->head = (zupt->head + 1 == window) ? 0 : zupt->head + 1;
+
+	zupt->stats.samples++;
+	if (zupt->filled < window)
+		return false;
+
+	// sum |a[k] - g u|^2 = scatter + W (|mean(a)| - g)^2
+	sumSq = (int64_t)zupt->sumA[0] * zupt->sumA[0] +
+	        (int64_t)zupt->sumA[1] * zupt->sumA[1] +
+	        (int64_t)zupt->sumA[2] * zupt->sumA[2];
+	scatter = window * zupt->sumA2 - sumSq;
+	mean = sqrtf((float)sumSq) / window - zupt->gravity;
+	statistic = ((float)scatter / window + window * mean * mean) * zupt->accelWeight +
+	            (float)zupt->sumW2 * zupt->gyroWeight;
+	statistic /= window;
+	zupt->statistic = statistic;
+	if (statistic < zupt->stats.statisticMin)
+		zupt->stats.statisticMin = statistic;
+
+	pass = (statistic < zupt->threshold);
+	if (pass)
+	{
+		zupt->stats.stationarySamples++;
+		if (!zupt->stationary)
+		{
+			// The oldest sample of the window is the next slot to be written
+			zupt->open.startUs = zupt->times[zupt->head];
+			zupt->open.samples = window - 1;
+			zupt->stationary = true;
+		}
+		zupt->open.endUs = us;
+		zupt->open.samples++;
+	}
+	else if (zupt->stationary)
+		closeInterval(zupt);
+	return pass;
+}
+
+uint32_t LSM9DS1_zuptFifo(lsm9ds1_zupt *zupt, const uint8_t *samples,
+                          uint8_t count, uint8_t sampleBytes,
+                          uint32_t firstUs, uint32_t periodUs)
+{
+	int16_t values[6];
+	uint32_t mask = 0;
+	uint8_t ii, axis, words = sampleBytes / 2;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		for (axis = 0; axis < words; axis++)
+			values[axis] = (int16_t)((samples[2 * axis + 1] << 8) | samples[2 * axis]);
+		samples += sampleBytes;
+
+		if (LSM9DS1_zuptUpdate(zupt, (words == 6) ? values : NULL,
+		                       (words == 6) ? values + 3 : values,
+		                       firstUs + ii * periodUs) && (ii < 32))
+			mask |= 1UL << ii;
+	}
+	return mask;
+}
+
+bool LSM9DS1_zuptGetInterval(lsm9ds1_zupt *zupt, lsm9ds1_zupt_interval *interval)
+{
+	if (zupt->intervalCount == 0)
+		return false;
+	*interval = zupt->intervals[zupt->intervalHead];
+	zupt->intervalHead = (zupt->intervalHead + 1) % LSM9DS1_ZUPT_INTERVALS;
+	zupt->intervalCount--;
+	return true;
+}
+
+void LSM9DS1_zuptGetStats(lsm9ds1_zupt *zupt, lsm9ds1_zupt_stats *stats,
+                          bool reset)
+{
+	*stats = zupt->stats;
+	if (reset)
+	{
+		memset(&zupt->stats, 0, sizeof(zupt->stats));
+		zupt->stats.statisticMin = INFINITY;
+	}
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+
+	LSM9DS1_Zupt.h
+	Stationary (zero-velocity) detection on the LSM9DS1 sample stream.
+
+Foot-mounted and vehicle dead reckoning bound its drift with zero-velocity
+updates, applied whenever the sensor is standing still. The detector is
+the generalized likelihood ratio test of Skog et al. (SHOE): over the last
+W samples,
+
+	T = 1/W * sum( |a[k] - g * mean(a) / |mean(a)||^2 / sigmaA^2
+	             + |w[k]|^2 / sigmaG^2 )
+
+and the sensor is stationary while T < threshold. The accel term splits
+into the scatter around the window mean plus W (|mean(a)| - g)^2, so the
+window is kept as running sums (sum of a, of |a|^2 and of |w|^2) updated
+by adding the new sample and removing the one leaving the window: the cost
+per sample is constant, whatever W. It runs on the raw FIFO blocks that
+LSM9DS1_wmDrain() returns, with no copy or conversion of the samples.
+
+A sample is stationary when the window ending at it passes the test; a
+zero-velocity interval then covers the whole window, from its first sample
+to the last sample of the last passing window. Completed intervals are
+queued with their timestamps; the one in progress can be read at any time.
+******************************************************************************/
+
+#ifndef __LSM9DS1_Zupt_H__
+#define __LSM9DS1_Zupt_H__
+
+    #include <stdbool.h>
+    #include <stdint.h>
+
+    // Longest window, in samples.
+    #define LSM9DS1_ZUPT_MAX_WINDOW     64
+
+    // Completed intervals kept until zuptGetInterval() collects them.
+    #define LSM9DS1_ZUPT_INTERVALS      8
+
+    typedef struct
+    {
+        uint32_t startUs;       // first sample of the first passing window
+        uint32_t endUs;         // last sample of the last passing window
+        uint32_t samples;       // samples from startUs to endUs
+    } lsm9ds1_zupt_interval;
+
+    typedef struct
+    {
+        uint32_t samples;             // samples tested
+        uint32_t stationarySamples;   // samples that passed
+        uint32_t intervals;           // intervals completed
+        uint32_t droppedIntervals;    // overwritten before zuptGetInterval()
+        float statisticMin;           // smallest T seen
+    } lsm9ds1_zupt_stats;
+
+    typedef struct
+    {
+        // Configuration
+        uint8_t window;               // W, samples
+        float threshold;              // test threshold on T
+        float gravity;                // 1 g in raw accel counts
+        float accelWeight;            // 1 / sigmaA^2, raw counts
+        float gyroWeight;             // 1 / sigmaG^2, raw counts
+        int16_t gyroBias[3];          // subtracted from raw gyro samples
+
+        // Window and running sums
+        int16_t history[LSM9DS1_ZUPT_MAX_WINDOW][6];   // gyro, accel
+        uint32_t times[LSM9DS1_ZUPT_MAX_WINDOW];
+        uint8_t head;
+        uint8_t filled;
+        int32_t sumA[3];
+        int64_t sumA2;
+        int64_t sumW2;
+
+        // State
+        float statistic;              // T of the last sample
+        bool stationary;
+        lsm9ds1_zupt_interval open;   // valid while stationary
+        lsm9ds1_zupt_interval intervals[LSM9DS1_ZUPT_INTERVALS];
+        uint8_t intervalHead;
+        uint8_t intervalCount;
+        lsm9ds1_zupt_stats stats;
+    } lsm9ds1_zupt;
+
+    // zuptInit() -- Configure the detector for the current accel and gyro
+    // full scales (call after begin()) and empty the window.
+    // Input:
+    //	- window = W, 1..LSM9DS1_ZUPT_MAX_WINDOW samples (e.g. 3 at 100 Hz
+    //	  for a foot, 20 to 30 at 952 Hz).
+    //	- threshold = Largest T of a stationary window. With the sigmas set
+    //	  to the sensor noise, T averages about 6 at rest (3 with the gyro
+    //	  off); tens to a few hundred suit most motion.
+    //	- sigmaAccel = Accelerometer noise standard deviation, g.
+    //	- sigmaGyro = Gyroscope noise standard deviation, dps.
+    // Output: false if window is out of range. gyroBias starts at zero.
+    bool LSM9DS1_zuptInit(lsm9ds1_zupt *zupt, uint8_t window, float threshold,
+                          float sigmaAccel, float sigmaGyro);
+
+    // zuptUpdate() -- Test one sample.
+    // Input:
+    //	- gyro = Raw gyro X, Y, Z, or NULL when the gyro is off.
+    //	- accel = Raw accel X, Y, Z.
+    //	- us = Sample time.
+    // Output: true if the sample is stationary.
+    bool LSM9DS1_zuptUpdate(lsm9ds1_zupt *zupt, const int16_t *gyro,
+                            const int16_t *accel, uint32_t us);
+
+    // zuptFifo() -- Test a block of raw FIFO samples, as stored by
+    // LSM9DS1_wmDrain() (gyro X,Y,Z then accel X,Y,Z, or accel only).
+    // Input:
+    //	- samples, count, sampleBytes = The block (12 or 6 bytes per sample).
+    //	- firstUs = Time of the first sample. After a threshold interrupt at
+    //	  irqUs this is irqUs - (threshold - 1) * periodUs.
+    //	- periodUs = Sample period.
+    // Output: Bit k set if sample k is stationary (samples 0..31).
+    uint32_t LSM9DS1_zuptFifo(lsm9ds1_zupt *zupt, const uint8_t *samples,
+                              uint8_t count, uint8_t sampleBytes,
+                              uint32_t firstUs, uint32_t periodUs);
+
+    // zuptGetInterval() -- Take the oldest completed interval.
+    // Output: true if interval was filled.
+    bool LSM9DS1_zuptGetInterval(lsm9ds1_zupt *zupt,
+                                 lsm9ds1_zupt_interval *interval);
+
+    // zuptGetStats() -- Copy the counters, optionally restarting them.
+    void LSM9DS1_zuptGetStats(lsm9ds1_zupt *zupt, lsm9ds1_zupt_stats *stats,
+                              bool reset);
+
+#endif
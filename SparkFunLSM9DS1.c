@@ -19,22 +19,23 @@ Distributed as-is; no warranty is given.
 
 #include "SparkFunLSM9DS1.h"
 #include "LSM9DS1_Registers.h"
+#include "LSM9DS1_RegMap.h"
 #include "LSM9DS1_Types.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "drivers/i2c_if.h"
+#include "drivers/i2c_sched.h"
+#ifndef OS_IF_POSIX
 #include "utils/uartstdio.h"
+#endif
 
 
-//Include FreeRTOS
-#include "FreeRTOS.h"
-#include "task.h"
-#include "semphr.h"
-#include "queue.h"
-#include "portmacro.h"
+//FreeRTOS, or the bare-metal replacement if OS_IF_BAREMETAL is defined
+#include "drivers/os_if.h"
 
 // Sensor Sensitivity Constants
 // Values set according to the typical specifications provided in
@@ -82,6 +83,11 @@ static float gRes, aRes, mRes;
 // accelerometer and gyroscope bias calculated in calibrate().
 static bool _autoCalc;
 
+// _i2cController is the I2C module the sensor is wired to, and _i2cBus the
+// bus opened on it by initI2C().
+static const I2C_IF_Controller *_i2cController = &g_sI2C_IF_I2C3;
+static I2C_IF_Handle _i2cBus;
+
 void LSM9DS1_set_mAddress(uint8_t i_mAddress){
 	_mAddress = i_mAddress;
 }  
@@ -94,6 +100,18 @@ bool LSM9DS1_is_autoCalc(){
 	return _autoCalc;
 }
 
+IMUSettings * LSM9DS1_getSettings(){
+	return &settings;
+}
+
+void LSM9DS1_setI2CController(const I2C_IF_Controller *controller){
+	_i2cController = controller;
+}
+
+I2C_IF_Handle LSM9DS1_getI2CBus(){
+	return _i2cBus;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ FUNCTIONS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 
 bool LSM9DS1_isConnected(){
@@ -113,6 +131,9 @@ void LSM9DS1_init(interface_mode interface, uint8_t xgAddr, uint8_t mAddr)
 	settings.device.commInterface = interface;
 	settings.device.agAddress = xgAddr;
 	settings.device.mAddress = mAddr;
+	// I2C clock can be 100000 (standard) or 400000 (fast mode) Hz.
+	// See LSM9DS1_Planner.h to check a configuration fits the bus.
+	settings.device.i2cSpeed = 100000;
 
 	settings.gyro.enabled = true;
 	settings.gyro.enableX = true;
@@ -220,7 +241,7 @@ uint16_t LSM9DS1_begin()
 	else if (settings.device.commInterface == IMU_MODE_SPI) 	// else, if we're using SPI
 	    LSM9DS1_initSPI();	// Initialize SPI
 		
-	vTaskDelay(10);
+	OS_IF_Delay(OS_IF_MS_TO_TICKS(10));
 
 	// To verify communication, we can read from the WHO_AM_I register of
 	// each device. Store those in a variable so we can return them.
@@ -258,19 +279,19 @@ void LSM9DS1_initGyro()
 	// rate if the gyro is enabled.
 	if (settings.gyro.enabled)
 	{
-		tempRegValue = (settings.gyro.sampleRate & 0x07) << 5;
+		tempRegValue = LSM9DS1_set_ODR_G(tempRegValue, settings.gyro.sampleRate);
 	}
 	switch (settings.gyro.scale)
 	{
 		case 500:
-			tempRegValue |= (0x1 << 3);
+			tempRegValue = LSM9DS1_set_FS_G(tempRegValue, 0x1);
 			break;
 		case 2000:
-			tempRegValue |= (0x3 << 3);
+			tempRegValue = LSM9DS1_set_FS_G(tempRegValue, 0x3);
 			break;
-		// Otherwise we'll set it to 245 dps (0x0 << 4)
+		// Otherwise we'll set it to 245 dps (0x0)
 	}
-	tempRegValue |= (settings.gyro.bandwidth & 0x3);
+	tempRegValue = LSM9DS1_set_BW_G(tempRegValue, settings.gyro.bandwidth);
 	LSM9DS1_xgWriteByte(CTRL_REG1_G, tempRegValue);
 	
 	// CTRL_REG2_G (Default value: 0x00)
@@ -343,25 +364,25 @@ void LSM9DS1_initAccel()
 	// To disable the accel, set the sampleRate bits to 0.
 	if (settings.accel.enabled)
 	{
-		tempRegValue |= (settings.accel.sampleRate & 0x07) << 5;
+		tempRegValue = LSM9DS1_set_ODR_XL(tempRegValue, settings.accel.sampleRate);
 	}
 	switch (settings.accel.scale)
 	{
 		case 4:
-			tempRegValue |= (0x2 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x2);
 			break;
 		case 8:
-			tempRegValue |= (0x3 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x3);
 			break;
 		case 16:
-			tempRegValue |= (0x1 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x1);
 			break;
-		// Otherwise it'll be set to 2g (0x0 << 3)
+		// Otherwise it'll be set to 2g (0x0)
 	}
 	if (settings.accel.bandwidth >= 0)
 	{
-		tempRegValue |= (1<<2); // Set BW_SCAL_ODR
-		tempRegValue |= (settings.accel.bandwidth & 0x03);
+		tempRegValue = LSM9DS1_set_BW_SCAL_ODR(tempRegValue, 1);
+		tempRegValue = LSM9DS1_set_BW_XL(tempRegValue, settings.accel.bandwidth);
 	}
 	LSM9DS1_xgWriteByte(CTRL_REG6_XL, tempRegValue);
 	
@@ -374,8 +395,8 @@ void LSM9DS1_initAccel()
 	tempRegValue = 0;
 	if (settings.accel.highResEnable)
 	{
-		tempRegValue |= (1<<7); // Set HR bit
-		tempRegValue |= (settings.accel.highResBandwidth & 0x3) << 5;
+		tempRegValue = LSM9DS1_set_HR(tempRegValue, 1);
+		tempRegValue = LSM9DS1_set_DCF(tempRegValue, settings.accel.highResBandwidth);
 	}
 	LSM9DS1_xgWriteByte(CTRL_REG7_XL, tempRegValue);
 }
@@ -480,9 +501,9 @@ void LSM9DS1_initMag()
 	//	10: high performance, 11:ultra-high performance
 	// DO[2:0] - Output data rate selection
 	// ST - Self-test enable
-	if (settings.mag.tempCompensationEnable) tempRegValue |= (1<<7);
-	tempRegValue |= (settings.mag.XYPerformance & 0x3) << 5;
-	tempRegValue |= (settings.mag.sampleRate & 0x7) << 2;
+	if (settings.mag.tempCompensationEnable) tempRegValue = LSM9DS1_set_TEMP_COMP(tempRegValue, 1);
+	tempRegValue = LSM9DS1_set_OM(tempRegValue, settings.mag.XYPerformance);
+	tempRegValue = LSM9DS1_set_DO(tempRegValue, settings.mag.sampleRate);
 	LSM9DS1_mWriteByte(CTRL_REG1_M, tempRegValue);
 	
 	// CTRL_REG2_M (Default value 0x00)
@@ -494,13 +515,13 @@ void LSM9DS1_initMag()
 	switch (settings.mag.scale)
 	{
 	case 8:
-		tempRegValue |= (0x1 << 5);
+		tempRegValue = LSM9DS1_set_FS_M(tempRegValue, 0x1);
 		break;
 	case 12:
-		tempRegValue |= (0x2 << 5);
+		tempRegValue = LSM9DS1_set_FS_M(tempRegValue, 0x2);
 		break;
 	case 16:
-		tempRegValue |= (0x3 << 5);
+		tempRegValue = LSM9DS1_set_FS_M(tempRegValue, 0x3);
 		break;
 	// Otherwise we'll default to 4 gauss (00)
 	}
@@ -515,8 +536,8 @@ void LSM9DS1_initMag()
 	//	00:continuous conversion, 01:single-conversion,
 	//  10,11: Power-down
 	tempRegValue = 0;
-	if (settings.mag.lowPowerEnable) tempRegValue |= (1<<5);
-	tempRegValue |= (settings.mag.operatingMode & 0x3);
+	if (settings.mag.lowPowerEnable) tempRegValue = LSM9DS1_set_LP(tempRegValue, 1);
+	tempRegValue = LSM9DS1_set_MD(tempRegValue, settings.mag.operatingMode);
 	LSM9DS1_mWriteByte(CTRL_REG3_M, tempRegValue); // Continuous conversion mode
 	
 	// CTRL_REG4_M (Default value: 0x00)
@@ -526,7 +547,7 @@ void LSM9DS1_initMag()
 	//	10:high performance, 10:ultra-high performance
 	// BLE - Big/little endian data
 	tempRegValue = 0;
-	tempRegValue = (settings.mag.ZPerformance & 0x3) << 2;
+	tempRegValue = LSM9DS1_set_OMZ(tempRegValue, settings.mag.ZPerformance);
 	LSM9DS1_mWriteByte(CTRL_REG4_M, tempRegValue);
 	
 	// CTRL_REG5_M (Default value: 0x00)
@@ -620,6 +641,48 @@ int16_t LSM9DS1_readMagAxis(lsm9ds1_axis axis)
 	return 0;
 }
 
+// Single conversion time per operating mode (low-power, medium, high and
+// ultra-high performance): the inverse of the fastest ODR each mode
+// supports, plus 25 %.
+static const uint16_t magConversion_us[4] = {1250, 2250, 4200, 8100};
+
+uint32_t LSM9DS1_magConversionUs()
+{
+	uint8_t mode = settings.mag.XYPerformance & 0x03;
+
+	if ((settings.mag.ZPerformance & 0x03) > mode)
+		mode = settings.mag.ZPerformance & 0x03;
+	if (settings.mag.lowPowerEnable)
+		mode = 0;
+	return magConversion_us[mode];
+}
+
+uint32_t LSM9DS1_magTrigger()
+{
+	uint8_t tempRegValue = 0;
+
+	// Same CTRL_REG3_M as initMag(), mode forced to single-conversion
+	if (settings.mag.lowPowerEnable) tempRegValue = LSM9DS1_set_LP(tempRegValue, 1);
+	tempRegValue = LSM9DS1_set_MD(tempRegValue, 0x1);
+	LSM9DS1_mWriteByte(CTRL_REG3_M, tempRegValue);
+
+	return LSM9DS1_magConversionUs();
+}
+
+bool LSM9DS1_magCollect(int16_t *mx, int16_t *my, int16_t *mz)
+{
+	uint8_t temp[7]; // STATUS_REG_M, then OUT_X_L_M..OUT_Z_H_M
+
+	if (LSM9DS1_mReadBytes(STATUS_REG_M | 0x80, temp, 7) != 7)
+		return false;
+	if (!LSM9DS1_get_ZYXDA(temp[0]))
+		return false;
+	*mx = (temp[2] << 8) | temp[1];
+	*my = (temp[4] << 8) | temp[3];
+	*mz = (temp[6] << 8) | temp[5];
+	return true;
+}
+
 int16_t LSM9DS1_readTemp()
 {
     int16_t temperature;
@@ -668,6 +731,164 @@ int16_t LSM9DS1_readGyroAxis(lsm9ds1_axis axis)
 	return 0;
 }
 
+// Plan buffer: worst case 0x15..0x1D and 0x28..0x2D on XG, 6 mag bytes,
+// plus the check spans.
+#define PLAN_BUFFER_BYTES	40
+
+// First register of each channel, in lsm9ds1_channel order. Within a slave
+// the channels are listed by increasing address.
+static const uint8_t channelRegister[CH_COUNT] = {
+	OUT_TEMP_L,
+	OUT_X_L_G, OUT_Y_L_G, OUT_Z_L_G,
+	OUT_X_L_XL, OUT_Y_L_XL, OUT_Z_L_XL,
+	OUT_X_L_M, OUT_Y_L_M, OUT_Z_L_M
+};
+
+void LSM9DS1_planChannels(lsm9ds1_read_plan *plan, uint16_t channels,
+                          uint16_t transactionCost)
+{
+	// A new burst costs its address phase (I2C_SCHED_BusBits(0)) plus the
+	// caller's per-transaction overhead; a bridged byte costs 9 bit times.
+	uint32_t newBurstCost = I2C_SCHED_BusBits(0) + transactionCost;
+	lsm9ds1_span *span;
+	uint8_t mag, reg, gap, ii;
+	int ch;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->channels = channels;
+
+	for (mag = 0; mag < 2; mag++)
+	{
+		span = NULL;
+		for (ch = 0; ch < CH_COUNT; ch++)
+		{
+			if (!(channels & LSM9DS1_CH(ch)) || ((ch >= CH_MX) != mag))
+				continue;
+			reg = channelRegister[ch];
+
+			if (span != NULL)
+			{
+				gap = reg - (span->subAddress + span->count);
+				// Bridge only over registers the map says are safe to read
+				if (LSM9DS1_canBurst(mag, span->subAddress + span->count, gap) &&
+				    (9UL * gap <= newBurstCost))
+					span->count = reg + 2 - span->subAddress;
+				else
+					span = NULL;
+			}
+			if (span == NULL)
+			{
+				span = &plan->spans[plan->spanCount++];
+				span->mag = mag;
+				span->subAddress = reg;
+				span->count = 2;
+				span->offset = plan->bytes;
+			}
+			plan->position[ch] = span->offset + (reg - span->subAddress);
+			plan->bytes = span->offset + span->count;
+		}
+	}
+
+	for (ii = 0; ii < plan->spanCount; ii++)
+		plan->busBits += I2C_SCHED_BusBits(plan->spans[ii].count);
+}
+
+bool LSM9DS1_planCheck(lsm9ds1_read_plan *plan, uint8_t mag,
+                       uint8_t subAddress, uint8_t count)
+{
+	lsm9ds1_span *span;
+
+	if ((plan->spanCount >= LSM9DS1_MAX_SPANS) || (count == 0) ||
+	    (plan->bytes + count > PLAN_BUFFER_BYTES) ||
+	    !LSM9DS1_canBurst(mag, subAddress, count))
+		return false;
+
+	if (plan->checkBytes == 0)
+		plan->checkOffset = plan->bytes;
+	span = &plan->spans[plan->spanCount++];
+	span->mag = mag;
+	span->subAddress = subAddress;
+	span->count = count;
+	span->offset = plan->bytes;
+	plan->bytes += count;
+	plan->checkBytes += count;
+	plan->busBits += I2C_SCHED_BusBits(count);
+	return true;
+}
+
+uint8_t LSM9DS1_readChannels(const lsm9ds1_read_plan *plan, int16_t *values)
+{
+	return LSM9DS1_readChannelsCheck(plan, values, NULL);
+}
+
+uint8_t LSM9DS1_readChannelsCheck(const lsm9ds1_read_plan *plan,
+                                  int16_t *values, uint8_t *check)
+{
+	uint8_t buffer[PLAN_BUFFER_BYTES];
+	I2C_IF_Segment segments[LSM9DS1_MAX_SPANS];
+	uint8_t subAddress[LSM9DS1_MAX_SPANS];
+	const lsm9ds1_span *span;
+	const uint8_t *raw;
+	uint8_t ii, got, first = 0;
+	int ch;
+
+	// Check spans go out first, so status registers (e.g. ZYXDA) are read
+	// before the data reads clear them
+	if (plan->checkBytes)
+		while ((first < plan->spanCount) && (plan->spans[first].offset < plan->checkOffset))
+			first++;
+
+	// MSB of the sub-address enables auto-increment on the magnetometer
+	if (settings.device.commInterface == IMU_MODE_I2C)
+	{
+		// All spans in one request, a single I2C_RDWR ioctl on Linux
+		for (ii = 0; ii < plan->spanCount; ii++)
+		{
+			span = &plan->spans[(first + ii) % plan->spanCount];
+			subAddress[ii] = span->mag ? (span->subAddress | 0x80) : span->subAddress;
+			segments[ii].ucDevAddr = span->mag ? _mAddress : _xgAddress;
+			segments[ii].pucWrData = &subAddress[ii];
+			segments[ii].ucWrLen = 1;
+			segments[ii].pucRdData = buffer + span->offset;
+			segments[ii].ucRdLen = span->count;
+		}
+		if (I2C_IF_ReadFromMulti(_i2cBus, segments, plan->spanCount) != 0)
+		{
+			DBG_PRINT("I2C readfrom failed\n");
+			return 0;
+		}
+	}
+	else
+	{
+		for (ii = 0; ii < plan->spanCount; ii++)
+		{
+			span = &plan->spans[(first + ii) % plan->spanCount];
+			if (span->mag)
+				got = LSM9DS1_mReadBytes(span->subAddress | 0x80, buffer + span->offset, span->count);
+			else
+				got = LSM9DS1_xgReadBytes(span->subAddress, buffer + span->offset, span->count);
+			if (got != span->count)
+				return 0;
+		}
+	}
+
+	for (ch = 0; ch < CH_COUNT; ch++)
+	{
+		if (!(plan->channels & LSM9DS1_CH(ch)))
+			continue;
+		raw = buffer + plan->position[ch];
+		values[ch] = (raw[1] << 8) | raw[0];
+		if (_autoCalc && (ch >= CH_GX) && (ch <= CH_GZ))
+			values[ch] -= gBiasRaw[ch - CH_GX];
+		else if (_autoCalc && (ch >= CH_AX) && (ch <= CH_AZ))
+			values[ch] -= aBiasRaw[ch - CH_AX];
+	}
+	if ((check != NULL) && plan->checkBytes)
+		memcpy(check, buffer + plan->checkOffset, plan->checkBytes);
+
+	return plan->spanCount;
+}
+
 float LSM9DS1_calcGyro(int16_t gyro)
 {
 	// Return the gyro raw reading times our pre-calculated DPS / (ADC tick):
@@ -690,19 +911,18 @@ void LSM9DS1_setGyroScale(uint16_t gScl)
 {
 	// Read current value of CTRL_REG1_G:
 	uint8_t ctrl1RegValue = LSM9DS1_xgReadByte(CTRL_REG1_G);
-	// Mask out scale bits (3 & 4):
-	ctrl1RegValue &= 0xE7;
 	switch (gScl)
 	{
 		case 500:
-			ctrl1RegValue |= (0x1 << 3);
+			ctrl1RegValue = LSM9DS1_set_FS_G(ctrl1RegValue, 0x1);
 			settings.gyro.scale = 500;
 			break;
 		case 2000:
-			ctrl1RegValue |= (0x3 << 3);
+			ctrl1RegValue = LSM9DS1_set_FS_G(ctrl1RegValue, 0x3);
 			settings.gyro.scale = 2000;
 			break;
-		default: // Otherwise we'll set it to 245 dps (0x0 << 4)
+		default: // Otherwise we'll set it to 245 dps (0x0)
+			ctrl1RegValue = LSM9DS1_set_FS_G(ctrl1RegValue, 0x0);
 			settings.gyro.scale = 245;
 			break;
 	}
@@ -715,24 +935,23 @@ void LSM9DS1_setAccelScale(uint8_t aScl)
 {
 	// We need to preserve the other bytes in CTRL_REG6_XL. So, first read it:
 	uint8_t tempRegValue = LSM9DS1_xgReadByte(CTRL_REG6_XL);
-	// Mask out accel scale bits:
-	tempRegValue &= 0xE7;
 	
 	switch (aScl)
 	{
 		case 4:
-			tempRegValue |= (0x2 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x2);
 			settings.accel.scale = 4;
 			break;
 		case 8:
-			tempRegValue |= (0x3 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x3);
 			settings.accel.scale = 8;
 			break;
 		case 16:
-			tempRegValue |= (0x1 << 3);
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x1);
 			settings.accel.scale = 16;
 			break;
-		default: // Otherwise it'll be set to 2g (0x0 << 3)
+		default: // Otherwise it'll be set to 2g (0x0)
+			tempRegValue = LSM9DS1_set_FS_XL(tempRegValue, 0x0);
 			settings.accel.scale = 2;
 			break;
 	}
@@ -746,24 +965,23 @@ void LSM9DS1_setMagScale(uint8_t mScl)
 {
 	// We need to preserve the other bytes in CTRL_REG6_XM. So, first read it:
 	uint8_t temp = LSM9DS1_mReadByte(CTRL_REG2_M);
-	// Then mask out the mag scale bits:
-	temp &= 0xFF^(0x3 << 5);
 	
 	switch (mScl)
 	{
 	case 8:
-		temp |= (0x1 << 5);
+		temp = LSM9DS1_set_FS_M(temp, 0x1);
 		settings.mag.scale = 8;
 		break;
 	case 12:
-		temp |= (0x2 << 5);
+		temp = LSM9DS1_set_FS_M(temp, 0x2);
 		settings.mag.scale = 12;
 		break;
 	case 16:
-		temp |= (0x3 << 5);
+		temp = LSM9DS1_set_FS_M(temp, 0x3);
 		settings.mag.scale = 16;
 		break;
 	default: // Otherwise we'll default to 4 gauss (00)
+		temp = LSM9DS1_set_FS_M(temp, 0x0);
 		settings.mag.scale = 4;
 		break;
 	}	
@@ -785,9 +1003,8 @@ void LSM9DS1_setGyroODR(uint8_t gRate)
 	{
 		// We need to preserve the other bytes in CTRL_REG1_G. So, first read it:
 		uint8_t temp = LSM9DS1_xgReadByte(CTRL_REG1_G);
-		// Then mask out the gyro ODR bits:
-		temp &= 0xFF^(0x7 << 5);
-		temp |= (gRate & 0x07) << 5;
+		// Then replace the gyro ODR bits:
+		temp = LSM9DS1_set_ODR_G(temp, gRate & 0x07);
 		// Update our settings struct
 		settings.gyro.sampleRate = gRate & 0x07;
 		// And write the new register value back into CTRL_REG1_G:
@@ -802,10 +1019,8 @@ void LSM9DS1_setAccelODR(uint8_t aRate)
 	{
 		// We need to preserve the other bytes in CTRL_REG1_XM. So, first read it:
 		uint8_t temp = LSM9DS1_xgReadByte(CTRL_REG6_XL);
-		// Then mask out the accel ODR bits:
-		temp &= 0x1F;
-		// Then shift in our new ODR bits:
-		temp |= ((aRate & 0x07) << 5);
+		// Then replace the accel ODR bits:
+		temp = LSM9DS1_set_ODR_XL(temp, aRate & 0x07);
 		settings.accel.sampleRate = aRate & 0x07;
 		// And write the new register value back into CTRL_REG1_XM:
 		LSM9DS1_xgWriteByte(CTRL_REG6_XL, temp);
@@ -816,10 +1031,8 @@ void LSM9DS1_setMagODR(uint8_t mRate)
 {
 	// We need to preserve the other bytes in CTRL_REG5_XM. So, first read it:
 	uint8_t temp = LSM9DS1_mReadByte(CTRL_REG1_M);
-	// Then mask out the mag ODR bits:
-	temp &= 0xFF^(0x7 << 2);
-	// Then shift in our new ODR bits:
-	temp |= ((mRate & 0x07) << 2);
+	// Then replace the mag ODR bits:
+	temp = LSM9DS1_set_DO(temp, mRate & 0x07);
 	settings.mag.sampleRate = mRate & 0x07;
 	// And write the new register value back into CTRL_REG5_XM:
 	LSM9DS1_mWriteByte(CTRL_REG1_M, temp);
@@ -1040,17 +1253,13 @@ uint8_t LSM9DS1_getMagIntSrc()
 void LSM9DS1_sleepGyro(bool enable) // default -> enable = true
 {
 	uint8_t temp = LSM9DS1_xgReadByte(CTRL_REG9);
-	if (enable) temp |= (1<<6);
-	else temp &= ~(1<<6);
-	LSM9DS1_xgWriteByte(CTRL_REG9, temp);
+	LSM9DS1_xgWriteByte(CTRL_REG9, LSM9DS1_set_SLEEP_G(temp, enable));
 }
 
 void LSM9DS1_enableFIFO(bool enable) // default -> enable = true
 {
 	uint8_t temp = LSM9DS1_xgReadByte(CTRL_REG9);
-	if (enable) temp |= (1<<1);
-	else temp &= ~(1<<1);
-	LSM9DS1_xgWriteByte(CTRL_REG9, temp);
+	LSM9DS1_xgWriteByte(CTRL_REG9, LSM9DS1_set_FIFO_EN(temp, enable));
 }
 
 void LSM9DS1_setFIFO(fifoMode_type fifoMode, uint8_t fifoThs)
@@ -1058,12 +1267,12 @@ void LSM9DS1_setFIFO(fifoMode_type fifoMode, uint8_t fifoThs)
 	// Limit threshold - 0x1F (31) is the maximum. If more than that was asked
 	// limit it to the maximum.
 	uint8_t threshold = fifoThs <= 0x1F ? fifoThs : 0x1F;
-	LSM9DS1_xgWriteByte(FIFO_CTRL, ((fifoMode & 0x7) << 5) | (threshold & 0x1F));
+	LSM9DS1_xgWriteByte(FIFO_CTRL, LSM9DS1_set_FTH(LSM9DS1_set_FMODE(0, fifoMode), threshold));
 }
 
 uint8_t LSM9DS1_getFIFOSamples()
 {
-	return (LSM9DS1_xgReadByte(FIFO_SRC) & 0x3F);
+	return LSM9DS1_get_FSS(LSM9DS1_xgReadByte(FIFO_SRC));
 }
 
 void LSM9DS1_constrainScales()
@@ -1107,6 +1316,22 @@ void LSM9DS1_mWriteByte(uint8_t subAddress, uint8_t data)
 		return LSM9DS1_SPIwriteByte(_mAddress, subAddress, data);
 }
 
+uint8_t LSM9DS1_xgWriteBytes(uint8_t subAddress, const uint8_t * data, uint8_t count)
+{
+	// SPI writes are not implemented yet
+	if (settings.device.commInterface == IMU_MODE_I2C)
+		return LSM9DS1_I2CwriteBytes(_xgAddress, subAddress, data, count);
+	return 0;
+}
+
+uint8_t LSM9DS1_mWriteBytes(uint8_t subAddress, const uint8_t * data, uint8_t count)
+{
+	// MSB of the sub-address enables auto-increment on the magnetometer
+	if (settings.device.commInterface == IMU_MODE_I2C)
+		return LSM9DS1_I2CwriteBytes(_mAddress, subAddress | 0x80, data, count);
+	return 0;
+}
+
 uint8_t LSM9DS1_xgReadByte(uint8_t subAddress)
 {
 	// Whether we're using I2C or SPI, read a byte using the
@@ -1235,12 +1460,14 @@ void LSM9DS1_initI2C()
 	// Iinitializes i2c channel
 	int i = 1;
 
-    if(I2C_IF_Open(I2C_MASTER_MODE_STD) < 0)
+    _i2cBus = I2C_IF_Open(_i2cController, (settings.device.i2cSpeed > 100000) ?
+                          I2C_MASTER_MODE_FST : I2C_MASTER_MODE_STD);
+    if(_i2cBus == NULL)
     	while (i){
 
     	}
     
-    vTaskDelay(10);
+    OS_IF_Delay(OS_IF_MS_TO_TICKS(10));
 }
 
 void LSM9DS1_I2CwriteByte(uint8_t address, uint8_t subAddress, uint8_t data)
@@ -1255,7 +1482,7 @@ void LSM9DS1_I2CwriteByte(uint8_t address, uint8_t subAddress, uint8_t data)
     //
     // Initiate the I2C write
     //
-    if(I2C_IF_Write(address,ucData,2,1) != 0)
+    if(I2C_IF_Write(_i2cBus,address,ucData,2,1) != 0)
     {
         DBG_PRINT("I2C write failed\n\r");
     }
@@ -1263,13 +1490,30 @@ void LSM9DS1_I2CwriteByte(uint8_t address, uint8_t subAddress, uint8_t data)
 
 }
 
+uint8_t LSM9DS1_I2CwriteBytes(uint8_t address, uint8_t subAddress,
+                              const uint8_t * data, uint8_t count)
+{
+	uint8_t ucData[17];
+
+	if ((count == 0) || (count > sizeof(ucData) - 1))
+		return 0;
+	ucData[0] = subAddress;
+	memcpy(&ucData[1], data, count);
+	if(I2C_IF_Write(_i2cBus,address,ucData,count + 1,1) != 0)
+	{
+		DBG_PRINT("I2C write failed\n\r");
+		return 0;
+	}
+	return count;
+}
+
 uint8_t LSM9DS1_I2CreadByte(uint8_t address, uint8_t subAddress)
 {
 	uint8_t BlkData;
 	//
     // Invoke the readfrom I2C API to get the required bytes
     //
-    if(I2C_IF_ReadFrom(address, &subAddress, sizeof(uint8_t), &BlkData, sizeof(uint8_t)) != 0)
+    if(I2C_IF_ReadFrom(_i2cBus, address, &subAddress, sizeof(uint8_t), &BlkData, sizeof(uint8_t)) != 0)
     {
         DBG_PRINT("I2C readfrom failed\n");
     }
@@ -1283,11 +1527,11 @@ uint8_t LSM9DS1_I2CreadBytes(uint8_t address, uint8_t subAddress, uint8_t * dest
 	//
     // Invoke the readfrom I2C API to get the required bytes
     //
-    if(I2C_IF_ReadFrom(address, &subAddress, 1, dest, count) != 0)
+    if(I2C_IF_ReadFrom(_i2cBus, address, &subAddress, 1, dest, count) != 0)
     {
         DBG_PRINT("I2C readfrom failed\n");
+        return 0;
     }
-    else {/* error code not implemented */}
 
     return count;
 }
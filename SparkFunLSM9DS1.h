@@ -32,17 +32,14 @@ Distributed as-is; no warranty is given.
     #include <stdio.h>
     #include <math.h>
     #include "drivers/i2c_if.h"
-    #include "utils/uartstdio.h"
-
-
-    //Include FreeRTOS
-    #include "FreeRTOS.h"
-    #include "task.h"
-    #include "semphr.h"
-    #include "queue.h"
-    #include "portmacro.h"
+    #include "drivers/os_if.h"
 
+#ifdef OS_IF_POSIX
+    #define DBG_PRINT               printf
+#else
+    #include "utils/uartstdio.h"
     #define DBG_PRINT               UARTprintf
+#endif
 
     #define LSM9DS1_AG_ADDR(sa0)	((sa0) == 0 ? 0x6A : 0x6B)
     #define LSM9DS1_M_ADDR(sa1)		((sa1) == 0 ? 0x1C : 0x1E)
@@ -54,11 +51,63 @@ Distributed as-is; no warranty is given.
         ALL_AXIS
     } lsm9ds1_axis;
 
+    // Output channels for readChannels(). Build a set with LSM9DS1_CH().
+    typedef enum lsm9ds1_channel {
+        CH_TEMP,
+        CH_GX, CH_GY, CH_GZ,
+        CH_AX, CH_AY, CH_AZ,
+        CH_MX, CH_MY, CH_MZ,
+        CH_COUNT
+    } lsm9ds1_channel;
+
+    #define LSM9DS1_CH(channel)     (1u << (channel))
+    #define LSM9DS1_CH_GYRO         (LSM9DS1_CH(CH_GX) | LSM9DS1_CH(CH_GY) | LSM9DS1_CH(CH_GZ))
+    #define LSM9DS1_CH_ACCEL        (LSM9DS1_CH(CH_AX) | LSM9DS1_CH(CH_AY) | LSM9DS1_CH(CH_AZ))
+    #define LSM9DS1_CH_MAG          (LSM9DS1_CH(CH_MX) | LSM9DS1_CH(CH_MY) | LSM9DS1_CH(CH_MZ))
+
+    // A read plan never needs more spans than this: temperature, gyro and
+    // accel on the accel/gyro slave, one span on the magnetometer, and one
+    // check span per slave added by planCheck().
+    #define LSM9DS1_MAX_SPANS       6
+
+    typedef struct
+    {
+        uint8_t mag;            // 0: accel/gyro slave, 1: magnetometer slave
+        uint8_t subAddress;     // first register of the burst
+        uint8_t count;          // bytes to read
+        uint8_t offset;         // where the burst lands in the plan buffer
+    } lsm9ds1_span;
+
+    typedef struct
+    {
+        uint16_t channels;      // LSM9DS1_CH() set the plan reads
+        uint8_t spanCount;
+        lsm9ds1_span spans[LSM9DS1_MAX_SPANS];
+        uint8_t position[CH_COUNT]; // buffer offset of each channel's low byte
+        uint8_t bytes;          // total bytes read, bridged gaps included
+        uint16_t busBits;       // bus bit times per readChannels() call
+        uint8_t checkOffset;    // buffer offset of the check bytes
+        uint8_t checkBytes;     // bytes read by check spans, after the data
+    } lsm9ds1_read_plan;
+
     bool LSM9DS1_isConnected();
     void LSM9DS1_set_mAddress(uint8_t i_mAddress);  //magnetometer address
     void LSM9DS1_set_xgAddress(uint8_t i_xgAddress); //acelerometer and gyro address
     bool LSM9DS1_is_autoCalc();
 
+    // getSettings() -- Access the IMUSettings used by begin(). Change them
+    // after init() and before begin() to customize the configuration.
+    IMUSettings * LSM9DS1_getSettings();
+
+    // setI2CController() -- Select the I2C controller (and pins) the sensor
+    // is wired to. Must be called before begin(). Defaults to I2C3 (PD0/PD1).
+    // Sensors on different controllers are serviced in parallel.
+    void LSM9DS1_setI2CController(const I2C_IF_Controller *controller);
+
+    // getI2CBus() -- Bus opened by begin(), so other drivers on the same
+    // wires can share it.
+    I2C_IF_Handle LSM9DS1_getI2CBus();
+
     // begin() -- Initialize the gyro, accelerometer, and magnetometer.
     // This will set up the scale and output rate of each sensor. The values set
     // in the IMUSettings struct will take effect after calling this function.
@@ -138,12 +187,67 @@ Distributed as-is; no warranty is given.
     //	A 16-bit signed integer with sensor data on requested axis.
     int16_t LSM9DS1_readMagAxis(lsm9ds1_axis axis);
 
+    // magConversionUs() -- Time a single magnetometer conversion takes with
+    // the current XY and Z performance modes, margin included.
+    uint32_t LSM9DS1_magConversionUs();
+
+    // magTrigger() -- Start one magnetometer conversion (CTRL_REG3_M MD =
+    // single-conversion). The magnetometer powers down again once the
+    // result is in the output registers. Use with mag.operatingMode = 1 so
+    // initMag() does not leave it converting continuously.
+    // Output: magConversionUs(), the time until the result is ready.
+    uint32_t LSM9DS1_magTrigger();
+
+    // magCollect() -- Read STATUS_REG_M and the mag outputs in one burst.
+    // Output: true if a new sample was ready (ZYXDA) and stored. To collect
+    // it together with accel/gyro data instead, add
+    // LSM9DS1_planCheck(plan, 1, STATUS_REG_M, 1) to a plan that reads
+    // LSM9DS1_CH_MAG and test ZYXDA in the check byte.
+    bool LSM9DS1_magCollect(int16_t *mx, int16_t *my, int16_t *mz);
+
     // readTemp() -- Read the temperature output register.
     // This function will read two temperature output registers.
     // The combined readings are stored in the class' temperature variables. Read
     // those _after_ calling readTemp().
     int16_t LSM9DS1_readTemp();
 
+    // planChannels() -- Precompute the bursts that read a set of channels.
+    // Registers wanted on the same slave are merged into one burst when
+    // reading the unwanted bytes between them is cheaper than a new address
+    // phase; bursts never cover registers LSM9DS1_canBurst() rejects
+    // (reserved, or clear-on-read like INT_GEN_SRC_XL).
+    // Input:
+    //	- plan = Plan to fill, reused by every readChannels() call.
+    //	- channels = LSM9DS1_CH() set, e.g. LSM9DS1_CH(CH_GZ) | LSM9DS1_CH(CH_AX).
+    //	- transactionCost = Extra cost of a transaction, in bus bit times, on
+    //	  top of its address phase (interrupt and task wake-up overhead).
+    //	  Large values give at most one burst per slave.
+    void LSM9DS1_planChannels(lsm9ds1_read_plan *plan, uint16_t channels,
+                              uint16_t transactionCost);
+
+    // readChannels() -- Run a plan made by planChannels(). Over I2C all the
+    // bursts go out in one I2C_IF_ReadFromMulti() request.
+    // Input:
+    //	- values = CH_COUNT entries; the planned ones get the raw reading
+    //	  (bias-corrected like readGyroAxis()/readAccelAxis() when autoCalc
+    //	  is on), the others are left untouched.
+    // Output: Number of transactions issued, 0 if the bus request failed.
+    uint8_t LSM9DS1_readChannels(const lsm9ds1_read_plan *plan, int16_t *values);
+
+    // planCheck() -- Append a span that reads count registers from
+    // subAddress along with the plan's channels, in the same request. Used
+    // to watch configuration registers at no extra transaction on Linux.
+    // Call after planChannels(). Output: false if the plan is full or the
+    // registers cannot be read in one burst.
+    bool LSM9DS1_planCheck(lsm9ds1_read_plan *plan, uint8_t mag,
+                           uint8_t subAddress, uint8_t count);
+
+    // readChannelsCheck() -- readChannels(), also copying the bytes read by
+    // the check spans, in planCheck() order, to check (plan->checkBytes).
+    // The check spans are read ahead of the data spans in the request.
+    uint8_t LSM9DS1_readChannelsCheck(const lsm9ds1_read_plan *plan,
+                                      int16_t *values, uint8_t *check);
+
     // calcGyro() -- Convert from RAW signed 16-bit value to degrees per second
     // This function reads in a signed 16-bit value and returns the scaled
     // DPS. This function relies on gScale and gRes being correct.
@@ -374,8 +478,8 @@ Distributed as-is; no warranty is given.
     // 	- * dest = A pointer to an array of uint8_t's. Values read will be
     //		stored in here on return.
     //	- count = The number of bytes to be read.
-    // Output: No value is returned, but the `dest` array will store
-    // 	the data read upon exit.
+    // Output: count, with the data read stored in the `dest` array, or 0
+    // 	if the bus transaction failed.
     uint8_t LSM9DS1_mReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count);
 
     // gWriteByte() -- Write a byte to a register in the gyroscope.
@@ -384,6 +488,11 @@ Distributed as-is; no warranty is given.
     //	- data = data to be written to the register.
     void LSM9DS1_mWriteByte(uint8_t subAddress, uint8_t data);
 
+    // mWriteBytes() -- Write count consecutive registers of the magnetometer
+    // in one auto-increment burst (count <= 16).
+    // Output: count, or 0 if the slave did not acknowledge.
+    uint8_t LSM9DS1_mWriteBytes(uint8_t subAddress, const uint8_t * data, uint8_t count);
+
     // xmReadByte() -- Read a byte from a register in the accel/mag sensor
     // Input:
     //	- subAddress = Register to be read from.
@@ -398,8 +507,8 @@ Distributed as-is; no warranty is given.
     // 	- * dest = A pointer to an array of uint8_t's. Values read will be
     //		stored in here on return.
     //	- count = The number of bytes to be read.
-    // Output: No value is returned, but the `dest` array will store
-    // 	the data read upon exit.
+    // Output: count, with the data read stored in the `dest` array, or 0
+    // 	if the bus transaction failed.
     uint8_t LSM9DS1_xgReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count);
 
     // xmWriteByte() -- Write a byte to a register in the accel/mag sensor.
@@ -408,6 +517,12 @@ Distributed as-is; no warranty is given.
     //	- data = data to be written to the register.
     void LSM9DS1_xgWriteByte(uint8_t subAddress, uint8_t data);
 
+    // xgWriteBytes() -- Write count consecutive registers of the accel/gyro
+    // in one burst (count <= 16). Relies on CTRL_REG8 IF_ADD_INC, which is
+    // set after reset.
+    // Output: count, or 0 if the slave did not acknowledge.
+    uint8_t LSM9DS1_xgWriteBytes(uint8_t subAddress, const uint8_t * data, uint8_t count);
+
     // calcgRes() -- Calculate the resolution of the gyroscope.
     // This function will set the value of the gRes variable. gScale must
     // be set prior to calling this function.
@@ -483,14 +598,20 @@ Distributed as-is; no warranty is given.
     //	- The byte read from the requested address.
     uint8_t LSM9DS1_I2CreadByte(uint8_t address, uint8_t subAddress);
 
+    // I2CwriteBytes() -- Write a series of registers, starting at subAddress,
+    // in one I2C transaction.
+    // Output: count, or 0 if the write failed.
+    uint8_t LSM9DS1_I2CwriteBytes(uint8_t address, uint8_t subAddress,
+                                  const uint8_t * data, uint8_t count);
+
     // I2CreadBytes() -- Read a series of bytes, starting at a register via SPI
     // Input:
     //	- address = The 7-bit I2C address of the slave device.
     //	- subAddress = The register to begin reading.
     // 	- * dest = Pointer to an array where we'll store the readings.
     //	- count = Number of registers to be read.
-    // Output: No value is returned by the function, but the registers read are
-    // 		all stored in the *dest array given.
+    // Output: count, with the registers read stored in the *dest array
+    //		given, or 0 if the bus transaction failed.
     uint8_t LSM9DS1_I2CreadBytes(uint8_t address, uint8_t subAddress, uint8_t * dest, uint8_t count);
 
 
@@ -40,9 +40,17 @@
 // Para mejorar la eficiencia gestion del bus I2C aprovechando el RTOS se utilizan los siguientes mecanismos:
 // -> Las transacciones I2C las realiza una rutina de interrupci�n
 // -> Las funciones I2C_IF_Read, I2C_IF_ReadFrom e I2C_IF_Write envian los datos de la transaccion a realizar mediante una cola de mensaje.
+//    (2019: sustituida por un anillo sin cerrojos de punteros a descriptores de un pool estatico, ver I2CRingPush)
 // -> La ISR va procesando las peticiones de transaccion/realizando nuevas transacciones. Cuando finaliza cada transaccion utiliza las DirectToTaskNotification para desbloquear la tarea.
 // Se mantiene la compatibilidad hacia atras, por eso las funciones de las bibliotecas bma222drv.c y tmp000drv.c no hay que cambiarlas.
 
+//2019. Varios controladores I2C en paralelo: cada I2C_IF_Open devuelve una instancia de bus con su propia ISR, anillo y pines.
+//2019. Sin RTOS: los servicios del kernel pasan por os_if.h. Con OS_IF_BAREMETAL la notificacion es una palabra de bits que
+//      activa la ISR y espera el bucle principal (WFI), y las llamadas asincronas pueden avisar con un flag (I2C_IF_SetFlag).
+
+//2019. Con I2C_IF_TRACE la ISR entrega cada transaccion terminada a i2c_trace.c, con marca de tiempo CYCCNT (I2C_IF_TRACE_HZ).
+//      La sub-direccion de las lecturas se guarda al enviar, porque los datos leidos la sobrescriben (hasta I2C_TRACE_MAX_WR bytes).
+
 //2018. Adaptado de la CC3200 a la TIVA.
 // --> La TIVA no tiene flag de interrupcion por error y otras causas (NACK), hay que tratarlo de otra manera (Mediante una funcion que comrprueba si ha habido error).
 // --> Arreglado un fallo por el cual no saltaba la notificaci�n directa a tarea en el caso de este error.
@@ -51,6 +59,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "inc/hw_i2c.h"
 #include "inc/hw_memmap.h"
@@ -65,33 +74,50 @@
 #include "driverlib/rom_map.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/gpio.h"
+#include "driverlib/pin_map.h"
 
 // Common interface include
 #include "i2c_if.h"
+#ifdef I2C_IF_TRACE
+#include "i2c_trace.h"
+#endif
 
-//Include FreeRTOS
-#include "FreeRTOS.h"
-#include "task.h"
-#include "semphr.h"
-#include "queue.h"
-#include "portmacro.h"
+//FreeRTOS, or the bare-metal replacement if OS_IF_BAREMETAL is defined
+#include "os_if.h"
 
 
 typedef struct {
-	TaskHandle_t OriginTask;	/* Tarea que origina la peticion */
+	OS_IF_Task OriginTask;	/* Tarea que origina la peticion */
 	uint8_t *buffer;	/* puntero a los datos TX/RX */
 	uint8_t rxlenght;	/* longitud a recibir */
 	uint8_t txlenght;	/* longitud a transmitir */
 	uint8_t command;	/* comando */
 	uint8_t dev_address; /* direccion I2C */
+	I2C_IF_Callback pfnDone;	/* NULL: notificar a OriginTask. Si no, se llama desde la ISR */
+	void *pvArg;	/* argumento de pfnDone */
+#ifdef I2C_IF_PROFILE
+	uint32_t submitcycles;	/* CYCCNT when the descriptor was published */
+#endif
+#ifdef I2C_IF_TRACE
+	uint8_t tracewr[I2C_TRACE_MAX_WR];	/* sub-direccion de READ_FROM, el buffer la pierde al leer */
+	uint8_t tracewrlen;	/* txlenght y rxlenght al publicar, la ISR los descuenta */
+	uint8_t tracerdlen;
+#endif
 } I2C_Transaction;
 
+//Celda del anillo de envio. sequence indica a productores y consumidor de quien es el turno
+typedef struct {
+	volatile uint32_t sequence;
+	I2C_Transaction *transaction;
+} I2C_RingCell;
+
+
 
 
 //*****************************************************************************
 //                      MACRO DEFINITIONS
 //*****************************************************************************
-#define SYS_CLK                 configCPU_CLOCK_HZ
+#define SYS_CLK                 OS_IF_CPU_CLOCK_HZ
 #define FAILURE                 -1
 #define SUCCESS                 0
 #define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
@@ -111,31 +137,95 @@ typedef struct {
 #define I2C_COMMAND_READ 1
 #define I2C_COMMAND_READ_FROM 2
 
-//Numero maximo de ordenes de transaccion que se pueden acumular en la cola
+//Numero maximo de ordenes de transaccion que se pueden acumular en el anillo.
+//Must be a power of two no greater than 32 (the pool is tracked with a 32 bit mask)
 #define MAX_I2C_TRANSACTIONS 16
+#define I2C_RING_MASK (MAX_I2C_TRANSACTIONS-1)
 
 //Flags para las DirectToTaskNotifications
 #define I2C_NOTIFY_READ_COMPLETE (0x01)
 #define I2C_NOTIFY_WRITE_COMPLETE (0x02)
 #define I2C_NOTIFY_ERR (0x04)
 
+//
+// Lock-free primitives. They compile to LDREX/STREX on the Cortex-M4, so
+// tasks of any priority may submit concurrently with each other and with
+// the ISR without entering a kernel critical section.
+//
+#define I2C_ATOMIC_LOAD(p)          __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define I2C_ATOMIC_STORE(p, v)      __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define I2C_ATOMIC_CAS(p, pexp, v)  __atomic_compare_exchange_n((p), (pexp), (v), false, \
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define I2C_ATOMIC_OR(p, v)         __atomic_fetch_or((p), (v), __ATOMIC_RELEASE)
+#define I2C_MEMORY_BARRIER()        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(I2C_IF_PROFILE) || defined(I2C_IF_TRACE)
+//
+// Data Watchpoint and Trace cycle counter, used to measure the CPU cost of
+// each transaction (submission path plus every ISR entry) and to time-stamp
+// the bus trace. Host builds (tools/tm4c_host) provide their own counter.
+//
+#ifndef DWT_CYCCNT
+#define DWT_CTRL                (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT              (*(volatile uint32_t *)0xE0001004)
+#define DEM_CR                  (*(volatile uint32_t *)0xE000EDFC)
+#define DEM_CR_TRCENA           (1UL << 24)
+#define DWT_CTRL_CYCCNTENA      (1UL << 0)
+#endif
+#define I2C_CYCLES()            DWT_CYCCNT
+#endif
+
+
+//Estado de un controlador I2C (lo que antes eran variables globales del modulo)
+struct I2C_IF_Bus {
+	const I2C_IF_Controller *psController;	/* perifericos, ISR y pines del bus */
+	unsigned int refcount;	/* numero de I2C_IF_Open sin su I2C_IF_Close */
+
+	//Controla los estados que atraviesa la ISR mientras se va realizando la transaccion
+	//De esta forma cada vez que salta la ISR se ejecuta un comportamiento que depende de su estado
+	volatile uint16_t isrstate;
+	uint8_t *tmpptr;	/* siguiente byte a enviar/recibir, mantiene su valor entre ISRs */
+
+	//Pool estatico de descriptores. Un bit a 1 en poolfree indica descriptor libre
+	I2C_Transaction pool[MAX_I2C_TRANSACTIONS];
+	volatile uint32_t poolfree;
+
+	//Anillo MPSC de punteros a descriptor. Productores: tareas. Consumidor: la ISR
+	I2C_RingCell ring[MAX_I2C_TRANSACTIONS];
+	volatile uint32_t ringhead;	/* siguiente posicion a reservar (productores) */
+	uint32_t ringtail;			/* siguiente posicion a consumir (solo la ISR) */
+
+	//Descriptor en curso. Solo lo toca la ISR
+	I2C_Transaction *active;
+
+	//Timbre: 1 mientras el motor de la ISR tenga trabajo. Solo quien lo pasa de 0 a 1 dispara la ISR
+	volatile uint32_t doorbell;
+
+#ifdef I2C_IF_PROFILE
+	I2C_IF_Profile profile;
+#endif
+};
+
 
 //****************************************************************************
 //                      LOCAL FUNCTION DEFINITIONS                          
 //****************************************************************************
-static int I2CTransact(unsigned long ulCmd);
+static int I2CTransact(struct I2C_IF_Bus *psBus, unsigned long ulCmd);
+static int I2CSubmit(struct I2C_IF_Bus *psBus, I2C_Transaction *psTransaction, uint32_t ulDoneMask);
+static void I2CFinishFromISR(struct I2C_IF_Bus *psBus, uint32_t ulNotify, OS_IF_ISRState *pxHigherPriorityTaskWoken);
+static void I2CBusISR(struct I2C_IF_Bus *psBus);
 
 
-//Controla los estados que atraviesa la ISR mientras se va realizando la transaccion
-//De esta forma cada vez que salta la ISR se ejecuta un comportamiento que depende de su estado
-static volatile uint16_t g_i2cisrstate=STATE_IDLE;
-static QueueHandle_t g_I2Cqueue;
+//Una instancia por controlador I2C. Cada una tiene su propia maquina de estados de ISR,
+//su pool de descriptores y su anillo, de forma que los buses trabajan en paralelo.
+static struct I2C_IF_Bus g_sI2CBus[I2C_IF_MAX_BUSES];
 
 
 //****************************************************************************
 //
 //! Invokes the transaction over I2C
 //!
+//! \param psBus is the bus whose controller runs the command
 //! \param ulCmd is the command to be executed over I2C
 //! 
 //! This function works in a polling mode,
@@ -148,39 +238,39 @@ static QueueHandle_t g_I2Cqueue;
 //
 //****************************************************************************
 static int 
-I2CTransact(unsigned long ulCmd)
+I2CTransact(struct I2C_IF_Bus *psBus, unsigned long ulCmd)
 {
     //
     // Clear all interrupts
     //
-    MAP_I2CMasterIntClearEx(I2C3_BASE,MAP_I2CMasterIntStatusEx(I2C3_BASE,false));
+    MAP_I2CMasterIntClearEx(psBus->psController->ulBase,MAP_I2CMasterIntStatusEx(psBus->psController->ulBase,false));
     //
     // Set the time-out. Not to be used with breakpoints.
     //
-    MAP_I2CMasterTimeoutSet(I2C3_BASE, I2C_TIMEOUT_VAL);
+    MAP_I2CMasterTimeoutSet(psBus->psController->ulBase, I2C_TIMEOUT_VAL);
     //
     // Initiate the transfer.
     //
-    MAP_I2CMasterControl(I2C3_BASE, ulCmd);
+    MAP_I2CMasterControl(psBus->psController->ulBase, ulCmd);
 
 
     //
     // Check for any errors in transfer
     //
-    if(MAP_I2CMasterErr(I2C3_BASE) != I2C_MASTER_ERR_NONE)
+    if(MAP_I2CMasterErr(psBus->psController->ulBase) != I2C_MASTER_ERR_NONE)
     {
         switch(ulCmd)
         {
         case I2C_MASTER_CMD_BURST_SEND_START:
         case I2C_MASTER_CMD_BURST_SEND_CONT:
         case I2C_MASTER_CMD_BURST_SEND_STOP:
-            MAP_I2CMasterControl(I2C3_BASE,
+            MAP_I2CMasterControl(psBus->psController->ulBase,
                          I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
             break;
         case I2C_MASTER_CMD_BURST_RECEIVE_START:
         case I2C_MASTER_CMD_BURST_RECEIVE_CONT:
         case I2C_MASTER_CMD_BURST_RECEIVE_FINISH:
-            MAP_I2CMasterControl(I2C3_BASE,
+            MAP_I2CMasterControl(psBus->psController->ulBase,
                          I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP);
             break;
         default:
@@ -192,10 +282,237 @@ I2CTransact(unsigned long ulCmd)
     return SUCCESS;
 }
 
+//****************************************************************************
+//
+//! Takes a free transaction descriptor from the static pool
+//!
+//! Lock-free: the lowest free bit of psBus->poolfree is claimed with a
+//! compare-and-swap, retrying if another task got there first.
+//!
+//! \return pointer to the descriptor, or NULL if the pool is exhausted.
+//
+//****************************************************************************
+static I2C_Transaction *
+I2CPoolAlloc(struct I2C_IF_Bus *psBus)
+{
+	uint32_t ulFree, ulBit;
+
+	ulFree=I2C_ATOMIC_LOAD(&psBus->poolfree);
+	do
+	{
+		if (ulFree==0) return NULL;
+		ulBit=ulFree&(~ulFree+1);	//bit libre mas bajo
+	} while (!I2C_ATOMIC_CAS(&psBus->poolfree,&ulFree,ulFree&~ulBit));
+
+	return &psBus->pool[__builtin_ctz(ulBit)];
+}
+
+static void
+I2CPoolRelease(struct I2C_IF_Bus *psBus, I2C_Transaction *psTransaction)
+{
+	I2C_ATOMIC_OR(&psBus->poolfree,1UL<<(psTransaction-psBus->pool));
+}
+
+//****************************************************************************
+//
+//! Publishes a descriptor in the MPSC ring (bounded Vyukov queue)
+//!
+//! A producer claims a position by advancing psBus->ringhead with a
+//! compare-and-swap, stores the pointer, then hands the cell to the ISR by
+//! bumping its sequence number. Every descriptor comes from the pool and the
+//! ring has as many cells as the pool, so a push never finds the ring full.
+//
+//****************************************************************************
+static void
+I2CRingPush(struct I2C_IF_Bus *psBus, I2C_Transaction *psTransaction)
+{
+	I2C_RingCell *psCell;
+	uint32_t ulPos=I2C_ATOMIC_LOAD(&psBus->ringhead);
+
+	for (;;)
+	{
+		psCell=&psBus->ring[ulPos&I2C_RING_MASK];
+		if ((int32_t)(I2C_ATOMIC_LOAD(&psCell->sequence)-ulPos)==0)
+		{
+			if (I2C_ATOMIC_CAS(&psBus->ringhead,&ulPos,ulPos+1))
+				break;	//posicion reservada
+		}
+		else
+		{
+			ulPos=I2C_ATOMIC_LOAD(&psBus->ringhead);
+		}
+	}
+
+	psCell->transaction=psTransaction;
+	I2C_ATOMIC_STORE(&psCell->sequence,ulPos+1);	//la celda pasa a la ISR
+}
+
+//Devuelve true si la siguiente celda del anillo ya esta publicada. Solo desde la ISR
+static bool
+I2CRingReady(struct I2C_IF_Bus *psBus)
+{
+	return I2C_ATOMIC_LOAD(&psBus->ring[psBus->ringtail&I2C_RING_MASK].sequence)==psBus->ringtail+1;
+}
+
+//Extrae el siguiente descriptor del anillo (NULL si no hay). Solo desde la ISR
+static I2C_Transaction *
+I2CRingPop(struct I2C_IF_Bus *psBus)
+{
+	I2C_RingCell *psCell=&psBus->ring[psBus->ringtail&I2C_RING_MASK];
+	I2C_Transaction *psTransaction;
+
+	if (!I2CRingReady(psBus)) return NULL;
+
+	psTransaction=psCell->transaction;
+	I2C_ATOMIC_STORE(&psCell->sequence,psBus->ringtail+MAX_I2C_TRANSACTIONS);	//libera la celda
+	psBus->ringtail++;
+
+	return psTransaction;
+}
+
+//****************************************************************************
+//
+//! Rings the doorbell after a descriptor has been published
+//!
+//! Only the caller that moves the doorbell from 0 to 1 triggers the ISR, so
+//! the engine is never kicked while it is in the middle of a transaction
+//! (which would be taken for a hardware interrupt and corrupt the transfer).
+//
+//****************************************************************************
+static void
+I2CDoorbellRing(struct I2C_IF_Bus *psBus)
+{
+	uint32_t ulIdle=0;
+
+	if (I2C_ATOMIC_CAS(&psBus->doorbell,&ulIdle,1))
+	{
+		IntPendSet(psBus->psController->ulInt);	//Produce un disparo software de la ISR (comienza a transmitir)....
+	}
+}
+
+//****************************************************************************
+//
+//! Called from the ISR once the active transaction is over. Re-triggers the
+//! engine if more descriptors are pending, otherwise releases the doorbell.
+//!
+//! The ring is checked again after the release: a producer that published
+//! between the first check and the release found the doorbell still at 1 and
+//! did not trigger the ISR, so the engine has to reclaim it itself.
+//
+//****************************************************************************
+static void
+I2CDoorbellRelease(struct I2C_IF_Bus *psBus)
+{
+	uint32_t ulIdle=0;
+
+	if (!I2CRingReady(psBus))
+	{
+		I2C_ATOMIC_STORE(&psBus->doorbell,0);
+		I2C_MEMORY_BARRIER();
+		if (!I2CRingReady(psBus) || !I2C_ATOMIC_CAS(&psBus->doorbell,&ulIdle,1))
+			return;
+	}
+	IntPendSet(psBus->psController->ulInt);
+}
+
+//****************************************************************************
+//
+//! Publishes a transaction and blocks the calling task until it is over
+//!
+//! \param psTransaction is the descriptor (taken from the pool) to submit
+//! \param ulDoneMask is the notification bit that signals completion
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+static int
+I2CSubmit(struct I2C_IF_Bus *psBus, I2C_Transaction *psTransaction, uint32_t ulDoneMask)
+{
+	uint32_t notifVal;
+
+	psTransaction->OriginTask=OS_IF_CurrentTask();
+	psTransaction->pfnDone=NULL;
+#ifdef I2C_IF_PROFILE
+	psTransaction->submitcycles=I2C_CYCLES();
+#endif
+#ifdef I2C_IF_TRACE
+	psTransaction->tracewrlen=psTransaction->txlenght;
+	psTransaction->tracerdlen=psTransaction->rxlenght;
+#endif
+
+	//Publica el descriptor y, si el motor estaba parado, lo arranca...
+	I2CRingPush(psBus,psTransaction);
+	I2CDoorbellRing(psBus);
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulSubmitCycles+=I2C_CYCLES()-psTransaction->submitcycles;
+#endif
+
+	//Espera a que se produzca la transacci�n (o haya error)...
+	notifVal=OS_IF_Wait(ulDoneMask|I2C_NOTIFY_ERR);
+
+	//La ISR ya no usa el descriptor
+	I2CPoolRelease(psBus,psTransaction);
+
+	if (notifVal&I2C_NOTIFY_ERR) return FAILURE;
+
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Publishes a transaction without waiting for it
+//!
+//! The descriptor goes back to the pool in the ISR, just before pfnDone is
+//! called, so the caller never blocks and needs no task of its own.
+//!
+//! \return 0: Success, < 0: Failure (descriptor pool exhausted).
+//
+//****************************************************************************
+static int
+I2CSubmitAsync(struct I2C_IF_Bus *psBus, I2C_Transaction *psTransaction,
+               I2C_IF_Callback pfnDone, void *pvArg)
+{
+	psTransaction->OriginTask=NULL;
+	psTransaction->pfnDone=pfnDone;
+	psTransaction->pvArg=pvArg;
+#ifdef I2C_IF_PROFILE
+	psTransaction->submitcycles=I2C_CYCLES();
+#endif
+#ifdef I2C_IF_TRACE
+	psTransaction->tracewrlen=psTransaction->txlenght;
+	psTransaction->tracerdlen=psTransaction->rxlenght;
+#endif
+
+	I2CRingPush(psBus,psTransaction);
+	I2CDoorbellRing(psBus);
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulSubmitCycles+=I2C_CYCLES()-psTransaction->submitcycles;
+#endif
+
+	return SUCCESS;
+}
+
+//Saca un descriptor del pool. Si esta agotado espera a que otra tarea libere uno
+static I2C_Transaction *
+I2CAlloc(struct I2C_IF_Bus *psBus)
+{
+	I2C_Transaction *psTransaction;
+
+	while ((psTransaction=I2CPoolAlloc(psBus))==NULL)
+	{
+		OS_IF_Delay(1);
+	}
+
+	return psTransaction;
+}
+
 //****************************************************************************
 //
 //! Invokes the I2C driver APIs to write to the specified address
 //!
+//! \param hBus is the bus returned by I2C_IF_Open
 //! \param ucDevAddr is the 7-bit I2C slave address
 //! \param pucData is the pointer to the data to be written
 //! \param ucLen is the length of data to be written
@@ -209,44 +526,28 @@ I2CTransact(unsigned long ulCmd)
 //
 //****************************************************************************
 int 
-I2C_IF_Write(unsigned char ucDevAddr,
+I2C_IF_Write(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
 		unsigned char *pucData,
 		unsigned char ucLen,
 		unsigned char ucStop)
 {
-	uint32_t notifVal=0;
-	I2C_Transaction transaction;
+	struct I2C_IF_Bus *psBus=hBus;
+	I2C_Transaction *transaction;
 
+	RETERR_IF_TRUE(psBus == NULL);
 	RETERR_IF_TRUE(pucData == NULL);
 	RETERR_IF_TRUE(ucLen == 0);
 	RETERR_IF_TRUE(ucStop == 0); //XXX quitar parametro ucStop!!
 
+	transaction=I2CAlloc(psBus);
+	transaction->buffer=pucData;
+	transaction->txlenght=ucLen;
+	transaction->rxlenght=0;
+	transaction->dev_address=ucDevAddr;
+	transaction->command=I2C_COMMAND_WRITE;
 
-	transaction.OriginTask=xTaskGetCurrentTaskHandle();
-	transaction.buffer=pucData;
-	transaction.txlenght=ucLen;
-	transaction.rxlenght=0;
-	transaction.dev_address=ucDevAddr;
-	transaction.command=I2C_COMMAND_WRITE;
-
-	//Envia la transaccion a la cola de mensajes...
-	xQueueSend(g_I2Cqueue,&transaction,portMAX_DELAY);
-
-	if (g_i2cisrstate==STATE_IDLE)
-	{
-		IntPendSet(INT_I2C3);	//Produce un disparo software de la ISR (comienza a transmitir)....
-	}
-
-	//Espera a que se produzca la transacci�n (o haya error)...
-	while (!(notifVal&(I2C_NOTIFY_WRITE_COMPLETE|I2C_NOTIFY_ERR)))
-	{
-		xTaskNotifyWait( 0, I2C_NOTIFY_WRITE_COMPLETE|I2C_NOTIFY_ERR, &notifVal, portMAX_DELAY);
-	}
-
-	if (notifVal&I2C_NOTIFY_ERR) return FAILURE;
-
-	return SUCCESS;
-
+	return I2CSubmit(psBus,transaction,I2C_NOTIFY_WRITE_COMPLETE);
 }
 
 //****************************************************************************
@@ -254,6 +555,7 @@ I2C_IF_Write(unsigned char ucDevAddr,
 //! Invokes the I2C driver APIs to read from the device. This assumes the 
 //! device local address to read from is set using the I2CWrite API.
 //!
+//! \param hBus is the bus returned by I2C_IF_Open
 //! \param ucDevAddr is the 7-bit I2C slave address
 //! \param pucData is the pointer to the read data to be placed
 //! \param ucLen is the length of data to be read
@@ -266,42 +568,26 @@ I2C_IF_Write(unsigned char ucDevAddr,
 //
 //****************************************************************************
 int 
-I2C_IF_Read(unsigned char ucDevAddr,
+I2C_IF_Read(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
 		unsigned char *pucData,
 		unsigned char ucLen)
 {
-	//unsigned long ulCmdID;
-	uint32_t notifVal=0;
-	I2C_Transaction transaction;
+	struct I2C_IF_Bus *psBus=hBus;
+	I2C_Transaction *transaction;
 
+	RETERR_IF_TRUE(psBus == NULL);
 	RETERR_IF_TRUE(pucData == NULL);
 	RETERR_IF_TRUE(ucLen == 0);
 
+	transaction=I2CAlloc(psBus);
+	transaction->buffer=pucData;
+	transaction->txlenght=0;
+	transaction->rxlenght=ucLen;
+	transaction->dev_address=ucDevAddr;
+	transaction->command=I2C_COMMAND_READ;
 
-	transaction.OriginTask=xTaskGetCurrentTaskHandle();
-	transaction.buffer=pucData;
-	transaction.txlenght=0;
-	transaction.rxlenght=ucLen;
-	transaction.dev_address=ucDevAddr;
-	transaction.command=I2C_COMMAND_READ;
-
-	xQueueSend(g_I2Cqueue,&transaction,portMAX_DELAY);
-
-	if (g_i2cisrstate==STATE_IDLE)
-	{
-		IntPendSet(INT_I2C3);	//Produce un disparo software (comienza a transmitir)....
-	}
-
-
-	//Espera a que se produzca la transacci�n (o haya error)...
-	while (!(notifVal&(I2C_NOTIFY_READ_COMPLETE|I2C_NOTIFY_ERR)))
-	{
-		xTaskNotifyWait( 0, I2C_NOTIFY_READ_COMPLETE|I2C_NOTIFY_ERR, &notifVal, portMAX_DELAY);
-	}
-
-	if (notifVal&I2C_NOTIFY_ERR) return FAILURE;
-
-	return SUCCESS;
+	return I2CSubmit(psBus,transaction,I2C_NOTIFY_READ_COMPLETE);
 }
 
 //****************************************************************************
@@ -310,6 +596,7 @@ I2C_IF_Read(unsigned char ucDevAddr,
 //! This assumes the device local address to be of 8-bit. For other 
 //! combinations use I2CWrite followed by I2CRead.
 //!
+//! \param hBus is the bus returned by I2C_IF_Open
 //! \param ucDevAddr is the 7-bit I2C slave address
 //! \param pucWrDataBuf is the pointer to the data to be written (reg addr)
 //! \param ucWrLen is the length of data to be written
@@ -324,49 +611,231 @@ I2C_IF_Read(unsigned char ucDevAddr,
 //
 //****************************************************************************
 int 
-I2C_IF_ReadFrom(unsigned char ucDevAddr,
+I2C_IF_ReadFrom(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
             unsigned char *pucWrDataBuf,
             unsigned char ucWrLen,
             unsigned char *pucRdDataBuf,
             unsigned char ucRdLen)
 {
-	I2C_Transaction transaction;
-	uint32_t notifVal=0;
-	volatile int i=0;
+	struct I2C_IF_Bus *psBus=hBus;
+	I2C_Transaction *transaction;
 
+	    RETERR_IF_TRUE(psBus == NULL);
 	    RETERR_IF_TRUE(pucRdDataBuf == NULL);
 	    RETERR_IF_TRUE(pucWrDataBuf == NULL);
 	    RETERR_IF_TRUE(ucWrLen == 0);
-	    RETERR_IF_TRUE(ucWrLen > ucWrLen);
+	    RETERR_IF_TRUE(ucWrLen > ucRdLen);	//la direccion viaja en el buffer de lectura
 
 	    memcpy(pucRdDataBuf,pucWrDataBuf,ucWrLen);
-	    transaction.OriginTask=xTaskGetCurrentTaskHandle();
-	    transaction.buffer=pucRdDataBuf;
-	    transaction.txlenght=ucWrLen;
-	    transaction.rxlenght=ucRdLen;
-	    transaction.dev_address=ucDevAddr;
-	    transaction.command=I2C_COMMAND_READ_FROM;
-
-	    xQueueSend(g_I2Cqueue,&transaction,portMAX_DELAY);
-
-	    if (g_i2cisrstate==STATE_IDLE)
-	    {
-	    	IntPendSet(INT_I2C3);	//Produce un disparo software....
-	    }
-
-	    //CEspera a que se complete la operacion de escritura/lectura o se produza error
-	    while (!(notifVal&(I2C_NOTIFY_READ_COMPLETE|I2C_NOTIFY_ERR)))
-	    {
-	    	xTaskNotifyWait( 0, I2C_NOTIFY_WRITE_COMPLETE|I2C_NOTIFY_READ_COMPLETE|I2C_NOTIFY_ERR, &notifVal, portMAX_DELAY);
-	    	i++;
-	    }
-
-	    if (notifVal&I2C_NOTIFY_ERR)
-	    {
-	        return FAILURE;
-	    }
+	    transaction=I2CAlloc(psBus);
+#ifdef I2C_IF_TRACE
+	    memcpy(transaction->tracewr,pucWrDataBuf,I2C_TRACE_WR_LEN(ucWrLen));
+#endif
+	    transaction->buffer=pucRdDataBuf;
+	    transaction->txlenght=ucWrLen;
+	    transaction->rxlenght=ucRdLen;
+	    transaction->dev_address=ucDevAddr;
+	    transaction->command=I2C_COMMAND_READ_FROM;
+
+	    //Espera a que se complete la operacion de escritura/lectura o se produza error
+	    return I2CSubmit(psBus,transaction,I2C_NOTIFY_READ_COMPLETE);
+}
 
-    return SUCCESS;
+//****************************************************************************
+//
+//! Several register reads in a row
+//!
+//! \param hBus is the bus returned by I2C_IF_Open
+//! \param psSegments are the reads, possibly from different slaves
+//! \param ucCount is the number of segments, at most I2C_IF_MAX_SEGMENTS
+//!
+//! Here every segment is an I2C_IF_ReadFrom of its own; the Linux backend
+//! issues them all in a single I2C_RDWR ioctl. All segments are attempted
+//! even if one fails.
+//!
+//! \return 0: Success, < 0: Failure of at least one segment.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromMulti(I2C_IF_Handle hBus,
+            const I2C_IF_Segment *psSegments,
+            unsigned char ucCount)
+{
+	int iRetVal=SUCCESS;
+	unsigned char i;
+
+	RETERR_IF_TRUE(psSegments == NULL);
+	RETERR_IF_TRUE(ucCount == 0 || ucCount > I2C_IF_MAX_SEGMENTS);
+
+	for (i=0; i<ucCount; i++)
+	{
+		if (I2C_IF_ReadFrom(hBus,psSegments[i].ucDevAddr,psSegments[i].pucWrData,psSegments[i].ucWrLen,
+		                    psSegments[i].pucRdData,psSegments[i].ucRdLen)!=SUCCESS)
+			iRetVal=FAILURE;
+	}
+
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! Asynchronous I2C_IF_Write
+//!
+//! \param hBus is the bus returned by I2C_IF_Open
+//! \param ucDevAddr is the 7-bit I2C slave address
+//! \param pucData is the data to be written, untouched until pfnDone runs
+//! \param ucLen is the length of data to be written
+//! \param pfnDone is called from the ISR when the transaction is over
+//! \param pvArg is passed to pfnDone
+//!
+//! Returns as soon as the transaction is queued. Unlike the blocking calls
+//! it does not wait for a free descriptor and may be used from an ISR.
+//!
+//! \return 0: queued, < 0: bad parameters or no free descriptor.
+//
+//****************************************************************************
+int
+I2C_IF_WriteAsync(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		I2C_IF_Callback pfnDone,
+		void *pvArg)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	I2C_Transaction *transaction;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	transaction=I2CPoolAlloc(psBus);
+	RETERR_IF_TRUE(transaction == NULL);
+	transaction->buffer=pucData;
+	transaction->txlenght=ucLen;
+	transaction->rxlenght=0;
+	transaction->dev_address=ucDevAddr;
+	transaction->command=I2C_COMMAND_WRITE;
+
+	return I2CSubmitAsync(psBus,transaction,pfnDone,pvArg);
+}
+
+//****************************************************************************
+//
+//! Asynchronous I2C_IF_ReadFrom
+//!
+//! \param hBus is the bus returned by I2C_IF_Open
+//! \param ucDevAddr is the 7-bit I2C slave address
+//! \param pucWrDataBuf is the data to be written (reg addr)
+//! \param ucWrLen is the length of data to be written
+//! \param pucRdDataBuf receives the data, valid when pfnDone runs
+//! \param ucRdLen is the length of data to be read
+//! \param pfnDone is called from the ISR when the transaction is over
+//! \param pvArg is passed to pfnDone
+//!
+//! \return 0: queued, < 0: bad parameters or no free descriptor.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	I2C_Transaction *transaction;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucRdDataBuf == NULL);
+	RETERR_IF_TRUE(pucWrDataBuf == NULL);
+	RETERR_IF_TRUE(ucWrLen == 0);
+	RETERR_IF_TRUE(ucWrLen > ucRdLen);	//la direccion viaja en el buffer de lectura
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	transaction=I2CPoolAlloc(psBus);
+	RETERR_IF_TRUE(transaction == NULL);
+	memcpy(pucRdDataBuf,pucWrDataBuf,ucWrLen);
+#ifdef I2C_IF_TRACE
+	memcpy(transaction->tracewr,pucWrDataBuf,I2C_TRACE_WR_LEN(ucWrLen));
+#endif
+	transaction->buffer=pucRdDataBuf;
+	transaction->txlenght=ucWrLen;
+	transaction->rxlenght=ucRdLen;
+	transaction->dev_address=ucDevAddr;
+	transaction->command=I2C_COMMAND_READ_FROM;
+
+	return I2CSubmitAsync(psBus,transaction,pfnDone,pvArg);
+}
+
+//****************************************************************************
+//
+//! Completion callback that only stores the status
+//!
+//! \param pvArg points to a volatile int set to I2C_IF_PENDING before the
+//! asynchronous call; it becomes 0 or < 0 when the transaction is over.
+//! Lets a super-loop poll for completion instead of using callbacks.
+//
+//****************************************************************************
+void
+I2C_IF_SetFlag(void *pvArg, int iStatus)
+{
+	*(volatile int *)pvArg=iStatus;
+}
+
+//****************************************************************************
+//
+//! Ends the active transaction from the ISR
+//!
+//! Stops the interrupt source, returns to STATE_IDLE, notifies the task that
+//! owns the descriptor (or, for the asynchronous calls, returns it to the
+//! pool and runs its callback) and moves on to the next pending descriptor.
+//
+//****************************************************************************
+static void
+I2CFinishFromISR(struct I2C_IF_Bus *psBus, uint32_t ulNotify, OS_IF_ISRState *pxHigherPriorityTaskWoken)
+{
+	I2C_Transaction *psTransaction=psBus->active;
+
+	I2CMasterIntDisable(psBus->psController->ulBase);
+	psBus->isrstate=STATE_IDLE; //Vuelve al estado IDLE
+	psBus->active=NULL;
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulTransactions++;
+	psBus->profile.ulLatencyCycles+=I2C_CYCLES()-psTransaction->submitcycles;
+	if (ulNotify&I2C_NOTIFY_ERR) psBus->profile.ulErrors++;
+#endif
+
+#ifdef I2C_IF_TRACE
+	//Los comandos I2C_COMMAND_x valen lo mismo que I2C_TRACE_x
+	I2C_TRACE_Record(psBus->psController->ucIndex,psTransaction->command,psTransaction->dev_address,
+	                 (psTransaction->command==I2C_COMMAND_READ_FROM) ? psTransaction->tracewr : psTransaction->buffer,
+	                 (psTransaction->command==I2C_COMMAND_READ_FROM) ? I2C_TRACE_WR_LEN(psTransaction->tracewrlen) : psTransaction->tracewrlen,
+	                 psTransaction->buffer,psTransaction->tracerdlen,
+	                 (ulNotify&I2C_NOTIFY_ERR) ? FAILURE : SUCCESS,false,I2C_CYCLES());
+#endif
+
+	if (psTransaction->pfnDone!=NULL)
+	{
+		//Transaccion asincrona: el descriptor vuelve al pool antes del callback, que puede encadenar otra
+		I2C_IF_Callback pfnDone=psTransaction->pfnDone;
+		void *pvArg=psTransaction->pvArg;
+
+		I2CPoolRelease(psBus,psTransaction);
+		pfnDone(pvArg,(ulNotify&I2C_NOTIFY_ERR) ? FAILURE : SUCCESS);
+	}
+	else
+	{
+		//A partir de aqui el descriptor vuelve a ser de la tarea
+		OS_IF_NotifyFromISR(psTransaction->OriginTask,ulNotify,pxHigherPriorityTaskWoken);
+	}
+	I2CDoorbellRelease(psBus);
 }
 
 
@@ -374,117 +843,107 @@ I2C_IF_ReadFrom(unsigned char ucDevAddr,
 //Esta rutina parece muy larga, pero s�lo se ejecuta una parte u otra seg�n el estado en el que estemos...
 //Utiliza una m�quina de estados para cambiar el comportamiento cuando se produce la interrupcion, ya que lo que se debe realizar depende de si estamos o no
 // en una transacci�n, del tipo de transaccion (escritura, lectura o escritura-lectura, y de que punto de dicha transacci�n estamos.
-// Para ello se utiliza la variable de estado g_i2cisrstate.
+// Para ello se utiliza la variable de estado psBus->isrstate.
+// La ISR es duena del descriptor en curso (psBus->active) desde que lo saca del anillo hasta que notifica a la tarea.
 
-void I2C_IF_ISR(void)
+static void I2CBusISR(struct I2C_IF_Bus *psBus)
 {
-	BaseType_t xHigherPriorityTaskWoken=pdFALSE;
+	OS_IF_ISRState xHigherPriorityTaskWoken=OS_IF_ISR_STATE_INIT;
+
+	I2C_Transaction *transaction;
 
-	//The following two variables should maintain values between calls to the ISR
-	static I2C_Transaction transaction;
-	static uint8_t *tmpptr;
+#ifdef I2C_IF_PROFILE
+	uint32_t ulEntry=I2C_CYCLES();
+#endif
 
-	I2CMasterIntClear(I2C3_BASE); //Borra el flag de interrupcion
+	I2CMasterIntClear(psBus->psController->ulBase); //Borra el flag de interrupcion
 
 	//Primero tratamos posible error... (por ejemplo NACK)
-	if (I2CMasterErr(I2C3_BASE)&&g_i2cisrstate!=STATE_IDLE)
+	if (I2CMasterErr(psBus->psController->ulBase)&&psBus->isrstate!=STATE_IDLE)
 	{
-		I2CMasterIntDisable(I2C3_BASE);
-		xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-		xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-		switch (g_i2cisrstate)
+		switch (psBus->isrstate)
 		{
 			case STATE_READ_NEXT:
 		 	case STATE_READ_FINAL:
-				I2CMasterControl(I2C3_BASE,I2C_MASTER_CMD_BURST_RECEIVE_FINISH);
+				I2CMasterControl(psBus->psController->ulBase,I2C_MASTER_CMD_BURST_RECEIVE_FINISH);
 				break;
 			case STATE_WRITE_NEXT:
 			case STATE_WRITE_FINAL:
-				I2CMasterControl(I2C3_BASE,I2C_MASTER_CMD_BURST_SEND_FINISH);
+				I2CMasterControl(psBus->psController->ulBase,I2C_MASTER_CMD_BURST_SEND_FINISH);
 				break;
 		}
-		g_i2cisrstate=STATE_IDLE;
-		if (xQueuePeekFromISR(g_I2Cqueue,&transaction))
-		{
-		        IntPendSet(INT_I2C3);
-		}
-		portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);    //Esto es necesario antes del return...
+		I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
+#ifdef I2C_IF_PROFILE
+		psBus->profile.ulISRCycles+=I2C_CYCLES()-ulEntry;
+#endif
+		OS_IF_EndISR(xHigherPriorityTaskWoken);    //Esto es necesario antes del return...
 		return;
 	}
 
 	//Ejecuta la maquina de estados para responder al evento. Miramos primero en qu� estado estamos.
-	switch(g_i2cisrstate)
+	switch(psBus->isrstate)
 	{
 		case STATE_IDLE:
 		{
 			//Arranca la transaccion....
-			if (xQueuePeekFromISR(g_I2Cqueue,&transaction)==pdTRUE)
+			psBus->active=I2CRingPop(psBus);
+			transaction=psBus->active;
+			if (transaction!=NULL)
 			{
-				//Hay algo en la cola... puedo comenzar
-				switch (transaction.command)
+				//Hay algo en el anillo... puedo comenzar
+				switch (transaction->command)
 				{
 					case I2C_COMMAND_WRITE:
 					case I2C_COMMAND_READ_FROM:
 					{	//Disparo una escritura
-						tmpptr=transaction.buffer;
-						MAP_I2CMasterSlaveAddrSet(I2C3_BASE, transaction.dev_address, false); // Set I2C codec slave address
-						I2CMasterDataPut(I2C3_BASE, *tmpptr);	 // Write the first byte to the controller.
-						if (I2CTransact(I2C_MASTER_CMD_BURST_SEND_START)==SUCCESS)
+						psBus->tmpptr=transaction->buffer;
+						MAP_I2CMasterSlaveAddrSet(psBus->psController->ulBase, transaction->dev_address, false); // Set I2C codec slave address
+						I2CMasterDataPut(psBus->psController->ulBase, *psBus->tmpptr);	 // Write the first byte to the controller.
+						if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_SEND_START)==SUCCESS)
 						{
-							transaction.txlenght--;
-							tmpptr++;
-							I2CMasterIntEnable(I2C3_BASE);
-							if (transaction.txlenght>0)
-								g_i2cisrstate=STATE_WRITE_NEXT;	//Cambia de estado. La proxima interrupcion Escribe otro caracter
+							transaction->txlenght--;
+							psBus->tmpptr++;
+							I2CMasterIntEnable(psBus->psController->ulBase);
+							if (transaction->txlenght>0)
+								psBus->isrstate=STATE_WRITE_NEXT;	//Cambia de estado. La proxima interrupcion Escribe otro caracter
 							else
-								g_i2cisrstate=STATE_WRITE_FINAL; //Cambia de estado. La proxima interrupcion finaliza la transmision
+								psBus->isrstate=STATE_WRITE_FINAL; //Cambia de estado. La proxima interrupcion finaliza la transmision
 						}
 						else
-						{	//Fallo de transmision. Elimino la transaccion en curso y aviso a la tarea
-							//Luego borro los flags de interrupci�n y compruebo si hay mas transacciones pendientes
-							xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-							xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-							if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+						{	//Fallo de transmision. Aviso a la tarea y paso a la siguiente transaccion pendiente
+							I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 						}
 					}
 					break;
 					case I2C_COMMAND_READ:
 					{   //Disparo una lectura (simple o multiple, segun el caso)
-						tmpptr=transaction.buffer;
-						MAP_I2CMasterSlaveAddrSet(I2C3_BASE, transaction.dev_address, true); // Set I2C codec slave address
-						transaction.rxlenght--;
-						if(transaction.rxlenght==0)
+						psBus->tmpptr=transaction->buffer;
+						MAP_I2CMasterSlaveAddrSet(psBus->psController->ulBase, transaction->dev_address, true); // Set I2C codec slave address
+						transaction->rxlenght--;
+						if(transaction->rxlenght==0)
 						{	//Lectura simple
-							if (I2CTransact(I2C_MASTER_CMD_SINGLE_RECEIVE)==SUCCESS)
+							if (I2CTransact(psBus, I2C_MASTER_CMD_SINGLE_RECEIVE)==SUCCESS)
 							{
-								g_i2cisrstate=STATE_READ_FINAL; //La siguiente ISR sera el final de lectura
-								I2CMasterIntEnable(I2C3_BASE); //,I2C_MASTER_INT_DATA|I2C_MASTER_INT_TIMEOUT|I2C_MASTER_INT_NACK);
+								psBus->isrstate=STATE_READ_FINAL; //La siguiente ISR sera el final de lectura
+								I2CMasterIntEnable(psBus->psController->ulBase); //,I2C_MASTER_INT_DATA|I2C_MASTER_INT_TIMEOUT|I2C_MASTER_INT_NACK);
 							}
 							else
 							{
-								//Fallo de transmision. Elimino la transaccion en curso y aviso a la tarea
-								//Luego borro los flags de interrupci�n y compruebo si hay mas transacciones pendientes
-								xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-								xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-								if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
-
+								//Fallo de transmision. Aviso a la tarea y paso a la siguiente transaccion pendiente
+								I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 							}
 						}
 						else
 						{	//lectura multiple
-							if (I2CTransact(I2C_MASTER_CMD_BURST_RECEIVE_START)==SUCCESS)
+							if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_RECEIVE_START)==SUCCESS)
 							{
-								g_i2cisrstate=STATE_READ_NEXT;	//La siguente ISR sera la recepcion de un dato
-								I2CMasterIntEnable(I2C3_BASE); //,I2C_MASTER_INT_DATA|I2C_MASTER_INT_TIMEOUT|I2C_MASTER_INT_NACK);
+								psBus->isrstate=STATE_READ_NEXT;	//La siguente ISR sera la recepcion de un dato
+								I2CMasterIntEnable(psBus->psController->ulBase); //,I2C_MASTER_INT_DATA|I2C_MASTER_INT_TIMEOUT|I2C_MASTER_INT_NACK);
 							}
 							else
 							{
-								//Fallo de transmision. Elimino la transaccion en curso y aviso a la tarea
-								//Luego borro los flags de interrupci�n y compruebo si hay mas transacciones pendientes
-								xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-								xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-								//I2CMasterIntClearEx(I2C3_BASE,i2cflags);
-								if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+								//Fallo de transmision. Aviso a la tarea y paso a la siguiente transaccion pendiente
+								I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 							}
 						}
 					}
@@ -492,96 +951,72 @@ void I2C_IF_ISR(void)
 				}
 			}
 			else
-			{	//No habia nada en la cola de ordenes I2C
-				//��Que ha pasao??
+			{	//No habia nada publicado en el anillo (un productor aun no ha terminado de publicar).
+				//Suelto el timbre; ese productor volvera a disparar la ISR
+				I2CDoorbellRelease(psBus);
 			}
 		}
 		break; //FIN DEL CASO STATE_IDLE...
 
 		case STATE_WRITE_NEXT:
 		{	//Continuacion de escritura...Envio el siguiente byte
-			I2CMasterDataPut(I2C3_BASE, *tmpptr);
-			if (I2CTransact(I2C_MASTER_CMD_BURST_SEND_CONT)==SUCCESS)
+			transaction=psBus->active;
+			I2CMasterDataPut(psBus->psController->ulBase, *psBus->tmpptr);
+			if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_SEND_CONT)==SUCCESS)
 			{
-				transaction.txlenght--;
-				tmpptr++;
-				if (transaction.txlenght>0)
-					g_i2cisrstate=STATE_WRITE_NEXT; //Si hay mas que enviar, no cambio de estado (en realidad podia no hacer nada)
+				transaction->txlenght--;
+				psBus->tmpptr++;
+				if (transaction->txlenght>0)
+					psBus->isrstate=STATE_WRITE_NEXT; //Si hay mas que enviar, no cambio de estado (en realidad podia no hacer nada)
 				else
-					g_i2cisrstate=STATE_WRITE_FINAL; //Si no hay mas que enviar, la siguiente ISR finaliza la transmision (condicion de STOP)
+					psBus->isrstate=STATE_WRITE_FINAL; //Si no hay mas que enviar, la siguiente ISR finaliza la transmision (condicion de STOP)
 			}
 			else
 			{
-				//Fallo de transmision. Elimino la transaccion en curso y aviso a la tarea
-				//Deshabilita las ISR y vuelve al estado inicial. De parar la transaccion ya se encarga internamente I2CTransact (creo)
-				//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
-				I2CMasterIntDisable(I2C3_BASE);
-				g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-				xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-				xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-				if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+				//Fallo de transmision. De parar la transaccion ya se encarga internamente I2CTransact (creo)
+				I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 			}
 		}
 		break; //FIN DEL ESTADO STATE_WRITE_NEXT
 
 		case STATE_WRITE_FINAL:
 		{	//Fin transmision. Si era una transmision simple, finalizo y paso a la siguiente
-			if (transaction.command!=I2C_COMMAND_READ_FROM)
+			transaction=psBus->active;
+			if (transaction->command!=I2C_COMMAND_READ_FROM)
 			{
-				//Transaccion finalizada
-				//Deshabilito las ISR, vuelvo al estado IDLE, elimino la transaccion de la cola
-				//Finalmente compruebo si hay almacenada en la cola para dispararla
-				I2CTransact(I2C_MASTER_CMD_BURST_SEND_STOP);
-				I2CMasterIntDisable(I2C3_BASE);
-				g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-				xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-				xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_WRITE_COMPLETE,eSetBits,&xHigherPriorityTaskWoken);	//Transaccion correcta
-				if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+				//Transaccion finalizada. Aviso a la tarea y paso a la siguiente transaccion pendiente
+				I2CTransact(psBus, I2C_MASTER_CMD_BURST_SEND_STOP);
+				I2CFinishFromISR(psBus,I2C_NOTIFY_WRITE_COMPLETE,&xHigherPriorityTaskWoken);	//Transaccion correcta
 			}
 			else //Si era la operacion READ_FROM...
 			{
 				//Operacion READ_FROM. Finaliza la parte de envio, ahora pasamos a recepcion
 				//Comenzar una recepcion!!!
-				tmpptr=transaction.buffer;
-				MAP_I2CMasterSlaveAddrSet(I2C3_BASE, transaction.dev_address, true); // Set I2C codec slave address
-				transaction.rxlenght--;
-				if(transaction.rxlenght==0)
+				psBus->tmpptr=transaction->buffer;
+				MAP_I2CMasterSlaveAddrSet(psBus->psController->ulBase, transaction->dev_address, true); // Set I2C codec slave address
+				transaction->rxlenght--;
+				if(transaction->rxlenght==0)
 				{	//Recepcion de un solo byte
-					if (I2CTransact(I2C_MASTER_CMD_SINGLE_RECEIVE)==SUCCESS)
+					if (I2CTransact(psBus, I2C_MASTER_CMD_SINGLE_RECEIVE)==SUCCESS)
 					{
-						g_i2cisrstate=STATE_READ_FINAL;	//Cambia de estado a finalizar. La proxima ISR finaliza la RX
-						I2CMasterIntEnable(I2C3_BASE);;
+						psBus->isrstate=STATE_READ_FINAL;	//Cambia de estado a finalizar. La proxima ISR finaliza la RX
+						I2CMasterIntEnable(psBus->psController->ulBase);;
 					}
 					else
-					{	//Error
-						//Fallo de recepci�n. Elimino la transaccion en curso y aviso a la tarea
-						//Deshabilita las ISR y vuelve al estado inicial. De parar la transaccion ya se encarga internamente I2CTransact (creo)
-						//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
-						I2CMasterIntDisable(I2C3_BASE);
-						g_i2cisrstate=STATE_IDLE;	//Vuelve al estado IDLE
-						xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-						xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-						if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+					{	//Fallo de recepci�n. Aviso a la tarea y paso a la siguiente transaccion pendiente
+						I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 					}
 				}
 				else
 				{	//Recepcion de varios bytes
-					if (I2CTransact(I2C_MASTER_CMD_BURST_RECEIVE_START)==SUCCESS)
+					if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_RECEIVE_START)==SUCCESS)
 					{
-						g_i2cisrstate=STATE_READ_NEXT;	//La proxima ISR continua la recepcion
-						I2CMasterIntEnable(I2C3_BASE);
+						psBus->isrstate=STATE_READ_NEXT;	//La proxima ISR continua la recepcion
+						I2CMasterIntEnable(psBus->psController->ulBase);
 					}
 					else
-					{
-						//Fallo de recepci�n. Elimino la transaccion en curso y aviso a la tarea
-						//Deshabilita las ISR y vuelve al estado inicial. De parar la transaccion ya se encarga internamente I2CTransact (creo)
-						//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
-					    //La verdad es que esto podia ponerlo en una subfuncion, porque se repite muchiiiiisimo...
-						I2CMasterIntDisable(I2C3_BASE);
-						g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-						xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-						xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-						if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+					{	//Fallo de recepci�n. Aviso a la tarea y paso a la siguiente transaccion pendiente
+						I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 					}
 				}
 			}
@@ -590,70 +1025,120 @@ void I2C_IF_ISR(void)
 
 		case STATE_READ_NEXT:
 		{	//Lectura "larga" en curso... Intento leer datos  continuar...
-			*tmpptr = MAP_I2CMasterDataGet(I2C3_BASE);
-			transaction.rxlenght--;
-			tmpptr++;
-			if (transaction.rxlenght==0)
+			transaction=psBus->active;
+			*psBus->tmpptr = MAP_I2CMasterDataGet(psBus->psController->ulBase);
+			transaction->rxlenght--;
+			psBus->tmpptr++;
+			if (transaction->rxlenght==0)
 			{	//Ya no tengo que recibir mas. Ordeno la recepcion del ultimo byte y la condicion de stop
-				if (I2CTransact(I2C_MASTER_CMD_BURST_RECEIVE_FINISH)==SUCCESS)
+				if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_RECEIVE_FINISH)==SUCCESS)
 				{
-					g_i2cisrstate=STATE_READ_FINAL;	//Ultimo dato, la siguiente ISR finaliza la recepci�n
+					psBus->isrstate=STATE_READ_FINAL;	//Ultimo dato, la siguiente ISR finaliza la recepci�n
 				}
 				else
-				{
-					//Fallo de recepci�n. Elimino la transaccion en curso y aviso a la tarea
-					//Deshabilita las ISR y vuelve al estado inicial. De parar la transaccion ya se encarga internamente I2CTransact (creo)
-					//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
-					I2CMasterIntDisable(I2C3_BASE);
-					g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-					xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-					xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-					if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+				{	//Fallo de recepci�n. Aviso a la tarea y paso a la siguiente transaccion pendiente
+					I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 				}
 			}
 			else
 			{	//Tengo que continuar recibiendo
-				if (I2CTransact(I2C_MASTER_CMD_BURST_RECEIVE_CONT)==SUCCESS)
+				if (I2CTransact(psBus, I2C_MASTER_CMD_BURST_RECEIVE_CONT)==SUCCESS)
 				{
 					//No state change
 				}
 				else
-				{
-					//Fallo de recepci�n. Elimino la transaccion en curso y aviso a la tarea
-					//Deshabilita las ISR y vuelve al estado inicial. De parar la transaccion ya se encarga internamente I2CTransact (creo)
-					//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
-					I2CMasterIntDisable(I2C3_BASE); //,I2C_MASTER_INT_DATA|I2C_MASTER_INT_TIMEOUT|I2C_MASTER_INT_NACK);
-					g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-					xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-					xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_ERR,eSetBits,&xHigherPriorityTaskWoken);
-					if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+				{	//Fallo de recepci�n. Aviso a la tarea y paso a la siguiente transaccion pendiente
+					I2CFinishFromISR(psBus,I2C_NOTIFY_ERR,&xHigherPriorityTaskWoken);
 				}
 			}
 		}
 		break; //FIN DEL ESTADO STATE_READ_NEXT
 		case STATE_READ_FINAL:
 		{
-			//Fin de la lectura/recepcion. Elimino la transaccion en curso y aviso a la tarea
-			//Deshabilita las ISR y vuelve al estado inicial.
-			//Finalmente ompruebo si hay mas transacciones pendientes para volver a lanzar una
+			//Fin de la lectura/recepcion. Aviso a la tarea y paso a la siguiente transaccion pendiente
 			//Ademas borro los flags de interrupcion (aqui no se llama a transact)
-			*tmpptr = MAP_I2CMasterDataGet(I2C3_BASE);
-			I2CMasterIntDisable(I2C3_BASE);
-			g_i2cisrstate=STATE_IDLE; //Vuelve al estado IDLE
-			xQueueReceiveFromISR(g_I2Cqueue,&transaction,&xHigherPriorityTaskWoken);
-			xTaskNotifyFromISR(transaction.OriginTask,I2C_NOTIFY_READ_COMPLETE,eSetBits,&xHigherPriorityTaskWoken);
-			if (xQueuePeekFromISR(g_I2Cqueue,&transaction)) IntPendSet(INT_I2C3);
+			*psBus->tmpptr = MAP_I2CMasterDataGet(psBus->psController->ulBase);
+			I2CFinishFromISR(psBus,I2C_NOTIFY_READ_COMPLETE,&xHigherPriorityTaskWoken);
 		}
 		break; //FIN DEL ESTADO STATE_READ_FINAL
 	}
-	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulISRCycles+=I2C_CYCLES()-ulEntry;
+#endif
+	OS_IF_EndISR(xHigherPriorityTaskWoken);
 }
 
+#ifdef I2C_IF_PROFILE
+//****************************************************************************
+//
+//! Returns the transaction cost counters of a bus and optionally clears them
+//!
+//! \param hBus is the bus returned by I2C_IF_Open
+//! \param psProfile receives a copy of the counters
+//! \param bReset clears the counters after copying them
+//!
+//! Cycles per transaction = (ulSubmitCycles + ulISRCycles) / ulTransactions.
+//!
+//! \return None.
+//
+//****************************************************************************
+void
+I2C_IF_GetProfile(I2C_IF_Handle hBus, I2C_IF_Profile *psProfile, bool bReset)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	*psProfile=psBus->profile;
+	if (bReset)
+	{
+		memset(&psBus->profile,0,sizeof(psBus->profile));
+	}
+}
+#endif
 
 //****************************************************************************
 //
-//! Enables and configures the I2C peripheral
+//! Interrupt handlers, one per controller. Install I2C_IF_ISRn in the vector
+//! table entry of I2Cn for every controller passed to I2C_IF_Open.
+//
+//****************************************************************************
+void I2C_IF_ISR0(void) { I2CBusISR(&g_sI2CBus[0]); }
+void I2C_IF_ISR1(void) { I2CBusISR(&g_sI2CBus[1]); }
+void I2C_IF_ISR2(void) { I2CBusISR(&g_sI2CBus[2]); }
+void I2C_IF_ISR3(void) { I2CBusISR(&g_sI2CBus[3]); }
+
+//****************************************************************************
+//
+// Controller descriptors for the TM4C123 I2C modules on their usual pins.
+// Boards with a different pin mux can pass their own I2C_IF_Controller.
+//
+//****************************************************************************
+const I2C_IF_Controller g_sI2C_IF_I2C0 =
+{
+    0, I2C0_BASE, INT_I2C0, SYSCTL_PERIPH_I2C0,
+    SYSCTL_PERIPH_GPIOB, GPIO_PORTB_BASE, GPIO_PB2_I2C0SCL, GPIO_PB3_I2C0SDA, GPIO_PIN_2, GPIO_PIN_3
+};
+const I2C_IF_Controller g_sI2C_IF_I2C1 =
+{
+    1, I2C1_BASE, INT_I2C1, SYSCTL_PERIPH_I2C1,
+    SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE, GPIO_PA6_I2C1SCL, GPIO_PA7_I2C1SDA, GPIO_PIN_6, GPIO_PIN_7
+};
+const I2C_IF_Controller g_sI2C_IF_I2C2 =
+{
+    2, I2C2_BASE, INT_I2C2, SYSCTL_PERIPH_I2C2,
+    SYSCTL_PERIPH_GPIOE, GPIO_PORTE_BASE, GPIO_PE4_I2C2SCL, GPIO_PE5_I2C2SDA, GPIO_PIN_4, GPIO_PIN_5
+};
+const I2C_IF_Controller g_sI2C_IF_I2C3 =
+{
+    3, I2C3_BASE, INT_I2C3, SYSCTL_PERIPH_I2C3,
+    SYSCTL_PERIPH_GPIOD, GPIO_PORTD_BASE, GPIO_PD0_I2C3SCL, GPIO_PD1_I2C3SDA, GPIO_PIN_0, GPIO_PIN_1
+};
+
+
+//****************************************************************************
+//
+//! Enables and configures an I2C peripheral
 //!
+//! \param psController describes the controller, its interrupt and its pins
 //! \param ulMode is the mode configuration of I2C
 //! The parameter \e ulMode is one of the following
 //! - \b I2C_MASTER_MODE_STD for 100 Kbps standard mode.
@@ -663,32 +1148,49 @@ void I2C_IF_ISR(void)
 //!    1. Powers ON the I2C peripheral.
 //!    2. Configures the I2C peripheral
 //!
-//! \return 0: Success, < 0: Failure.
+//! Opening a controller that is already open returns the same bus (and keeps
+//! the mode it was first opened with), so several drivers can share it.
+//!
+//! \return the bus handle, or NULL on failure.
 //
 //****************************************************************************
-int 
-I2C_IF_Open(unsigned long ulMode)
+I2C_IF_Handle 
+I2C_IF_Open(const I2C_IF_Controller *psController, unsigned long ulMode)
 {
+    struct I2C_IF_Bus *psBus;
+    int i;
+
+    if ((psController==NULL)||(psController->ucIndex>=I2C_IF_MAX_BUSES))
+        return NULL;
+
+    psBus=&g_sI2CBus[psController->ucIndex];
+    if (psBus->refcount>0)
+    {
+        if (psBus->psController!=psController) return NULL;	//mismo I2Cn con otros pines
+        psBus->refcount++;
+        return psBus;
+    }
+    psBus->psController=psController;
 
     // Inicializacion del interfaz con los sensores
     //
-    // The I2C3 peripheral must be enabled before use.
+    // The I2C peripheral must be enabled before use.
     //
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C3);
-    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOD);
+    SysCtlPeripheralEnable(psController->ulPeriph);
+    ROM_SysCtlPeripheralEnable(psController->ulGPIOPeriph);
 
     //
     // Set I2C pins pull-up.
     //
-    MAP_GPIOPadConfigSet(GPIO_PORTD_BASE, GPIO_PIN_0 | GPIO_PIN_1, GPIO_STRENGTH_12MA, GPIO_PIN_TYPE_STD_WPU); //////////////////////////////////////////////////////
+    MAP_GPIOPadConfigSet(psController->ulGPIOBase, psController->ucSCLPin | psController->ucSDAPin, GPIO_STRENGTH_12MA, GPIO_PIN_TYPE_STD_WPU); //////////////////////////////////////////////////////
 
 
     //
-    // Configure the pin muxing for I2C3 functions on port D0 and D1.
+    // Configure the pin muxing for the I2C functions on the SCL/SDA pins.
     // This step is not necessary if your part does not support pin muxing.
     //
-    ROM_GPIOPinConfigure(GPIO_PD0_I2C3SCL);
-    ROM_GPIOPinConfigure(GPIO_PD1_I2C3SDA);
+    ROM_GPIOPinConfigure(psController->ulSCLPinConfig);
+    ROM_GPIOPinConfigure(psController->ulSDAPinConfig);
 
     //
     // Select the I2C function for these pins.  This function will also
@@ -696,11 +1198,11 @@ I2C_IF_Open(unsigned long ulMode)
     // open-drain operation with weak pull-ups.  Consult the data sheet
     // to see which functions are allocated per pin.
     //
-    GPIOPinTypeI2CSCL(GPIO_PORTD_BASE, GPIO_PIN_0);
-    ROM_GPIOPinTypeI2C(GPIO_PORTD_BASE, GPIO_PIN_1);
+    GPIOPinTypeI2CSCL(psController->ulGPIOBase, psController->ucSCLPin);
+    ROM_GPIOPinTypeI2C(psController->ulGPIOBase, psController->ucSDAPin);
 
     //por el clock gating
-    ROM_SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_I2C3);
+    ROM_SysCtlPeripheralSleepEnable(psController->ulPeriph);
 
 
     //
@@ -709,60 +1211,81 @@ I2C_IF_Open(unsigned long ulMode)
     switch(ulMode)
     {
         case I2C_MASTER_MODE_STD:       /* 100000 */
-            MAP_I2CMasterInitExpClk(I2C3_BASE,SYS_CLK,false);
+            MAP_I2CMasterInitExpClk(psBus->psController->ulBase,SYS_CLK,false);
             break;
 
         case I2C_MASTER_MODE_FST:       /* 400000 */
-            MAP_I2CMasterInitExpClk(I2C3_BASE,SYS_CLK,true);
+            MAP_I2CMasterInitExpClk(psBus->psController->ulBase,SYS_CLK,true);
             break;
 
         default:
-            MAP_I2CMasterInitExpClk(I2C3_BASE,SYS_CLK,true);
+            MAP_I2CMasterInitExpClk(psBus->psController->ulBase,SYS_CLK,true);
             break;
     }
 
     
     //Empezamos por estado IDLE (no hay transaccion en marcha)
-    g_i2cisrstate=STATE_IDLE;
-
-    g_I2Cqueue=xQueueCreate(MAX_I2C_TRANSACTIONS,sizeof(I2C_Transaction));
-    if (g_I2Cqueue==NULL)
-    	while(1);
-
-    MAP_IntPrioritySet(INT_I2C3,configMAX_SYSCALL_INTERRUPT_PRIORITY); //jose: La prioridad debe ser mayor o igual que configMAX_SYSCALL_INTERRUPT_PRIORITY
-    MAP_IntEnable(INT_I2C3);
+    psBus->isrstate=STATE_IDLE;
+    psBus->active=NULL;
 
-    return SUCCESS;
+    //Todos los descriptores libres, anillo vacio y timbre en reposo
+    psBus->poolfree=(MAX_I2C_TRANSACTIONS==32) ? 0xFFFFFFFF : ((1UL<<MAX_I2C_TRANSACTIONS)-1);
+    for (i=0; i<MAX_I2C_TRANSACTIONS; i++)
+    {
+    	psBus->ring[i].sequence=i;
+    	psBus->ring[i].transaction=NULL;
+    }
+    psBus->ringhead=0;
+    psBus->ringtail=0;
+    psBus->doorbell=0;
+
+#if defined(I2C_IF_PROFILE) || defined(I2C_IF_TRACE)
+    //Arranca el contador de ciclos del DWT (compartido por todos los buses, no se pone a cero)
+    DEM_CR|=DEM_CR_TRCENA;
+    DWT_CTRL|=DWT_CTRL_CYCCNTENA;
+#endif
+#ifdef I2C_IF_PROFILE
+    memset(&psBus->profile,0,sizeof(psBus->profile));
+#endif
+
+    MAP_IntPrioritySet(psBus->psController->ulInt,OS_IF_ISR_PRIORITY); //jose: La prioridad debe ser mayor o igual que configMAX_SYSCALL_INTERRUPT_PRIORITY
+    MAP_IntEnable(psBus->psController->ulInt);
+
+    psBus->refcount=1;
+    return psBus;
 }
 
 //****************************************************************************
 //
 //! Disables the I2C peripheral
 //!
-//! \param None
+//! \param hBus is the bus returned by I2C_IF_Open
 //! 
 //! This function works in a polling mode,
-//!    1. Powers OFF the I2C peripheral.
+//!    1. Powers OFF the I2C peripheral once its last user closes it.
 //!
 //! \return 0: Success, < 0: Failure.
 //
 //****************************************************************************
 int 
-I2C_IF_Close()
+I2C_IF_Close(I2C_IF_Handle hBus)
 {
+	struct I2C_IF_Bus *psBus=hBus;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psBus->refcount == 0);
+
+	if (--psBus->refcount>0)
+		return SUCCESS;	//Otro driver sigue usando el bus
+
     //
     // Power OFF the I2C peripheral
     //
 
 	//xxx Deber�a comprobarse antes si no hay una transaccion en marcha!!!
 
-	IntDisable(INT_I2C3);	//Deshabilita la ISR
-	SysCtlPeripheralDisable(SYSCTL_PERIPH_I2C3);
-    if (g_I2Cqueue!=NULL)
-    {
-    		vQueueDelete(g_I2Cqueue);
-    		g_I2Cqueue=NULL;
-    }
+	IntDisable(psBus->psController->ulInt);	//Deshabilita la ISR
+	SysCtlPeripheralDisable(psBus->psController->ulPeriph);
 
     return SUCCESS;
 }
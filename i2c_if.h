@@ -39,6 +39,8 @@
 #ifndef __I2C_IF_H__
 #define __I2C_IF_H__
 
+#include <stdbool.h>
+
 //*****************************************************************************
 //
 // If building with a C++ compiler, make all of the definitions in this header
@@ -67,25 +69,237 @@ extern "C"
 #define I2C_MASTER_MODE_STD     0
 #define I2C_MASTER_MODE_FST     1
 
+//*****************************************************************************
+//
+// Number of I2C controllers that can be open at the same time. Each one gets
+// its own ISR context, descriptor pool and submission ring.
+//
+//*****************************************************************************
+#define I2C_IF_MAX_BUSES        4
+
+//*****************************************************************************
+//
+// Controller descriptor passed to I2C_IF_Open: which I2C module to use and
+// how its SCL/SDA pins are muxed. ucIndex selects the I2C_IF_ISRn handler
+// that must be installed in the vector table for that module.
+//
+// Built with I2C_IF_LINUX (i2c_if_linux.c instead of i2c_if.c) a controller
+// is an i2c-dev adapter node instead; g_sI2C_IF_I2Cn is /dev/i2c-n. With
+// I2C_IF_REPLAY as well (i2c_if_replay.c) pcDevice is a bus trace file and
+// g_sI2C_IF_I2Cn is i2c-n.trace. With I2C_IF_SIM (i2c_if_sim.c) pcDevice is
+// only a name and the bus talks to the model given by I2C_IF_SimAttach.
+//
+//*****************************************************************************
+#ifdef I2C_IF_LINUX
+typedef struct
+{
+    unsigned char ucIndex;          // 0..I2C_IF_MAX_BUSES-1, one bus each
+    const char *pcDevice;           // e.g. "/dev/i2c-1"
+} I2C_IF_Controller;
+#else
+typedef struct
+{
+    unsigned char ucIndex;          // n of I2Cn, 0..I2C_IF_MAX_BUSES-1
+    unsigned long ulBase;           // I2Cn_BASE
+    unsigned long ulInt;            // INT_I2Cn
+    unsigned long ulPeriph;         // SYSCTL_PERIPH_I2Cn
+    unsigned long ulGPIOPeriph;     // SYSCTL_PERIPH_GPIOx of the SCL/SDA port
+    unsigned long ulGPIOBase;       // GPIO_PORTx_BASE of the SCL/SDA port
+    unsigned long ulSCLPinConfig;   // GPIO_Pxy_I2CnSCL
+    unsigned long ulSDAPinConfig;   // GPIO_Pxy_I2CnSDA
+    unsigned char ucSCLPin;         // GPIO_PIN_y of SCL
+    unsigned char ucSDAPin;         // GPIO_PIN_y of SDA
+} I2C_IF_Controller;
+#endif
+
+//*****************************************************************************
+//
+// Default TM4C123 controllers: I2C0 on PB2/PB3, I2C1 on PA6/PA7, I2C2 on
+// PE4/PE5 and I2C3 on PD0/PD1.
+//
+//*****************************************************************************
+extern const I2C_IF_Controller g_sI2C_IF_I2C0;
+extern const I2C_IF_Controller g_sI2C_IF_I2C1;
+extern const I2C_IF_Controller g_sI2C_IF_I2C2;
+extern const I2C_IF_Controller g_sI2C_IF_I2C3;
+
+//*****************************************************************************
+//
+// Handle of an open bus, returned by I2C_IF_Open.
+//
+//*****************************************************************************
+typedef struct I2C_IF_Bus *I2C_IF_Handle;
+
+//*****************************************************************************
+//
+// Completion callback of the asynchronous calls. It runs in the I2C ISR, once
+// the descriptor is back in the pool, with iStatus 0 on success and < 0 on
+// error. It may submit new asynchronous transactions and, with FreeRTOS,
+// must only use ...FromISR services.
+//
+// I2C_IF_SetFlag is a ready-made callback for polling: pvArg points to a
+// volatile int set to I2C_IF_PENDING, which receives iStatus.
+//
+//*****************************************************************************
+typedef void (*I2C_IF_Callback)(void *pvArg, int iStatus);
+
+#define I2C_IF_PENDING          1
+
+//*****************************************************************************
+//
+// One register read of I2C_IF_ReadFromMulti: write ucWrLen bytes (the
+// sub-address) to ucDevAddr, then read ucRdLen bytes into pucRdData. As in
+// I2C_IF_ReadFrom the written bytes travel in the read buffer, so
+// ucWrLen <= ucRdLen.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ucDevAddr;
+    unsigned char *pucWrData;
+    unsigned char ucWrLen;
+    unsigned char *pucRdData;
+    unsigned char ucRdLen;
+} I2C_IF_Segment;
+
+// Segments per I2C_IF_ReadFromMulti call (i2c-dev accepts 42 messages)
+#define I2C_IF_MAX_SEGMENTS     8
+
+//*****************************************************************************
+//
+// Transaction cost counters, only built with I2C_IF_PROFILE defined. Values
+// are Cortex-M DWT cycles accumulated since I2C_IF_Open or the last reset.
+// On Linux ulTransactions counts ioctl() calls, the other cycle counters are
+// zero and ulLatencyCycles is the time spent in them, in nanoseconds.
+//
+//*****************************************************************************
+#ifdef I2C_IF_PROFILE
+typedef struct
+{
+    unsigned long ulTransactions;   // completed transactions (ok or error)
+    unsigned long ulErrors;         // transactions that ended with an error
+    unsigned long ulSubmitCycles;   // task side: publish + doorbell
+    unsigned long ulISRCycles;      // every ISR entry, all states
+    unsigned long ulLatencyCycles;  // submission to completion notification
+} I2C_IF_Profile;
+#endif
+
+//*****************************************************************************
+//
+// Rate of the timestamps the backends pass to i2c_trace.c when built with
+// I2C_IF_TRACE, to be given to I2C_TRACE_Start: CLOCK_MONOTONIC microseconds
+// on Linux, the DWT cycle counter on the TM4C (include os_if.h).
+//
+//*****************************************************************************
+#ifdef I2C_IF_LINUX
+#define I2C_IF_TRACE_HZ         1000000UL
+#else
+#define I2C_IF_TRACE_HZ         OS_IF_CPU_CLOCK_HZ
+#endif
+
+//*****************************************************************************
+//
+// Replay counters, only built with I2C_IF_REPLAY (i2c_if_replay.c instead of
+// i2c_if_linux.c). A call matches when the next record of its bus has the
+// same command, slave address, read length and written bytes; it then gets
+// the recorded data and status. A call that does not match is looked for in
+// the following records, which are skipped if it is found there; otherwise
+// it fails and the record waits for the next call. A divergence is counted
+// once, however many calls fail before the replay matches again, and not at
+// all when it follows a gap in the trace and the call is found further on.
+//
+//*****************************************************************************
+#ifdef I2C_IF_REPLAY
+typedef struct
+{
+    unsigned long ulReplayed;       // calls answered from the trace
+    unsigned long ulMismatches;     // times the calls diverged from the trace
+    long lFirstMismatch;            // record index of the first one, -1 none
+    unsigned long ulSkipped;        // records passed over to resynchronize
+    bool bEnded;                    // a call came after the last record
+    unsigned long ulTraceMicros;    // trace time of the last record replayed
+} I2C_IF_ReplayStats;
+#endif
+
+//*****************************************************************************
+//
+// Slave model of a simulated bus, only built with I2C_IF_SIM (i2c_if_sim.c
+// instead of i2c_if_linux.c). pfnWrite gets the bytes of I2C_IF_Write,
+// pfnRead the written bytes (none for I2C_IF_Read) and the buffer to fill;
+// both return < 0 to NAK. pfnElapsed, if not NULL, gets the bus clock in
+// nanoseconds every time it moves.
+//
+//*****************************************************************************
+#ifdef I2C_IF_SIM
+typedef struct
+{
+    int (*pfnWrite)(void *pvModel, unsigned char ucDevAddr,
+                    const unsigned char *pucData, unsigned char ucLen);
+    int (*pfnRead)(void *pvModel, unsigned char ucDevAddr,
+                   const unsigned char *pucWr, unsigned char ucWrLen,
+                   unsigned char *pucData, unsigned char ucLen);
+    void (*pfnElapsed)(void *pvModel, unsigned long long ullNanos);
+    void *pvModel;
+} I2C_IF_SimModel;
+#endif
+
 //*****************************************************************************
 //
 // API Function prototypes
 //
 //*****************************************************************************
-extern int I2C_IF_Open(unsigned long ulMode);
-extern int I2C_IF_Close();
-extern int I2C_IF_Write(unsigned char ucDevAddr,
+extern I2C_IF_Handle I2C_IF_Open(const I2C_IF_Controller *psController,
+             unsigned long ulMode);
+extern int I2C_IF_Close(I2C_IF_Handle hBus);
+extern int I2C_IF_Write(I2C_IF_Handle hBus,
+             unsigned char ucDevAddr,
              unsigned char *pucData,
              unsigned char ucLen, 
              unsigned char ucStop);
-extern int I2C_IF_Read(unsigned char ucDevAddr,
+extern int I2C_IF_Read(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
             unsigned char *pucData,
             unsigned char ucLen);
-extern int I2C_IF_ReadFrom(unsigned char ucDevAddr,
+extern int I2C_IF_ReadFrom(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
             unsigned char *pucWrDataBuf,
             unsigned char ucWrLen,
             unsigned char *pucRdDataBuf,
             unsigned char ucRdLen);
+extern int I2C_IF_ReadFromMulti(I2C_IF_Handle hBus,
+            const I2C_IF_Segment *psSegments,
+            unsigned char ucCount);
+extern int I2C_IF_WriteAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucData,
+            unsigned char ucLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg);
+extern int I2C_IF_ReadFromAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg);
+extern void I2C_IF_SetFlag(void *pvArg, int iStatus);
+extern void I2C_IF_ISR0(void);
+extern void I2C_IF_ISR1(void);
+extern void I2C_IF_ISR2(void);
+extern void I2C_IF_ISR3(void);
+#ifdef I2C_IF_PROFILE
+extern void I2C_IF_GetProfile(I2C_IF_Handle hBus, I2C_IF_Profile *psProfile,
+            bool bReset);
+#endif
+#ifdef I2C_IF_REPLAY
+extern void I2C_IF_GetReplayStats(I2C_IF_Handle hBus, I2C_IF_ReplayStats *psStats);
+#endif
+#ifdef I2C_IF_SIM
+extern int I2C_IF_SimAttach(unsigned char ucIndex, const I2C_IF_SimModel *psModel);
+extern void I2C_IF_SimAdvance(I2C_IF_Handle hBus, unsigned long ulNanos);
+extern unsigned long long I2C_IF_SimNanos(I2C_IF_Handle hBus);
+#endif
 
 //*****************************************************************************
 //
@@ -0,0 +1,564 @@
+//*****************************************************************************
+// i2c_if_linux.c
+//
+// i2c_if backend for Linux i2c-dev adapters. Build it instead of i2c_if.c,
+// with I2C_IF_LINUX and OS_IF_POSIX defined, to run the drivers on a
+// single-board computer:
+//
+//  -> Every call is a single ioctl() on /dev/i2c-N. A register read is one
+//     I2C_RDWR with a write and a read message joined by a repeated START,
+//     and I2C_IF_ReadFromMulti puts all its segments (from any slave) in the
+//     same I2C_RDWR, so a combined accel/gyro + magnetometer read costs one
+//     system call.
+//  -> Adapters without plain I2C support (I2C_FUNC_I2C), such as the kernel
+//     i2c-stub test module, are driven with the equivalent SMBus transfers
+//     instead: one ioctl per segment, up to 32 bytes per read.
+//  -> The asynchronous calls run the transfer before returning and call
+//     pfnDone from the calling thread.
+//  -> The bus clock belongs to the adapter (device tree or module option),
+//     so the ulMode passed to I2C_IF_Open is ignored.
+//  -> With I2C_IF_TRACE every transfer is handed to i2c_trace.c once it is
+//     over, time-stamped in CLOCK_MONOTONIC microseconds. The segments of an
+//     I2C_IF_ReadFromMulti are recorded as one combined transaction.
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+// Standard includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "i2c_if.h"
+#ifdef I2C_IF_TRACE
+#include "i2c_trace.h"
+#endif
+
+#ifndef I2C_IF_LINUX
+#error "i2c_if_linux.c must be built with I2C_IF_LINUX defined"
+#endif
+
+//*****************************************************************************
+//                      MACRO DEFINITIONS
+//*****************************************************************************
+#define FAILURE                 -1
+#define SUCCESS                 0
+#define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
+
+//Funciones SMBus que hacen falta si el adaptador no admite I2C_RDWR
+#define I2C_FUNC_SMBUS_NEEDED   (I2C_FUNC_SMBUS_READ_I2C_BLOCK | I2C_FUNC_SMBUS_BYTE_DATA | \
+                                 I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)
+
+
+//Estado de un adaptador i2c-dev abierto
+struct I2C_IF_Bus {
+	const I2C_IF_Controller *psController;
+	unsigned int refcount;	/* numero de I2C_IF_Open sin su I2C_IF_Close */
+	int fd;					/* descriptor de /dev/i2c-N */
+	bool rdwr;				/* el adaptador admite I2C_RDWR; si no, SMBus */
+	int slave;				/* direccion fijada con I2C_SLAVE (solo SMBus), -1 ninguna */
+#ifdef I2C_IF_PROFILE
+	I2C_IF_Profile profile;
+#endif
+};
+
+static struct I2C_IF_Bus g_sI2CBus[I2C_IF_MAX_BUSES];
+
+
+#ifdef I2C_IF_PROFILE
+static unsigned long
+I2CNanoseconds(void)
+{
+	struct timespec sNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &sNow);
+	return (unsigned long)sNow.tv_sec * 1000000000UL + (unsigned long)sNow.tv_nsec;
+}
+#endif
+
+#ifdef I2C_IF_TRACE
+//Marca de tiempo de la traza: microsegundos, I2C_IF_TRACE_HZ
+static unsigned long
+I2CTraceTicks(void)
+{
+	struct timespec sNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &sNow);
+	return (unsigned long)sNow.tv_sec * 1000000UL + (unsigned long)sNow.tv_nsec / 1000UL;
+}
+#endif
+
+//****************************************************************************
+//
+//! Issues one ioctl on the adapter and accounts for it
+//
+//****************************************************************************
+static int
+I2CIoctl(struct I2C_IF_Bus *psBus, unsigned long ulRequest, void *pvArg)
+{
+	int iRetVal;
+#ifdef I2C_IF_PROFILE
+	unsigned long ulStart=I2CNanoseconds();
+#endif
+
+	do
+	{
+		iRetVal=ioctl(psBus->fd,ulRequest,pvArg);
+	} while ((iRetVal<0)&&(errno==EINTR));
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulTransactions++;
+	psBus->profile.ulLatencyCycles+=I2CNanoseconds()-ulStart;
+	if (iRetVal<0) psBus->profile.ulErrors++;
+#endif
+
+	return (iRetVal<0) ? FAILURE : SUCCESS;
+}
+
+//Transferencia combinada: todos los mensajes en un solo I2C_RDWR
+static int
+I2CTransfer(struct I2C_IF_Bus *psBus, struct i2c_msg *psMsgs, unsigned int uiCount)
+{
+	struct i2c_rdwr_ioctl_data sData;
+
+	sData.msgs=psMsgs;
+	sData.nmsgs=uiCount;
+	return I2CIoctl(psBus,I2C_RDWR,&sData);
+}
+
+//Transferencia SMBus con el esclavo ucDevAddr
+static int
+I2CSmbus(struct I2C_IF_Bus *psBus, unsigned char ucDevAddr, char cReadWrite,
+         unsigned char ucCommand, int iSize, union i2c_smbus_data *psData)
+{
+	struct i2c_smbus_ioctl_data sArgs;
+
+	if (psBus->slave!=ucDevAddr)
+	{
+		RETERR_IF_TRUE(I2CIoctl(psBus,I2C_SLAVE,(void *)(uintptr_t)ucDevAddr)!=SUCCESS);
+		psBus->slave=ucDevAddr;
+	}
+
+	sArgs.read_write=cReadWrite;
+	sArgs.command=ucCommand;
+	sArgs.size=iSize;
+	sArgs.data=psData;
+	return I2CIoctl(psBus,I2C_SMBUS,&sArgs);
+}
+
+//Lectura de registros por SMBus: ucRdLen bytes desde ucReg
+static int
+I2CSmbusReadFrom(struct I2C_IF_Bus *psBus, unsigned char ucDevAddr, unsigned char ucReg,
+                 unsigned char *pucRdData, unsigned char ucRdLen)
+{
+	union i2c_smbus_data uData;
+
+	RETERR_IF_TRUE(ucRdLen > I2C_SMBUS_BLOCK_MAX);
+
+	if (ucRdLen==1)
+	{
+		RETERR_IF_TRUE(I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_READ,ucReg,I2C_SMBUS_BYTE_DATA,&uData)!=SUCCESS);
+		pucRdData[0]=uData.byte;
+		return SUCCESS;
+	}
+
+	uData.block[0]=ucRdLen;
+	RETERR_IF_TRUE(I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_READ,ucReg,I2C_SMBUS_I2C_BLOCK_DATA,&uData)!=SUCCESS);
+	memcpy(pucRdData,&uData.block[1],ucRdLen);
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Opens an i2c-dev adapter
+//!
+//! \param psController names the adapter node
+//! \param ulMode is ignored, the adapter sets the bus clock
+//!
+//! Opening a controller that is already open returns the same bus.
+//!
+//! \return the bus handle, or NULL on failure.
+//
+//****************************************************************************
+I2C_IF_Handle
+I2C_IF_Open(const I2C_IF_Controller *psController, unsigned long ulMode)
+{
+	struct I2C_IF_Bus *psBus;
+	unsigned long ulFuncs;
+
+	(void)ulMode;
+
+	if ((psController==NULL)||(psController->ucIndex>=I2C_IF_MAX_BUSES)||(psController->pcDevice==NULL))
+		return NULL;
+
+	psBus=&g_sI2CBus[psController->ucIndex];
+	if (psBus->refcount>0)
+	{
+		if (psBus->psController!=psController) return NULL;
+		psBus->refcount++;
+		return psBus;
+	}
+
+	memset(psBus,0,sizeof(*psBus));
+	psBus->fd=open(psController->pcDevice,O_RDWR|O_CLOEXEC);
+	if (psBus->fd<0)
+		return NULL;
+
+	if ((ioctl(psBus->fd,I2C_FUNCS,&ulFuncs)<0)||
+	    (!(ulFuncs&I2C_FUNC_I2C)&&((ulFuncs&I2C_FUNC_SMBUS_NEEDED)!=I2C_FUNC_SMBUS_NEEDED)))
+	{
+		close(psBus->fd);
+		return NULL;
+	}
+
+	psBus->psController=psController;
+	psBus->rdwr=(ulFuncs&I2C_FUNC_I2C)!=0;
+	psBus->slave=-1;
+	psBus->refcount=1;
+	return psBus;
+}
+
+//****************************************************************************
+//
+//! Closes the adapter once its last user closes it
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Close(I2C_IF_Handle hBus)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psBus->refcount == 0);
+
+	if (--psBus->refcount==0)
+	{
+		close(psBus->fd);
+		psBus->fd=-1;
+	}
+	return SUCCESS;
+}
+
+//Escritura: un mensaje I2C o la transferencia SMBus equivalente
+static int
+I2CWrite(struct I2C_IF_Bus *psBus, unsigned char ucDevAddr, unsigned char *pucData,
+         unsigned char ucLen)
+{
+	struct i2c_msg sMsg;
+	union i2c_smbus_data uData;
+
+	if (psBus->rdwr)
+	{
+		sMsg.addr=ucDevAddr;
+		sMsg.flags=0;
+		sMsg.len=ucLen;
+		sMsg.buf=pucData;
+		return I2CTransfer(psBus,&sMsg,1);
+	}
+
+	//SMBus: "send byte", "write byte" o escritura de bloque I2C
+	if (ucLen==1)
+		return I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_WRITE,pucData[0],I2C_SMBUS_BYTE,NULL);
+	if (ucLen==2)
+	{
+		uData.byte=pucData[1];
+		return I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_WRITE,pucData[0],I2C_SMBUS_BYTE_DATA,&uData);
+	}
+	RETERR_IF_TRUE(ucLen-1 > I2C_SMBUS_BLOCK_MAX);
+	uData.block[0]=ucLen-1;
+	memcpy(&uData.block[1],pucData+1,ucLen-1);
+	return I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_WRITE,pucData[0],I2C_SMBUS_I2C_BLOCK_DATA,&uData);
+}
+
+//****************************************************************************
+//
+//! Writes ucLen bytes to ucDevAddr, see i2c_if.c
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Write(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		unsigned char ucStop)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	int iRetVal;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(ucStop == 0);
+
+	iRetVal=I2CWrite(psBus,ucDevAddr,pucData,ucLen);
+#ifdef I2C_IF_TRACE
+	I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_WRITE,ucDevAddr,
+	                 pucData,ucLen,NULL,0,iRetVal,false,I2CTraceTicks());
+#endif
+	return iRetVal;
+}
+
+//Lectura sin sub-direccion: un mensaje I2C o "receive byte" SMBus
+static int
+I2CRead(struct I2C_IF_Bus *psBus, unsigned char ucDevAddr, unsigned char *pucData,
+        unsigned char ucLen)
+{
+	struct i2c_msg sMsg;
+	union i2c_smbus_data uData;
+
+	if (psBus->rdwr)
+	{
+		sMsg.addr=ucDevAddr;
+		sMsg.flags=I2C_M_RD;
+		sMsg.len=ucLen;
+		sMsg.buf=pucData;
+		return I2CTransfer(psBus,&sMsg,1);
+	}
+
+	//SMBus "receive byte": un solo byte
+	RETERR_IF_TRUE(ucLen != 1);
+	RETERR_IF_TRUE(I2CSmbus(psBus,ucDevAddr,I2C_SMBUS_READ,0,I2C_SMBUS_BYTE,&uData)!=SUCCESS);
+	pucData[0]=uData.byte;
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Reads ucLen bytes from ucDevAddr without writing a sub-address first
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Read(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	int iRetVal;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+
+	iRetVal=I2CRead(psBus,ucDevAddr,pucData,ucLen);
+#ifdef I2C_IF_TRACE
+	I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_READ,ucDevAddr,
+	                 NULL,0,pucData,ucLen,iRetVal,false,I2CTraceTicks());
+#endif
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! Writes the sub-address and reads ucRdLen bytes, with a repeated START
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFrom(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen)
+{
+	I2C_IF_Segment sSegment;
+
+	sSegment.ucDevAddr=ucDevAddr;
+	sSegment.pucWrData=pucWrDataBuf;
+	sSegment.ucWrLen=ucWrLen;
+	sSegment.pucRdData=pucRdDataBuf;
+	sSegment.ucRdLen=ucRdLen;
+	return I2C_IF_ReadFromMulti(hBus,&sSegment,1);
+}
+
+//****************************************************************************
+//
+//! Several register reads in one I2C_RDWR ioctl
+//!
+//! The segments go out back to back separated by repeated STARTs, with a
+//! single STOP at the end. On SMBus-only adapters each segment is a
+//! transfer of its own and all of them are attempted even if one fails.
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromMulti(I2C_IF_Handle hBus,
+            const I2C_IF_Segment *psSegments,
+            unsigned char ucCount)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	struct i2c_msg sMsgs[2*I2C_IF_MAX_SEGMENTS];
+	int iRetVal=SUCCESS, iSegment;
+	unsigned char i;
+#ifdef I2C_IF_TRACE
+	//La sub-direccion viaja en el buffer de lectura: se guarda antes de transferir
+	unsigned char pucTraceWr[I2C_IF_MAX_SEGMENTS][I2C_TRACE_MAX_WR];
+	unsigned long ulTicks;
+#endif
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psSegments == NULL);
+	RETERR_IF_TRUE(ucCount == 0 || ucCount > I2C_IF_MAX_SEGMENTS);
+	for (i=0; i<ucCount; i++)
+	{
+		RETERR_IF_TRUE(psSegments[i].pucWrData == NULL);
+		RETERR_IF_TRUE(psSegments[i].pucRdData == NULL);
+		RETERR_IF_TRUE(psSegments[i].ucWrLen == 0);
+		RETERR_IF_TRUE(psSegments[i].ucRdLen == 0);
+	}
+
+#ifdef I2C_IF_TRACE
+	for (i=0; i<ucCount; i++)
+	{
+		memcpy(pucTraceWr[i],psSegments[i].pucWrData,I2C_TRACE_WR_LEN(psSegments[i].ucWrLen));
+	}
+#endif
+
+	if (!psBus->rdwr)
+	{
+		for (i=0; i<ucCount; i++)
+		{
+			iSegment=((psSegments[i].ucWrLen==1)&&
+			          (I2CSmbusReadFrom(psBus,psSegments[i].ucDevAddr,psSegments[i].pucWrData[0],
+			                            psSegments[i].pucRdData,psSegments[i].ucRdLen)==SUCCESS)) ? SUCCESS : FAILURE;
+			if (iSegment!=SUCCESS) iRetVal=FAILURE;
+#ifdef I2C_IF_TRACE
+			I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_READ_FROM,psSegments[i].ucDevAddr,
+			                 pucTraceWr[i],I2C_TRACE_WR_LEN(psSegments[i].ucWrLen),
+			                 psSegments[i].pucRdData,psSegments[i].ucRdLen,iSegment,false,I2CTraceTicks());
+#endif
+		}
+		return iRetVal;
+	}
+
+	//El kernel copia los buffers de escritura antes de transferir, asi que
+	//la direccion puede viajar en el buffer de lectura como en i2c_if.c
+	for (i=0; i<ucCount; i++)
+	{
+		sMsgs[2*i].addr=psSegments[i].ucDevAddr;
+		sMsgs[2*i].flags=0;
+		sMsgs[2*i].len=psSegments[i].ucWrLen;
+		sMsgs[2*i].buf=psSegments[i].pucWrData;
+		sMsgs[2*i+1].addr=psSegments[i].ucDevAddr;
+		sMsgs[2*i+1].flags=I2C_M_RD;
+		sMsgs[2*i+1].len=psSegments[i].ucRdLen;
+		sMsgs[2*i+1].buf=psSegments[i].pucRdData;
+	}
+	iRetVal=I2CTransfer(psBus,sMsgs,2*ucCount);
+#ifdef I2C_IF_TRACE
+	ulTicks=I2CTraceTicks();
+	for (i=0; i<ucCount; i++)
+	{
+		I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_READ_FROM,psSegments[i].ucDevAddr,
+		                 pucTraceWr[i],I2C_TRACE_WR_LEN(psSegments[i].ucWrLen),
+		                 psSegments[i].pucRdData,psSegments[i].ucRdLen,iRetVal,i>0,ulTicks);
+	}
+#endif
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_Write, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_WriteAsync(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		I2C_IF_Callback pfnDone,
+		void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_Write(hBus,ucDevAddr,pucData,ucLen,1));
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_ReadFrom, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucRdDataBuf == NULL);
+	RETERR_IF_TRUE(pucWrDataBuf == NULL);
+	RETERR_IF_TRUE(ucWrLen == 0);
+	RETERR_IF_TRUE(ucWrLen > ucRdLen);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_ReadFrom(hBus,ucDevAddr,pucWrDataBuf,ucWrLen,pucRdDataBuf,ucRdLen));
+	return SUCCESS;
+}
+
+void
+I2C_IF_SetFlag(void *pvArg, int iStatus)
+{
+	*(volatile int *)pvArg=iStatus;
+}
+
+#ifdef I2C_IF_PROFILE
+//****************************************************************************
+//
+//! Returns the ioctl counters of a bus and optionally clears them
+//
+//****************************************************************************
+void
+I2C_IF_GetProfile(I2C_IF_Handle hBus, I2C_IF_Profile *psProfile, bool bReset)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	*psProfile=psBus->profile;
+	if (bReset)
+	{
+		memset(&psBus->profile,0,sizeof(psBus->profile));
+	}
+}
+#endif
+
+//****************************************************************************
+//
+// Adapters /dev/i2c-0 to /dev/i2c-3. Pass your own I2C_IF_Controller for
+// other adapter numbers.
+//
+//****************************************************************************
+const I2C_IF_Controller g_sI2C_IF_I2C0 = { 0, "/dev/i2c-0" };
+const I2C_IF_Controller g_sI2C_IF_I2C1 = { 1, "/dev/i2c-1" };
+const I2C_IF_Controller g_sI2C_IF_I2C2 = { 2, "/dev/i2c-2" };
+const I2C_IF_Controller g_sI2C_IF_I2C3 = { 3, "/dev/i2c-3" };
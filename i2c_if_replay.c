@@ -0,0 +1,526 @@
+//*****************************************************************************
+// i2c_if_replay.c
+//
+// i2c_if backend that answers from a bus trace written by i2c_trace.c.
+// Build it instead of i2c_if_linux.c, with I2C_IF_LINUX, I2C_IF_REPLAY and
+// OS_IF_POSIX defined, together with i2c_trace.c, to run the unmodified
+// drivers on the transactions a unit saw in the field:
+//
+//  -> The controller's pcDevice names the trace file, which I2C_IF_Open
+//     loads whole. Each bus replays the records of its own ucIndex, in
+//     order, so several buses can share one file.
+//  -> A call is answered by the next record of its bus when the command,
+//     slave address, read length and written bytes (the first
+//     I2C_TRACE_MAX_WR of a register read) match: the read data and the
+//     status are the recorded ones. Past the last record every call fails.
+//  -> When the next record does not match, the replay looks for the call
+//     in the following I2C_IF_REPLAY_WINDOW records of the bus and, if it
+//     is there, skips the records before it (ulSkipped) and answers it.
+//     Otherwise the call fails and the record stays for the next call.
+//  -> A record that follows a gap (transactions the recorder dropped) is
+//     expected not to match the calls of the lost transactions, so it is
+//     resynchronized on silently. Any other mismatch is reported once
+//     (ulMismatches, lFirstMismatch): the calls that fail until the replay
+//     matches again are not counted again.
+//  -> Nothing waits for the recorded times, so calibration, FIFO decoding
+//     and fusion run as fast as the host allows and can be profiled.
+//  -> The asynchronous calls complete before returning, as on Linux.
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+// Standard includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2c_if.h"
+#include "i2c_trace.h"
+
+#if !defined(I2C_IF_LINUX) || !defined(I2C_IF_REPLAY)
+#error "i2c_if_replay.c must be built with I2C_IF_LINUX and I2C_IF_REPLAY defined"
+#endif
+
+//*****************************************************************************
+//                      MACRO DEFINITIONS
+//*****************************************************************************
+#define FAILURE                 -1
+#define SUCCESS                 0
+#define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
+
+//Registros del bus en los que se busca la llamada para resincronizar
+#define I2C_IF_REPLAY_WINDOW    64
+
+
+//Estado de un bus reproducido
+struct I2C_IF_Bus {
+	const I2C_IF_Controller *psController;
+	unsigned int refcount;	/* numero de I2C_IF_Open sin su I2C_IF_Close */
+	unsigned char *pucTrace;	/* fichero de traza entero */
+	I2C_TRACE_Reader sReader;	/* apunta al siguiente registro de este bus */
+	bool bPending;			/* sRecord ya leido y sin consumir */
+	I2C_TRACE_Entry sRecord;
+	unsigned long ulIndex;		/* indice del siguiente registro del bus */
+	bool bDiverged;			/* desincronizado, el fallo ya se conto */
+	I2C_IF_ReplayStats sStats;
+#ifdef I2C_IF_PROFILE
+	I2C_IF_Profile profile;
+#endif
+};
+
+static struct I2C_IF_Bus g_sI2CBus[I2C_IF_MAX_BUSES];
+
+
+#ifdef I2C_IF_PROFILE
+static unsigned long
+I2CNanoseconds(void)
+{
+	struct timespec sNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &sNow);
+	return (unsigned long)sNow.tv_sec * 1000000000UL + (unsigned long)sNow.tv_nsec;
+}
+#endif
+
+//Carga el fichero de traza completo
+static unsigned char *
+I2CLoadTrace(const char *pcPath, unsigned long *pulLen)
+{
+	FILE *psFile;
+	unsigned char *pucData;
+	long lLen;
+
+	psFile=fopen(pcPath,"rb");
+	if (psFile==NULL)
+		return NULL;
+
+	if ((fseek(psFile,0,SEEK_END)!=0)||((lLen=ftell(psFile))<0)||(fseek(psFile,0,SEEK_SET)!=0)||
+	    ((pucData=malloc(lLen>0 ? (size_t)lLen : 1))==NULL))
+	{
+		fclose(psFile);
+		return NULL;
+	}
+	if (fread(pucData,1,(size_t)lLen,psFile)!=(size_t)lLen)
+	{
+		free(pucData);
+		fclose(psFile);
+		return NULL;
+	}
+	fclose(psFile);
+	*pulLen=(unsigned long)lLen;
+	return pucData;
+}
+
+//****************************************************************************
+//
+//! Looks up the next record of the bus without consuming it
+//!
+//! \return the record, or NULL at the end of the trace (or at a corrupt
+//! record, which ends it as well).
+//
+//****************************************************************************
+static const I2C_TRACE_Entry *
+I2CPeek(struct I2C_IF_Bus *psBus)
+{
+	while (!psBus->bPending)
+	{
+		if (I2C_TRACE_ReaderNext(&psBus->sReader,&psBus->sRecord)!=1)
+			return NULL;
+		psBus->bPending=(psBus->sRecord.ucBus==psBus->psController->ucIndex);
+	}
+	return &psBus->sRecord;
+}
+
+//Coincide el registro con la llamada?
+static bool
+I2CMatches(const I2C_TRACE_Entry *psRecord, unsigned char ucCommand, unsigned char ucDevAddr,
+           const unsigned char *pucWr, unsigned char ucWrLen, unsigned char ucRdLen)
+{
+	return (psRecord->ucCommand==ucCommand)&&(psRecord->ucDevAddr==ucDevAddr)&&
+	       (psRecord->ucRdLen==ucRdLen)&&
+	       (psRecord->ucWrLen==((ucCommand==I2C_TRACE_READ_FROM) ? I2C_TRACE_WR_LEN(ucWrLen) : ucWrLen))&&
+	       ((psRecord->ucWrLen==0)||(memcmp(psRecord->pucWr,pucWr,psRecord->ucWrLen)==0));
+}
+
+//****************************************************************************
+//
+//! Looks for the call in the records of the bus that follow the next one
+//!
+//! If one of the next I2C_IF_REPLAY_WINDOW records matches, the records
+//! before it are skipped and it becomes the next record.
+//!
+//! \return true if the call was found.
+//
+//****************************************************************************
+static bool
+I2CResync(struct I2C_IF_Bus *psBus, unsigned char ucCommand, unsigned char ucDevAddr,
+          const unsigned char *pucWr, unsigned char ucWrLen, unsigned char ucRdLen)
+{
+	I2C_TRACE_Reader sAhead=psBus->sReader;
+	I2C_TRACE_Entry sRecord;
+	unsigned long ulSkip=1;
+
+	while ((ulSkip<=I2C_IF_REPLAY_WINDOW)&&(I2C_TRACE_ReaderNext(&sAhead,&sRecord)==1))
+	{
+		if (sRecord.ucBus!=psBus->psController->ucIndex)
+			continue;
+		if (I2CMatches(&sRecord,ucCommand,ucDevAddr,pucWr,ucWrLen,ucRdLen))
+		{
+			psBus->sReader=sAhead;
+			psBus->sRecord=sRecord;
+			psBus->ulIndex+=ulSkip;
+			psBus->sStats.ulSkipped+=ulSkip;
+			return true;
+		}
+		ulSkip++;
+	}
+	return false;
+}
+
+//****************************************************************************
+//
+//! Answers one call from the trace
+//!
+//! \param psBus is the bus
+//! \param ucCommand is I2C_TRACE_WRITE, I2C_TRACE_READ or I2C_TRACE_READ_FROM
+//! \param ucDevAddr is the slave address of the call
+//! \param pucWr, ucWrLen are the bytes the call writes (sub-address)
+//! \param pucRd, ucRdLen receive the recorded data
+//!
+//! pucWr is compared before anything is copied to pucRd, since a register
+//! read may pass the sub-address in the read buffer. See the file header
+//! for how the replay resynchronizes after a gap or a mismatch.
+//!
+//! \return the recorded status, or < 0 if the call does not match.
+//
+//****************************************************************************
+static int
+I2CReplay(struct I2C_IF_Bus *psBus, unsigned char ucCommand, unsigned char ucDevAddr,
+          const unsigned char *pucWr, unsigned char ucWrLen,
+          unsigned char *pucRd, unsigned char ucRdLen)
+{
+	const I2C_TRACE_Entry *psRecord=I2CPeek(psBus);
+	unsigned long ulIndex=psBus->ulIndex;
+	bool bFound=false, bGap;
+	int iRetVal=FAILURE;
+
+#ifdef I2C_IF_PROFILE
+	unsigned long ulStart=I2CNanoseconds();
+#endif
+
+	if (psRecord==NULL)
+	{
+		psBus->sStats.bEnded=true;
+	}
+	else
+	{
+		bFound=I2CMatches(psRecord,ucCommand,ucDevAddr,pucWr,ucWrLen,ucRdLen);
+		if (!bFound)
+		{
+			//Tras un hueco la llamada puede ser de una transaccion perdida: si
+			//aparece mas adelante no es un fallo
+			bGap=psRecord->bGap;
+			bFound=I2CResync(psBus,ucCommand,ucDevAddr,pucWr,ucWrLen,ucRdLen);
+			if ((!bFound||!bGap)&&!psBus->bDiverged)
+			{
+				if (psBus->sStats.ulMismatches++==0)
+					psBus->sStats.lFirstMismatch=(long)ulIndex;
+			}
+		}
+		//Si no aparece, el registro se queda para la siguiente llamada y no
+		//se vuelve a contar hasta que otra coincida
+		psBus->bDiverged=!bFound;
+	}
+
+	if (bFound)
+	{
+		psRecord=&psBus->sRecord;
+		if (!psRecord->bError)
+			memcpy(pucRd,psRecord->pucRd,ucRdLen);
+		iRetVal=psRecord->bError ? FAILURE : SUCCESS;
+		psBus->sStats.ulReplayed++;
+		psBus->sStats.ulTraceMicros=(unsigned long)(psRecord->ullTime*1000000ULL/psBus->sReader.ulTickHz);
+		psBus->bPending=false;
+		psBus->ulIndex++;
+	}
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulTransactions++;
+	psBus->profile.ulLatencyCycles+=I2CNanoseconds()-ulStart;
+	if (iRetVal<0) psBus->profile.ulErrors++;
+#endif
+
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! Loads the trace named by the controller
+//!
+//! \param psController gives the bus index and the trace file
+//! \param ulMode is ignored
+//!
+//! Opening a controller that is already open returns the same bus.
+//!
+//! \return the bus handle, or NULL if the file is missing or not a trace.
+//
+//****************************************************************************
+I2C_IF_Handle
+I2C_IF_Open(const I2C_IF_Controller *psController, unsigned long ulMode)
+{
+	struct I2C_IF_Bus *psBus;
+	unsigned long ulLen;
+
+	(void)ulMode;
+
+	if ((psController==NULL)||(psController->ucIndex>=I2C_IF_MAX_BUSES)||(psController->pcDevice==NULL))
+		return NULL;
+
+	psBus=&g_sI2CBus[psController->ucIndex];
+	if (psBus->refcount>0)
+	{
+		if (psBus->psController!=psController) return NULL;
+		psBus->refcount++;
+		return psBus;
+	}
+
+	memset(psBus,0,sizeof(*psBus));
+	psBus->pucTrace=I2CLoadTrace(psController->pcDevice,&ulLen);
+	if (psBus->pucTrace==NULL)
+		return NULL;
+	if (I2C_TRACE_ReaderInit(&psBus->sReader,psBus->pucTrace,ulLen)!=SUCCESS)
+	{
+		free(psBus->pucTrace);
+		psBus->pucTrace=NULL;
+		return NULL;
+	}
+
+	psBus->psController=psController;
+	psBus->sStats.lFirstMismatch=-1;
+	psBus->refcount=1;
+	return psBus;
+}
+
+//****************************************************************************
+//
+//! Frees the trace once the last user closes the bus
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Close(I2C_IF_Handle hBus)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psBus->refcount == 0);
+
+	if (--psBus->refcount==0)
+	{
+		free(psBus->pucTrace);
+		psBus->pucTrace=NULL;
+	}
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Replays a write of ucLen bytes to ucDevAddr
+//!
+//! \return the recorded status, < 0 on a mismatch.
+//
+//****************************************************************************
+int
+I2C_IF_Write(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		unsigned char ucStop)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(ucStop == 0);
+
+	return I2CReplay(hBus,I2C_TRACE_WRITE,ucDevAddr,pucData,ucLen,NULL,0);
+}
+
+//****************************************************************************
+//
+//! Replays a read of ucLen bytes without sub-address
+//!
+//! \return the recorded status, < 0 on a mismatch.
+//
+//****************************************************************************
+int
+I2C_IF_Read(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+
+	return I2CReplay(hBus,I2C_TRACE_READ,ucDevAddr,NULL,0,pucData,ucLen);
+}
+
+//****************************************************************************
+//
+//! Replays a register read
+//!
+//! \return the recorded status, < 0 on a mismatch.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFrom(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucRdDataBuf == NULL);
+	RETERR_IF_TRUE(pucWrDataBuf == NULL);
+	RETERR_IF_TRUE(ucWrLen == 0);
+	RETERR_IF_TRUE(ucRdLen == 0);
+
+	return I2CReplay(hBus,I2C_TRACE_READ_FROM,ucDevAddr,pucWrDataBuf,ucWrLen,pucRdDataBuf,ucRdLen);
+}
+
+//****************************************************************************
+//
+//! Replays several register reads, one record each
+//!
+//! All segments are attempted even if one fails.
+//!
+//! \return 0: Success, < 0: Failure of at least one segment.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromMulti(I2C_IF_Handle hBus,
+            const I2C_IF_Segment *psSegments,
+            unsigned char ucCount)
+{
+	int iRetVal=SUCCESS;
+	unsigned char i;
+
+	RETERR_IF_TRUE(psSegments == NULL);
+	RETERR_IF_TRUE(ucCount == 0 || ucCount > I2C_IF_MAX_SEGMENTS);
+
+	for (i=0; i<ucCount; i++)
+	{
+		if (I2C_IF_ReadFrom(hBus,psSegments[i].ucDevAddr,psSegments[i].pucWrData,psSegments[i].ucWrLen,
+		                    psSegments[i].pucRdData,psSegments[i].ucRdLen)!=SUCCESS)
+			iRetVal=FAILURE;
+	}
+
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_Write, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_WriteAsync(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		I2C_IF_Callback pfnDone,
+		void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_Write(hBus,ucDevAddr,pucData,ucLen,1));
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_ReadFrom, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucRdDataBuf == NULL);
+	RETERR_IF_TRUE(pucWrDataBuf == NULL);
+	RETERR_IF_TRUE(ucWrLen == 0);
+	RETERR_IF_TRUE(ucWrLen > ucRdLen);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_ReadFrom(hBus,ucDevAddr,pucWrDataBuf,ucWrLen,pucRdDataBuf,ucRdLen));
+	return SUCCESS;
+}
+
+void
+I2C_IF_SetFlag(void *pvArg, int iStatus)
+{
+	*(volatile int *)pvArg=iStatus;
+}
+
+//****************************************************************************
+//
+//! Returns the replay counters of a bus
+//
+//****************************************************************************
+void
+I2C_IF_GetReplayStats(I2C_IF_Handle hBus, I2C_IF_ReplayStats *psStats)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	*psStats=psBus->sStats;
+}
+
+#ifdef I2C_IF_PROFILE
+//****************************************************************************
+//
+//! Returns the replay call counters of a bus and optionally clears them
+//
+//****************************************************************************
+void
+I2C_IF_GetProfile(I2C_IF_Handle hBus, I2C_IF_Profile *psProfile, bool bReset)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	*psProfile=psBus->profile;
+	if (bReset)
+	{
+		memset(&psBus->profile,0,sizeof(psBus->profile));
+	}
+}
+#endif
+
+//****************************************************************************
+//
+// Traces i2c-0.trace to i2c-3.trace in the working directory. Pass your own
+// I2C_IF_Controller for other files.
+//
+//****************************************************************************
+const I2C_IF_Controller g_sI2C_IF_I2C0 = { 0, "i2c-0.trace" };
+const I2C_IF_Controller g_sI2C_IF_I2C1 = { 1, "i2c-1.trace" };
+const I2C_IF_Controller g_sI2C_IF_I2C2 = { 2, "i2c-2.trace" };
+const I2C_IF_Controller g_sI2C_IF_I2C3 = { 3, "i2c-3.trace" };
@@ -0,0 +1,441 @@
+//*****************************************************************************
+// i2c_if_sim.c
+//
+// i2c_if backend that hands every transfer to a slave model in the same
+// process. Build it instead of i2c_if_linux.c, with I2C_IF_LINUX,
+// I2C_IF_SIM and OS_IF_POSIX defined, to run the unmodified drivers on a
+// PC against a register model such as LSM9DS1_Sim:
+//
+//  -> I2C_IF_SimAttach gives a bus index its model before I2C_IF_Open;
+//     the controller's pcDevice is not used.
+//  -> Each bus keeps a simulated clock that only moves with the bus: every
+//     transfer advances it by its length in SCL periods at 100 or 400 kHz
+//     (the ulMode of I2C_IF_Open), and the application adds idle time with
+//     I2C_IF_SimAdvance. The model sees the clock through pfnElapsed and
+//     can produce samples at its own rate, so a driver polling a status
+//     register sees data arrive as on the bus. Runs are deterministic.
+//  -> I2C_IF_ReadFromMulti is one combined transfer, as on Linux.
+//  -> With I2C_IF_TRACE the transfers are recorded like on Linux, stamped
+//     with the simulated clock in microseconds.
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+// Standard includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2c_if.h"
+#ifdef I2C_IF_TRACE
+#include "i2c_trace.h"
+#endif
+
+#if !defined(I2C_IF_LINUX) || !defined(I2C_IF_SIM)
+#error "i2c_if_sim.c must be built with I2C_IF_LINUX and I2C_IF_SIM defined"
+#endif
+
+//*****************************************************************************
+//                      MACRO DEFINITIONS
+//*****************************************************************************
+#define FAILURE                 -1
+#define SUCCESS                 0
+#define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
+
+//Bits de un byte con su ACK, y START/STOP
+#define I2C_BYTE_BITS           9
+#define I2C_COND_BITS           1
+
+
+//Estado de un bus simulado
+struct I2C_IF_Bus {
+	const I2C_IF_Controller *psController;
+	unsigned int refcount;	/* numero de I2C_IF_Open sin su I2C_IF_Close */
+	I2C_IF_SimModel sModel;	/* esclavos del bus */
+	bool bAttached;
+	unsigned long ulNsPerBit;	/* periodo de SCL */
+	unsigned long long ullNanos;	/* reloj simulado */
+#ifdef I2C_IF_PROFILE
+	I2C_IF_Profile profile;
+#endif
+};
+
+static struct I2C_IF_Bus g_sI2CBus[I2C_IF_MAX_BUSES];
+
+
+//****************************************************************************
+//
+//! Advances the clock of a bus by ulBits SCL periods and accounts for the
+//! transfer
+//
+//****************************************************************************
+static void
+I2CSimElapsed(struct I2C_IF_Bus *psBus, unsigned long ulBits, int iStatus)
+{
+	psBus->ullNanos+=(unsigned long long)ulBits*psBus->ulNsPerBit;
+	if (psBus->sModel.pfnElapsed!=NULL)
+		psBus->sModel.pfnElapsed(psBus->sModel.pvModel,psBus->ullNanos);
+
+#ifdef I2C_IF_PROFILE
+	psBus->profile.ulTransactions++;
+	psBus->profile.ulLatencyCycles+=ulBits*psBus->ulNsPerBit;
+	if (iStatus<0) psBus->profile.ulErrors++;
+#else
+	(void)iStatus;
+#endif
+}
+
+#ifdef I2C_IF_TRACE
+static unsigned long
+I2CTraceTicks(struct I2C_IF_Bus *psBus)
+{
+	return (unsigned long)(psBus->ullNanos/1000ULL);
+}
+#endif
+
+//****************************************************************************
+//
+//! Gives a bus its slave model
+//!
+//! \param ucIndex is the controller index the driver will open
+//! \param psModel is copied; pvModel must stay valid while the bus is open
+//!
+//! \return 0: Success, < 0: Failure (bad index, bus open or no callbacks).
+//
+//****************************************************************************
+int
+I2C_IF_SimAttach(unsigned char ucIndex, const I2C_IF_SimModel *psModel)
+{
+	RETERR_IF_TRUE(ucIndex >= I2C_IF_MAX_BUSES);
+	RETERR_IF_TRUE(psModel == NULL);
+	RETERR_IF_TRUE(psModel->pfnWrite == NULL || psModel->pfnRead == NULL);
+	RETERR_IF_TRUE(g_sI2CBus[ucIndex].refcount > 0);
+
+	memset(&g_sI2CBus[ucIndex],0,sizeof(g_sI2CBus[ucIndex]));
+	g_sI2CBus[ucIndex].sModel=*psModel;
+	g_sI2CBus[ucIndex].bAttached=true;
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Lets ulNanos of idle bus time pass, so the model produces its samples
+//
+//****************************************************************************
+void
+I2C_IF_SimAdvance(I2C_IF_Handle hBus, unsigned long ulNanos)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	psBus->ullNanos+=ulNanos;
+	if (psBus->sModel.pfnElapsed!=NULL)
+		psBus->sModel.pfnElapsed(psBus->sModel.pvModel,psBus->ullNanos);
+}
+
+//****************************************************************************
+//
+//! Returns the simulated clock of a bus, in nanoseconds
+//
+//****************************************************************************
+unsigned long long
+I2C_IF_SimNanos(I2C_IF_Handle hBus)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	return psBus->ullNanos;
+}
+
+//****************************************************************************
+//
+//! Opens a simulated bus
+//!
+//! \param psController gives the bus index, which must have a model
+//! \param ulMode selects the simulated SCL rate
+//!
+//! Opening a controller that is already open returns the same bus. The
+//! clock keeps running across close and open.
+//!
+//! \return the bus handle, or NULL on failure.
+//
+//****************************************************************************
+I2C_IF_Handle
+I2C_IF_Open(const I2C_IF_Controller *psController, unsigned long ulMode)
+{
+	struct I2C_IF_Bus *psBus;
+
+	if ((psController==NULL)||(psController->ucIndex>=I2C_IF_MAX_BUSES))
+		return NULL;
+
+	psBus=&g_sI2CBus[psController->ucIndex];
+	if (!psBus->bAttached)
+		return NULL;
+	if (psBus->refcount>0)
+	{
+		if (psBus->psController!=psController) return NULL;
+		psBus->refcount++;
+		return psBus;
+	}
+
+	psBus->psController=psController;
+	psBus->ulNsPerBit=(ulMode==I2C_MASTER_MODE_FST) ? 2500 : 10000;
+#ifdef I2C_IF_PROFILE
+	memset(&psBus->profile,0,sizeof(psBus->profile));
+#endif
+	psBus->refcount=1;
+	return psBus;
+}
+
+//****************************************************************************
+//
+//! Closes the bus once its last user closes it. The model stays attached.
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Close(I2C_IF_Handle hBus)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psBus->refcount == 0);
+
+	psBus->refcount--;
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Writes ucLen bytes to ucDevAddr through the model
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Write(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		unsigned char ucStop)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	int iRetVal;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(ucStop == 0);
+
+	iRetVal=(psBus->sModel.pfnWrite(psBus->sModel.pvModel,ucDevAddr,pucData,ucLen)<0) ? FAILURE : SUCCESS;
+	I2CSimElapsed(psBus,2*I2C_COND_BITS+I2C_BYTE_BITS*(1+(unsigned long)ucLen),iRetVal);
+#ifdef I2C_IF_TRACE
+	I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_WRITE,ucDevAddr,
+	                 pucData,ucLen,NULL,0,iRetVal,false,I2CTraceTicks(psBus));
+#endif
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! Reads ucLen bytes from ucDevAddr without writing a sub-address first
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_Read(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	int iRetVal;
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+
+	iRetVal=(psBus->sModel.pfnRead(psBus->sModel.pvModel,ucDevAddr,NULL,0,pucData,ucLen)<0) ? FAILURE : SUCCESS;
+	I2CSimElapsed(psBus,2*I2C_COND_BITS+I2C_BYTE_BITS*(1+(unsigned long)ucLen),iRetVal);
+#ifdef I2C_IF_TRACE
+	I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_READ,ucDevAddr,
+	                 NULL,0,pucData,ucLen,iRetVal,false,I2CTraceTicks(psBus));
+#endif
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! Writes the sub-address and reads ucRdLen bytes, with a repeated START
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFrom(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen)
+{
+	I2C_IF_Segment sSegment;
+
+	sSegment.ucDevAddr=ucDevAddr;
+	sSegment.pucWrData=pucWrDataBuf;
+	sSegment.ucWrLen=ucWrLen;
+	sSegment.pucRdData=pucRdDataBuf;
+	sSegment.ucRdLen=ucRdLen;
+	return I2C_IF_ReadFromMulti(hBus,&sSegment,1);
+}
+
+//****************************************************************************
+//
+//! Several register reads in one combined transfer
+//!
+//! Every segment is handed to the model; the transfer fails if any does.
+//! The written bytes are copied first, since they may travel in the read
+//! buffer.
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromMulti(I2C_IF_Handle hBus,
+            const I2C_IF_Segment *psSegments,
+            unsigned char ucCount)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+	unsigned char pucWr[255];
+	unsigned long ulBits=I2C_COND_BITS;
+	int iRetVal=SUCCESS;
+	unsigned char i;
+#ifdef I2C_IF_TRACE
+	unsigned char pucTraceWr[I2C_IF_MAX_SEGMENTS][I2C_TRACE_MAX_WR];
+#endif
+
+	RETERR_IF_TRUE(psBus == NULL);
+	RETERR_IF_TRUE(psSegments == NULL);
+	RETERR_IF_TRUE(ucCount == 0 || ucCount > I2C_IF_MAX_SEGMENTS);
+	for (i=0; i<ucCount; i++)
+	{
+		RETERR_IF_TRUE(psSegments[i].pucWrData == NULL);
+		RETERR_IF_TRUE(psSegments[i].pucRdData == NULL);
+		RETERR_IF_TRUE(psSegments[i].ucWrLen == 0);
+		RETERR_IF_TRUE(psSegments[i].ucRdLen == 0);
+	}
+
+	for (i=0; i<ucCount; i++)
+	{
+		memcpy(pucWr,psSegments[i].pucWrData,psSegments[i].ucWrLen);
+#ifdef I2C_IF_TRACE
+		memcpy(pucTraceWr[i],pucWr,I2C_TRACE_WR_LEN(psSegments[i].ucWrLen));
+#endif
+		if (psBus->sModel.pfnRead(psBus->sModel.pvModel,psSegments[i].ucDevAddr,pucWr,psSegments[i].ucWrLen,
+		                          psSegments[i].pucRdData,psSegments[i].ucRdLen)<0)
+			iRetVal=FAILURE;
+		//Direccion+W, sub-direccion, START repetido, direccion+R y datos
+		ulBits+=I2C_COND_BITS+I2C_BYTE_BITS*(2+(unsigned long)psSegments[i].ucWrLen+psSegments[i].ucRdLen);
+	}
+	I2CSimElapsed(psBus,ulBits+I2C_COND_BITS,iRetVal);
+
+#ifdef I2C_IF_TRACE
+	for (i=0; i<ucCount; i++)
+	{
+		I2C_TRACE_Record(psBus->psController->ucIndex,I2C_TRACE_READ_FROM,psSegments[i].ucDevAddr,
+		                 pucTraceWr[i],I2C_TRACE_WR_LEN(psSegments[i].ucWrLen),
+		                 psSegments[i].pucRdData,psSegments[i].ucRdLen,iRetVal,i>0,I2CTraceTicks(psBus));
+	}
+#endif
+	return iRetVal;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_Write, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_WriteAsync(I2C_IF_Handle hBus,
+		unsigned char ucDevAddr,
+		unsigned char *pucData,
+		unsigned char ucLen,
+		I2C_IF_Callback pfnDone,
+		void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucData == NULL);
+	RETERR_IF_TRUE(ucLen == 0);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_Write(hBus,ucDevAddr,pucData,ucLen,1));
+	return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! I2C_IF_ReadFrom, then pfnDone from the calling thread
+//!
+//! \return 0: done (see pfnDone for the status), < 0: bad parameters.
+//
+//****************************************************************************
+int
+I2C_IF_ReadFromAsync(I2C_IF_Handle hBus,
+            unsigned char ucDevAddr,
+            unsigned char *pucWrDataBuf,
+            unsigned char ucWrLen,
+            unsigned char *pucRdDataBuf,
+            unsigned char ucRdLen,
+            I2C_IF_Callback pfnDone,
+            void *pvArg)
+{
+	RETERR_IF_TRUE(hBus == NULL);
+	RETERR_IF_TRUE(pucRdDataBuf == NULL);
+	RETERR_IF_TRUE(pucWrDataBuf == NULL);
+	RETERR_IF_TRUE(ucWrLen == 0);
+	RETERR_IF_TRUE(ucWrLen > ucRdLen);
+	RETERR_IF_TRUE(pfnDone == NULL);
+
+	pfnDone(pvArg,I2C_IF_ReadFrom(hBus,ucDevAddr,pucWrDataBuf,ucWrLen,pucRdDataBuf,ucRdLen));
+	return SUCCESS;
+}
+
+void
+I2C_IF_SetFlag(void *pvArg, int iStatus)
+{
+	*(volatile int *)pvArg=iStatus;
+}
+
+#ifdef I2C_IF_PROFILE
+//****************************************************************************
+//
+//! Returns the transfer counters of a bus and optionally clears them.
+//! ulLatencyCycles is simulated bus time, in nanoseconds.
+//
+//****************************************************************************
+void
+I2C_IF_GetProfile(I2C_IF_Handle hBus, I2C_IF_Profile *psProfile, bool bReset)
+{
+	struct I2C_IF_Bus *psBus=hBus;
+
+	*psProfile=psBus->profile;
+	if (bReset)
+	{
+		memset(&psBus->profile,0,sizeof(psBus->profile));
+	}
+}
+#endif
+
+//****************************************************************************
+//
+// Simulated buses 0 to 3.
+//
+//****************************************************************************
+const I2C_IF_Controller g_sI2C_IF_I2C0 = { 0, "sim-0" };
+const I2C_IF_Controller g_sI2C_IF_I2C1 = { 1, "sim-1" };
+const I2C_IF_Controller g_sI2C_IF_I2C2 = { 2, "sim-2" };
+const I2C_IF_Controller g_sI2C_IF_I2C3 = { 3, "sim-3" };
@@ -0,0 +1,486 @@
+//*****************************************************************************
+// i2c_sched.c
+//
+// Earliest-deadline-first periodic read scheduler on top of i2c_if.
+//
+// The timer ISR only advances the scheduler clock and wakes the scheduler
+// task. The task then serves every released job: it picks the ready job with
+// the earliest absolute deadline, merges into the same burst every other
+// ready job of that slave whose registers are within I2C_SCHED_MAX_GAP bytes,
+// reads the whole span with a single I2C_IF_ReadFrom and hands each job its
+// slice. Jobs of a slave are therefore never split into several address
+// phases in the same tick, and bus accesses are spread by period instead of
+// arriving in bursts from unrelated tasks.
+//
+//*****************************************************************************
+
+// Standard includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2c_sched.h"
+
+//FreeRTOS, or the bare-metal replacement if OS_IF_BAREMETAL is defined
+#include "os_if.h"
+
+//*****************************************************************************
+//                      MACRO DEFINITIONS
+//*****************************************************************************
+#define FAILURE                 -1
+#define SUCCESS                 0
+#define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
+
+//Tiempo "a" respecto a "b" con el contador dando la vuelta
+#define TIME_AFTER_EQ(a, b)     ((long)((a) - (b)) >= 0)
+#define TIME_AFTER(a, b)        ((long)((a) - (b)) > 0)
+
+//Stack por defecto de la tarea del planificador, en palabras
+#define I2C_SCHED_STACK_DEFAULT 256
+
+//Bit de notificacion del tick. La tarea comparte la palabra de notificacion
+//con las esperas de i2c_if (bits bajos) al leer las rafagas
+#define I2C_SCHED_NOTIFY_TICK   (0x80000000UL)
+
+//Instantes de plazo que la prueba de demanda llega a comprobar
+#define I2C_SCHED_DBF_POINTS    4096
+
+
+//****************************************************************************
+//                      LOCAL FUNCTION DEFINITIONS
+//****************************************************************************
+static bool I2CSchedFeasible(I2C_SCHED_Context *psSched, I2C_SCHED_Job *psJob);
+#ifdef OS_IF_HAS_TASKS
+static void I2CSchedTask(void *pvParameters);
+#endif
+
+
+//****************************************************************************
+//
+//! Bit times a register read of ucLen bytes keeps the bus busy
+//!
+//! START, address+W, sub-address, repeated START, address+R, ucLen data
+//! bytes and STOP; every byte takes 9 clocks with its ACK.
+//!
+//! \return number of SCL periods.
+//
+//****************************************************************************
+unsigned long
+I2C_SCHED_BusBits(unsigned char ucLen)
+{
+    return 3 + 9 * (3 + (unsigned long)ucLen);
+}
+
+//****************************************************************************
+//
+//! Prepares a scheduler for a bus
+//!
+//! \param psSched is the scheduler instance (caller storage)
+//! \param hBus is the bus returned by I2C_IF_Open
+//! \param ulTickHz is the rate at which I2C_SCHED_TickFromISR is called
+//! \param ulBusHz is the SCL frequency, used for utilization figures
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_SCHED_Init(I2C_SCHED_Context *psSched, I2C_IF_Handle hBus,
+               unsigned long ulTickHz, unsigned long ulBusHz)
+{
+    RETERR_IF_TRUE(psSched == NULL);
+    RETERR_IF_TRUE(hBus == NULL);
+    RETERR_IF_TRUE(ulTickHz == 0);
+    RETERR_IF_TRUE(ulBusHz == 0);
+
+    memset(psSched, 0, sizeof(*psSched));
+    psSched->hBus = hBus;
+    psSched->ulTickHz = ulTickHz;
+    psSched->ulBusHz = ulBusHz;
+
+    return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Registers a periodic read job. Must be called before I2C_SCHED_Start.
+//!
+//! The job is rejected if its parameters are invalid, if the table is full,
+//! or if the job set would no longer meet every deadline under EDF. With
+//! deadline == period for every job that is a bus demand of at most 100%;
+//! once a deadline is shorter than its period the processor demand test is
+//! run as well (see I2CSchedFeasible).
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_SCHED_AddJob(I2C_SCHED_Context *psSched, I2C_SCHED_Job *psJob)
+{
+    unsigned long ulDemand;
+
+    RETERR_IF_TRUE(psSched == NULL);
+    RETERR_IF_TRUE(psJob == NULL);
+    RETERR_IF_TRUE(psSched->bStarted);
+    RETERR_IF_TRUE(psSched->ucJobs >= I2C_SCHED_MAX_JOBS);
+    RETERR_IF_TRUE(psJob->pucData == NULL);
+    RETERR_IF_TRUE(psJob->ucLen == 0 || psJob->ucLen > I2C_SCHED_MAX_BURST);
+    RETERR_IF_TRUE((unsigned)psJob->ucReg + psJob->ucLen > 0x100);
+    RETERR_IF_TRUE(psJob->ulPeriod == 0);
+    RETERR_IF_TRUE(psJob->ulDeadline == 0 || psJob->ulDeadline > psJob->ulPeriod);
+
+    //Demanda en tanto por mil: tiempo de bus por liberacion / periodo
+    ulDemand = (unsigned long)(((uint64_t)I2C_SCHED_BusBits(psJob->ucLen) *
+                                psSched->ulTickHz * 1000) /
+                               ((uint64_t)psSched->ulBusHz * psJob->ulPeriod)) + 1;
+    RETERR_IF_TRUE(psSched->sStats.ulDemand + ulDemand > 1000);
+    RETERR_IF_TRUE(!I2CSchedFeasible(psSched, psJob));
+
+    psJob->ulRuns = 0;
+    psJob->ulMisses = 0;
+    psSched->sStats.ulDemand += ulDemand;
+    psSched->psJobs[psSched->ucJobs++] = psJob;
+
+    return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! EDF processor demand test of the job set plus psJob
+//!
+//! Every job is taken as released at the same instant (offsets ignored, the
+//! worst case). The bus time demanded by jobs whose release and deadline
+//! both fall in [0, t] must not exceed t, for every absolute deadline t up to
+//! the longest busy period (Baruah's bound), also capped at the hyperperiod
+//! plus the largest deadline. Work is counted in bit times scaled by
+//! ulTickHz, so a job costs BusBits * ulTickHz and t ticks supply
+//! t * ulBusHz. The caller has already checked the demand is below 100%.
+//!
+//! \return true if the set is feasible, false if not or if it would take
+//! more than I2C_SCHED_DBF_POINTS deadlines to prove it.
+//
+//****************************************************************************
+static bool
+I2CSchedFeasible(I2C_SCHED_Context *psSched, I2C_SCHED_Job *psJob)
+{
+    I2C_SCHED_Job *psSet[I2C_SCHED_MAX_JOBS + 1];
+    uint64_t pullCost[I2C_SCHED_MAX_JOBS + 1];
+    uint64_t ullHorizon, ullHyper, ullDemand, ullT;
+    unsigned long ulMaxDeadline, ulPoints;
+    double dUtil, dSlack;
+    bool bConstrained;
+    unsigned char ucSet, i, j;
+
+    ucSet = 0;
+    for (i = 0; i < psSched->ucJobs; i++)
+    {
+        psSet[ucSet++] = psSched->psJobs[i];
+    }
+    psSet[ucSet++] = psJob;
+
+    bConstrained = false;
+    ulMaxDeadline = 0;
+    ullHyper = 1;
+    dUtil = 0;
+    dSlack = 0;
+    for (i = 0; i < ucSet; i++)
+    {
+        pullCost[i] = (uint64_t)I2C_SCHED_BusBits(psSet[i]->ucLen) * psSched->ulTickHz;
+        if (psSet[i]->ulDeadline < psSet[i]->ulPeriod) bConstrained = true;
+        if (psSet[i]->ulDeadline > ulMaxDeadline) ulMaxDeadline = psSet[i]->ulDeadline;
+
+        //mcm de los periodos, saturado
+        ullT = ullHyper;
+        while (ullT % psSet[i]->ulPeriod)
+        {
+            ullT += ullHyper;
+            if (ullT > UINT32_MAX) break;
+        }
+        ullHyper = ullT;
+
+        dUtil += (double)pullCost[i] / ((double)psSched->ulBusHz * psSet[i]->ulPeriod);
+        dSlack += (double)(psSet[i]->ulPeriod - psSet[i]->ulDeadline) *
+                  pullCost[i] / ((double)psSched->ulBusHz * psSet[i]->ulPeriod);
+    }
+
+    //Con plazo == periodo basta la demanda <= 100%
+    if (!bConstrained) return true;
+    if (dUtil >= 1.0) return false;
+
+    ullHorizon = ullHyper + ulMaxDeadline;
+    if (dSlack / (1.0 - dUtil) < (double)ullHorizon)
+    {
+        ullHorizon = (uint64_t)(dSlack / (1.0 - dUtil)) + 1;
+    }
+    if (ullHorizon < ulMaxDeadline) ullHorizon = ulMaxDeadline;
+
+    //Basta con comprobar los plazos absolutos: la demanda solo crece en ellos
+    ulPoints = 0;
+    for (i = 0; i < ucSet; i++)
+    {
+        for (ullT = psSet[i]->ulDeadline; ullT <= ullHorizon; ullT += psSet[i]->ulPeriod)
+        {
+            if (++ulPoints > I2C_SCHED_DBF_POINTS) return false;
+
+            ullDemand = 0;
+            for (j = 0; j < ucSet; j++)
+            {
+                if (ullT < psSet[j]->ulDeadline) continue;
+                ullDemand += ((ullT - psSet[j]->ulDeadline) / psSet[j]->ulPeriod + 1) * pullCost[j];
+            }
+            if (ullDemand > ullT * psSched->ulBusHz) return false;
+        }
+    }
+
+    return true;
+}
+
+//****************************************************************************
+//
+//! Creates the scheduler task and releases every job at its offset
+//!
+//! \param usStackDepth is the task stack in words (0 for the default)
+//! \param uxPriority is the task priority
+//!
+//! Without an RTOS both parameters are ignored and no task is created; call
+//! I2C_SCHED_Dispatch from the main loop after each tick.
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_SCHED_Start(I2C_SCHED_Context *psSched, unsigned short usStackDepth,
+                OS_IF_Priority uxPriority)
+{
+    unsigned char i;
+
+    RETERR_IF_TRUE(psSched == NULL);
+    RETERR_IF_TRUE(psSched->bStarted);
+
+    psSched->ulStart = psSched->ulNow;
+    for (i = 0; i < psSched->ucJobs; i++)
+    {
+        psSched->psJobs[i]->ulRelease = psSched->ulStart + psSched->psJobs[i]->ulOffset;
+    }
+
+#ifdef OS_IF_HAS_TASKS
+    if (!OS_IF_TaskCreate(I2CSchedTask, "I2CSched",
+                          usStackDepth ? usStackDepth : I2C_SCHED_STACK_DEFAULT,
+                          psSched, uxPriority, &psSched->xTask))
+    {
+        psSched->xTask = NULL;
+        return FAILURE;
+    }
+#else
+    (void)usStackDepth;
+    (void)uxPriority;
+#endif
+    psSched->bStarted = true;
+
+    return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Scheduler time base. Call it from a periodic timer ISR at ulTickHz.
+//
+//****************************************************************************
+void
+I2C_SCHED_TickFromISR(I2C_SCHED_Context *psSched)
+{
+#ifdef OS_IF_HAS_TASKS
+    OS_IF_ISRState xState = OS_IF_ISR_STATE_INIT;
+#endif
+
+    psSched->ulNow++;
+#ifdef OS_IF_HAS_TASKS
+    if (psSched->xTask != NULL)
+    {
+        OS_IF_NotifyFromISR(psSched->xTask, I2C_SCHED_NOTIFY_TICK, &xState);
+    }
+    OS_IF_EndISR(xState);
+#endif
+}
+
+//****************************************************************************
+//
+//! Completes a job: callback, deadline accounting and next release.
+//
+//****************************************************************************
+static void
+I2CSchedComplete(I2C_SCHED_Context *psSched, I2C_SCHED_Job *psJob,
+                 const unsigned char *pucData, int iStatus)
+{
+    unsigned long ulNow = psSched->ulNow;
+    unsigned long ulSkipped;
+    bool bLate = TIME_AFTER(ulNow, psJob->ulRelease + psJob->ulDeadline);
+
+    if (iStatus == SUCCESS)
+    {
+        memcpy(psJob->pucData, pucData, psJob->ucLen);
+    }
+    if (bLate)
+    {
+        psJob->ulMisses++;
+    }
+    psJob->ulRuns++;
+    psSched->sStats.ulJobsRun++;
+
+    //Siguiente liberacion. Si ya ha pasado (el bus no dio abasto) se saltan
+    //los periodos perdidos y cuentan como fallos de plazo
+    psJob->ulRelease += psJob->ulPeriod;
+    if (TIME_AFTER_EQ(ulNow, psJob->ulRelease + psJob->ulPeriod))
+    {
+        ulSkipped = (ulNow - psJob->ulRelease) / psJob->ulPeriod;
+        psJob->ulMisses += ulSkipped;
+        psJob->ulRelease += ulSkipped * psJob->ulPeriod;
+    }
+
+    if (psJob->pfnCallback != NULL)
+    {
+        psJob->pfnCallback(psJob->pvArg, psJob->pucData, psJob->ucLen, iStatus, bLate);
+    }
+}
+
+//****************************************************************************
+//
+//! Serves every job released up to now, in EDF order, merging same-slave
+//! jobs into bursts. Called by the scheduler task on every tick; exposed so
+//! a caller can run the scheduler from its own loop instead.
+//
+//****************************************************************************
+void
+I2C_SCHED_Dispatch(I2C_SCHED_Context *psSched)
+{
+    I2C_SCHED_Job *psLead, *psJob;
+    unsigned char pucMembers[I2C_SCHED_MAX_JOBS];
+    unsigned char ucMembers, ucFirst, ucLast, ucNewFirst, ucNewLast, ucSub;
+    unsigned long ulNow, ulMisses;
+    bool bMerged;
+    int iStatus;
+    unsigned char i, j;
+
+    for (;;)
+    {
+        ulNow = psSched->ulNow;
+
+        //Trabajo liberado con el plazo absoluto mas temprano
+        psLead = NULL;
+        for (i = 0; i < psSched->ucJobs; i++)
+        {
+            psJob = psSched->psJobs[i];
+            if (!TIME_AFTER_EQ(ulNow, psJob->ulRelease)) continue;
+            if ((psLead == NULL) ||
+                TIME_AFTER(psLead->ulRelease + psLead->ulDeadline,
+                           psJob->ulRelease + psJob->ulDeadline))
+            {
+                psLead = psJob;
+                pucMembers[0] = i;
+            }
+        }
+        if (psLead == NULL) break;
+
+        //Empaqueta en la misma rafaga los trabajos listos del mismo esclavo
+        ucMembers = 1;
+        ucFirst = psLead->ucReg;
+        ucLast = psLead->ucReg + psLead->ucLen - 1;
+        do
+        {
+            bMerged = false;
+            for (i = 0; i < psSched->ucJobs; i++)
+            {
+                psJob = psSched->psJobs[i];
+                if (memchr(pucMembers, i, ucMembers) != NULL) continue;
+                if (!TIME_AFTER_EQ(ulNow, psJob->ulRelease)) continue;
+                if ((psJob->ucDevAddr != psLead->ucDevAddr) ||
+                    (psJob->ucRegFlags != psLead->ucRegFlags)) continue;
+
+                ucNewFirst = psJob->ucReg < ucFirst ? psJob->ucReg : ucFirst;
+                ucNewLast = psJob->ucReg + psJob->ucLen - 1;
+                if (ucNewLast < ucLast) ucNewLast = ucLast;
+
+                //Bytes que nadie necesita al unir las dos lecturas
+                if ((ucNewLast - ucNewFirst + 1 > I2C_SCHED_MAX_BURST) ||
+                    ((ucNewLast - ucNewFirst + 1) >
+                     (ucLast - ucFirst + 1) + psJob->ucLen + I2C_SCHED_MAX_GAP))
+                    continue;
+
+                ucFirst = ucNewFirst;
+                ucLast = ucNewLast;
+                pucMembers[ucMembers++] = i;
+                bMerged = true;
+            }
+        } while (bMerged);
+
+        ucSub = ucFirst | psLead->ucRegFlags;
+        iStatus = I2C_IF_ReadFrom(psSched->hBus, psLead->ucDevAddr, &ucSub, 1,
+                                  psSched->pucBurst, ucLast - ucFirst + 1);
+
+        psSched->sStats.ulTransactions++;
+        psSched->sStats.ulBusBits += I2C_SCHED_BusBits(ucLast - ucFirst + 1);
+        if (iStatus != SUCCESS) psSched->sStats.ulErrors++;
+
+        for (j = 0; j < ucMembers; j++)
+        {
+            psJob = psSched->psJobs[pucMembers[j]];
+            I2CSchedComplete(psSched, psJob, &psSched->pucBurst[psJob->ucReg - ucFirst], iStatus);
+        }
+    }
+
+    ulMisses = 0;
+    for (i = 0; i < psSched->ucJobs; i++)
+    {
+        ulMisses += psSched->psJobs[i]->ulMisses;
+    }
+    psSched->sStats.ulDeadlineMisses = ulMisses;
+}
+
+#ifdef OS_IF_HAS_TASKS
+//****************************************************************************
+//
+//! Scheduler task: waits for the timer tick and dispatches.
+//!
+//! A tick notified while the task waits inside I2C_IF_ReadFrom wakes that
+//! wait instead (it only sets the tick bit), so the clock is checked again
+//! before going back to sleep.
+//
+//****************************************************************************
+static void
+I2CSchedTask(void *pvParameters)
+{
+    I2C_SCHED_Context *psSched = (I2C_SCHED_Context *)pvParameters;
+    unsigned long ulSeen;
+
+    for (;;)
+    {
+        ulSeen = psSched->ulNow;
+        I2C_SCHED_Dispatch(psSched);
+        if (psSched->ulNow == ulSeen)
+        {
+            OS_IF_Wait(I2C_SCHED_NOTIFY_TICK);
+        }
+    }
+}
+#endif
+
+//****************************************************************************
+//
+//! Returns the scheduler counters
+//!
+//! ulUtilization is the share of the elapsed time the bus spent on
+//! scheduled transfers, in per mille of (ulElapsed / ulTickHz) seconds.
+//
+//****************************************************************************
+void
+I2C_SCHED_GetStats(I2C_SCHED_Context *psSched, I2C_SCHED_Stats *psStats)
+{
+    *psStats = psSched->sStats;
+    psStats->ulElapsed = psSched->ulNow - psSched->ulStart;
+    psStats->ulUtilization = 0;
+    if (psStats->ulElapsed > 0)
+    {
+        psStats->ulUtilization = (unsigned long)(((uint64_t)psStats->ulBusBits *
+                                                  psSched->ulTickHz * 1000) /
+                                                 ((uint64_t)psSched->ulBusHz * psStats->ulElapsed));
+    }
+}
@@ -0,0 +1,144 @@
+//*****************************************************************************
+// i2c_sched.h
+//
+// Periodic read scheduler for an I2C bus opened with i2c_if.
+//
+// Devices register periodic read jobs (slave address, first register,
+// length, period and relative deadline). A periodic timer ISR calls
+// I2C_SCHED_TickFromISR, which wakes the scheduler task; the task issues
+// every released job in earliest-deadline-first order, packing ready jobs of
+// the same slave into a single burst, and keeps deadline-miss and bus
+// utilization counters.
+//
+// Built without an RTOS (OS_IF_BAREMETAL, OS_IF_POSIX) there is no scheduler
+// task: I2C_SCHED_Start only releases the jobs and the main loop calls
+// I2C_SCHED_Dispatch.
+//
+//*****************************************************************************
+
+#ifndef __I2C_SCHED_H__
+#define __I2C_SCHED_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "i2c_if.h"
+#include "os_if.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Limits. A burst is one I2C_IF_ReadFrom covering several jobs of the same
+// slave; I2C_SCHED_MAX_GAP is the number of unwanted bytes we accept reading
+// to bridge two jobs, roughly the cost of the extra address phase saved.
+//
+//*****************************************************************************
+#define I2C_SCHED_MAX_JOBS      8
+#define I2C_SCHED_MAX_BURST     64
+#define I2C_SCHED_MAX_GAP       3
+
+//*****************************************************************************
+//
+// Called from the scheduler task once a job has been read. iStatus is 0 on
+// success and < 0 if the bus transaction failed. bLate is true if the data
+// arrived after the job's absolute deadline.
+//
+//*****************************************************************************
+typedef void (*I2C_SCHED_Callback)(void *pvArg, const unsigned char *pucData,
+                                   unsigned char ucLen, int iStatus,
+                                   bool bLate);
+
+//*****************************************************************************
+//
+// A periodic read job. The caller owns the structure (static storage) and
+// fills the first block before I2C_SCHED_AddJob; the scheduler owns the rest.
+// Times are in scheduler ticks (see ulTickHz in I2C_SCHED_Init).
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ucDevAddr;        // 7-bit slave address
+    unsigned char ucReg;            // first register to read; the last one,
+                                    // ucReg + ucLen - 1, must be <= 0xFF
+    unsigned char ucRegFlags;       // OR'ed into the sub-address, e.g. an
+                                    // auto-increment bit (0x80 on the
+                                    // LSM9DS1 magnetometer)
+    unsigned char ucLen;            // bytes to read
+    unsigned long ulPeriod;         // release period, ticks (> 0)
+    unsigned long ulDeadline;       // relative deadline, ticks (<= ulPeriod)
+    unsigned long ulOffset;         // first release, ticks after start
+    unsigned char *pucData;         // ucLen bytes, updated before pfnCallback
+    I2C_SCHED_Callback pfnCallback; // may be NULL
+    void *pvArg;
+
+    // Scheduler private
+    unsigned long ulRelease;        // next release time
+    unsigned long ulRuns;           // times the job was read
+    unsigned long ulMisses;         // late completions plus skipped periods
+} I2C_SCHED_Job;
+
+//*****************************************************************************
+//
+// Scheduler counters, see I2C_SCHED_GetStats.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulElapsed;        // ticks since I2C_SCHED_Start
+    unsigned long ulTransactions;   // bursts issued
+    unsigned long ulJobsRun;        // jobs served (a burst serves >= 1)
+    unsigned long ulDeadlineMisses; // sum of ulMisses over all jobs
+    unsigned long ulErrors;         // failed bursts
+    unsigned long ulBusBits;        // bit times spent on the bus
+    unsigned long ulUtilization;    // bus utilization, per mille
+    unsigned long ulDemand;         // utilization the job set asks for, per mille
+} I2C_SCHED_Stats;
+
+//*****************************************************************************
+//
+// Scheduler instance. One per bus; treat the fields as private.
+//
+//*****************************************************************************
+typedef struct
+{
+    I2C_IF_Handle hBus;
+    unsigned long ulTickHz;
+    unsigned long ulBusHz;
+    I2C_SCHED_Job *psJobs[I2C_SCHED_MAX_JOBS];
+    unsigned char ucJobs;
+    volatile unsigned long ulNow;
+    unsigned long ulStart;
+    bool bStarted;
+#ifdef OS_IF_HAS_TASKS
+    OS_IF_Task xTask;
+#endif
+    I2C_SCHED_Stats sStats;
+    unsigned char pucBurst[I2C_SCHED_MAX_BURST];
+} I2C_SCHED_Context;
+
+//*****************************************************************************
+//
+// API Function prototypes
+//
+//*****************************************************************************
+extern int I2C_SCHED_Init(I2C_SCHED_Context *psSched, I2C_IF_Handle hBus,
+                          unsigned long ulTickHz, unsigned long ulBusHz);
+extern int I2C_SCHED_AddJob(I2C_SCHED_Context *psSched, I2C_SCHED_Job *psJob);
+extern int I2C_SCHED_Start(I2C_SCHED_Context *psSched,
+                           unsigned short usStackDepth,
+                           OS_IF_Priority uxPriority);
+extern void I2C_SCHED_TickFromISR(I2C_SCHED_Context *psSched);
+extern void I2C_SCHED_Dispatch(I2C_SCHED_Context *psSched);
+extern void I2C_SCHED_GetStats(I2C_SCHED_Context *psSched,
+                               I2C_SCHED_Stats *psStats);
+extern unsigned long I2C_SCHED_BusBits(unsigned char ucLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //  __I2C_SCHED_H__
@@ -0,0 +1,374 @@
+//*****************************************************************************
+// i2c_trace.c
+//
+// Bus transaction recorder for i2c_if, and reader of the traces it writes.
+//
+// The recorder encodes each record into a small stack buffer and copies it
+// into the ring in at most two pieces. A record that does not fit is
+// dropped whole, never truncated, and the next one that fits carries
+// I2C_TRACE_GAP, so a reader always resynchronizes on a record boundary.
+// Times are stored as the difference with the previous record kept, so
+// dropped records do not shift the time base of the following ones.
+//
+//*****************************************************************************
+
+// Standard includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2c_trace.h"
+
+//*****************************************************************************
+//                      MACRO DEFINITIONS
+//*****************************************************************************
+#define FAILURE                 -1
+#define SUCCESS                 0
+#define RETERR_IF_TRUE(condition) {if(condition) return FAILURE;}
+
+#define I2C_ATOMIC_LOAD(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define I2C_ATOMIC_STORE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+//Numero de buses que caben en los bits de bus de los flags
+#define I2C_TRACE_BUS_MASK      0x03
+
+
+//Estado del grabador. Productor: I2C_TRACE_Record. Consumidor: I2C_TRACE_Read
+static struct {
+    unsigned char *pucBuffer;
+    uint32_t ulSize;
+    volatile uint32_t ulHead;       /* bytes escritos desde Start (productor) */
+    volatile uint32_t ulTail;       /* bytes leidos desde Start (consumidor) */
+    volatile bool bActive;
+    volatile bool bLock;            /* hilos concurrentes en Linux */
+    bool bGap;                      /* se han perdido registros desde el ultimo */
+    uint32_t ulLastTicks;           /* marca de tiempo del ultimo registro guardado */
+    bool bTimed;                    /* ulLastTicks es valido: el primer registro va a tiempo 0 */
+    I2C_TRACE_Stats sStats;
+} g_sTrace;
+
+
+//****************************************************************************
+//                      LOCAL FUNCTION DEFINITIONS
+//****************************************************************************
+
+//Copia ulLen bytes al anillo en la posicion ulHead (caben, ya comprobado)
+static void
+I2CTraceCopyIn(uint32_t ulHead, const unsigned char *pucSrc, uint32_t ulLen)
+{
+    uint32_t ulPos=ulHead%g_sTrace.ulSize;
+    uint32_t ulFirst=g_sTrace.ulSize-ulPos;
+
+    if (ulFirst>ulLen) ulFirst=ulLen;
+    memcpy(&g_sTrace.pucBuffer[ulPos],pucSrc,ulFirst);
+    memcpy(g_sTrace.pucBuffer,pucSrc+ulFirst,ulLen-ulFirst);
+}
+
+static unsigned long
+I2CTraceGet32(const unsigned char *pucData)
+{
+    return (unsigned long)pucData[0] | ((unsigned long)pucData[1] << 8) |
+           ((unsigned long)pucData[2] << 16) | ((unsigned long)pucData[3] << 24);
+}
+
+//****************************************************************************
+//
+//! Starts recording into a caller-supplied ring
+//!
+//! \param pucBuffer is the ring storage, owned by the recorder until
+//! I2C_TRACE_Stop
+//! \param ulSize is its size in bytes; a few kilobytes absorb the bursts of
+//! a 952 Hz FIFO drain between two I2C_TRACE_Read calls
+//! \param ulTickHz is the rate of the ulTicks passed to I2C_TRACE_Record
+//!
+//! The file header is the first thing I2C_TRACE_Read returns. Counters are
+//! cleared.
+//!
+//! \return 0: Success, < 0: Failure.
+//
+//****************************************************************************
+int
+I2C_TRACE_Start(unsigned char *pucBuffer, unsigned long ulSize, unsigned long ulTickHz)
+{
+    unsigned char pucHeader[I2C_TRACE_HEADER_LEN];
+
+    RETERR_IF_TRUE(pucBuffer == NULL);
+    RETERR_IF_TRUE(ulSize <= I2C_TRACE_HEADER_LEN);
+    RETERR_IF_TRUE(ulTickHz == 0);
+
+    I2C_ATOMIC_STORE(&g_sTrace.bActive,false);
+    g_sTrace.pucBuffer=pucBuffer;
+    g_sTrace.ulSize=ulSize;
+    g_sTrace.ulHead=0;
+    g_sTrace.ulTail=0;
+    g_sTrace.bGap=false;
+    g_sTrace.bTimed=false;
+    memset(&g_sTrace.sStats,0,sizeof(g_sTrace.sStats));
+
+    memcpy(pucHeader,"I2CT",4);
+    pucHeader[4]=I2C_TRACE_VERSION;
+    pucHeader[5]=(unsigned char)ulTickHz;
+    pucHeader[6]=(unsigned char)(ulTickHz>>8);
+    pucHeader[7]=(unsigned char)(ulTickHz>>16);
+    pucHeader[8]=(unsigned char)(ulTickHz>>24);
+    I2CTraceCopyIn(0,pucHeader,I2C_TRACE_HEADER_LEN);
+    g_sTrace.sStats.ulBytes=I2C_TRACE_HEADER_LEN;
+    I2C_ATOMIC_STORE(&g_sTrace.ulHead,I2C_TRACE_HEADER_LEN);
+
+    I2C_ATOMIC_STORE(&g_sTrace.bActive,true);
+    return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Stops recording. What is in the ring can still be read.
+//
+//****************************************************************************
+void
+I2C_TRACE_Stop(void)
+{
+    I2C_ATOMIC_STORE(&g_sTrace.bActive,false);
+}
+
+//****************************************************************************
+//
+//! Records one finished transaction, called by the i2c_if backends
+//!
+//! \param ucBus is the controller index
+//! \param ucCommand is I2C_TRACE_WRITE, I2C_TRACE_READ or I2C_TRACE_READ_FROM
+//! \param ucDevAddr is the 7-bit slave address
+//! \param pucWr, ucWrLen are the bytes written (payload or sub-address)
+//! \param pucRd, ucRdLen are the bytes read, ignored if iStatus < 0
+//! \param iStatus is the result returned to the caller
+//! \param bCont marks a segment of the same bus transaction as the
+//! previous record (I2C_IF_ReadFromMulti on Linux)
+//! \param ulTicks is a free-running timestamp at ulTickHz
+//!
+//! Does nothing unless a trace is started. Safe from an ISR; callers on
+//! different interrupt priorities must not record concurrently.
+//
+//****************************************************************************
+void
+I2C_TRACE_Record(unsigned char ucBus, unsigned char ucCommand, unsigned char ucDevAddr,
+                 const unsigned char *pucWr, unsigned char ucWrLen,
+                 const unsigned char *pucRd, unsigned char ucRdLen,
+                 int iStatus, bool bCont, unsigned long ulTicks)
+{
+    unsigned char pucRecord[I2C_TRACE_MAX_RECORD];
+    uint32_t ulLen=0, ulDelta, ulHead;
+    unsigned char ucFlags;
+
+    if (!I2C_ATOMIC_LOAD(&g_sTrace.bActive))
+        return;
+
+    while (__atomic_test_and_set(&g_sTrace.bLock,__ATOMIC_ACQUIRE))
+        ;
+
+    ucFlags=(ucCommand&I2C_TRACE_CMD_MASK)|((ucBus&I2C_TRACE_BUS_MASK)<<I2C_TRACE_BUS_SHIFT);
+    if (iStatus<0) ucFlags|=I2C_TRACE_ERROR;
+    if (bCont) ucFlags|=I2C_TRACE_CONT;
+    if (g_sTrace.bGap) ucFlags|=I2C_TRACE_GAP;
+    pucRecord[ulLen++]=ucFlags;
+
+    //Tiempo desde el registro anterior, LEB128
+    ulDelta=g_sTrace.bTimed ? (uint32_t)ulTicks-g_sTrace.ulLastTicks : 0;
+    while (ulDelta>=0x80)
+    {
+        pucRecord[ulLen++]=(unsigned char)(ulDelta|0x80);
+        ulDelta>>=7;
+    }
+    pucRecord[ulLen++]=(unsigned char)ulDelta;
+
+    pucRecord[ulLen++]=ucDevAddr;
+    if ((ucCommand&I2C_TRACE_CMD_MASK)!=I2C_TRACE_READ)
+    {
+        pucRecord[ulLen++]=ucWrLen;
+        memcpy(&pucRecord[ulLen],pucWr,ucWrLen);
+        ulLen+=ucWrLen;
+    }
+    if ((ucCommand&I2C_TRACE_CMD_MASK)!=I2C_TRACE_WRITE)
+    {
+        pucRecord[ulLen++]=ucRdLen;
+        if (iStatus>=0)
+        {
+            memcpy(&pucRecord[ulLen],pucRd,ucRdLen);
+            ulLen+=ucRdLen;
+        }
+    }
+
+    ulHead=g_sTrace.ulHead;
+    if (ulLen>g_sTrace.ulSize-(ulHead-I2C_ATOMIC_LOAD(&g_sTrace.ulTail)))
+    {
+        //No cabe: se pierde entero y el siguiente lleva la marca de hueco
+        g_sTrace.bGap=true;
+        g_sTrace.sStats.ulDropped++;
+    }
+    else
+    {
+        I2CTraceCopyIn(ulHead,pucRecord,ulLen);
+        I2C_ATOMIC_STORE(&g_sTrace.ulHead,ulHead+ulLen);
+        g_sTrace.bGap=false;
+        g_sTrace.ulLastTicks=(uint32_t)ulTicks;
+        g_sTrace.bTimed=true;
+        g_sTrace.sStats.ulRecords++;
+        g_sTrace.sStats.ulBytes+=ulLen;
+    }
+
+    __atomic_clear(&g_sTrace.bLock,__ATOMIC_RELEASE);
+}
+
+//****************************************************************************
+//
+//! Drains encoded trace bytes from the ring
+//!
+//! \param pucDest receives the bytes, to be appended to the trace file
+//! \param ulMax is the room in pucDest
+//!
+//! Records may be split between calls; the concatenation of everything
+//! returned since I2C_TRACE_Start is a valid trace.
+//!
+//! \return number of bytes copied.
+//
+//****************************************************************************
+unsigned long
+I2C_TRACE_Read(unsigned char *pucDest, unsigned long ulMax)
+{
+    uint32_t ulTail=g_sTrace.ulTail;
+    uint32_t ulLen, ulPos, ulFirst;
+
+    if (g_sTrace.pucBuffer==NULL)
+        return 0;
+
+    ulLen=I2C_ATOMIC_LOAD(&g_sTrace.ulHead)-ulTail;
+    if (ulLen>ulMax) ulLen=ulMax;
+
+    ulPos=ulTail%g_sTrace.ulSize;
+    ulFirst=g_sTrace.ulSize-ulPos;
+    if (ulFirst>ulLen) ulFirst=ulLen;
+    memcpy(pucDest,&g_sTrace.pucBuffer[ulPos],ulFirst);
+    memcpy(pucDest+ulFirst,g_sTrace.pucBuffer,ulLen-ulFirst);
+
+    I2C_ATOMIC_STORE(&g_sTrace.ulTail,ulTail+ulLen);
+    return ulLen;
+}
+
+//****************************************************************************
+//
+//! Returns the recorder counters and optionally clears them
+//!
+//! Not synchronized with the recorder (a task must not take its lock, an
+//! ISR would spin on it): a record finishing meanwhile may be missed.
+//
+//****************************************************************************
+void
+I2C_TRACE_GetStats(I2C_TRACE_Stats *psStats, bool bReset)
+{
+    *psStats=g_sTrace.sStats;
+    if (bReset)
+    {
+        memset(&g_sTrace.sStats,0,sizeof(g_sTrace.sStats));
+    }
+}
+
+//****************************************************************************
+//
+//! Prepares to decode a trace held in memory
+//!
+//! \param psReader is the reader instance (caller storage)
+//! \param pucData, ulLen are the whole trace, header included
+//!
+//! \return 0: Success, < 0: not a trace of a known version.
+//
+//****************************************************************************
+int
+I2C_TRACE_ReaderInit(I2C_TRACE_Reader *psReader, const unsigned char *pucData,
+                     unsigned long ulLen)
+{
+    RETERR_IF_TRUE(psReader == NULL);
+    RETERR_IF_TRUE(pucData == NULL);
+    RETERR_IF_TRUE(ulLen < I2C_TRACE_HEADER_LEN);
+    RETERR_IF_TRUE(memcmp(pucData,"I2CT",4) != 0);
+    RETERR_IF_TRUE(pucData[4] != I2C_TRACE_VERSION);
+
+    psReader->pucData=pucData;
+    psReader->ulLen=ulLen;
+    psReader->ulPos=I2C_TRACE_HEADER_LEN;
+    psReader->ulTickHz=I2CTraceGet32(&pucData[5]);
+    psReader->ullTime=0;
+    RETERR_IF_TRUE(psReader->ulTickHz == 0);
+    return SUCCESS;
+}
+
+//****************************************************************************
+//
+//! Decodes the next record
+//!
+//! \param psReader is the reader
+//! \param psRecord receives the record; its byte pointers point into the
+//! trace
+//!
+//! \return 1: a record, 0: end of the trace, < 0: truncated or corrupt
+//! record (the reader stays on it).
+//
+//****************************************************************************
+int
+I2C_TRACE_ReaderNext(I2C_TRACE_Reader *psReader, I2C_TRACE_Entry *psRecord)
+{
+    const unsigned char *pucData=psReader->pucData;
+    unsigned long ulLen=psReader->ulLen, ulPos=psReader->ulPos;
+    uint32_t ulDelta=0;
+    unsigned char ucFlags, ucShift=0;
+
+    if (ulPos>=ulLen)
+        return 0;
+
+    ucFlags=pucData[ulPos++];
+    psRecord->ucCommand=ucFlags&I2C_TRACE_CMD_MASK;
+    RETERR_IF_TRUE(psRecord->ucCommand > I2C_TRACE_READ_FROM);
+    RETERR_IF_TRUE((ucFlags & 0x80) != 0);
+    psRecord->ucBus=(ucFlags>>I2C_TRACE_BUS_SHIFT)&I2C_TRACE_BUS_MASK;
+    psRecord->bError=(ucFlags&I2C_TRACE_ERROR)!=0;
+    psRecord->bCont=(ucFlags&I2C_TRACE_CONT)!=0;
+    psRecord->bGap=(ucFlags&I2C_TRACE_GAP)!=0;
+
+    do
+    {
+        RETERR_IF_TRUE(ulPos >= ulLen || ucShift > 28);
+        ulDelta|=(uint32_t)(pucData[ulPos]&0x7F)<<ucShift;
+        ucShift+=7;
+    } while (pucData[ulPos++]&0x80);
+
+    RETERR_IF_TRUE(ulPos >= ulLen);
+    psRecord->ucDevAddr=pucData[ulPos++];
+
+    psRecord->pucWr=NULL;
+    psRecord->ucWrLen=0;
+    if (psRecord->ucCommand!=I2C_TRACE_READ)
+    {
+        RETERR_IF_TRUE(ulPos >= ulLen);
+        psRecord->ucWrLen=pucData[ulPos++];
+        RETERR_IF_TRUE(ulLen - ulPos < psRecord->ucWrLen);
+        psRecord->pucWr=&pucData[ulPos];
+        ulPos+=psRecord->ucWrLen;
+    }
+
+    psRecord->pucRd=NULL;
+    psRecord->ucRdLen=0;
+    if (psRecord->ucCommand!=I2C_TRACE_WRITE)
+    {
+        RETERR_IF_TRUE(ulPos >= ulLen);
+        psRecord->ucRdLen=pucData[ulPos++];
+        if (!psRecord->bError)
+        {
+            RETERR_IF_TRUE(ulLen - ulPos < psRecord->ucRdLen);
+            psRecord->pucRd=&pucData[ulPos];
+            ulPos+=psRecord->ucRdLen;
+        }
+    }
+
+    psReader->ullTime+=ulDelta;
+    psRecord->ullTime=psReader->ullTime;
+    psReader->ulPos=ulPos;
+    return 1;
+}
@@ -0,0 +1,135 @@
+//*****************************************************************************
+// i2c_trace.h
+//
+// Bus transaction recorder for i2c_if, and reader of the traces it writes.
+//
+// Built with I2C_IF_TRACE defined, i2c_if.c and i2c_if_linux.c hand every
+// finished transaction (slave address, bytes written, bytes read, status
+// and time) to I2C_TRACE_Record, which encodes it into a caller-supplied
+// RAM ring. The application drains the ring with I2C_TRACE_Read into a
+// file, a UART or flash. i2c_if_replay.c plays a trace back to the
+// unmodified drivers on Linux.
+//
+// Trace format, little-endian:
+//  -> Header: "I2CT", version, tick rate in Hz (4 bytes).
+//  -> Record: flags (command, error, continuation, gap, bus), ticks since
+//     the previous record (LEB128), slave address, then for writes and
+//     register reads the written length and bytes, and for reads and
+//     register reads the read length and bytes (omitted on error).
+// A register read costs 6 to 8 bytes over the data it returns.
+//
+// On the TM4C the records are written from the I2C ISRs: keep all traced
+// buses at the same interrupt priority so that records never interleave.
+// The ring has a single consumer.
+//
+//*****************************************************************************
+
+#ifndef __I2C_TRACE_H__
+#define __I2C_TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Format constants.
+//
+//*****************************************************************************
+#define I2C_TRACE_VERSION       1
+#define I2C_TRACE_HEADER_LEN    9
+
+// Record flags
+#define I2C_TRACE_WRITE         0x00    // I2C_IF_Write
+#define I2C_TRACE_READ          0x01    // I2C_IF_Read
+#define I2C_TRACE_READ_FROM     0x02    // I2C_IF_ReadFrom (and each segment of ..Multi)
+#define I2C_TRACE_CMD_MASK      0x03
+#define I2C_TRACE_ERROR         0x04    // the transaction failed
+#define I2C_TRACE_CONT          0x08    // same bus transaction as the previous record
+#define I2C_TRACE_GAP           0x10    // records were dropped before this one
+#define I2C_TRACE_BUS_SHIFT     5       // bits 5-6: controller index
+
+// Sub-address bytes kept per register read by the TM4C backend, which
+// overwrites them with the data
+#define I2C_TRACE_MAX_WR        4
+#define I2C_TRACE_WR_LEN(len)   (((len) > I2C_TRACE_MAX_WR) ? I2C_TRACE_MAX_WR : (len))
+
+// Longest encoded record
+#define I2C_TRACE_MAX_RECORD    (1 + 5 + 1 + 1 + 255 + 1 + 255)
+
+//*****************************************************************************
+//
+// Recorder counters.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulRecords;        // transactions recorded
+    unsigned long ulDropped;        // transactions lost to a full ring
+    unsigned long ulBytes;          // bytes encoded, header included
+} I2C_TRACE_Stats;
+
+//*****************************************************************************
+//
+// One decoded record. The byte pointers point into the trace.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ucBus;
+    unsigned char ucCommand;        // I2C_TRACE_WRITE, _READ or _READ_FROM
+    unsigned char ucDevAddr;
+    bool bError;
+    bool bCont;
+    bool bGap;
+    uint64_t ullTime;               // ticks since the start of the trace
+    const unsigned char *pucWr;
+    unsigned char ucWrLen;
+    const unsigned char *pucRd;     // NULL on error
+    unsigned char ucRdLen;
+} I2C_TRACE_Entry;
+
+//*****************************************************************************
+//
+// Reader of a trace held in memory.
+//
+//*****************************************************************************
+typedef struct
+{
+    const unsigned char *pucData;
+    unsigned long ulLen;
+    unsigned long ulPos;
+    unsigned long ulTickHz;
+    uint64_t ullTime;
+} I2C_TRACE_Reader;
+
+//*****************************************************************************
+//
+// API Function prototypes
+//
+//*****************************************************************************
+extern int I2C_TRACE_Start(unsigned char *pucBuffer, unsigned long ulSize,
+                           unsigned long ulTickHz);
+extern void I2C_TRACE_Stop(void);
+extern void I2C_TRACE_Record(unsigned char ucBus, unsigned char ucCommand,
+                             unsigned char ucDevAddr,
+                             const unsigned char *pucWr, unsigned char ucWrLen,
+                             const unsigned char *pucRd, unsigned char ucRdLen,
+                             int iStatus, bool bCont, unsigned long ulTicks);
+extern unsigned long I2C_TRACE_Read(unsigned char *pucDest, unsigned long ulMax);
+extern void I2C_TRACE_GetStats(I2C_TRACE_Stats *psStats, bool bReset);
+extern int I2C_TRACE_ReaderInit(I2C_TRACE_Reader *psReader,
+                                const unsigned char *pucData,
+                                unsigned long ulLen);
+extern int I2C_TRACE_ReaderNext(I2C_TRACE_Reader *psReader,
+                                I2C_TRACE_Entry *psRecord);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //  __I2C_TRACE_H__
@@ -0,0 +1,167 @@
+//*****************************************************************************
+// os_if.h
+//
+// The few kernel services used by i2c_if, i2c_sched and the LSM9DS1 driver.
+//
+// By default they map onto FreeRTOS (direct-to-task notifications and
+// vTaskDelay) with no extra code. Define OS_IF_BAREMETAL to build without a
+// kernel: there is a single thread of execution (the main super-loop) plus
+// interrupts, so
+//  - a "task" is a word of notification bits. OS_IF_NotifyFromISR sets bits,
+//    OS_IF_Wait sleeps the core (WFI) until one of the wanted bits is set.
+//  - OS_IF_Delay counts ticks of a SysTick interrupt. Call OS_IF_Init once
+//    and install OS_IF_TickISR as the SysTick handler.
+// Blocking calls must then not be made from interrupt handlers; use the
+// asynchronous I2C_IF calls (callback or completion flag) there instead.
+//
+// Define OS_IF_POSIX for Linux builds (with the i2c-dev backend, see
+// I2C_IF_LINUX). Only the delay is needed there, as i2c_if_linux.c blocks
+// in the kernel.
+//
+// OS_IF_HAS_TASKS is defined when the build has a scheduler, i.e. i2c_sched
+// may create its own task (OS_IF_TaskCreate).
+//
+// A task has one word of notification bits for everything it waits for:
+// i2c_if uses the low bits, i2c_sched its tick bit. OS_IF_Wait only clears
+// the bits it was asked for.
+//
+//*****************************************************************************
+
+#ifndef __OS_IF_H__
+#define __OS_IF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(OS_IF_POSIX)
+#include <time.h>
+#elif !defined(OS_IF_BAREMETAL)
+//Include FreeRTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(OS_IF_POSIX)
+
+//*****************************************************************************
+//
+// Linux build
+//
+//*****************************************************************************
+typedef unsigned int OS_IF_Priority;        // unused, i2c_sched has no task
+
+#define OS_IF_TICK_HZ           1000
+#define OS_IF_MS_TO_TICKS(ms)   ((uint32_t)(ms))
+
+static inline void
+OS_IF_Delay(uint32_t ulTicks)
+{
+    struct timespec sDelay = { ulTicks / 1000, (long)(ulTicks % 1000) * 1000000L };
+
+    nanosleep(&sDelay, NULL);
+}
+
+#elif !defined(OS_IF_BAREMETAL)
+
+//*****************************************************************************
+//
+// FreeRTOS build
+//
+//*****************************************************************************
+#define OS_IF_HAS_TASKS
+
+typedef TaskHandle_t OS_IF_Task;
+typedef UBaseType_t OS_IF_Priority;
+typedef BaseType_t OS_IF_ISRState;         // "higher priority task woken"
+
+#define OS_IF_CPU_CLOCK_HZ      configCPU_CLOCK_HZ
+#define OS_IF_TICK_HZ           configTICK_RATE_HZ
+#define OS_IF_MS_TO_TICKS(ms)   pdMS_TO_TICKS(ms)
+
+// Highest priority an interrupt calling the ...FromISR services may have
+#define OS_IF_ISR_PRIORITY      configMAX_SYSCALL_INTERRUPT_PRIORITY
+
+#define OS_IF_ISR_STATE_INIT    pdFALSE
+#define OS_IF_CurrentTask()     xTaskGetCurrentTaskHandle()
+#define OS_IF_Delay(ticks)      vTaskDelay(ticks)
+#define OS_IF_EndISR(state)     portEND_SWITCHING_ISR(state)
+#define OS_IF_NotifyFromISR(task, bits, pstate) \
+        xTaskNotifyFromISR((task), (bits), eSetBits, (pstate))
+
+// True if the task was created; ulWords is the stack depth in words
+#define OS_IF_TaskCreate(fn, name, ulWords, arg, prio, ptask) \
+        (xTaskCreate((fn), (name), (ulWords), (arg), (prio), (ptask)) == pdPASS)
+
+//*****************************************************************************
+//
+// Blocks until one of the ulMask bits is notified. Returns the notified
+// bits; those in ulMask are cleared.
+//
+//*****************************************************************************
+static inline uint32_t
+OS_IF_Wait(uint32_t ulMask)
+{
+    uint32_t ulBits = 0;
+
+    while (!(ulBits & ulMask))
+    {
+        xTaskNotifyWait(0, ulMask, &ulBits, portMAX_DELAY);
+    }
+    return ulBits;
+}
+
+#else
+
+//*****************************************************************************
+//
+// Bare-metal build
+//
+//*****************************************************************************
+typedef volatile uint32_t *OS_IF_Task;
+typedef unsigned int OS_IF_Priority;        // unused, there are no tasks
+typedef int OS_IF_ISRState;                 // unused, there is no scheduler
+
+// Core clock. Define it to a constant if the clock is known at build time
+#ifndef OS_IF_CPU_CLOCK_HZ
+#include "driverlib/sysctl.h"
+#define OS_IF_CPU_CLOCK_HZ      SysCtlClockGet()
+#endif
+
+#ifndef OS_IF_TICK_HZ
+#define OS_IF_TICK_HZ           1000
+#endif
+#define OS_IF_MS_TO_TICKS(ms)   ((uint32_t)(((uint64_t)(ms) * OS_IF_TICK_HZ) / 1000))
+
+// Without a kernel any priority works; default to the FreeRTOS usual one so
+// interrupt nesting is the same in both builds.
+#ifndef OS_IF_ISR_PRIORITY
+#define OS_IF_ISR_PRIORITY      0xA0
+#endif
+
+// Notification bits of the super-loop, the only "task"
+extern volatile uint32_t g_ulOS_IF_Notify;
+
+#define OS_IF_ISR_STATE_INIT    0
+#define OS_IF_CurrentTask()     (&g_ulOS_IF_Notify)
+#define OS_IF_EndISR(state)     ((void)(state))
+#define OS_IF_NotifyFromISR(task, bits, pstate) \
+        ((void)(pstate), __atomic_fetch_or((task), (bits), __ATOMIC_RELEASE))
+
+extern void OS_IF_Init(void);
+extern void OS_IF_TickISR(void);
+extern uint32_t OS_IF_Ticks(void);
+extern void OS_IF_Delay(uint32_t ulTicks);
+extern uint32_t OS_IF_Wait(uint32_t ulMask);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //  __OS_IF_H__
@@ -0,0 +1,98 @@
+//*****************************************************************************
+// os_if_baremetal.c
+//
+// Kernel-less implementation of os_if.h, built with OS_IF_BAREMETAL.
+//
+// The whole "RTOS" is a tick counter and a word of notification bits. The
+// core sleeps with WFI while waiting; interrupts are masked between checking
+// the bits and WFI so a notification arriving in between still wakes it (a
+// pending interrupt ends WFI even when PRIMASK is set).
+//
+//*****************************************************************************
+
+#ifdef OS_IF_BAREMETAL
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driverlib/cpu.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/systick.h"
+
+#include "os_if.h"
+
+volatile uint32_t g_ulOS_IF_Notify;
+
+static volatile uint32_t g_ulOSTicks;
+
+//****************************************************************************
+//
+//! Starts the SysTick time base at OS_IF_TICK_HZ
+//
+//****************************************************************************
+void
+OS_IF_Init(void)
+{
+    SysTickPeriodSet(OS_IF_CPU_CLOCK_HZ / OS_IF_TICK_HZ);
+    SysTickIntEnable();
+    SysTickEnable();
+}
+
+//SysTick handler
+void
+OS_IF_TickISR(void)
+{
+    g_ulOSTicks++;
+}
+
+uint32_t
+OS_IF_Ticks(void)
+{
+    return g_ulOSTicks;
+}
+
+//****************************************************************************
+//
+//! Sleeps for ulTicks periods of the time base
+//
+//****************************************************************************
+void
+OS_IF_Delay(uint32_t ulTicks)
+{
+    uint32_t ulStart = g_ulOSTicks;
+
+    while ((uint32_t)(g_ulOSTicks - ulStart) < ulTicks)
+    {
+        CPUwfi();
+    }
+}
+
+//****************************************************************************
+//
+//! Sleeps until one of the ulMask bits is notified
+//!
+//! \return the notified bits; those in ulMask are cleared.
+//
+//****************************************************************************
+uint32_t
+OS_IF_Wait(uint32_t ulMask)
+{
+    uint32_t ulBits;
+    bool bMasked;
+
+    for (;;)
+    {
+        bMasked = IntMasterDisable();
+        ulBits = g_ulOS_IF_Notify;
+        if (ulBits & ulMask)
+        {
+            g_ulOS_IF_Notify = ulBits & ~ulMask;
+            if (!bMasked) IntMasterEnable();
+            return ulBits;
+        }
+        CPUwfi();
+        if (!bMasked) IntMasterEnable();
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/******************************************************************************
+
+	i2c_if_cyclebench.c
+	CPU cost per transaction of the TM4C I2C backend, run on the host.
+
+	cc -O2 -I.. -Itm4c_host i2c_if_cyclebench.c ../i2c_if.c \
+	   tm4c_host/tm4c_host.c -o i2c_if_cyclebench
+
+	The queue-based i2c_if.c of the first commit, for comparison:
+	mkdir -p /tmp/queue && for f in i2c_if.c i2c_if.h; do \
+	   git show $(git rev-list --max-parents=0 HEAD):$f > /tmp/queue/$f; done
+	cc -O2 -DCYCLEBENCH_QUEUE -I/tmp/queue -Itm4c_host i2c_if_cyclebench.c \
+	   /tmp/queue/i2c_if.c tm4c_host/tm4c_host.c -o i2c_if_cyclebench_queue
+
+	i2c_if_cyclebench [-n transactions] [-r rounds]
+
+The unmodified i2c_if.c, ISR included, drives the I2C3 master of
+tm4c_host with a register-file slave at 0x6B; every command completes at
+once and the ISR runs right away, so what is timed is the CPU work of a
+blocking call: submission, every ISR entry and the wake-up. For three
+transaction shapes the tool prints host cycles per transaction (x86 TSC,
+nanoseconds elsewhere; the best of -r rounds, 5 by default), ISR
+entries, kernel critical sections (including the interrupt masking of the
+...FromISR calls) and bytes copied through kernel queues. Both builds share the peripheral model, so the difference
+of the cycle figures is the difference of the backends; the counts are
+what the code does on the target too. Cycles on the Cortex-M4 come from
+an I2C_IF_PROFILE build there (I2C_IF_GetProfile).
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i2c_if.h"
+#include "tm4c_host.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define CYCLE_UNIT		"cycles"
+	static uint64_t cycles(void) { return __rdtsc(); }
+#else
+	#define CYCLE_UNIT		"ns"
+	static uint64_t cycles(void)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	}
+#endif
+
+#define SLAVE			0x6B
+
+#ifdef CYCLEBENCH_QUEUE
+	#define BUILD			"queue (first commit)"
+	#define busOpen()		(TM4CHostSetHandler(INT_I2C3, I2C_IF_ISR), I2C_IF_Open(I2C_MASTER_MODE_FST) == 0)
+	#define busWrite(data, len)	I2C_IF_Write(SLAVE, data, len, 1)
+	#define busReadFrom(wr, wrLen, rd, rdLen) \
+		I2C_IF_ReadFrom(SLAVE, wr, wrLen, rd, rdLen)
+	extern void I2C_IF_ISR(void);
+#else
+	#define BUILD			"ring"
+	static I2C_IF_Handle bus;
+	#define busOpen()		(TM4CHostSetHandler(INT_I2C3, I2C_IF_ISR3), \
+					 (bus = I2C_IF_Open(&g_sI2C_IF_I2C3, I2C_MASTER_MODE_FST)) != NULL)
+	#define busWrite(data, len)	I2C_IF_Write(bus, SLAVE, data, len, 1)
+	#define busReadFrom(wr, wrLen, rd, rdLen) \
+		I2C_IF_ReadFrom(bus, SLAVE, wr, wrLen, rd, rdLen)
+#endif
+
+static uint8_t regs[256];
+
+int main(int argc, char **argv)
+{
+	static const char *names[3] = { "write 2 bytes", "read 1 register", "read 6 registers" };
+	unsigned long count = 100000, rounds = 5, round, ii;
+	TM4CHostCounters counters;
+	uint8_t wr[2], rd[6];
+	uint64_t start, spent, best;
+	double total;
+	int opt, shape, failed = 0;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': count = strtoul(optarg, NULL, 0); break;
+		case 'r': rounds = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n transactions] [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (count == 0)
+		count = 1;
+	if (rounds == 0)
+		rounds = 1;
+
+	TM4CHostAddSlave(I2C3_BASE, SLAVE, regs);
+	if (!busOpen())
+	{
+		fprintf(stderr, "I2C_IF_Open failed\n");
+		return 1;
+	}
+	for (ii = 0; ii < sizeof(regs); ii++)
+		regs[ii] = (uint8_t)ii;
+
+	printf("%s backend, %lu transactions each\n", BUILD, count);
+	printf("%-18s %10s %12s %10s %12s\n", "", CYCLE_UNIT, "ISR entries", "critical", "queue bytes");
+	for (shape = 0; shape < 3; shape++)
+	{
+		best = UINT64_MAX;
+		TM4CHostGetCounters(&counters, true);
+		for (round = 0; round < rounds; round++)
+		{
+			start = cycles();
+			for (ii = 0; ii < count; ii++)
+			{
+				wr[0] = 0x28;
+				wr[1] = (uint8_t)ii;
+				switch (shape)
+				{
+				case 0: failed |= busWrite(wr, 2); break;
+				case 1: failed |= busReadFrom(wr, 1, rd, 1); break;
+				default: failed |= busReadFrom(wr, 1, rd, 6); break;
+				}
+			}
+			spent = cycles() - start;
+			if (spent < best)
+				best = spent;
+		}
+		TM4CHostGetCounters(&counters, true);
+		total = (double)count * rounds;
+		printf("%-18s %10.0f %12.2f %10.2f %12.1f\n", names[shape], (double)best / count,
+		       counters.ulISREntries / total, counters.ulCritical / total,
+		       counters.ulQueueBytes / total);
+	}
+	if (failed)
+		fprintf(stderr, "some transactions failed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+
+	i2c_if_tracecheck.c
+	Checks the records the TM4C backend writes to an I2C trace.
+
+	cc -O2 -DI2C_IF_TRACE -I.. -Itm4c_host i2c_if_tracecheck.c ../i2c_if.c \
+	   ../i2c_trace.c tm4c_host/tm4c_host.c -o i2c_if_tracecheck
+
+	i2c_if_tracecheck [-v]
+
+The unmodified i2c_if.c, ISR included, runs on the I2C3 master of
+tm4c_host with a register-file slave at 0x6B. The tool issues a fixed mix
+of blocking and asynchronous writes, reads and register reads, one of them
+to an address nobody answers, so every record goes through the real ISR
+completion path. It then decodes the trace and compares command, slave,
+error flag and the bytes written and read of each record with what was
+submitted. -v prints the records. Exit status 0 if they all match, 1 if
+not.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "i2c_if.h"
+#include "i2c_trace.h"
+#include "tm4c_host.h"
+
+#define SLAVE			0x6B
+#define ABSENT			0x55
+#define STEPS			7
+
+typedef struct
+{
+	unsigned char command;
+	unsigned char address;
+	bool error;
+	unsigned char wr[4];
+	unsigned char wrLen;
+	unsigned char rd[8];
+	unsigned char rdLen;
+} expected_record;
+
+static uint8_t regs[256];
+static unsigned char trace[4096];
+
+static bool sameBytes(const unsigned char *got, unsigned char gotLen,
+                      const unsigned char *want, unsigned char wantLen)
+{
+	return (gotLen == wantLen) && ((wantLen == 0) || (memcmp(got, want, wantLen) == 0));
+}
+
+static void printBytes(const unsigned char *data, unsigned char len)
+{
+	unsigned char ii;
+
+	for (ii = 0; ii < len; ii++)
+		printf(" %02x", data[ii]);
+}
+
+int main(int argc, char **argv)
+{
+	static const expected_record expected[STEPS] =
+	{
+		{ I2C_TRACE_WRITE,     SLAVE,  false, { 0x20, 0xaa, 0xbb }, 3, { 0 }, 0 },
+		{ I2C_TRACE_READ_FROM, SLAVE,  false, { 0x20 }, 1, { 0xaa, 0xbb }, 2 },
+		{ I2C_TRACE_READ,      SLAVE,  false, { 0 }, 0, { 0x22, 0x23, 0x24 }, 3 },
+		{ I2C_TRACE_READ_FROM, SLAVE,  false, { 0x0f }, 1, { 0x0f }, 1 },
+		{ I2C_TRACE_READ_FROM, ABSENT, true,  { 0x10 }, 1, { 0 }, 2 },
+		{ I2C_TRACE_WRITE,     SLAVE,  false, { 0x30, 0x11 }, 2, { 0 }, 0 },
+		{ I2C_TRACE_READ_FROM, SLAVE,  false, { 0x28 }, 1, { 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d }, 6 },
+	};
+	static const char *commands[3] = { "W ", "R ", "RF" };
+	I2C_IF_Handle bus;
+	I2C_TRACE_Reader reader;
+	I2C_TRACE_Entry record;
+	unsigned char wr[3], rd[8];
+	volatile int flag;
+	unsigned long len;
+	uint64_t lastTime = 0;
+	bool verbose = false, ok;
+	int opt, result, ii, mismatches = 0;
+
+	while ((opt = getopt(argc, argv, "v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (ii = 0; ii < (int)sizeof(regs); ii++)
+		regs[ii] = (uint8_t)ii;
+	TM4CHostAddSlave(I2C3_BASE, SLAVE, regs);
+	TM4CHostSetHandler(INT_I2C3, I2C_IF_ISR3);
+	if ((I2C_TRACE_Start(trace, sizeof(trace), configCPU_CLOCK_HZ) != 0) ||
+	    ((bus = I2C_IF_Open(&g_sI2C_IF_I2C3, I2C_MASTER_MODE_FST)) == NULL))
+	{
+		fprintf(stderr, "setup failed\n");
+		return 1;
+	}
+
+	// The same transactions as expected[], in order
+	wr[0] = 0x20; wr[1] = 0xaa; wr[2] = 0xbb;
+	result = I2C_IF_Write(bus, SLAVE, wr, 3, 1);
+	wr[0] = 0x20;
+	result |= I2C_IF_ReadFrom(bus, SLAVE, wr, 1, rd, 2);
+	result |= I2C_IF_Read(bus, SLAVE, rd, 3);
+	wr[0] = 0x0f;
+	flag = I2C_IF_PENDING;
+	result |= I2C_IF_ReadFromAsync(bus, SLAVE, wr, 1, rd, 1, I2C_IF_SetFlag, (void *)&flag);
+	result |= flag;
+	wr[0] = 0x10;
+	if (I2C_IF_ReadFrom(bus, ABSENT, wr, 1, rd, 2) == 0)
+		result |= 1;
+	wr[0] = 0x30; wr[1] = 0x11;
+	flag = I2C_IF_PENDING;
+	result |= I2C_IF_WriteAsync(bus, SLAVE, wr, 2, I2C_IF_SetFlag, (void *)&flag);
+	result |= flag;
+	wr[0] = 0x28;
+	result |= I2C_IF_ReadFrom(bus, SLAVE, wr, 1, rd, 6);
+	if (result != 0)
+	{
+		fprintf(stderr, "a transaction did not complete as expected\n");
+		return 1;
+	}
+
+	len = I2C_TRACE_Read(trace, sizeof(trace));
+	I2C_TRACE_ReaderInit(&reader, trace, len);
+	for (ii = 0; (result = I2C_TRACE_ReaderNext(&reader, &record)) > 0; ii++)
+	{
+		if (verbose)
+		{
+			printf("%2d bus %u %02x %s", ii, record.ucBus, record.ucDevAddr,
+			       record.ucCommand < 3 ? commands[record.ucCommand] : "??");
+			printBytes(record.pucWr, record.ucWrLen);
+			printf(" ->");
+			if (record.bError)
+				printf(" ERR (%u)", record.ucRdLen);
+			else
+				printBytes(record.pucRd, record.ucRdLen);
+			printf("\n");
+		}
+		if (ii >= STEPS)
+		{
+			mismatches++;
+			continue;
+		}
+		ok = (record.ucBus == 3) && !record.bCont && !record.bGap &&
+		     (record.ucCommand == expected[ii].command) &&
+		     (record.ucDevAddr == expected[ii].address) &&
+		     (record.bError == expected[ii].error) &&
+		     (record.ullTime >= lastTime) &&
+		     sameBytes(record.pucWr, record.ucWrLen, expected[ii].wr, expected[ii].wrLen) &&
+		     (record.ucRdLen == expected[ii].rdLen) &&
+		     (record.bError || sameBytes(record.pucRd, record.ucRdLen, expected[ii].rd,
+		                                 expected[ii].rdLen));
+		if (!ok)
+		{
+			fprintf(stderr, "record %d does not match the transaction submitted\n", ii);
+			mismatches++;
+		}
+		lastTime = record.ullTime;
+	}
+	if (result < 0)
+	{
+		fprintf(stderr, "corrupt trace after %d records\n", ii);
+		return 1;
+	}
+	if (ii != STEPS)
+	{
+		fprintf(stderr, "%d records, expected %d\n", ii, STEPS);
+		return 1;
+	}
+	printf("%d records checked, %d mismatches\n", ii, mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+
+	i2c_tracedump.c
+	Prints a bus trace written by i2c_trace.c.
+
+	cc -O2 -I.. i2c_tracedump.c ../i2c_trace.c -o i2c_tracedump
+
+	i2c_tracedump [-s] [trace]
+
+One line per record: time in seconds, bus, slave address, W (write),
+R (read) or RF (register read), the bytes written, "->" and the bytes read.
+"ERR" marks a failed transaction, "+" a segment of the same combined
+transfer as the previous line, and a "-- gap --" line records lost to a
+full ring. -s only prints the summary: records, errors, gaps, bytes and
+transactions per second per slave address.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "i2c_trace.h"
+
+int main(int argc, char **argv)
+{
+	static unsigned long perAddress[128];
+	I2C_TRACE_Reader reader;
+	I2C_TRACE_Entry record;
+	unsigned char *data = NULL;
+	size_t size = 0, len = 0, got;
+	unsigned long records = 0, errors = 0, gaps = 0;
+	double seconds = 0.0;
+	bool summary = false;
+	FILE *in = stdin;
+	int opt, result, ii;
+	static const char *commands[3] = { "W ", "R ", "RF" };
+
+	while ((opt = getopt(argc, argv, "s")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': summary = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-s] [trace]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((optind < argc) && ((in = fopen(argv[optind], "rb")) == NULL))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	do
+	{
+		if (len == size)
+		{
+			size = size ? 2 * size : 65536;
+			if ((data = realloc(data, size)) == NULL)
+				return 1;
+		}
+		got = fread(data + len, 1, size - len, in);
+		len += got;
+	} while (got > 0);
+
+	if (I2C_TRACE_ReaderInit(&reader, data, len) != 0)
+	{
+		fprintf(stderr, "not a bus trace\n");
+		return 1;
+	}
+
+	while ((result = I2C_TRACE_ReaderNext(&reader, &record)) == 1)
+	{
+		seconds = (double)record.ullTime / reader.ulTickHz;
+		records++;
+		errors += record.bError;
+		gaps += record.bGap;
+		perAddress[record.ucDevAddr & 0x7F]++;
+		if (summary)
+			continue;
+
+		if (record.bGap)
+			printf("-- gap --\n");
+		printf("%12.6f %u 0x%02X %s%s", seconds, record.ucBus, record.ucDevAddr,
+		       commands[record.ucCommand], record.bCont ? "+" : " ");
+		for (ii = 0; ii < record.ucWrLen; ii++)
+			printf(" %02X", record.pucWr[ii]);
+		if (record.ucCommand != I2C_TRACE_WRITE)
+		{
+			printf(" ->");
+			if (record.bError)
+				printf(" (%u)", record.ucRdLen);
+			else
+				for (ii = 0; ii < record.ucRdLen; ii++)
+					printf(" %02X", record.pucRd[ii]);
+		}
+		printf("%s\n", record.bError ? " ERR" : "");
+	}
+	if (result < 0)
+		fprintf(stderr, "corrupt record at byte %lu\n", reader.ulPos);
+
+	printf("%lu records, %lu errors, %lu gaps, %lu bytes, %.3f s at %lu Hz\n",
+	       records, errors, gaps, (unsigned long)len, seconds, reader.ulTickHz);
+	for (ii = 0; ii < 128; ii++)
+		if (perAddress[ii] != 0)
+			printf("  0x%02X: %lu transactions, %.1f/s\n", ii, perAddress[ii],
+			       (seconds > 0.0) ? perAddress[ii] / seconds : 0.0);
+	free(data);
+	if (in != stdin)
+		fclose(in);
+	return (result < 0) ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+
+	lsm9ds1_allan.c
+	Allan deviation and noise model of a recorded LSM9DS1 FIFO log.
+
+	cc -O2 -I.. lsm9ds1_allan.c ../LSM9DS1_Allan.c -lm -o lsm9ds1_allan
+
+	lsm9ds1_allan [-a] [-b 6|12] [-r rate Hz] [-s units/count] [log]
+
+The log is the raw FIFO stream as LSM9DS1_wmDrain() stores it, blocks
+written back to back (12 bytes per sample, gyro X,Y,Z then accel X,Y,Z,
+or 6 with -b 6, accel only), read from the file or stdin. It goes through
+the same engine the target runs, so results match an on-device run over
+the same samples. The tool prints the Allan deviation per octave and axis,
+then the fitted noise terms; -a selects the accelerometer. The default
+scales are those of 245 dps and 2 g.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Allan.h"
+
+#define GYRO_LSB_DPS	0.00875f
+#define ACCEL_LSB_G		0.000061f
+#define BLOCK			32
+
+int main(int argc, char **argv)
+{
+	uint8_t source = LSM9DS1_ALLAN_GYRO, sampleBytes = 12, count, found, ii, axis;
+	uint8_t block[BLOCK * 12];
+	float rate = 952.0f, scale = 0.0f;
+	lsm9ds1_allan_point points[LSM9DS1_ALLAN_LEVELS];
+	lsm9ds1_allan_model model;
+	static const char *names[3] = { "X", "Y", "Z" };
+	const char *unit;
+	lsm9ds1_allan *allan;
+	FILE *in = stdin;
+	size_t got;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ab:r:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a': source = LSM9DS1_ALLAN_ACCEL; break;
+		case 'b': sampleBytes = (uint8_t)strtoul(optarg, NULL, 0); break;
+		case 'r': rate = strtof(optarg, NULL); break;
+		case 's': scale = strtof(optarg, NULL); break;
+		default:
+			fprintf(stderr, "usage: %s [-a] [-b 6|12] [-r rate] [-s scale] [log]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (scale == 0.0f)
+		scale = (source == LSM9DS1_ALLAN_GYRO) ? GYRO_LSB_DPS : ACCEL_LSB_G;
+	unit = (source == LSM9DS1_ALLAN_GYRO) ? "dps" : "g";
+	if ((optind < argc) && ((in = fopen(argv[optind], "rb")) == NULL))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	allan = malloc(sizeof(*allan));
+	if ((allan == NULL) || !(rate > 0.0f) ||
+	    !LSM9DS1_allanInit(allan, source, scale, 1.0f / rate) ||
+	    ((sampleBytes != 12) && (sampleBytes != 6)) ||
+	    ((sampleBytes == 6) && (source == LSM9DS1_ALLAN_GYRO)))
+	{
+		fprintf(stderr, "invalid settings\n");
+		return 2;
+	}
+
+	while ((got = fread(block, sampleBytes, BLOCK, in)) > 0)
+	{
+		count = (uint8_t)got;
+		LSM9DS1_allanFeed(allan, block, count, sampleBytes);
+	}
+
+	found = LSM9DS1_allanResult(allan, points, LSM9DS1_ALLAN_LEVELS);
+	printf("%lu samples at %.1f Hz (%.1f s), engine RAM %lu bytes\n",
+	       (unsigned long)allan->samples, rate, allan->samples / rate,
+	       (unsigned long)sizeof(*allan));
+	printf("       tau s     terms  adev X %-4s  adev Y %-4s  adev Z %-4s\n", unit, unit, unit);
+	for (ii = 0; ii < found; ii++)
+		printf("%12.5f %9lu %12.4e %12.4e %12.4e\n", points[ii].tau,
+		       (unsigned long)points[ii].terms, points[ii].adev[0],
+		       points[ii].adev[1], points[ii].adev[2]);
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		if (!LSM9DS1_allanFit(points, found, axis, &model))
+			continue;
+		printf("%s: N %.4e %s/rtHz (%.4f %s/rt-h)  B %.4e %s (min %.4e at %.3g s)  "
+		       "K %.4e %s*rtHz  Q %.3e  R %.3e\n", names[axis],
+		       model.randomWalk, unit, model.randomWalk * 60.0f, unit,
+		       model.biasInstability, unit, model.minAdev, model.minTau,
+		       model.rateRandomWalk, unit, model.quantization, model.rateRamp);
+	}
+	free(allan);
+	if (in != stdin)
+		fclose(in);
+	return 0;
+}
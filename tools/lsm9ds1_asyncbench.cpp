@@ -0,0 +1,264 @@
+/******************************************************************************
+
+	lsm9ds1_asyncbench.cpp
+	Memory per sensor of the coroutine API against a blocking task each.
+
+	cc -O2 -c ../LSM9DS1_Sim.c ../LSM9DS1_RegMap.c
+	c++ -std=c++20 -O2 -DLSM9DS1_SIM -I.. lsm9ds1_asyncbench.cpp \
+	   LSM9DS1_Sim.o LSM9DS1_RegMap.o -pthread -o lsm9ds1_asyncbench
+
+	lsm9ds1_asyncbench [-n sensors] [-f frames]
+
+Each of -n sensors (4 by default) is an LSM9DS1_Sim model that runs
+begin() and then -f frames (1000 by default) of gyro, accel and mag reads,
+once through each API.
+
+Coroutines: one AsyncLsm9ds1 pipeline per sensor, all on this thread. The
+bus queues every completion and the loop delivers them one at a time, as
+the I2C ISR would, so all the pipelines are suspended at once. What they
+cost is the coroutine frames, counted by frameStats(): the peak bytes
+allocated and the frames live at that peak.
+
+Blocking: one thread per sensor running Lsm9ds1<SimBus> through the same
+reads, on a stack painted with a pattern. The bytes overwritten are the
+stack high-water mark, as uxTaskGetStackHighWaterMark() reports it on the
+target; a thread that returns at once is measured the same way and
+subtracted, which leaves the depth the driver calls need. A FreeRTOS task
+also has its TCB, and its stack must be sized for that depth plus
+whatever interrupts push onto it, so the figure is a lower bound.
+
+Host figures are for x86-64 code, with pointers twice the size of ARM's;
+both sides shrink on the target.
+******************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Async.hpp"
+
+#define STACK_BYTES		(256 * 1024)
+#define STACK_PAINT		0xA5
+
+using namespace lsm9ds1;
+
+struct Completion
+{
+	I2C_IF_Callback done;
+	void *arg;
+	int status;
+};
+
+// Completions waiting for the "ISR", oldest first
+static std::deque<Completion> completions;
+
+// SimAsyncBus with the completion deferred to the loop
+struct DeferredSimBus
+{
+	static constexpr uint8_t magBurst = 0x80;
+
+	lsm9ds1_sim *sim;
+
+	bool readAsync(uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count,
+	               I2C_IF_Callback done, void *arg)
+	{
+		completions.push_back({done, arg, LSM9DS1_simRead(sim, address, subAddress, dest, count)});
+		return true;
+	}
+
+	bool writeAsync(uint8_t address, uint8_t *data, uint8_t count,
+	                I2C_IF_Callback done, void *arg)
+	{
+		completions.push_back({done, arg, LSM9DS1_simWrite(sim, address, data, count)});
+		return true;
+	}
+};
+
+// Resumes on this thread when the loop polls
+struct LoopResumer
+{
+	std::vector<std::coroutine_handle<>> ready;
+
+	void post(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+	void poll()
+	{
+		std::vector<std::coroutine_handle<>> now;
+
+		now.swap(ready);
+		for (std::coroutine_handle<> handle : now)
+			handle.resume();
+	}
+};
+
+typedef async::AsyncLsm9ds1<DeferredSimBus, LoopResumer> AsyncImu;
+
+static async::Task<bool> pipeline(AsyncImu &imu, unsigned frames)
+{
+	if (!co_await imu.begin())
+		co_return false;
+	for (unsigned ii = 0; ii < frames; ii++)
+	{
+		AsyncImu::Frame frame = co_await imu.readFrame();
+		if (!frame.ok)
+			co_return false;
+	}
+	co_return true;
+}
+
+struct BlockingJob
+{
+	lsm9ds1_sim *sim;
+	unsigned frames;
+	bool ok;
+};
+
+static void *blockingTask(void *arg)
+{
+	BlockingJob *job = (BlockingJob *)arg;
+	SimBus bus{job->sim};
+	Lsm9ds1<SimBus> imu{bus};
+	Vector3 gyro, accel, mag;
+	unsigned ii;
+
+	job->ok = imu.begin();
+	for (ii = 0; (ii < job->frames) && job->ok; ii++)
+		job->ok = imu.readGyro(gyro) && imu.readAccel(accel) && imu.readMag(mag);
+	return NULL;
+}
+
+static void *idleTask(void *arg)
+{
+	return arg;
+}
+
+// Runs fn on a painted stack. Output: bytes of it written, 0 on failure.
+static size_t stackUsed(void *(*fn)(void *), void *arg)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	uint8_t *stack;
+	size_t untouched;
+
+	if (posix_memalign((void **)&stack, 4096, STACK_BYTES) != 0)
+		return 0;
+	memset(stack, STACK_PAINT, STACK_BYTES);
+	pthread_attr_init(&attr);
+	if ((pthread_attr_setstack(&attr, stack, STACK_BYTES) != 0) ||
+	    (pthread_create(&thread, &attr, fn, arg) != 0))
+	{
+		pthread_attr_destroy(&attr);
+		free(stack);
+		return 0;
+	}
+	pthread_join(thread, NULL);
+	pthread_attr_destroy(&attr);
+	// The stack grows down: the lowest byte written marks the depth
+	for (untouched = 0; (untouched < STACK_BYTES) && (stack[untouched] == STACK_PAINT); untouched++)
+		;
+	free(stack);
+	return STACK_BYTES - untouched;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned sensors = 4, frames = 1000, ii, finished;
+	size_t peakLive = 0, idle, used, worst = 0;
+	bool ok = true;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:f:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': sensors = (unsigned)strtoul(optarg, NULL, 0); break;
+		case 'f': frames = (unsigned)strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n sensors] [-f frames]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (sensors == 0)
+		sensors = 1;
+
+	std::vector<lsm9ds1_sim> sims(sensors);
+	for (ii = 0; ii < sensors; ii++)
+		LSM9DS1_simInit(&sims[ii], DefaultConfig::xgAddress, DefaultConfig::mAddress);
+
+	// Coroutines
+	{
+		LoopResumer resumer;
+		std::vector<DeferredSimBus> buses(sensors);
+		std::vector<AsyncImu> imus;
+		std::vector<async::Task<bool>> tasks;
+		size_t peakBytes;
+
+		imus.reserve(sensors);
+		tasks.reserve(sensors);
+		for (ii = 0; ii < sensors; ii++)
+		{
+			buses[ii].sim = &sims[ii];
+			imus.emplace_back(buses[ii], resumer);
+		}
+		for (ii = 0; ii < sensors; ii++)
+		{
+			tasks.push_back(pipeline(imus[ii], frames));
+			tasks.back().start();
+		}
+		while (!completions.empty())
+		{
+			Completion completion = completions.front();
+			completions.pop_front();
+			completion.done(completion.arg, completion.status);
+			resumer.poll();
+			if (async::frameStats().bytes == async::frameStats().peakBytes)
+				peakLive = async::frameStats().live;
+		}
+		for (ii = 0, finished = 0; ii < sensors; ii++)
+		{
+			if (tasks[ii].done() && tasks[ii].result())
+				finished++;
+		}
+		peakBytes = async::frameStats().peakBytes;
+		printf("%u sensors, %u frames each\n", sensors, frames);
+		printf("coroutines  %6zu bytes of frames at the peak, %zu frames live, %zu per sensor\n",
+		       peakBytes, peakLive, peakBytes / sensors);
+		if (finished != sensors)
+		{
+			fprintf(stderr, "%u of %u pipelines did not finish\n", sensors - finished, sensors);
+			ok = false;
+		}
+	}
+
+	// Blocking tasks, one at a time: each has its own stack anyway
+	idle = stackUsed(idleTask, NULL);
+	for (ii = 0; ii < sensors; ii++)
+	{
+		BlockingJob job = {&sims[ii], frames, false};
+
+		used = stackUsed(blockingTask, &job);
+		if ((used == 0) || !job.ok)
+		{
+			fprintf(stderr, "blocking task %u failed\n", ii);
+			ok = false;
+		}
+		if (used > worst)
+			worst = used;
+	}
+	if (worst > idle)
+	{
+		printf("blocking    %6zu bytes of stack per task over an idle thread (%zu in all), "
+		       "%zu for %u tasks\n", worst - idle, worst, (worst - idle) * sensors, sensors);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,499 @@
+/******************************************************************************
+
+	lsm9ds1_busbudget.c
+	Bus transaction budgets of the LSM9DS1 driver, checked on a simulated bus.
+
+Build with the simulated backend and the recorder:
+	cc -DI2C_IF_LINUX -DI2C_IF_SIM -DI2C_IF_TRACE -DOS_IF_POSIX \
+	   -I<dir with drivers/> -I.. lsm9ds1_busbudget.c ../SparkFunLSM9DS1.c \
+	   ../LSM9DS1_Watermark.c ../LSM9DS1_Planner.c ../LSM9DS1_RegMap.c \
+	   ../LSM9DS1_Sim.c ../i2c_if_sim.c ../i2c_trace.c ../i2c_sched.c \
+	   -lm -o lsm9ds1_busbudget
+
+	lsm9ds1_busbudget [-b budgets] [-u] [-t dir] [-v]
+
+The unmodified driver runs against LSM9DS1_Sim on i2c_if_sim.c, whose
+clock moves with the bus, so that gyro/accel samples arrive at the
+configured ODR (952 Hz by default) and the magnetometer at its own, and
+every run gives the same transactions. The bus runs at 400 kHz: gyro and
+accel at 952 Hz need about 103 kbit/s of reads, more than a 100 kHz bus
+carries. The scenarios run in order on the same device:
+	begin      init(), begin() and initMag(), as lsm9ds1_pubd starts
+	calibrate  calibrate(true), which collects 31 FIFO samples
+	stream     1 s of FIFO streaming under the watermark controller, polled
+	           as lsm9ds1_pubd does, with one readMag() per drain
+	rescale    setGyroScale(2000), setAccelScale(16), setMagScale(16)
+
+Each scenario is traced with i2c_trace.c and summed per slave address,
+command (W, R, RF) and first register: count and data bytes, plus the
+totals of transactions, data bytes and bus bits (START, STOP and
+repeated START one bit each, 9 per byte with its ACK). The sums are
+compared with the budget file (lsm9ds1_busbudget.txt by default); the
+exit status is 1 if any count, byte or bit total is over its budget, or
+an access appears that has none. Lines under budget are reported so
+that the file can be tightened with -u, which rewrites it from this run.
+-t saves each scenario's trace as <dir>/<scenario>.trace for
+i2c_tracedump, -v prints every access.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SparkFunLSM9DS1.h"
+#include "LSM9DS1_Planner.h"
+#include "LSM9DS1_Watermark.h"
+#include "LSM9DS1_Registers.h"
+#include "LSM9DS1_RegMap.h"
+#include "LSM9DS1_Sim.h"
+#include "i2c_trace.h"
+
+#define TRACE_SIZE		(4UL << 20)
+#define MAX_KEYS		64
+#define STREAM_NS		1000000000ULL
+#define BUS_HZ			400000
+
+typedef struct
+{
+	uint8_t address;
+	uint8_t command;		// I2C_TRACE_WRITE, _READ or _READ_FROM
+	int reg;				// first register, -1 for plain reads
+	unsigned long count;
+	unsigned long bytes;
+} access_sum;
+
+typedef struct
+{
+	const char *name;
+	unsigned long transactions;
+	unsigned long bytes;
+	unsigned long bits;
+	int keyCount;
+	access_sum keys[MAX_KEYS];
+} scenario_sum;
+
+// Simulated device and its sample clocks
+typedef struct
+{
+	lsm9ds1_sim sim;
+	uint64_t nextXgNs;
+	uint64_t nextMagNs;
+	uint32_t sequence;
+} sim_device;
+
+static const char *commands[3] = { "W", "R", "RF" };
+
+// Sample periods in ns by CTRL_REG1_G ODR_G, CTRL_REG6_XL ODR_XL (gyro
+// off) and CTRL_REG1_M DO
+static const uint32_t gyroPeriodNs[8] = { 0, 67114094, 16806723, 8403361, 4201681, 2100840, 1050420, 0 };
+static const uint32_t accelPeriodNs[8] = { 0, 100000000, 20000000, 8403361, 4201681, 2100840, 1050420, 0 };
+static const uint32_t magPeriodNs[8] = { 1600000000, 800000000, 400000000, 200000000,
+                                         100000000, 50000000, 25000000, 12500000 };
+
+static sim_device device;
+static I2C_IF_Handle bus;
+
+static int simWrite(void *model, unsigned char address, const unsigned char *data, unsigned char len)
+{
+	return LSM9DS1_simWrite(&((sim_device *)model)->sim, address, data, len);
+}
+
+static int simRead(void *model, unsigned char address, const unsigned char *wr,
+                   unsigned char wrLen, unsigned char *data, unsigned char len)
+{
+	// The LSM9DS1 needs a sub-address
+	if (wrLen != 1)
+		return -1;
+	return LSM9DS1_simRead(&((sim_device *)model)->sim, address, wr[0], data, len);
+}
+
+// Produce the samples due by nowNs: a sensor resting face up with a small
+// deterministic wobble
+static void simElapsed(void *model, unsigned long long nowNs)
+{
+	sim_device *dev = model;
+	uint8_t *xg = dev->sim.xg;
+	uint32_t periodNs;
+	int16_t gyro[3], accel[3], mag[3], temperature;
+	int wobble;
+
+	periodNs = LSM9DS1_get_ODR_G(xg[CTRL_REG1_G]) ? gyroPeriodNs[LSM9DS1_get_ODR_G(xg[CTRL_REG1_G])]
+	                                               : accelPeriodNs[LSM9DS1_get_ODR_XL(xg[CTRL_REG6_XL])];
+	if (periodNs == 0)
+		dev->nextXgNs = nowNs;
+	while ((periodNs != 0) && (dev->nextXgNs + periodNs <= nowNs))
+	{
+		dev->nextXgNs += periodNs;
+		wobble = (int)(dev->sequence++ % 7) - 3;
+		gyro[0] = 20 + wobble; gyro[1] = -15 - wobble; gyro[2] = 5;
+		accel[0] = 40 + wobble; accel[1] = -30; accel[2] = 16384 + wobble;
+		temperature = 25;
+		LSM9DS1_simSetSample(&dev->sim, LSM9DS1_get_ODR_G(xg[CTRL_REG1_G]) ? gyro : NULL,
+		                     accel, NULL, &temperature);
+	}
+
+	periodNs = magPeriodNs[LSM9DS1_get_DO(dev->sim.m[CTRL_REG1_M])];
+	while (dev->nextMagNs + periodNs <= nowNs)
+	{
+		dev->nextMagNs += periodNs;
+		mag[0] = 1200; mag[1] = -800; mag[2] = 3000;
+		LSM9DS1_simSetSample(&dev->sim, NULL, NULL, mag, NULL);
+	}
+}
+
+static uint32_t simMicros(void)
+{
+	return (uint32_t)(I2C_IF_SimNanos(bus) / 1000);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SCENARIOS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static bool runBegin(void)
+{
+	LSM9DS1_init(IMU_MODE_I2C, LSM9DS1_AG_ADDR(1), LSM9DS1_M_ADDR(1));
+	LSM9DS1_getSettings()->device.i2cSpeed = BUS_HZ;
+	if (LSM9DS1_begin() != ((WHO_AM_I_AG_RSP << 8) | WHO_AM_I_M_RSP))
+		return false;
+	LSM9DS1_initMag();
+	bus = LSM9DS1_getI2CBus();
+	return bus != NULL;
+}
+
+static bool runCalibrate(void)
+{
+	LSM9DS1_calibrate(true);
+	return true;
+}
+
+static bool runStream(void)
+{
+	static uint8_t raw[LSM9DS1_FIFO_DEPTH * 12];
+	lsm9ds1_watermark wm;
+	lsm9ds1_wm_stats stats;
+	uint64_t endNs;
+	int16_t mx, my, mz;
+
+	if (!LSM9DS1_wmInit(&wm, 20000, simMicros))
+		return false;
+	endNs = I2C_IF_SimNanos(bus) + STREAM_NS;
+	while (I2C_IF_SimNanos(bus) < endNs)
+	{
+		// Poll where the threshold interrupt would have fired
+		I2C_IF_SimAdvance(bus, wm.threshold * wm.periodUs * 1000UL);
+		if (LSM9DS1_wmDrain(&wm, simMicros(), raw, LSM9DS1_FIFO_DEPTH) > 0)
+			LSM9DS1_readMag(&mx, &my, &mz);
+	}
+	LSM9DS1_wmGetStats(&wm, &stats, false);
+	return stats.overruns == 0;
+}
+
+static bool runRescale(void)
+{
+	LSM9DS1_setGyroScale(2000);
+	LSM9DS1_setAccelScale(16);
+	LSM9DS1_setMagScale(16);
+	return true;
+}
+
+static const struct
+{
+	const char *name;
+	bool (*run)(void);
+} scenarios[] = {
+	{ "begin", runBegin },
+	{ "calibrate", runCalibrate },
+	{ "stream", runStream },
+	{ "rescale", runRescale },
+};
+#define SCENARIO_COUNT	(sizeof(scenarios) / sizeof(scenarios[0]))
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ BUDGETS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static access_sum *findKey(scenario_sum *sum, uint8_t address, uint8_t command, int reg, bool add)
+{
+	int ii;
+
+	for (ii = 0; ii < sum->keyCount; ii++)
+		if ((sum->keys[ii].address == address) && (sum->keys[ii].command == command) &&
+		    (sum->keys[ii].reg == reg))
+			return &sum->keys[ii];
+	if (!add || (sum->keyCount == MAX_KEYS))
+		return NULL;
+	sum->keys[sum->keyCount].address = address;
+	sum->keys[sum->keyCount].command = command;
+	sum->keys[sum->keyCount].reg = reg;
+	return &sum->keys[sum->keyCount++];
+}
+
+// Sum a trace; false if it is corrupt or has gaps
+static bool sumTrace(scenario_sum *sum, const unsigned char *data, unsigned long len)
+{
+	I2C_TRACE_Reader reader;
+	I2C_TRACE_Entry record;
+	access_sum *key;
+	int result, reg;
+
+	if (I2C_TRACE_ReaderInit(&reader, data, len) != 0)
+		return false;
+	while ((result = I2C_TRACE_ReaderNext(&reader, &record)) == 1)
+	{
+		if (record.bGap)
+			return false;
+		reg = ((record.ucCommand != I2C_TRACE_READ) && (record.ucWrLen > 0)) ? (record.pucWr[0] & 0x7F) : -1;
+		if ((key = findKey(sum, record.ucDevAddr, record.ucCommand, reg, true)) == NULL)
+			return false;
+		key->count++;
+		key->bytes += record.ucWrLen + record.ucRdLen;
+		sum->bytes += record.ucWrLen + record.ucRdLen;
+		if (!record.bCont)
+		{
+			sum->transactions++;
+			sum->bits += 2;
+		}
+		if (record.ucCommand == I2C_TRACE_READ_FROM)
+			sum->bits += 1 + 9 * (2 + record.ucWrLen + record.ucRdLen);
+		else
+			sum->bits += 9 * (1 + record.ucWrLen + record.ucRdLen);
+	}
+	return result == 0;
+}
+
+static scenario_sum *findScenario(scenario_sum *sums, int count, const char *name)
+{
+	int ii;
+
+	for (ii = 0; ii < count; ii++)
+		if (strcmp(sums[ii].name, name) == 0)
+			return &sums[ii];
+	return NULL;
+}
+
+// Budget file: "<scenario> total <transactions> <bytes> <bits>" and
+// "<scenario> <address> <W|R|RF> <register|-> <count> <bytes>" lines
+static int loadBudgets(const char *path, scenario_sum *budgets)
+{
+	char line[256], name[32], command[8], reg[8];
+	unsigned long a, b, c;
+	unsigned int address;
+	scenario_sum *sum;
+	access_sum *key;
+	FILE *in;
+	int lineNo = 0, cmd, ii;
+
+	if ((in = fopen(path, "r")) == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+	for (ii = 0; ii < (int)SCENARIO_COUNT; ii++)
+		budgets[ii].name = scenarios[ii].name;
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		lineNo++;
+		if ((line[strspn(line, " \t")] == '#') || (line[strspn(line, " \t\r\n")] == '\0'))
+			continue;
+		if ((sscanf(line, "%31s", name) != 1) ||
+		    ((sum = findScenario(budgets, SCENARIO_COUNT, name)) == NULL))
+			goto bad;
+		if (sscanf(line, "%*s total %lu %lu %lu", &a, &b, &c) == 3)
+		{
+			sum->transactions = a;
+			sum->bytes = b;
+			sum->bits = c;
+			continue;
+		}
+		if (sscanf(line, "%*s %x %7s %7s %lu %lu", &address, command, reg, &a, &b) != 5)
+			goto bad;
+		for (cmd = 0; (cmd < 3) && (strcmp(commands[cmd], command) != 0); cmd++)
+			;
+		if ((cmd == 3) ||
+		    ((key = findKey(sum, (uint8_t)address, (uint8_t)cmd,
+		                    (strcmp(reg, "-") == 0) ? -1 : (int)strtol(reg, NULL, 16), true)) == NULL))
+			goto bad;
+		key->count = a;
+		key->bytes = b;
+	}
+	fclose(in);
+	return 0;
+bad:
+	fprintf(stderr, "%s:%d: bad budget line\n", path, lineNo);
+	fclose(in);
+	return -1;
+}
+
+static void printKey(FILE *out, const char *scenario, const access_sum *key)
+{
+	char reg[12] = "-";
+
+	if (key->reg >= 0)
+		snprintf(reg, sizeof(reg), "0x%02X", key->reg);
+	fprintf(out, "%-10s 0x%02X %-2s %-4s %7lu %8lu\n", scenario, key->address,
+	        commands[key->command], reg, key->count, key->bytes);
+}
+
+static int saveBudgets(const char *path, const scenario_sum *sums)
+{
+	FILE *out;
+	int ii, jj;
+
+	if ((out = fopen(path, "w")) == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+	fprintf(out, "# LSM9DS1 driver bus budgets, checked by lsm9ds1_busbudget.\n"
+	             "# <scenario> total <transactions> <data bytes> <bus bits>\n"
+	             "# <scenario> <slave> <W|R|RF> <first register> <count> <data bytes>\n");
+	for (ii = 0; ii < (int)SCENARIO_COUNT; ii++)
+	{
+		fprintf(out, "\n%-10s total %lu %lu %lu\n", sums[ii].name, sums[ii].transactions,
+		        sums[ii].bytes, sums[ii].bits);
+		for (jj = 0; jj < sums[ii].keyCount; jj++)
+			printKey(out, sums[ii].name, &sums[ii].keys[jj]);
+	}
+	return fclose(out);
+}
+
+// Compare one scenario; returns the number of budgets exceeded
+static int check(const scenario_sum *sum, scenario_sum *budget, bool verbose)
+{
+	const access_sum *key;
+	access_sum *limit;
+	int over = 0, under = 0, ii;
+
+	printf("%-10s %6lu transactions (budget %lu), %7lu bytes (%lu), %8lu bits = %.1f ms\n",
+	       sum->name, sum->transactions, budget->transactions, sum->bytes, budget->bytes,
+	       sum->bits, sum->bits / (BUS_HZ / 1000.0));
+	if ((sum->transactions > budget->transactions) || (sum->bytes > budget->bytes) ||
+	    (sum->bits > budget->bits))
+	{
+		printf("  OVER  totals\n");
+		over++;
+	}
+	else if ((sum->transactions < budget->transactions) || (sum->bytes < budget->bytes) ||
+	         (sum->bits < budget->bits))
+		under++;
+
+	for (ii = 0; ii < sum->keyCount; ii++)
+	{
+		key = &sum->keys[ii];
+		limit = findKey(budget, key->address, key->command, key->reg, false);
+		if ((limit == NULL) || (key->count > limit->count) || (key->bytes > limit->bytes))
+		{
+			printf("  OVER  %s", (limit == NULL) ? "new " : "");
+			printKey(stdout, "", key);
+			if (limit != NULL)
+			{
+				printf("        budget");
+				printKey(stdout, "", limit);
+			}
+			over++;
+		}
+		else
+		{
+			if ((key->count < limit->count) || (key->bytes < limit->bytes))
+				under++;
+			if (verbose)
+			{
+				printf("        ");
+				printKey(stdout, "", key);
+			}
+		}
+		if (limit != NULL)
+		{
+			limit->count = 0;	// seen
+			limit->bytes = 0;
+		}
+	}
+	for (ii = 0; ii < budget->keyCount; ii++)
+		if ((budget->keys[ii].count != 0) || (budget->keys[ii].bytes != 0))
+		{
+			printf("  gone  ");
+			printKey(stdout, "", &budget->keys[ii]);
+			under++;
+		}
+	if ((over == 0) && (under > 0))
+		printf("  under budget, -u tightens it\n");
+	return over;
+}
+
+int main(int argc, char **argv)
+{
+	static scenario_sum sums[SCENARIO_COUNT], budgets[SCENARIO_COUNT];
+	static const I2C_IF_Controller controller = { 0, "sim-0" };
+	const char *budgetPath = "lsm9ds1_busbudget.txt", *traceDir = NULL;
+	const I2C_IF_SimModel model = { simWrite, simRead, simElapsed, &device };
+	unsigned char *ring, *trace;
+	unsigned long len;
+	I2C_TRACE_Stats stats;
+	bool update = false, verbose = false;
+	char path[512];
+	FILE *out;
+	int opt, over = 0, ii;
+
+	while ((opt = getopt(argc, argv, "b:ut:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b': budgetPath = optarg; break;
+		case 'u': update = true; break;
+		case 't': traceDir = optarg; break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-b budgets] [-u] [-t dir] [-v]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (!update && (loadBudgets(budgetPath, budgets) < 0))
+		return 2;
+	if (((ring = malloc(TRACE_SIZE)) == NULL) || ((trace = malloc(TRACE_SIZE)) == NULL))
+		return 2;
+
+	LSM9DS1_simInit(&device.sim, LSM9DS1_AG_ADDR(1), LSM9DS1_M_ADDR(1));
+	if (I2C_IF_SimAttach(controller.ucIndex, &model) < 0)
+		return 2;
+	LSM9DS1_setI2CController(&controller);
+
+	for (ii = 0; ii < (int)SCENARIO_COUNT; ii++)
+	{
+		sums[ii].name = scenarios[ii].name;
+		I2C_TRACE_Start(ring, TRACE_SIZE, I2C_IF_TRACE_HZ);
+		if (!scenarios[ii].run())
+		{
+			fprintf(stderr, "%s: scenario failed\n", scenarios[ii].name);
+			return 2;
+		}
+		I2C_TRACE_Stop();
+		I2C_TRACE_GetStats(&stats, false);
+		len = I2C_TRACE_Read(trace, TRACE_SIZE);
+		if ((stats.ulDropped != 0) || !sumTrace(&sums[ii], trace, len))
+		{
+			fprintf(stderr, "%s: trace incomplete\n", scenarios[ii].name);
+			return 2;
+		}
+		if (traceDir != NULL)
+		{
+			snprintf(path, sizeof(path), "%s/%s.trace", traceDir, scenarios[ii].name);
+			if (((out = fopen(path, "wb")) == NULL) || (fwrite(trace, 1, len, out) != len) ||
+			    (fclose(out) != 0))
+			{
+				perror(path);
+				return 2;
+			}
+		}
+		if (!update)
+			over += check(&sums[ii], &budgets[ii], verbose);
+	}
+
+	free(ring);
+	free(trace);
+	if (update)
+		return (saveBudgets(budgetPath, sums) < 0) ? 2 : 0;
+	printf("%s\n", over ? "FAIL" : "ok");
+	return over ? 1 : 0;
+}
@@ -0,0 +1,382 @@
+/******************************************************************************
+
+	lsm9ds1_calbatch.c
+	Solves the calibration of a batch of LSM9DS1 units in parallel.
+
+	cc -O2 -pthread -I.. lsm9ds1_calbatch.c ../LSM9DS1_Calib.c \
+	   ../LSM9DS1_Heading.c -lm -o lsm9ds1_calbatch
+
+	lsm9ds1_calbatch [-j threads] [-o dir] [-v] log...
+
+Each log is one unit's tumble recorded as LSM9DS1_Calib describes (see
+lsm9ds1_synth -c for synthetic ones); its file name without the
+extension is the unit serial. Every unit gets LSM9DS1_calSolve() and, if
+gyro and accel were fitted, its blob is written as <dir>/<serial>.cal
+(the current directory by default). One line per unit follows, in the
+order given: status, poses, fit residuals, temperature span and solve
+time; -v adds the fitted terms. The summary gives the throughput and the
+CPU time of all threads over the wall time, which stays near -j while
+the batch scales. The exit status is 1 if any unit failed.
+
+The units run on a work-stealing pool of -j threads (one per online CPU
+by default). The list is cut into one block per thread; a thread takes
+its own units from the end of its block and, once it runs dry, steals
+from the start of another's, so a few long logs do not leave the other
+cores idle. The blocks are Chase-Lev deques that only shrink: the owner
+and the thieves settle the last unit with one compare-and-swap, and a
+thread stops when every deque is empty. Each thread reads its logs and
+solves them in its own work area, so threads share nothing else and the
+batch scales with the cores until the disk is the limit.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Calib.h"
+
+#define STEAL_EMPTY		0
+#define STEAL_GOT		1
+#define STEAL_RETRY		2
+
+typedef struct
+{
+	const char *path;
+	char serial[16];
+	lsm9ds1_cal_status status;
+	bool readError;
+	lsm9ds1_cal cal;
+	double seconds;
+} unit_job;
+
+// Units first .. bottom - 1 of the list, owner at the bottom
+typedef struct
+{
+	int64_t top;
+	int64_t bottom;
+	char pad[64 - 2 * sizeof(int64_t)];   // one cache line per deque
+} unit_deque;
+
+typedef struct
+{
+	pthread_t thread;
+	unsigned index;
+	lsm9ds1_cal_work *work;
+	uint32_t solved;
+	uint32_t stolen;
+	double busy;              // thread CPU time, s
+} worker;
+
+static unit_job *jobs;
+static unit_deque *deques;
+static worker *workers;
+static unsigned threadCount;
+static const char *outDir = ".";
+
+static double seconds(clockid_t clock)
+{
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ DEQUES: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Owner: take the newest unit. Output: false if the deque is empty.
+static bool popBottom(unit_deque *deque, int64_t *unit)
+{
+	int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t top;
+	bool got = true;
+
+	__atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+	if (top > bottom)
+	{
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	if (top == bottom)
+	{
+		// Last unit: race the thieves for it
+		got = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+		                                  __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+	}
+	*unit = bottom;
+	return got;
+}
+
+// Thief: take the oldest unit
+static int stealTop(unit_deque *deque, int64_t *unit)
+{
+	int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	int64_t bottom;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+	if (top >= bottom)
+		return STEAL_EMPTY;
+	if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+	                                 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return STEAL_RETRY;
+	*unit = top;
+	return STEAL_GOT;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ UNITS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static uint8_t *readFile(const char *path, uint32_t *len)
+{
+	uint8_t *data = NULL;
+	size_t size = 0, used = 0, got;
+	FILE *in;
+
+	if ((in = fopen(path, "rb")) == NULL)
+		return NULL;
+	do
+	{
+		if (used == size)
+		{
+			uint8_t *grown;
+
+			size = size ? 2 * size : (1 << 20);
+			if ((size > UINT32_MAX) || ((grown = realloc(data, size)) == NULL))
+			{
+				free(data);
+				fclose(in);
+				return NULL;
+			}
+			data = grown;
+		}
+		got = fread(data + used, 1, size - used, in);
+		used += got;
+	} while (got > 0);
+	fclose(in);
+	*len = (uint32_t)used;
+	return data;
+}
+
+static void solveUnit(worker *self, unit_job *job)
+{
+	uint8_t blob[LSM9DS1_CAL_BLOB_LEN];
+	lsm9ds1_cal_log log;
+	char path[4096];
+	uint8_t *data;
+	uint32_t len;
+	double start = seconds(CLOCK_MONOTONIC);
+	double cpu = seconds(CLOCK_THREAD_CPUTIME_ID);
+	FILE *out;
+
+	data = readFile(job->path, &len);
+	if (data == NULL)
+	{
+		job->readError = true;
+		job->status = CAL_BAD_LOG;
+	}
+	else if (!LSM9DS1_calLogOpen(&log, data, len))
+		job->status = CAL_BAD_LOG;
+	else
+		job->status = LSM9DS1_calSolve(&log, self->work, &job->cal);
+	free(data);
+
+	if ((job->status == CAL_OK) || (job->status == CAL_NO_MAG))
+	{
+		LSM9DS1_calPack(blob, &job->cal, job->serial);
+		snprintf(path, sizeof(path), "%s/%s.cal", outDir, job->serial);
+		if (((out = fopen(path, "wb")) == NULL) ||
+		    (fwrite(blob, 1, sizeof(blob), out) != sizeof(blob)) || (fclose(out) != 0))
+			job->readError = true;
+	}
+	job->seconds = seconds(CLOCK_MONOTONIC) - start;
+	self->busy += seconds(CLOCK_THREAD_CPUTIME_ID) - cpu;
+	self->solved++;
+}
+
+static void *workerMain(void *arg)
+{
+	worker *self = arg;
+	unsigned victim, tries;
+	int64_t unit;
+	int result;
+	bool pending;
+
+	for (;;)
+	{
+		if (popBottom(&deques[self->index], &unit))
+		{
+			solveUnit(self, &jobs[unit]);
+			continue;
+		}
+
+		// Own block done: sweep the others until all are empty
+		pending = false;
+		for (tries = 1; tries < threadCount; tries++)
+		{
+			victim = (self->index + tries) % threadCount;
+			while ((result = stealTop(&deques[victim], &unit)) == STEAL_RETRY)
+				pending = true;
+			if (result == STEAL_GOT)
+			{
+				self->stolen++;
+				solveUnit(self, &jobs[unit]);
+				pending = true;
+				break;
+			}
+		}
+		if (!pending)
+			break;
+	}
+	return NULL;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ REPORT: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static const char *statusName(lsm9ds1_cal_status status)
+{
+	switch (status)
+	{
+	case CAL_OK: return "ok";
+	case CAL_NO_MAG: return "no mag";
+	case CAL_BAD_LOG: return "bad log";
+	case CAL_NO_REST: return "no rest";
+	case CAL_FEW_POSES: return "few poses";
+	default: return "no fit";
+	}
+}
+
+static void printSensor(const char *name, const lsm9ds1_cal_sensor *sensor)
+{
+	uint8_t ii;
+
+	printf("    %-5s bias %9.5f %9.5f %9.5f  tempCoeff %9.6f %9.6f %9.6f\n", name,
+	       sensor->bias[0], sensor->bias[1], sensor->bias[2],
+	       sensor->tempCoeff[0], sensor->tempCoeff[1], sensor->tempCoeff[2]);
+	for (ii = 0; ii < 3; ii++)
+		printf("          %9.6f %9.6f %9.6f\n", sensor->matrix[ii][0], sensor->matrix[ii][1],
+		       sensor->matrix[ii][2]);
+}
+
+static void serialOf(const char *path, char *serial)
+{
+	const char *name = strrchr(path, '/'), *dot;
+	size_t len;
+
+	name = name ? name + 1 : path;
+	dot = strrchr(name, '.');
+	len = dot ? (size_t)(dot - name) : strlen(name);
+	if (len > 15)
+		len = 15;
+	memcpy(serial, name, len);
+	serial[len] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t units, ii, failed = 0, stolen = 0;
+	double start, wall, busy = 0.0;
+	bool verbose = false;
+	int opt, error;
+
+	threadCount = (online > 0) ? (unsigned)online : 1;
+	while ((opt = getopt(argc, argv, "j:o:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'j': threadCount = (unsigned)strtoul(optarg, NULL, 0); break;
+		case 'o': outDir = optarg; break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-j threads] [-o dir] [-v] log...\n", argv[0]);
+			return 2;
+		}
+	}
+	units = (uint32_t)(argc - optind);
+	if ((units == 0) || (threadCount == 0))
+	{
+		fprintf(stderr, "usage: %s [-j threads] [-o dir] [-v] log...\n", argv[0]);
+		return 2;
+	}
+	if (threadCount > units)
+		threadCount = units;
+
+	jobs = calloc(units, sizeof(*jobs));
+	deques = calloc(threadCount, sizeof(*deques));
+	workers = calloc(threadCount, sizeof(*workers));
+	if ((jobs == NULL) || (deques == NULL) || (workers == NULL))
+		return 2;
+	for (ii = 0; ii < units; ii++)
+	{
+		jobs[ii].path = argv[optind + ii];
+		serialOf(jobs[ii].path, jobs[ii].serial);
+	}
+	for (ii = 0; ii < threadCount; ii++)
+	{
+		deques[ii].top = (int64_t)units * ii / threadCount;
+		deques[ii].bottom = (int64_t)units * (ii + 1) / threadCount;
+		workers[ii].index = ii;
+		if ((workers[ii].work = malloc(sizeof(lsm9ds1_cal_work))) == NULL)
+			return 2;
+	}
+
+	start = seconds(CLOCK_MONOTONIC);
+	for (ii = 0; ii < threadCount; ii++)
+	{
+		if ((error = pthread_create(&workers[ii].thread, NULL, workerMain, &workers[ii])) != 0)
+		{
+			fprintf(stderr, "pthread_create: %s\n", strerror(error));
+			return 2;
+		}
+	}
+	for (ii = 0; ii < threadCount; ii++)
+		pthread_join(workers[ii].thread, NULL);
+	wall = seconds(CLOCK_MONOTONIC) - start;
+
+	for (ii = 0; ii < units; ii++)
+	{
+		const unit_job *job = &jobs[ii];
+
+		if (((job->status != CAL_OK) && (job->status != CAL_NO_MAG)) || job->readError)
+			failed++;
+		if (job->readError)
+		{
+			printf("%-15s %s: %s\n", job->serial, job->path,
+			       (job->status == CAL_BAD_LOG) ? "cannot read" : "cannot write blob");
+			continue;
+		}
+		printf("%-15s %-9s %2u poses  accel %.4f g  gyro %.3f deg  mag %.4f  %.1f-%.1f C  %.0f ms\n",
+		       job->serial, statusName(job->status), job->cal.poses, job->cal.accelRms,
+		       job->cal.gyroRms, job->cal.magRms, job->cal.tempMinC, job->cal.tempMaxC,
+		       job->seconds * 1000.0);
+		if (verbose && ((job->status == CAL_OK) || (job->status == CAL_NO_MAG)))
+		{
+			printSensor("gyro", &job->cal.gyro);
+			printSensor("accel", &job->cal.accel);
+			printSensor("mag", &job->cal.mag);
+			printf("    field %.4f gauss\n", job->cal.fieldGauss);
+		}
+	}
+	for (ii = 0; ii < threadCount; ii++)
+	{
+		busy += workers[ii].busy;
+		stolen += workers[ii].stolen;
+		free(workers[ii].work);
+	}
+	printf("%u units, %u failed, %u threads, %u stolen, %.2f s (%.1f units/s, %.1fx parallel)\n",
+	       units, failed, threadCount, stolen, wall, units / wall, busy / wall);
+	free(jobs);
+	free(deques);
+	free(workers);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/******************************************************************************
+
+	lsm9ds1_calcheck.c
+	Checks the accel terms LSM9DS1_calSolve() recovers against known errors.
+
+	cc -O2 -I.. lsm9ds1_calcheck.c ../LSM9DS1_Synth.c ../LSM9DS1_Sim.c \
+	   ../LSM9DS1_RegMap.c ../LSM9DS1_Calib.c ../LSM9DS1_Heading.c \
+	   -lm -o lsm9ds1_calcheck
+
+	lsm9ds1_calcheck [-n units] [-w degrees] [-t g/C] [-v]
+
+Each unit is seed 1..-n (8 by default) of lsm9ds1_synth -m tumble -c -e:
+the same tumble, warmed up by -w degrees over the run (10 by default),
+with the bias, scale, misalignment and temperature coefficient errors
+that seed draws. The log is built in memory and solved, and the accel
+bias and bias temperature coefficients are compared with the ones the
+unit was given: every coefficient must be within -t g per degree (1e-4
+by default, a tenth of the largest drawn) and every bias within 1 mg.
+-v prints both for every unit. Exit status 0 if every unit passes, 1 if
+not.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Synth.h"
+#include "LSM9DS1_Calib.h"
+
+#define BIAS_TOLERANCE	0.001		// g
+
+#define TURN(x, y, z)	{ .duration = 1.0f, .rate = { x, y, z } }, { .duration = 2.0f }
+#define CIRCLE(x, y, z)	TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), \
+						TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), TURN(x, y, z)
+
+// lsm9ds1_synth's tumble
+static const lsm9ds1_synth_segment tumble[] = {
+	{ .duration = 5.0f },
+	CIRCLE(45.0f, 0.0f, 0.0f),
+	CIRCLE(0.0f, 45.0f, 0.0f),
+	TURN(45.0f, 0.0f, 0.0f), TURN(45.0f, 0.0f, 0.0f),
+	CIRCLE(0.0f, 0.0f, 45.0f),
+};
+
+// lsm9ds1_synth's error draw, so that seed N here is seed N there
+static float spread(uint64_t *state, float range)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return range * (float)((double)((*state * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-52 - 1.0);
+}
+
+static void unitErrors(lsm9ds1_synth_errors *errors, uint64_t *state, float bias,
+                       float scale, float misalignment, float tempCoeff)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		errors->bias[ii] = spread(state, bias);
+		errors->scaleError[ii] = spread(state, scale);
+		errors->misalignment[ii] = spread(state, misalignment);
+		errors->tempCoeff[ii] = spread(state, tempCoeff);
+	}
+}
+
+// Writes the unit's calibration log to data. Output: its length, 0 if it
+// does not fit.
+static uint32_t makeLog(uint32_t seed, double warmUp, lsm9ds1_synth_errors *accelTruth,
+                        uint8_t *data, uint32_t size)
+{
+	IMUSettings settings;
+	lsm9ds1_synth synth;
+	lsm9ds1_synth_sample sample;
+	lsm9ds1_cal_sample logged;
+	double duration = 0.0;
+	uint64_t state, total, wanted;
+	uint32_t len = LSM9DS1_CAL_LOG_HEADER;
+	uint16_t ii;
+
+	// The defaults LSM9DS1_init() sets
+	memset(&settings, 0, sizeof(settings));
+	settings.gyro.enabled = true;
+	settings.gyro.scale = 245;
+	settings.gyro.sampleRate = 6;
+	settings.accel.enabled = true;
+	settings.accel.scale = 2;
+	settings.accel.sampleRate = 6;
+	settings.accel.bandwidth = -1;
+	settings.mag.enabled = true;
+	settings.mag.scale = 4;
+	settings.mag.sampleRate = 7;
+
+	if (!LSM9DS1_synthInit(&synth, &settings, tumble, sizeof(tumble) / sizeof(tumble[0]), seed))
+		return 0;
+	synth.loop = false;
+	for (ii = 0; ii < sizeof(tumble) / sizeof(tumble[0]); ii++)
+		duration += tumble[ii].duration;
+	state = ((uint64_t)seed << 32) ^ 0xD1B54A32D192ED03ULL;
+	unitErrors(&synth.gyroErrors, &state, 1.0f, 0.03f, 0.01f, 0.02f);
+	unitErrors(&synth.accelErrors, &state, 0.05f, 0.02f, 0.01f, 0.001f);
+	unitErrors(&synth.magErrors, &state, 0.3f, 0.1f, 0.05f, 0.0f);
+	*accelTruth = synth.accelErrors;
+
+	wanted = (uint64_t)(duration / synth.period + 0.5);
+	if (size < LSM9DS1_CAL_LOG_HEADER + wanted * LSM9DS1_CAL_LOG_SAMPLE)
+		return 0;
+	LSM9DS1_calLogHeader(data, (uint32_t)lrint(synth.period * 1e9), synth.gyroScale,
+	                     synth.accelScale, synth.magScale);
+	memset(&logged, 0, sizeof(logged));
+	for (total = 0; total < wanted; total++)
+	{
+		synth.temperatureC = 25.0f + (float)(warmUp * total / wanted);
+		if (!LSM9DS1_synthStep(&synth, &sample))
+			break;
+		memcpy(logged.gyro, sample.gyro, sizeof(logged.gyro));
+		memcpy(logged.accel, sample.accel, sizeof(logged.accel));
+		if (sample.magReady)
+			memcpy(logged.mag, sample.mag, sizeof(logged.mag));
+		logged.temperature = sample.temperature;
+		logged.flags = sample.magReady ? LSM9DS1_CAL_MAG_NEW : 0;
+		LSM9DS1_calLogPack(data + len, &logged);
+		len += LSM9DS1_CAL_LOG_SAMPLE;
+	}
+	return len;
+}
+
+int main(int argc, char **argv)
+{
+	static lsm9ds1_cal_work work;
+	const uint32_t size = 4u << 20;
+	lsm9ds1_synth_errors truth;
+	lsm9ds1_cal_log log;
+	lsm9ds1_cal cal;
+	lsm9ds1_cal_status status;
+	double warmUp = 10.0, tolerance = 1e-4, coeffError, biasError, worst = 0.0;
+	uint32_t units = 8, seed, len;
+	uint8_t *data, ii;
+	bool verbose = false, ok;
+	int opt, failed = 0;
+
+	while ((opt = getopt(argc, argv, "n:w:t:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': units = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'w': warmUp = atof(optarg); break;
+		case 't': tolerance = atof(optarg); break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-n units] [-w degrees] [-t g/C] [-v]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((data = malloc(size)) == NULL)
+	{
+		perror("malloc");
+		return 1;
+	}
+
+	for (seed = 1; seed <= units; seed++)
+	{
+		len = makeLog(seed, warmUp, &truth, data, size);
+		if ((len == 0) || !LSM9DS1_calLogOpen(&log, data, len))
+		{
+			fprintf(stderr, "unit %u: could not build the log\n", seed);
+			failed++;
+			continue;
+		}
+		status = LSM9DS1_calSolve(&log, &work, &cal);
+		ok = (status == CAL_OK) || (status == CAL_NO_MAG);
+		for (ii = 0; (ii < 3) && ok; ii++)
+		{
+			coeffError = fabs(cal.accel.tempCoeff[ii] - truth.tempCoeff[ii]);
+			biasError = fabs(cal.accel.bias[ii] - truth.bias[ii]);
+			if (coeffError > worst)
+				worst = coeffError;
+			ok = (coeffError <= tolerance) && (biasError <= BIAS_TOLERANCE);
+		}
+		if (verbose || !ok)
+		{
+			printf("unit %u  status %d\n"
+			       "  truth  bias %9.5f %9.5f %9.5f  tempCoeff %9.6f %9.6f %9.6f\n"
+			       "  fitted bias %9.5f %9.5f %9.5f  tempCoeff %9.6f %9.6f %9.6f\n",
+			       seed, (int)status, truth.bias[0], truth.bias[1], truth.bias[2],
+			       truth.tempCoeff[0], truth.tempCoeff[1], truth.tempCoeff[2],
+			       cal.accel.bias[0], cal.accel.bias[1], cal.accel.bias[2],
+			       cal.accel.tempCoeff[0], cal.accel.tempCoeff[1], cal.accel.tempCoeff[2]);
+		}
+		if (!ok)
+		{
+			fprintf(stderr, "unit %u: accel terms off the truth\n", seed);
+			failed++;
+		}
+	}
+	free(data);
+	printf("%u units, %d failed, worst tempCoeff error %.6f g/C\n", units, failed, worst);
+	return failed ? 1 : 0;
+}
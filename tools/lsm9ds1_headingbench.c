@@ -0,0 +1,259 @@
+/******************************************************************************
+
+	lsm9ds1_headingbench.c
+	Accuracy and cost of the fixed-point LSM9DS1 heading.
+
+	cc -O2 -I.. lsm9ds1_headingbench.c ../LSM9DS1_Heading.c -lm -o lsm9ds1_headingbench
+
+	lsm9ds1_headingbench [-s step degrees] [-p max pitch degrees] [-d dip degrees]
+
+Raw accel and mag readings are synthesised for every attitude of a grid
+(heading and roll over the full turn, pitch up to the given limit), at the
+default full scales (2 g, 4 gauss) with a 0.5 gauss field, and rounded to
+integers like real readings. LSM9DS1_headingCompute() is compared with a
+double-precision reference computed from the same integers, so the
+reported error is that of the fixed-point arithmetic alone. Cost is
+measured per call in cycles (x86 TSC, Cortex-M DWT cycle counter) or
+nanoseconds elsewhere, next to a float version using libm.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Heading.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define CYCLE_UNIT		"cycles"
+	static uint64_t cycles(void) { return __rdtsc(); }
+#elif defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+	#define CYCLE_UNIT		"cycles"
+	// DWT_CYCCNT, enabled by the startup code (DEMCR.TRCENA, DWT_CTRL.CYCCNTENA)
+	static uint64_t cycles(void) { return *(volatile uint32_t *)0xE0001004; }
+#else
+	#define CYCLE_UNIT		"ns"
+	static uint64_t cycles(void)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	}
+#endif
+
+#define DEG			(M_PI / 180.0)
+#define ACCEL_LSB_G		0.000061
+#define MAG_LSB_GAUSS		0.00014
+#define FIELD_GAUSS		0.5
+
+typedef struct
+{
+	int16_t accel[3];
+	int16_t mag[3];
+} raw_sample;
+
+// Body-frame vector of a world (east, north, up) vector, for the attitude
+// heading (clockwise from north), pitch (X up) and roll (Y up).
+static void toBody(const double *world, double heading, double pitch,
+                   double roll, double *body)
+{
+	double x[3], y[3], z[3], y0[3], z0[3];
+	int ii;
+
+	// X from the heading and pitch, Y level to its left, then rolled
+	x[0] = sin(heading) * cos(pitch);
+	x[1] = cos(heading) * cos(pitch);
+	x[2] = sin(pitch);
+	y0[0] = -cos(heading);
+	y0[1] = sin(heading);
+	y0[2] = 0.0;
+	z0[0] = x[1] * y0[2] - x[2] * y0[1];
+	z0[1] = x[2] * y0[0] - x[0] * y0[2];
+	z0[2] = x[0] * y0[1] - x[1] * y0[0];
+	for (ii = 0; ii < 3; ii++)
+		y[ii] = y0[ii] * cos(roll) + z0[ii] * sin(roll);
+	z[0] = x[1] * y[2] - x[2] * y[1];
+	z[1] = x[2] * y[0] - x[0] * y[2];
+	z[2] = x[0] * y[1] - x[1] * y[0];
+
+	body[0] = world[0] * x[0] + world[1] * x[1] + world[2] * x[2];
+	body[1] = world[0] * y[0] + world[1] * y[1] + world[2] * y[2];
+	body[2] = world[0] * z[0] + world[1] * z[1] + world[2] * z[2];
+}
+
+// Same method as the fixed-point code, in double.
+static void reference(const raw_sample *s, const lsm9ds1_heading_cal *cal,
+                      double *heading, double *pitch, double *roll)
+{
+	double up[3], m[3], east[3], north[3], norm;
+	int ii, jj;
+
+	norm = sqrt((double)s->accel[0] * s->accel[0] + (double)s->accel[1] * s->accel[1] +
+	            (double)s->accel[2] * s->accel[2]);
+	for (ii = 0; ii < 3; ii++)
+	{
+		up[ii] = s->accel[ii] / norm;
+		m[ii] = 0.0;
+		for (jj = 0; jj < 3; jj++)
+			m[ii] += cal->matrix[ii][jj] / 16384.0 * (s->mag[jj] - cal->offset[jj]);
+	}
+	east[0] = m[1] * up[2] - m[2] * up[1];
+	east[1] = m[2] * up[0] - m[0] * up[2];
+	east[2] = m[0] * up[1] - m[1] * up[0];
+	north[0] = up[1] * east[2] - up[2] * east[1];
+
+	*heading = atan2(east[0], north[0]);
+	*pitch = atan2(up[0], sqrt(up[1] * up[1] + up[2] * up[2]));
+	*roll = atan2(up[1], up[2]);
+}
+
+// The float version a device would run without this module.
+static float floatHeading(const raw_sample *s, const lsm9ds1_heading_cal *cal)
+{
+	float up[3], m[3], east[3], north0, norm;
+	int ii, jj;
+
+	for (ii = 0; ii < 3; ii++)
+		up[ii] = s->accel[ii] * (float)ACCEL_LSB_G;
+	norm = 1.0f / sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+	for (ii = 0; ii < 3; ii++)
+	{
+		up[ii] *= norm;
+		m[ii] = 0.0f;
+		for (jj = 0; jj < 3; jj++)
+			m[ii] += cal->matrix[ii][jj] * (1.0f / 16384.0f) *
+			         ((s->mag[jj] - cal->offset[jj]) * (float)MAG_LSB_GAUSS);
+	}
+	east[0] = m[1] * up[2] - m[2] * up[1];
+	east[1] = m[2] * up[0] - m[0] * up[2];
+	east[2] = m[0] * up[1] - m[1] * up[0];
+	north0 = up[1] * east[2] - up[2] * east[1];
+	return atan2f(east[0], north0) + atan2f(up[1], up[2]) +
+	       atan2f(up[0], sqrtf(up[1] * up[1] + up[2] * up[2]));
+}
+
+// Difference of two angles in degrees, wrapped to +-180.
+static double angleError(double fixedDeg, double refRad)
+{
+	double error = fixedDeg - refRad / DEG;
+
+	while (error > 180.0)
+		error -= 360.0;
+	while (error < -180.0)
+		error += 360.0;
+	return fabs(error);
+}
+
+int main(int argc, char **argv)
+{
+	double step = 2.0, maxPitch = 80.0, dip = 60.0;
+	double world[3], body[3], h, p, r, error;
+	double maxErr[3] = {0, 0, 0}, sumSq[3] = {0, 0, 0};
+	lsm9ds1_heading_cal cal;
+	lsm9ds1_heading out;
+	uint64_t start, fixedCost, floatCost;
+	volatile float sink = 0.0f;
+	raw_sample *samples;
+	uint32_t count = 0, ii, round;
+	int opt, axis;
+
+	while ((opt = getopt(argc, argv, "s:p:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': step = atof(optarg); break;
+		case 'p': maxPitch = atof(optarg); break;
+		case 'd': dip = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-s step] [-p max pitch] [-d dip]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (step <= 0.0)
+		return 2;
+
+	samples = malloc(sizeof(*samples) * (size_t)(360.0 / step + 1) *
+	                 (size_t)(2.0 * maxPitch / step + 1) * (size_t)(360.0 / step + 1));
+	if (samples == NULL)
+		return 1;
+
+	LSM9DS1_headingCalInit(&cal);
+	for (h = 0.0; h < 360.0; h += step)
+		for (p = -maxPitch; p <= maxPitch; p += step)
+			for (r = -180.0; r < 180.0; r += step)
+			{
+				raw_sample *s = &samples[count];
+
+				world[0] = 0.0;
+				world[1] = 0.0;
+				world[2] = 1.0;
+				toBody(world, h * DEG, p * DEG, r * DEG, body);
+				for (axis = 0; axis < 3; axis++)
+					s->accel[axis] = (int16_t)lrint(body[axis] / ACCEL_LSB_G);
+
+				world[1] = FIELD_GAUSS * cos(dip * DEG);
+				world[2] = -FIELD_GAUSS * sin(dip * DEG);
+				toBody(world, h * DEG, p * DEG, r * DEG, body);
+				// Accel frame to raw mag axes (the map is its own inverse)
+				s->mag[0] = (int16_t)lrint(-body[0] / MAG_LSB_GAUSS);
+				s->mag[1] = (int16_t)lrint(body[1] / MAG_LSB_GAUSS);
+				s->mag[2] = (int16_t)lrint(body[2] / MAG_LSB_GAUSS);
+				count++;
+			}
+
+	for (ii = 0; ii < count; ii++)
+	{
+		double refHeading, refPitch, refRoll;
+
+		if (!LSM9DS1_headingCompute(samples[ii].accel, samples[ii].mag, &cal, &out))
+			continue;
+		reference(&samples[ii], &cal, &refHeading, &refPitch, &refRoll);
+		error = angleError(LSM9DS1_ANGLE_TO_DEG((double)out.heading), refHeading);
+		maxErr[0] = fmax(maxErr[0], error);
+		sumSq[0] += error * error;
+		error = angleError(LSM9DS1_ANGLE_TO_DEG((double)out.pitch), refPitch);
+		maxErr[1] = fmax(maxErr[1], error);
+		sumSq[1] += error * error;
+		error = angleError(LSM9DS1_ANGLE_TO_DEG((double)out.roll), refRoll);
+		maxErr[2] = fmax(maxErr[2], error);
+		sumSq[2] += error * error;
+	}
+
+	// Best of a few rounds, to keep interrupts and frequency changes out
+	fixedCost = floatCost = UINT64_MAX;
+	for (round = 0; round < 5; round++)
+	{
+		start = cycles();
+		for (ii = 0; ii < count; ii++)
+		{
+			LSM9DS1_headingCompute(samples[ii].accel, samples[ii].mag, &cal, &out);
+			sink += out.heading;
+		}
+		start = cycles() - start;
+		if (start < fixedCost)
+			fixedCost = start;
+
+		start = cycles();
+		for (ii = 0; ii < count; ii++)
+			sink += floatHeading(&samples[ii], &cal);
+		start = cycles() - start;
+		if (start < floatCost)
+			floatCost = start;
+	}
+
+	printf("%u attitudes, step %.1f deg, pitch +-%.0f deg, dip %.0f deg\n",
+	       count, step, maxPitch, dip);
+	printf("error vs double (deg)   max       rms\n");
+	printf("  heading          %9.4f %9.4f\n", maxErr[0], sqrt(sumSq[0] / count));
+	printf("  pitch            %9.4f %9.4f\n", maxErr[1], sqrt(sumSq[1] / count));
+	printf("  roll             %9.4f %9.4f\n", maxErr[2], sqrt(sumSq[2] / count));
+	printf("cost per call (%s): fixed %.1f, float + libm %.1f\n", CYCLE_UNIT,
+	       (double)fixedCost / count, (double)floatCost / count);
+	return 0;
+}
@@ -0,0 +1,174 @@
+/******************************************************************************
+
+	lsm9ds1_pubd.c
+	Publishes the LSM9DS1 stream of a Linux board into shared memory.
+
+Build with the Linux backend:
+	cc -DI2C_IF_LINUX -DOS_IF_POSIX -I<dir with drivers/> -I.. \
+	   lsm9ds1_pubd.c ../LSM9DS1_Shm.c ../SparkFunLSM9DS1.c \
+	   ../LSM9DS1_Watermark.c ../LSM9DS1_Planner.c ../LSM9DS1_RegMap.c \
+	   ../i2c_if_linux.c ../i2c_sched.c -lm -lrt -o lsm9ds1_pubd
+
+	lsm9ds1_pubd [-d /dev/i2c-1] [-n /lsm9ds1] [-s slots] [-l latency_us]
+
+The daemon is the only process on the bus. It runs the FIFO in continuous
+mode under the adaptive watermark controller, drains it whenever the
+current threshold should have been reached (boards rarely route INT1 to
+Linux, so the FIFO is polled), reads the magnetometer once per drain and
+publishes one frame per FIFO sample. Sample times are rebuilt backwards
+from the drain time at the FIFO period; with polling the newest sample is
+up to one period older than its timestamp says.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SparkFunLSM9DS1.h"
+#include "LSM9DS1_Planner.h"
+#include "LSM9DS1_Watermark.h"
+#include "LSM9DS1_Registers.h"
+#include "LSM9DS1_Shm.h"
+
+static volatile sig_atomic_t stop;
+
+static void onSignal(int signum)
+{
+	(void)signum;
+	stop = 1;
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t micros(void)
+{
+	return (uint32_t)(monotonicNs() / 1000);
+}
+
+static void sleepUs(uint32_t us)
+{
+	struct timespec delay = { us / 1000000, (long)(us % 1000000) * 1000 };
+
+	while ((nanosleep(&delay, &delay) < 0) && (errno == EINTR) && !stop)
+		;
+}
+
+int main(int argc, char **argv)
+{
+	I2C_IF_Controller controller = { 0, "/dev/i2c-1" };
+	const char *name = LSM9DS1_SHM_DEFAULT_NAME;
+	uint32_t slots = 1024, latencyUs = 20000;
+	lsm9ds1_shm_publisher pub;
+	lsm9ds1_shm_frame frames[LSM9DS1_FIFO_DEPTH];
+	lsm9ds1_watermark wm;
+	lsm9ds1_wm_stats stats;
+	uint8_t raw[LSM9DS1_FIFO_DEPTH * 12];
+	int16_t mag[3] = {0, 0, 0};
+	uint32_t overruns = 0;
+	uint64_t nowNs;
+	uint16_t id;
+	uint8_t count, ii, axis;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:n:s:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': controller.pcDevice = optarg; break;
+		case 'n': name = optarg; break;
+		case 's': slots = strtoul(optarg, NULL, 0); break;
+		case 'l': latencyUs = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-d /dev/i2c-N] [-n shm name] [-s slots] [-l latency_us]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	LSM9DS1_setI2CController(&controller);
+	LSM9DS1_init(IMU_MODE_I2C, LSM9DS1_AG_ADDR(1), LSM9DS1_M_ADDR(1));
+	id = LSM9DS1_begin();
+	if (id != ((WHO_AM_I_AG_RSP << 8) | WHO_AM_I_M_RSP))
+	{
+		fprintf(stderr, "no LSM9DS1 on %s (WHO_AM_I %04x)\n", controller.pcDevice, id);
+		return 1;
+	}
+	LSM9DS1_initMag();
+
+	if (!LSM9DS1_wmInit(&wm, latencyUs, micros))
+	{
+		fprintf(stderr, "FIFO not started: gyro and accel are off\n");
+		return 1;
+	}
+	if (LSM9DS1_shmCreate(&pub, name, slots, LSM9DS1_calcGyro(1), LSM9DS1_calcAccel(1),
+	                      LSM9DS1_calcMag(1), 1000000000UL / wm.periodUs) < 0)
+	{
+		perror("shm");
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	printf("publishing %s: %lu Hz, %u slots\n", name,
+	       1000000UL / wm.periodUs, pub.header->slotCount);
+
+	while (!stop)
+	{
+		// Poll where the threshold interrupt would have fired
+		sleepUs(wm.threshold * wm.periodUs);
+		count = LSM9DS1_wmDrain(&wm, micros(), raw, LSM9DS1_FIFO_DEPTH);
+		nowNs = monotonicNs();
+		if (count == 0)
+			continue;
+
+		LSM9DS1_readMag(&mag[0], &mag[1], &mag[2]);
+		LSM9DS1_wmGetStats(&wm, &stats, false);
+
+		for (ii = 0; ii < count; ii++)
+		{
+			lsm9ds1_shm_frame *frame = &frames[ii];
+			const uint8_t *sample = raw + ii * wm.sampleBytes;
+
+			memset(frame, 0, sizeof(*frame));
+			frame->timestampNs = nowNs - (uint64_t)(count - 1 - ii) * wm.periodUs * 1000;
+			for (axis = 0; axis < 3; axis++)
+			{
+				if (wm.sampleBytes == 12)
+				{
+					frame->gyro[axis] = (int16_t)((sample[2 * axis + 1] << 8) | sample[2 * axis]);
+					frame->accel[axis] = (int16_t)((sample[6 + 2 * axis + 1] << 8) | sample[6 + 2 * axis]);
+				}
+				else
+					frame->accel[axis] = (int16_t)((sample[2 * axis + 1] << 8) | sample[2 * axis]);
+				frame->mag[axis] = mag[axis];
+			}
+			frame->flags = LSM9DS1_SHM_ACCEL | ((wm.sampleBytes == 12) ? LSM9DS1_SHM_GYRO : 0);
+		}
+		frames[count - 1].flags |= LSM9DS1_SHM_MAG;
+		if (stats.overruns != overruns)
+			frames[0].flags |= LSM9DS1_SHM_OVERRUN;
+		overruns = stats.overruns;
+
+		LSM9DS1_shmPublish(&pub, frames, count);
+	}
+
+	LSM9DS1_wmGetStats(&wm, &stats, false);
+	printf("%lu frames, %u drains, %u overruns, worst latency %u us\n",
+	       (unsigned long)pub.header->published, stats.wakeups, stats.overruns,
+	       stats.latencyMaxUs);
+	LSM9DS1_shmDestroy(&pub);
+	return 0;
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+
+	lsm9ds1_shmbench.c
+	Reader latency and throughput of the LSM9DS1 shared-memory ring.
+
+	cc -O2 -I.. lsm9ds1_shmbench.c ../LSM9DS1_Shm.c -lrt -o lsm9ds1_shmbench
+
+	lsm9ds1_shmbench [-n max readers] [-r rate Hz, 0 = flat out]
+	                 [-b frames per batch] [-t seconds] [-w]
+
+A synthetic publisher stamps each batch with CLOCK_MONOTONIC and publishes
+it at the given rate; 1..N forked readers poll shmRead(), yielding the CPU
+when the ring is empty (or sleep in shmWait() with -w), and histogram the
+time from publish to read. Rate 0 publishes as fast as possible and
+measures how many frames each reader keeps up with. No sensor or bus is
+involved.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "LSM9DS1_Shm.h"
+
+#define BENCH_NAME          "/lsm9ds1_bench"
+#define BUCKET_NS           100
+#define BUCKETS             10000       // 1 ms; beyond goes to the last one
+
+typedef struct
+{
+	volatile uint32_t ready;
+	uint64_t frames;
+	uint64_t lost;
+	uint64_t sumNs;
+	uint64_t maxNs;
+	uint32_t histogram[BUCKETS];
+} reader_result;
+
+typedef struct
+{
+	volatile uint32_t stop;
+	reader_result readers[];
+} bench_shared;
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void runReader(bench_shared *shared, reader_result *result, bool sleep)
+{
+	lsm9ds1_shm_reader reader;
+	lsm9ds1_shm_frame frame;
+	uint64_t latency;
+
+	if (LSM9DS1_shmOpen(&reader, BENCH_NAME) < 0)
+	{
+		perror("shmOpen");
+		_exit(1);
+	}
+	__atomic_store_n(&result->ready, 1, __ATOMIC_RELEASE);
+
+	while (!__atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE))
+	{
+		if (!LSM9DS1_shmRead(&reader, &frame))
+		{
+			// Let the publisher and the other readers run on small hosts
+			if (sleep)
+				LSM9DS1_shmWait(&reader, 10000000);
+			else
+				sched_yield();
+			continue;
+		}
+		latency = monotonicNs() - frame.timestampNs;
+		result->frames++;
+		result->sumNs += latency;
+		if (latency > result->maxNs)
+			result->maxNs = latency;
+		latency /= BUCKET_NS;
+		result->histogram[latency < BUCKETS ? latency : BUCKETS - 1]++;
+	}
+	result->lost = reader.lost;
+	LSM9DS1_shmClose(&reader);
+	_exit(0);
+}
+
+static uint64_t percentileNs(const uint32_t *histogram, uint64_t total, double fraction)
+{
+	uint64_t target = (uint64_t)(total * fraction), seen = 0;
+	uint32_t ii;
+
+	for (ii = 0; ii < BUCKETS; ii++)
+	{
+		seen += histogram[ii];
+		if (seen > target)
+			break;
+	}
+	return (uint64_t)(ii < BUCKETS ? ii : BUCKETS - 1) * BUCKET_NS + BUCKET_NS / 2;
+}
+
+static void runRound(bench_shared *shared, size_t sharedSize, uint32_t readers,
+                     uint32_t rate, uint32_t batch, uint32_t seconds, bool sleep)
+{
+	lsm9ds1_shm_publisher pub;
+	lsm9ds1_shm_frame frames[256];
+	static uint32_t merged[BUCKETS];
+	uint64_t start, next, end, periodNs, total = 0, lost = 0, sum = 0, max = 0;
+	uint32_t ii, jj;
+
+	memset(shared, 0, sharedSize);
+	memset(frames, 0, sizeof(frames));
+	memset(merged, 0, sizeof(merged));
+	if (LSM9DS1_shmCreate(&pub, BENCH_NAME, 4096, 0.00875f, 0.000061f, 0.00014f,
+	                      rate * 1000) < 0)
+	{
+		perror("shmCreate");
+		exit(1);
+	}
+
+	for (ii = 0; ii < readers; ii++)
+		if (fork() == 0)
+			runReader(shared, &shared->readers[ii], sleep);
+	for (ii = 0; ii < readers; ii++)
+		while (!__atomic_load_n(&shared->readers[ii].ready, __ATOMIC_ACQUIRE))
+			usleep(1000);
+
+	periodNs = rate ? 1000000000ULL * batch / rate : 0;
+	start = next = monotonicNs();
+	end = start + (uint64_t)seconds * 1000000000ULL;
+	while (monotonicNs() < end)
+	{
+		if (periodNs)
+		{
+			struct timespec wake;
+
+			next += periodNs;
+			wake.tv_sec = (time_t)(next / 1000000000ULL);
+			wake.tv_nsec = (long)(next % 1000000000ULL);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+		}
+		frames[0].timestampNs = monotonicNs();
+		for (jj = 1; jj < batch; jj++)
+			frames[jj].timestampNs = frames[0].timestampNs;
+		LSM9DS1_shmPublish(&pub, frames, batch);
+	}
+	__atomic_store_n(&shared->stop, 1, __ATOMIC_RELEASE);
+	while (wait(NULL) > 0)
+		;
+
+	for (ii = 0; ii < readers; ii++)
+	{
+		reader_result *result = &shared->readers[ii];
+
+		total += result->frames;
+		lost += result->lost;
+		sum += result->sumNs;
+		if (result->maxNs > max)
+			max = result->maxNs;
+		for (jj = 0; jj < BUCKETS; jj++)
+			merged[jj] += result->histogram[jj];
+	}
+
+	printf("%7u %12.0f %12.0f %9llu %8llu %8llu %8llu %9llu\n", readers,
+	       (double)pub.header->published / seconds,
+	       (double)total / readers / seconds,
+	       (unsigned long long)lost,
+	       (unsigned long long)(total ? sum / total : 0),
+	       (unsigned long long)percentileNs(merged, total, 0.50),
+	       (unsigned long long)percentileNs(merged, total, 0.99),
+	       (unsigned long long)max);
+	LSM9DS1_shmDestroy(&pub);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t maxReaders = 4, rate = 952, batch = 1, seconds = 2, ii;
+	bool sleep = false;
+	bench_shared *shared;
+	size_t sharedSize;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:b:t:w")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': maxReaders = strtoul(optarg, NULL, 0); break;
+		case 'r': rate = strtoul(optarg, NULL, 0); break;
+		case 'b': batch = strtoul(optarg, NULL, 0); break;
+		case 't': seconds = strtoul(optarg, NULL, 0); break;
+		case 'w': sleep = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-n readers] [-r rate] [-b batch] [-t s] [-w]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((batch == 0) || (batch > 256) || (seconds == 0))
+		return 2;
+
+	sharedSize = sizeof(bench_shared) + maxReaders * sizeof(reader_result);
+	shared = mmap(NULL, sharedSize, PROT_READ | PROT_WRITE,
+	              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		return 1;
+
+	printf("rate %u Hz (0: flat out), batch %u, %s readers, %u s\n",
+	       rate, batch, sleep ? "futex" : "polling", seconds);
+	printf("readers  published/s   read/s/rdr      lost  mean ns   p50 ns   p99 ns    max ns\n");
+	for (ii = 1; ii <= maxReaders; ii++)
+		runRound(shared, sharedSize, ii, rate, batch, seconds, sleep);
+	return 0;
+}
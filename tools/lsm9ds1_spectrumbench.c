@@ -0,0 +1,150 @@
+/******************************************************************************
+
+	lsm9ds1_spectrumbench.c
+	Cost and accuracy of the LSM9DS1 vibration spectrum engine.
+
+	cc -O2 -I.. lsm9ds1_spectrumbench.c ../LSM9DS1_Spectrum.c -lm -o lsm9ds1_spectrumbench
+
+	lsm9ds1_spectrumbench [-r rate Hz] [-a averages]
+
+Raw FIFO blocks (gyro and accel, 12 bytes per sample, as wmDrain() stores
+them) are synthesised at the 2 g scale: 1 g on Z plus two tones on X,
+0.05 g at 60 Hz and 0.01 g at 237.3 Hz, and white noise of 2 mg rms. For
+each FFT length up to LSM9DS1_SPECTRUM_MAX_N (build both files with
+-DLSM9DS1_SPECTRUM_MAX_N=1024 for longer ones) and each variant the tool
+prints the cost per window in cycles (x86 TSC, Cortex-M DWT cycle counter)
+or nanoseconds, the engine's RAM, the two strongest peaks and the tone
+powers against their exact value A^2 / 2.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Spectrum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define CYCLE_UNIT		"cycles"
+	static uint64_t cycles(void) { return __rdtsc(); }
+#elif defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+	#define CYCLE_UNIT		"cycles"
+	// DWT_CYCCNT, enabled by the startup code (DEMCR.TRCENA, DWT_CTRL.CYCCNTENA)
+	static uint64_t cycles(void) { return *(volatile uint32_t *)0xE0001004; }
+#else
+	#define CYCLE_UNIT		"ns"
+	static uint64_t cycles(void)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	}
+#endif
+
+#define ACCEL_LSB_G		0.000061f
+#define BLOCK			16
+#define TONE1_HZ		60.0
+#define TONE1_G			0.05
+#define TONE2_HZ		237.3
+#define TONE2_G			0.01
+#define NOISE_G			0.002
+
+static double gaussian(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static void put16(uint8_t *p, double value)
+{
+	int16_t raw = (int16_t)lrint(value / ACCEL_LSB_G);
+
+	p[0] = (uint8_t)(raw & 0xFF);
+	p[1] = (uint8_t)((uint16_t)raw >> 8);
+}
+
+int main(int argc, char **argv)
+{
+	double rate = 952.0, t;
+	uint16_t averages = 8, n;
+	uint8_t *stream;
+	uint32_t total, ii, jj;
+	lsm9ds1_spectrum *spec;
+	lsm9ds1_spectrum_peak peaks[2];
+	uint64_t start, cost, windows;
+	uint8_t found, variant;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:a:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': rate = atof(optarg); break;
+		case 'a': averages = (uint16_t)strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-r rate] [-a averages]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((rate <= 0.0) || (averages == 0))
+		return 2;
+
+	// Enough samples for the longest length, a whole number of blocks
+	total = (uint32_t)(LSM9DS1_SPECTRUM_MAX_N / 2) * (averages + 1);
+	total = (total + BLOCK - 1) / BLOCK * BLOCK;
+	stream = calloc(total, 12);
+	spec = malloc(sizeof(*spec));
+	if ((stream == NULL) || (spec == NULL))
+		return 1;
+	for (ii = 0; ii < total; ii++)
+	{
+		t = ii / rate;
+		put16(stream + 12 * ii + 6, TONE1_G * sin(2.0 * M_PI * TONE1_HZ * t) +
+		      TONE2_G * sin(2.0 * M_PI * TONE2_HZ * t) + NOISE_G * gaussian());
+		put16(stream + 12 * ii + 8, NOISE_G * gaussian());
+		put16(stream + 12 * ii + 10, 1.0 + NOISE_G * gaussian());
+	}
+
+	printf("rate %.0f Hz, %u averages, engine RAM %lu bytes (max n %u)\n",
+	       rate, averages, (unsigned long)sizeof(*spec), LSM9DS1_SPECTRUM_MAX_N);
+	printf("    n variant %s/window  peak 1 Hz  peak 2 Hz  tone 1 dB  tone 2 dB\n", CYCLE_UNIT);
+	for (n = 64; n <= LSM9DS1_SPECTRUM_MAX_N; n *= 2)
+	{
+		for (variant = 0; variant < 2; variant++)
+		{
+			double band = 3.0 * rate / n;
+
+			LSM9DS1_spectrumInit(spec, n, LSM9DS1_SPECTRUM_X, variant == 1, averages,
+			                     (float)rate, ACCEL_LSB_G);
+			start = cycles();
+			for (ii = 0; ii < total / BLOCK; ii++)
+				if (LSM9DS1_spectrumFeed(spec, stream + 12 * BLOCK * ii, BLOCK, 12))
+					break;
+			cost = cycles() - start;
+			windows = spec->stats.segments;
+
+			found = LSM9DS1_spectrumPeaks(spec, peaks, 2);
+			for (jj = found; jj < 2; jj++)
+				peaks[jj].frequency = 0.0f;
+			printf("%5u %-7s %13.0f %10.2f %10.2f %+10.3f %+10.3f\n", n,
+			       variant ? "fixed" : "float", (double)cost / (windows ? windows : 1),
+			       peaks[0].frequency, peaks[1].frequency,
+			       10.0 * log10(LSM9DS1_spectrumBandPower(spec, TONE1_HZ - band, TONE1_HZ + band) /
+			                    (TONE1_G * TONE1_G / 2.0)),
+			       10.0 * log10(LSM9DS1_spectrumBandPower(spec, TONE2_HZ - band, TONE2_HZ + band) /
+			                    (TONE2_G * TONE2_G / 2.0)));
+		}
+	}
+	free(spec);
+	free(stream);
+	return 0;
+}
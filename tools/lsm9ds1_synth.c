@@ -0,0 +1,239 @@
+/******************************************************************************
+
+	lsm9ds1_synth.c
+	Writes synthetic LSM9DS1 FIFO logs from a scripted trajectory.
+
+	cc -O2 -I.. lsm9ds1_synth.c ../LSM9DS1_Synth.c ../LSM9DS1_Sim.c \
+	   ../LSM9DS1_RegMap.c ../LSM9DS1_Calib.c ../LSM9DS1_Heading.c \
+	   -lm -o lsm9ds1_synth
+
+	lsm9ds1_synth [-m motion|still|tumble] [-d seconds] [-s seed] [-b 6|12]
+	              [-c] [-w degrees] [-e] [log]
+
+The configuration is the driver's default (952 Hz gyro and accel, 245 dps,
+2 g, 80 Hz mag). "motion" repeats a 20 s script: rest, a 90 degree turn
+about Z, a 2 g 120 Hz vibration, a 6 g impact, a magnetic disturbance
+and a pitch up and back; "still" keeps the unit level, for noise work
+(pipe it into lsm9ds1_allan). The log holds raw FIFO samples as
+LSM9DS1_wmDrain() stores them, on stdout if no file is given; the
+generation rate goes to stderr.
+
+"tumble" is the end-of-line calibration motion, run once: 5 s still, then
+45 degree turns with 2 s still poses between them, a full turn about X,
+one about Y, a quarter turn onto the side and a full turn about Z. -c
+writes a LSM9DS1_Calib log (gyro, accel, mag and temperature) instead of
+FIFO samples, for lsm9ds1_calbatch. -w warms the die up by the given
+degrees over the run. -e gives the unit its own bias, scale,
+misalignment, temperature coefficient and hard/soft-iron errors, drawn
+from the seed and printed to stderr, so that a batch of seeds looks like
+a batch of boards.
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LSM9DS1_Synth.h"
+#include "LSM9DS1_Calib.h"
+
+#define BLOCK			256
+
+static const lsm9ds1_synth_segment motion[] = {
+	{ .duration = 4.0f },
+	{ .duration = 3.0f, .rate = { 0.0f, 0.0f, 30.0f } },
+	{ .duration = 3.0f, .vibration = { 0.0f, 0.0f, 2.0f }, .vibrationHz = 120.0f },
+	{ .duration = 2.0f, .impact = { 6.0f, 0.0f, 0.0f }, .impactMs = 5.0f },
+	{ .duration = 3.0f, .magOffset = { 0.3f, 0.0f, 0.0f } },
+	{ .duration = 1.0f, .rate = { 45.0f, 0.0f, 0.0f } },
+	{ .duration = 1.0f, .rate = { -45.0f, 0.0f, 0.0f } },
+	{ .duration = 3.0f, .rate = { 0.0f, 0.0f, -30.0f } },
+};
+
+static const lsm9ds1_synth_segment still[] = {
+	{ .duration = 3600.0f },
+};
+
+#define TURN(x, y, z)	{ .duration = 1.0f, .rate = { x, y, z } }, { .duration = 2.0f }
+#define CIRCLE(x, y, z)	TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), \
+						TURN(x, y, z), TURN(x, y, z), TURN(x, y, z), TURN(x, y, z)
+
+static const lsm9ds1_synth_segment tumble[] = {
+	{ .duration = 5.0f },
+	CIRCLE(45.0f, 0.0f, 0.0f),
+	CIRCLE(0.0f, 45.0f, 0.0f),
+	TURN(45.0f, 0.0f, 0.0f), TURN(45.0f, 0.0f, 0.0f),
+	CIRCLE(0.0f, 0.0f, 45.0f),
+};
+
+// Uniform in [-range, range], from its own generator so the noise stays
+// that of the seed
+static float spread(uint64_t *state, float range)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return range * (float)((double)((*state * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-52 - 1.0);
+}
+
+static void unitErrors(lsm9ds1_synth_errors *errors, uint64_t *state, float bias,
+                       float scale, float misalignment, float tempCoeff)
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < 3; ii++)
+	{
+		errors->bias[ii] = spread(state, bias);
+		errors->scaleError[ii] = spread(state, scale);
+		errors->misalignment[ii] = spread(state, misalignment);
+		errors->tempCoeff[ii] = spread(state, tempCoeff);
+	}
+}
+
+static void printErrors(const char *name, const lsm9ds1_synth_errors *errors)
+{
+	fprintf(stderr, "%-5s bias %9.5f %9.5f %9.5f  scale %8.5f %8.5f %8.5f\n"
+	                "      misalignment %8.5f %8.5f %8.5f  tempCoeff %9.6f %9.6f %9.6f\n",
+	        name, errors->bias[0], errors->bias[1], errors->bias[2],
+	        errors->scaleError[0], errors->scaleError[1], errors->scaleError[2],
+	        errors->misalignment[0], errors->misalignment[1], errors->misalignment[2],
+	        errors->tempCoeff[0], errors->tempCoeff[1], errors->tempCoeff[2]);
+}
+
+static double seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t block[BLOCK * 12];
+	uint8_t header[LSM9DS1_CAL_LOG_HEADER], record[LSM9DS1_CAL_LOG_SAMPLE];
+	IMUSettings settings;
+	lsm9ds1_synth synth;
+	lsm9ds1_synth_sample sample;
+	lsm9ds1_cal_sample logged;
+	const char *script = "motion";
+	double duration = 60.0, warmUp = 0.0, start, elapsed;
+	uint32_t seed = 1;
+	uint8_t sampleBytes = 12;
+	uint64_t total = 0, wanted, state;
+	uint16_t got;
+	bool calLog = false, errors = false, ok;
+	FILE *out = stdout;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:d:s:b:cw:e")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm': script = optarg; break;
+		case 'd': duration = atof(optarg); break;
+		case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'b': sampleBytes = (uint8_t)strtoul(optarg, NULL, 0); break;
+		case 'c': calLog = true; break;
+		case 'w': warmUp = atof(optarg); break;
+		case 'e': errors = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-m motion|still|tumble] [-d seconds] [-s seed] [-b 6|12]\n"
+			                "       [-c] [-w degrees] [-e] [log]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((optind < argc) && ((out = fopen(argv[optind], "wb")) == NULL))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	// The defaults LSM9DS1_init() sets
+	memset(&settings, 0, sizeof(settings));
+	settings.gyro.enabled = true;
+	settings.gyro.scale = 245;
+	settings.gyro.sampleRate = 6;
+	settings.accel.enabled = true;
+	settings.accel.scale = 2;
+	settings.accel.sampleRate = 6;
+	settings.accel.bandwidth = -1;
+	settings.mag.enabled = true;
+	settings.mag.scale = 4;
+	settings.mag.sampleRate = 7;
+
+	if (strcmp(script, "still") == 0)
+		ok = LSM9DS1_synthInit(&synth, &settings, still, 1, seed);
+	else if (strcmp(script, "tumble") == 0)
+		ok = LSM9DS1_synthInit(&synth, &settings, tumble, sizeof(tumble) / sizeof(tumble[0]), seed);
+	else
+		ok = LSM9DS1_synthInit(&synth, &settings, motion, sizeof(motion) / sizeof(motion[0]), seed);
+	if (!ok)
+		return 2;
+	synth.loop = (strcmp(script, "tumble") != 0);
+	if (!synth.loop)
+	{
+		for (duration = 0.0, got = 0; got < sizeof(tumble) / sizeof(tumble[0]); got++)
+			duration += tumble[got].duration;
+	}
+
+	if (errors)
+	{
+		state = ((uint64_t)seed << 32) ^ 0xD1B54A32D192ED03ULL;
+		unitErrors(&synth.gyroErrors, &state, 1.0f, 0.03f, 0.01f, 0.02f);
+		unitErrors(&synth.accelErrors, &state, 0.05f, 0.02f, 0.01f, 0.001f);
+		unitErrors(&synth.magErrors, &state, 0.3f, 0.1f, 0.05f, 0.0f);
+		printErrors("gyro", &synth.gyroErrors);
+		printErrors("accel", &synth.accelErrors);
+		printErrors("mag", &synth.magErrors);
+	}
+
+	wanted = (uint64_t)(duration / synth.period + 0.5);
+	start = seconds();
+	if (calLog)
+	{
+		memset(&logged, 0, sizeof(logged));
+		LSM9DS1_calLogHeader(header, (uint32_t)lrint(synth.period * 1e9), synth.gyroScale,
+		                     synth.accelScale, synth.magScale);
+		fwrite(header, 1, sizeof(header), out);
+	}
+	while (total < wanted)
+	{
+		if (calLog)
+		{
+			synth.temperatureC = 25.0f + (float)(warmUp * total / wanted);
+			if (!LSM9DS1_synthStep(&synth, &sample))
+				break;
+			memcpy(logged.gyro, sample.gyro, sizeof(logged.gyro));
+			memcpy(logged.accel, sample.accel, sizeof(logged.accel));
+			if (sample.magReady)
+				memcpy(logged.mag, sample.mag, sizeof(logged.mag));
+			logged.temperature = sample.temperature;
+			logged.flags = sample.magReady ? LSM9DS1_CAL_MAG_NEW : 0;
+			LSM9DS1_calLogPack(record, &logged);
+			fwrite(record, 1, sizeof(record), out);
+			total++;
+			continue;
+		}
+		got = LSM9DS1_synthFifo(&synth, block,
+		                        (wanted - total > BLOCK) ? BLOCK : (uint16_t)(wanted - total),
+		                        sampleBytes);
+		if (got == 0)
+			break;
+		fwrite(block, sampleBytes, got, out);
+		total += got;
+	}
+	elapsed = seconds() - start;
+	fprintf(stderr, "%llu samples (%.1f s of data) in %.2f s, %.0fx real time\n",
+	        (unsigned long long)total, total * synth.period, elapsed,
+	        total * synth.period / (elapsed > 0.0 ? elapsed : 1e-9));
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,2 @@
+// FreeRTOS stand-in, see tm4c_host.h
+#include "tm4c_host.h"
@@ -0,0 +1,420 @@
+/******************************************************************************
+
+	tm4c_host.c
+	Host stand-in for the TivaWare and FreeRTOS calls made by i2c_if.c.
+
+See tm4c_host.h.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "tm4c_host.h"
+
+#define MASTERS			4
+#define SLAVES			8
+
+#define CMD_RUN			0x01
+#define CMD_START		0x02
+#define CMD_STOP		0x04
+
+typedef struct
+{
+	uint32_t base;
+	uint8_t addr;
+	uint8_t *regs;
+	uint8_t pointer;
+	bool pointerSet;          // the first byte of a write was the pointer
+} host_slave;
+
+typedef struct
+{
+	uint8_t addr;
+	bool receive;
+	uint8_t data;
+	uint32_t err;
+	bool intEnabled;
+	bool intRaw;
+	host_slave *active;       // addressed slave between START and STOP
+} host_master;
+
+struct TM4CHostQueue
+{
+	uint8_t *storage;
+	UBaseType_t length, itemSize;
+	UBaseType_t head, count;
+};
+
+volatile uint32_t g_ulTM4CHostDWT[2];
+
+static host_master masters[MASTERS];
+static host_slave slaves[SLAVES];
+static uint8_t slaveCount;
+
+static const uint32_t masterInt[MASTERS] = { INT_I2C0, INT_I2C1, INT_I2C2, INT_I2C3 };
+static void (*handler[TM4C_HOST_INTS])(void);
+static uint32_t handled[TM4C_HOST_INTS];          // interrupts with a handler
+static uint32_t handledCount;
+static bool intEnabled[TM4C_HOST_INTS];
+static bool intPending[TM4C_HOST_INTS];
+static uint32_t pendingCount;
+static bool masked;
+static bool inHandler;
+
+static uint32_t notifyValue;
+static bool notifyPending;
+
+static TM4CHostCounters counters;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ NVIC: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// Runs the pending handlers, as the core does on leaving a handler or on
+// unmasking
+static void dispatch(void)
+{
+	uint32_t ii, irq;
+	bool ran;
+
+	if (inHandler || masked || (pendingCount == 0))
+		return;
+	do
+	{
+		ran = false;
+		for (ii = 0; ii < handledCount; ii++)
+		{
+			irq = handled[ii];
+			if (intPending[irq] && intEnabled[irq])
+			{
+				intPending[irq] = false;
+				pendingCount--;
+				inHandler = true;
+				counters.ulISREntries++;
+				handler[irq]();
+				inHandler = false;
+				ran = true;
+			}
+		}
+	} while (ran && (pendingCount > 0));
+}
+
+void IntEnable(uint32_t ui32Interrupt)
+{
+	intEnabled[ui32Interrupt] = true;
+	dispatch();
+}
+
+void IntDisable(uint32_t ui32Interrupt)
+{
+	intEnabled[ui32Interrupt] = false;
+}
+
+void IntPendSet(uint32_t ui32Interrupt)
+{
+	if (!intPending[ui32Interrupt])
+	{
+		intPending[ui32Interrupt] = true;
+		pendingCount++;
+	}
+	dispatch();
+}
+
+void IntPrioritySet(uint32_t ui32Interrupt, uint8_t ui8Priority)
+{
+	(void)ui32Interrupt;
+	(void)ui8Priority;
+}
+
+bool IntMasterEnable(void)
+{
+	bool was = masked;
+
+	masked = false;
+	dispatch();
+	return was;
+}
+
+bool IntMasterDisable(void)
+{
+	bool was = masked;
+
+	masked = true;
+	return was;
+}
+
+void TM4CHostSetHandler(uint32_t ulInt, void (*pfnHandler)(void))
+{
+	if (handler[ulInt] == NULL)
+		handled[handledCount++] = ulInt;
+	handler[ulInt] = pfnHandler;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ I2C: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static uint32_t masterIndex(uint32_t base)
+{
+	uint32_t index = (base - I2C0_BASE) >> 12;
+
+	if (index >= MASTERS)
+	{
+		fprintf(stderr, "tm4c_host: no I2C master at 0x%08x\n", (unsigned)base);
+		abort();
+	}
+	return index;
+}
+
+static host_master *master(uint32_t base)
+{
+	return &masters[masterIndex(base)];
+}
+
+// Raises the master interrupt line into the NVIC while it is enabled
+static void masterLine(uint32_t base)
+{
+	host_master *m = master(base);
+
+	if (m->intRaw && m->intEnabled)
+		IntPendSet(masterInt[masterIndex(base)]);
+}
+
+void TM4CHostAddSlave(uint32_t ulBase, uint8_t ucAddr, uint8_t *pucRegs)
+{
+	if (slaveCount == SLAVES)
+		abort();
+	slaves[slaveCount].base = ulBase;
+	slaves[slaveCount].addr = ucAddr;
+	slaves[slaveCount].regs = pucRegs;
+	slaveCount++;
+}
+
+void I2CMasterInitExpClk(uint32_t ui32Base, uint32_t ui32SysClk, bool bFast)
+{
+	(void)ui32SysClk;
+	(void)bFast;
+	memset(master(ui32Base), 0, sizeof(host_master));
+}
+
+void I2CMasterTimeoutSet(uint32_t ui32Base, uint32_t ui32Value)
+{
+	(void)ui32Base;
+	(void)ui32Value;
+}
+
+void I2CMasterSlaveAddrSet(uint32_t ui32Base, uint8_t ui8SlaveAddr, bool bReceive)
+{
+	host_master *m = master(ui32Base);
+
+	m->addr = ui8SlaveAddr;
+	m->receive = bReceive;
+}
+
+void I2CMasterDataPut(uint32_t ui32Base, uint8_t ui8Data)
+{
+	master(ui32Base)->data = ui8Data;
+}
+
+uint32_t I2CMasterDataGet(uint32_t ui32Base)
+{
+	return master(ui32Base)->data;
+}
+
+void I2CMasterControl(uint32_t ui32Base, uint32_t ui32Cmd)
+{
+	host_master *m = master(ui32Base);
+	host_slave *s;
+	uint8_t ii;
+
+	counters.ulCommands++;
+	m->err = I2C_MASTER_ERR_NONE;
+	if (ui32Cmd & CMD_START)
+	{
+		m->active = NULL;
+		for (ii = 0; ii < slaveCount; ii++)
+		{
+			if ((slaves[ii].base == ui32Base) && (slaves[ii].addr == m->addr))
+				m->active = &slaves[ii];
+		}
+		if (m->active == NULL)
+			m->err = I2C_MASTER_ERR_ADDR_ACK;
+		else if (!m->receive)
+			m->active->pointerSet = false;
+	}
+	if ((ui32Cmd & CMD_RUN) && (m->err == I2C_MASTER_ERR_NONE))
+	{
+		s = m->active;
+		if (s == NULL)
+			m->err = I2C_MASTER_ERR_ADDR_ACK;
+		else if (m->receive)
+			m->data = s->regs[s->pointer++];
+		else if (!s->pointerSet)
+		{
+			s->pointer = m->data;
+			s->pointerSet = true;
+		}
+		else
+			s->regs[s->pointer++] = m->data;
+	}
+	if ((ui32Cmd & CMD_STOP) || (m->err != I2C_MASTER_ERR_NONE))
+		m->active = NULL;
+
+	m->intRaw = true;
+	masterLine(ui32Base);
+}
+
+uint32_t I2CMasterErr(uint32_t ui32Base)
+{
+	return master(ui32Base)->err;
+}
+
+void I2CMasterIntEnable(uint32_t ui32Base)
+{
+	master(ui32Base)->intEnabled = true;
+	masterLine(ui32Base);
+}
+
+void I2CMasterIntDisable(uint32_t ui32Base)
+{
+	master(ui32Base)->intEnabled = false;
+}
+
+void I2CMasterIntClear(uint32_t ui32Base)
+{
+	master(ui32Base)->intRaw = false;
+}
+
+void I2CMasterIntClearEx(uint32_t ui32Base, uint32_t ui32IntFlags)
+{
+	if (ui32IntFlags)
+		master(ui32Base)->intRaw = false;
+}
+
+uint32_t I2CMasterIntStatusEx(uint32_t ui32Base, bool bMasked)
+{
+	host_master *m = master(ui32Base);
+
+	return (m->intRaw && (!bMasked || m->intEnabled)) ? 1 : 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ FREERTOS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return &notifyValue;
+}
+
+void vTaskDelay(TickType_t xTicks)
+{
+	(void)xTicks;
+	dispatch();
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulClearOnEntry, uint32_t ulClearOnExit,
+                           uint32_t *pulValue, TickType_t xTicks)
+{
+	(void)xTicks;
+	counters.ulCritical++;
+	if (!notifyPending)
+		notifyValue &= ~ulClearOnEntry;
+	dispatch();
+	if (!notifyPending)
+	{
+		fprintf(stderr, "tm4c_host: the task waits for a notification nothing will send\n");
+		abort();
+	}
+	if (pulValue != NULL)
+		*pulValue = notifyValue;
+	notifyValue &= ~ulClearOnExit;
+	notifyPending = false;
+	return pdTRUE;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTask, uint32_t ulValue,
+                              eNotifyAction eAction, BaseType_t *pxWoken)
+{
+	(void)xTask;
+	(void)eAction;
+	counters.ulCritical++;
+	notifyValue |= ulValue;
+	notifyPending = true;
+	if (pxWoken != NULL)
+		*pxWoken = pdTRUE;
+	return pdPASS;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize)
+{
+	QueueHandle_t queue = calloc(1, sizeof(*queue));
+
+	if ((queue == NULL) || ((queue->storage = calloc(uxLength, uxItemSize)) == NULL))
+		abort();
+	queue->length = uxLength;
+	queue->itemSize = uxItemSize;
+	return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+	free(xQueue->storage);
+	free(xQueue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItem, TickType_t xTicks)
+{
+	(void)xTicks;
+	counters.ulCritical++;
+	if (xQueue->count == xQueue->length)
+	{
+		fprintf(stderr, "tm4c_host: the task blocks on a full queue\n");
+		abort();
+	}
+	memcpy(xQueue->storage + ((xQueue->head + xQueue->count) % xQueue->length) * xQueue->itemSize,
+	       pvItem, xQueue->itemSize);
+	xQueue->count++;
+	counters.ulQueueBytes += xQueue->itemSize;
+	return pdPASS;
+}
+
+BaseType_t xQueuePeekFromISR(QueueHandle_t xQueue, void *pvBuffer)
+{
+	counters.ulCritical++;
+	if (xQueue->count == 0)
+		return pdFALSE;
+	memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->itemSize, xQueue->itemSize);
+	counters.ulQueueBytes += xQueue->itemSize;
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void *pvBuffer, BaseType_t *pxWoken)
+{
+	(void)pxWoken;
+	if (xQueuePeekFromISR(xQueue, pvBuffer) != pdTRUE)
+		return pdFALSE;
+	xQueue->head = (xQueue->head + 1) % xQueue->length;
+	xQueue->count--;
+	return pdTRUE;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ MODEL: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+void TM4CHostGetCounters(TM4CHostCounters *psCounters, bool bReset)
+{
+	*psCounters = counters;
+	if (bReset)
+		memset(&counters, 0, sizeof(counters));
+}
+
+uint32_t TM4CHostCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (uint32_t)__rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000000000ULL + now.tv_nsec);
+#endif
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+
+	tm4c_host.h
+	Host stand-in for the TivaWare and FreeRTOS calls made by i2c_if.c.
+
+Lets the TM4C backend (i2c_if.c, ISR and all) run on a PC, for the checks
+and benchmarks in tools/. Build with -Itm4c_host and tm4c_host.c; the
+TivaWare and FreeRTOS header names in this directory all include this
+file.
+
+The I2C master executes each MasterControl command at once, bit by bit as
+the hardware does (START, RUN, STOP, ACK), against register-file slaves
+added with TM4CHostAddSlave: the first byte written sets the register
+pointer, which then increments on every byte. An address nobody answers is
+NAKed. Every command raises the master interrupt; with it enabled the NVIC
+model runs the handler given to TM4CHostSetHandler as soon as the code
+leaves the handler and has interrupts unmasked, so a blocking call has its
+whole transaction done by the time it waits.
+
+There is one task. The FreeRTOS queue and notification calls behave as the
+kernel's and count the critical sections they enter and the bytes they
+copy (TM4CHostGetCounters), which is what the queue-based i2c_if.c paid
+per transaction. Waiting for a notification that can no longer come
+aborts the program.
+
+DWT_CYCCNT reads the host cycle counter (the TSC on x86).
+******************************************************************************/
+
+#ifndef __TM4C_HOST_H__
+#define __TM4C_HOST_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ TIVAWARE: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#define I2C0_BASE               0x40020000
+#define I2C1_BASE               0x40021000
+#define I2C2_BASE               0x40022000
+#define I2C3_BASE               0x40023000
+
+#define INT_I2C0                24
+#define INT_I2C1                53
+#define INT_I2C2                84
+#define INT_I2C3                85
+#define TM4C_HOST_INTS          160
+
+#define SYSCTL_PERIPH_I2C0      0xf0002000
+#define SYSCTL_PERIPH_I2C1      0xf0002001
+#define SYSCTL_PERIPH_I2C2      0xf0002002
+#define SYSCTL_PERIPH_I2C3      0xf0002003
+#define SYSCTL_PERIPH_GPIOA     0xf0000800
+#define SYSCTL_PERIPH_GPIOB     0xf0000801
+#define SYSCTL_PERIPH_GPIOD     0xf0000803
+#define SYSCTL_PERIPH_GPIOE     0xf0000804
+
+#define GPIO_PORTA_BASE         0x40004000
+#define GPIO_PORTB_BASE         0x40005000
+#define GPIO_PORTD_BASE         0x40007000
+#define GPIO_PORTE_BASE         0x40024000
+#define GPIO_PIN_0              0x01
+#define GPIO_PIN_1              0x02
+#define GPIO_PIN_2              0x04
+#define GPIO_PIN_3              0x08
+#define GPIO_PIN_4              0x10
+#define GPIO_PIN_5              0x20
+#define GPIO_PIN_6              0x40
+#define GPIO_PIN_7              0x80
+#define GPIO_PA6_I2C1SCL        0x00001803
+#define GPIO_PA7_I2C1SDA        0x00001C03
+#define GPIO_PB2_I2C0SCL        0x00010803
+#define GPIO_PB3_I2C0SDA        0x00010C03
+#define GPIO_PD0_I2C3SCL        0x00030003
+#define GPIO_PD1_I2C3SDA        0x00030403
+#define GPIO_PE4_I2C2SCL        0x00041003
+#define GPIO_PE5_I2C2SDA        0x00041403
+#define GPIO_STRENGTH_12MA      0x00000067
+#define GPIO_PIN_TYPE_STD_WPU   0x0000000A
+
+// Master commands: bit 0 RUN, 1 START, 2 STOP, 3 ACK
+#define I2C_MASTER_CMD_SINGLE_SEND              0x00000007
+#define I2C_MASTER_CMD_SINGLE_RECEIVE           0x00000007
+#define I2C_MASTER_CMD_BURST_SEND_START         0x00000003
+#define I2C_MASTER_CMD_BURST_SEND_CONT          0x00000001
+#define I2C_MASTER_CMD_BURST_SEND_FINISH        0x00000005
+#define I2C_MASTER_CMD_BURST_SEND_STOP          0x00000004
+#define I2C_MASTER_CMD_BURST_SEND_ERROR_STOP    0x00000004
+#define I2C_MASTER_CMD_BURST_RECEIVE_START      0x0000000b
+#define I2C_MASTER_CMD_BURST_RECEIVE_CONT       0x00000009
+#define I2C_MASTER_CMD_BURST_RECEIVE_FINISH     0x00000005
+#define I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP 0x00000004
+
+#define I2C_MASTER_ERR_NONE     0
+#define I2C_MASTER_ERR_ADDR_ACK 0x00000004
+#define I2C_MASTER_ERR_DATA_ACK 0x00000008
+
+extern void I2CMasterInitExpClk(uint32_t ui32Base, uint32_t ui32SysClk, bool bFast);
+extern void I2CMasterTimeoutSet(uint32_t ui32Base, uint32_t ui32Value);
+extern void I2CMasterSlaveAddrSet(uint32_t ui32Base, uint8_t ui8SlaveAddr, bool bReceive);
+extern void I2CMasterDataPut(uint32_t ui32Base, uint8_t ui8Data);
+extern uint32_t I2CMasterDataGet(uint32_t ui32Base);
+extern void I2CMasterControl(uint32_t ui32Base, uint32_t ui32Cmd);
+extern uint32_t I2CMasterErr(uint32_t ui32Base);
+extern void I2CMasterIntEnable(uint32_t ui32Base);
+extern void I2CMasterIntDisable(uint32_t ui32Base);
+extern void I2CMasterIntClear(uint32_t ui32Base);
+extern void I2CMasterIntClearEx(uint32_t ui32Base, uint32_t ui32IntFlags);
+extern uint32_t I2CMasterIntStatusEx(uint32_t ui32Base, bool bMasked);
+
+extern void IntEnable(uint32_t ui32Interrupt);
+extern void IntDisable(uint32_t ui32Interrupt);
+extern void IntPendSet(uint32_t ui32Interrupt);
+extern void IntPrioritySet(uint32_t ui32Interrupt, uint8_t ui8Priority);
+extern bool IntMasterEnable(void);
+extern bool IntMasterDisable(void);
+
+// Clocks and pins have nothing to model
+#define SysCtlPeripheralEnable(periph)          ((void)(periph))
+#define SysCtlPeripheralDisable(periph)         ((void)(periph))
+#define SysCtlPeripheralSleepEnable(periph)     ((void)(periph))
+#define GPIOPadConfigSet(base, pins, str, type) ((void)(base), (void)(pins))
+#define GPIOPinConfigure(config)                ((void)(config))
+#define GPIOPinTypeI2C(base, pins)              ((void)(base), (void)(pins))
+#define GPIOPinTypeI2CSCL(base, pins)           ((void)(base), (void)(pins))
+
+#define MAP_I2CMasterInitExpClk                 I2CMasterInitExpClk
+#define MAP_I2CMasterTimeoutSet                 I2CMasterTimeoutSet
+#define MAP_I2CMasterSlaveAddrSet               I2CMasterSlaveAddrSet
+#define MAP_I2CMasterDataGet                    I2CMasterDataGet
+#define MAP_I2CMasterControl                    I2CMasterControl
+#define MAP_I2CMasterErr                        I2CMasterErr
+#define MAP_I2CMasterIntClearEx                 I2CMasterIntClearEx
+#define MAP_I2CMasterIntStatusEx                I2CMasterIntStatusEx
+#define MAP_IntEnable                           IntEnable
+#define MAP_IntPrioritySet                      IntPrioritySet
+#define MAP_GPIOPadConfigSet                    GPIOPadConfigSet
+#define ROM_SysCtlPeripheralEnable              SysCtlPeripheralEnable
+#define ROM_SysCtlPeripheralSleepEnable         SysCtlPeripheralSleepEnable
+#define ROM_GPIOPinConfigure                    GPIOPinConfigure
+#define ROM_GPIOPinTypeI2C                      GPIOPinTypeI2C
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ FREERTOS: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef struct TM4CHostQueue *QueueHandle_t;
+typedef enum { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite } eNotifyAction;
+
+#define configCPU_CLOCK_HZ      80000000UL
+#define configTICK_RATE_HZ      1000
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY 0xA0
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portEND_SWITCHING_ISR(woken) ((void)(woken))
+
+extern TaskHandle_t xTaskGetCurrentTaskHandle(void);
+extern void vTaskDelay(TickType_t xTicks);
+extern BaseType_t xTaskNotifyWait(uint32_t ulClearOnEntry, uint32_t ulClearOnExit,
+                                  uint32_t *pulValue, TickType_t xTicks);
+extern BaseType_t xTaskNotifyFromISR(TaskHandle_t xTask, uint32_t ulValue,
+                                     eNotifyAction eAction, BaseType_t *pxWoken);
+extern QueueHandle_t xQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize);
+extern void vQueueDelete(QueueHandle_t xQueue);
+extern BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItem, TickType_t xTicks);
+extern BaseType_t xQueuePeekFromISR(QueueHandle_t xQueue, void *pvBuffer);
+extern BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void *pvBuffer,
+                                       BaseType_t *pxWoken);
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ DWT: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+extern volatile uint32_t g_ulTM4CHostDWT[2];
+#define DEM_CR                  g_ulTM4CHostDWT[0]
+#define DWT_CTRL                g_ulTM4CHostDWT[1]
+#define DEM_CR_TRCENA           (1UL << 24)
+#define DWT_CTRL_CYCCNTENA      (1UL << 0)
+#define DWT_CYCCNT              TM4CHostCycles()
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ MODEL: ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+typedef struct
+{
+    unsigned long ulISREntries;     // handler runs
+    unsigned long ulCommands;       // I2CMasterControl calls
+    unsigned long ulCritical;       // kernel critical sections and ISR masks
+    unsigned long ulQueueBytes;     // bytes copied in and out of queues
+} TM4CHostCounters;
+
+// Handler run for interrupt ulInt (INT_I2Cn)
+extern void TM4CHostSetHandler(uint32_t ulInt, void (*pfnHandler)(void));
+
+// Slave at ucAddr on the bus at ulBase answering from pucRegs (256 bytes)
+extern void TM4CHostAddSlave(uint32_t ulBase, uint8_t ucAddr, uint8_t *pucRegs);
+
+extern void TM4CHostGetCounters(TM4CHostCounters *psCounters, bool bReset);
+extern uint32_t TM4CHostCycles(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif